@@ -29,25 +29,159 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "CO_app_STM32.h"
-//#include "CO_storageBlank.h"
 
 #ifdef CO_MULTIPLE_OD
-#ifndef CO_OD_COUNT
-#error Provide count of CAN ports you use
+#ifdef CO_APP_PORTS_HEADER
+#include CO_APP_PORTS_HEADER
 #endif
-
+#ifndef CO_APP_PORTS
 #include "OD1.h"
 #include "OD2.h"
 
+/* OD1 on the first and OD2 on the second CAN peripheral */
+#ifdef CO_STM32_FDCAN_Driver
+#define CO_APP_PORTS(X)                                                                                                \
+        X(FDCAN1, OD1, OD1_INIT_CONFIG, OD1_PERSIST_COMM, 0, 0)                                                        \
+        X(FDCAN2, OD2, OD2_INIT_CONFIG, OD2_PERSIST_COMM, 0, 0)
+#else
+#define CO_APP_PORTS(X)                                                                                                \
+        X(CAN1, OD1, OD1_INIT_CONFIG, OD1_PERSIST_COMM, 0, 0)                                                          \
+        X(CAN2, OD2, OD2_INIT_CONFIG, OD2_PERSIST_COMM, 0, 0)
+#endif
+#endif
+
+/* CO_new() configuration function of each Object Dictionary */
+#define CO_APP_PORT_CONFIG(instance, od, initConfig, persistComm, filterFirst, filterCount)                            \
+        static void prv_config_##od(CO_config_t *config) { initConfig(*config); }
+CO_APP_PORTS(CO_APP_PORT_CONFIG)
+#define CO_APP_PORT_CONFIG_FN(od) prv_config_##od
+
 #else
 #include "OD.h"
-#define CO_OD_COUNT 1
+
+#ifndef CO_APP_PORTS
+#define CO_APP_PORTS(X) X(NULL, OD, OD_INIT_CONFIG, OD_PERSIST_COMM, 0, 0)
+#endif
+#define CO_APP_PORT_CONFIG_FN(od) NULL
 #endif
-static CANopenNodeHandle* hCANopenNode_List[CO_OD_COUNT];
-static uint8_t hCANopenNode_Counter = 0;
 
+#if CO_ARENA_SIZE > 0
+#ifndef CO_MULTIPLE_OD
+/* Counts of optional objects missing in OD.h, as in CO_new() */
+#ifndef OD_CNT_NMT
+#define OD_CNT_NMT 0
+#endif
+#ifndef OD_CNT_EM
+#define OD_CNT_EM 0
+#endif
+#ifndef OD_CNT_ARR_1003
+#define OD_CNT_ARR_1003 0
+#endif
+#ifndef OD_CNT_SYNC
+#define OD_CNT_SYNC 0
+#endif
+#ifndef OD_CNT_TIME
+#define OD_CNT_TIME 0
+#endif
+#ifndef OD_CNT_GFC
+#define OD_CNT_GFC 0
+#endif
+#ifndef OD_CNT_SRDO
+#define OD_CNT_SRDO 0
+#endif
+#ifndef OD_CNT_HB_PROD
+#define OD_CNT_HB_PROD 0
+#endif
+#ifndef OD_CNT_HB_CONS
+#define OD_CNT_HB_CONS 0
+#endif
+#ifndef OD_CNT_ARR_1016
+#define OD_CNT_ARR_1016 0
+#endif
+#ifndef OD_CNT_SDO_SRV
+#define OD_CNT_SDO_SRV 0
+#endif
+#ifndef OD_CNT_SDO_CLI
+#define OD_CNT_SDO_CLI 0
+#endif
+#ifndef OD_CNT_RPDO
+#define OD_CNT_RPDO 0
+#endif
+#ifndef OD_CNT_TPDO
+#define OD_CNT_TPDO 0
+#endif
+#endif
+
+/* Static memory of each port for CO_new(), 8-byte aligned, sized for its
+ * Object Dictionary */
+#define CO_APP_PORT_ARENA(instance, od, initConfig, persistComm, filterFirst, filterCount)                             \
+        static uint64_t prv_arena_##od[CO_APP_ARENA_WORDS(od)];
+CO_APP_PORTS(CO_APP_PORT_ARENA)
+#define CO_APP_PORT_ARENA_INIT(od) , prv_arena_##od, CO_APP_ARENA_WORDS(od)
+
+static uint64_t *prv_arenaActive; /* Arena of port in CO_new() or NULL */
+static size_t prv_arenaWords;     /* Size of active arena */
+static size_t prv_arenaUsed;      /* Words used in active arena */
+
+void *CO_arena_alloc(size_t num, size_t size) {
+        size_t words = (num * size + 7U) / 8U;
+
+        if (prv_arenaActive == NULL || words > prv_arenaWords - prv_arenaUsed) {
+                return NULL;
+        }
+        void *ptr = &prv_arenaActive[prv_arenaUsed];
+        prv_arenaUsed += words;
+        memset(ptr, 0, words * 8U); /* calloc() semantics */
+        return ptr;
+}
+#else
+#define CO_APP_PORT_ARENA_INIT(od)
+#endif /* CO_ARENA_SIZE > 0 */
+
+/* Port descriptor table, built from CO_APP_PORTS */
+#define CO_APP_PORT_ENTRY(instance, od, initConfig, persistComm, filterFirst, filterCount)                             \
+        {(instance),                                                                                                   \
+         &(od),                                                                                                        \
+         CO_APP_PORT_CONFIG_FN(od),                                                                                    \
+         {&(persistComm).x1018_identity.vendor_ID, &(persistComm).x1018_identity.productCode,                          \
+          &(persistComm).x1018_identity.revisionNumber, &(persistComm).x1018_identity.serialNumber},                   \
+         &(persistComm),                                                                                               \
+         sizeof(persistComm),                                                                                          \
+         (filterFirst),                                                                                                \
+         (filterCount) CO_APP_PORT_ARENA_INIT(od)},
+static const CO_app_port_t prv_portTable[] = {CO_APP_PORTS(CO_APP_PORT_ENTRY)};
+#define CO_APP_PORT_COUNT (sizeof(prv_portTable) / sizeof(prv_portTable[0]))
+
+/* Handle of each port, set by CANopenNode_Init() */
+static CANopenNodeHandle *prv_handles[CO_APP_PORT_COUNT];
+
+#ifdef CO_MULTIPLE_OD
+/* CO_new() configuration of each port */
+static CO_config_t prv_config[CO_APP_PORT_COUNT];
+#endif
+
+#if CO_GATEWAY_STM32
+/* Gateway between ports or NULL, set by CANopenNode_SetGateway() */
+static CO_gateway_t *prv_gateway;
+#endif
+
+/* CAN peripherals are 1 kB aligned and within 32 kB of each other, so bits
+ * 10..14 of the instance address identify the peripheral */
+#define CO_APP_ROUTE_SIZE 32U
+#define CO_APP_ROUTE(instance) ((((uintptr_t)(instance)) >> 10) & (CO_APP_ROUTE_SIZE - 1U))
+static CANopenNodeHandle* hCANopenNode_Route[CO_APP_ROUTE_SIZE];
+
+/* Get CAN module of the node running on CAN peripheral, NULL if none */
+static inline CO_CANmodule_t* prv_route(const void* instance) {
+        CANopenNodeHandle* hCANopenNode = hCANopenNode_Route[CO_APP_ROUTE(instance)];
+        if (hCANopenNode == NULL || hCANopenNode->canOpen_Obj == NULL) {
+                return NULL;
+        }
+        return hCANopenNode->canOpen_Obj->CANmodule;
+}
 
 /* Printf function of CanOpen app */
 #ifndef CAN_OPEN_NODE_PRINTF
@@ -74,54 +208,351 @@ static uint8_t hCANopenNode_Counter = 0;
 #define OD_STATUS_BITS       NULL
 #endif
 
+#if CO_APP_TICKLESS
+/* Software generated compare event of CO_APP_TIMER_CHANNEL */
+#define CO_APP_TIMER_EVENT (TIM_EGR_CC1G << (CO_APP_TIMER_CHANNEL / 4U))
+
+static inline uint32_t prv_time_us(const CANopenNodeHandle *hCANopenHandle) {
+        return __HAL_TIM_GET_COUNTER(hCANopenHandle->timerHandle);
+}
+
+/* Set timer compare to the nearest deadline, called with CO_LOCK_OD.
+ * Deadline of CANopenNode_Process() counts only while no wakeup is pending,
+ * passed one would fire the timer again until the main loop runs. */
+static void prv_timer_schedule(CANopenNodeHandle *hCANopenHandle) {
+        uint32_t deadline = hCANopenHandle->timerNextIRQ;
+
+        if (!hCANopenHandle->wakeup && (int32_t)(hCANopenHandle->timerNextProcess - deadline) < 0) {
+                deadline = hCANopenHandle->timerNextProcess;
+        }
+        __HAL_TIM_SET_COMPARE(hCANopenHandle->timerHandle, CO_APP_TIMER_CHANNEL, deadline);
+        if ((int32_t)(deadline - prv_time_us(hCANopenHandle)) <= 0) {
+                /* Deadline passed, compare would match after counter wraps around */
+                hCANopenHandle->timerHandle->Instance->EGR = CO_APP_TIMER_EVENT;
+        }
+}
+#else
+/* Period of the timer, which calls CANopenNode_IRQ(), 10 ms on the central
+ * board, 1 ms otherwise and without BOARD_TYPE */
+#ifndef CO_APP_IRQ_PERIOD_US
+#if defined(BOARD_TYPE) && BOARD_TYPE==BOARD_TYPE_CENTRAL_BOARD
+#define CO_APP_IRQ_PERIOD_US 10000
+#else
+#define CO_APP_IRQ_PERIOD_US 1000
+#endif
+#endif
+#endif /* CO_APP_TICKLESS */
+
+/* Received frame may need processing before the next deadline */
+static inline void prv_rx_wakeup(CO_CANmodule_t *CANmodule, uint32_t fifo) {
+#if CO_APP_TICKLESS
+        CANopenNodeHandle *hCANopenHandle = CANmodule->CANptr;
+
+        hCANopenHandle->wakeup = true;
+        if (fifo == 0) {
+                /* SYNC and PDO, run CANopenNode_IRQ() now */
+                hCANopenHandle->timerHandle->Instance->EGR = CO_APP_TIMER_EVENT;
+        }
+#else
+        (void) CANmodule;
+        (void) fifo;
+#endif
+}
+
+#if CO_CAN_RX_TIMESTAMP
+/* Receive buffer of object, after CO_CANopenInit(), or rxSize if none */
+static uint16_t prv_rx_index(const CO_CANmodule_t *CANmodule, const void *object) {
+        uint16_t i = 0;
+
+        while (i < CANmodule->rxSize && CANmodule->rxArray[i].object != object) {
+                i++;
+        }
+        return i;
+}
+
+/* Stack objects restart their timers, when they process a received frame.
+ * Time elapsed_us for the stack is split at the newest reception among count
+ * receive buffers from index since the last call: the part before it is
+ * returned, the part after it is kept in lag_us and given with the next call.
+ * Timers so count from reception and no time is lost. */
+static uint32_t prv_rx_split(const CO_CANmodule_t *CANmodule, uint16_t index, uint16_t count,
+                             uint32_t elapsed_us, uint32_t *checked_us, uint32_t *lag_us) {
+        uint32_t now = CO_CAN_TIME_US();
+        uint32_t time_us = elapsed_us + *lag_us;
+        uint32_t age = time_us;
+
+        for (uint16_t i = index; i < CANmodule->rxSize && i - index < count; i++) {
+                uint32_t rxTime = CANmodule->rxArray[i].rxTime_us;
+
+                if ((int32_t)(rxTime - *checked_us) > 0 && (int32_t)(now - rxTime) >= 0 && now - rxTime < age) {
+                        age = now - rxTime;
+                }
+        }
+        *checked_us = now;
+        *lag_us = age < time_us ? age : 0;
+        return time_us - *lag_us;
+}
+
+#if CO_APP_TICKLESS
+/* Timers of the stack lag behind by lag_us, so does their next deadline */
+static void prv_timer_lag(uint32_t *timerNext_us, uint32_t lag_us) {
+        *timerNext_us = *timerNext_us > lag_us ? *timerNext_us - lag_us : 0;
+}
+#endif
+
+/* Time from reception of SYNC to its TPDOs in transmit mailboxes, if SYNC
+ * was received within elapsed_us */
+static void prv_sync_tpdo_time(CANopenNodeHandle *hCANopenHandle, uint32_t elapsed_us) {
+        const CO_CANmodule_t *CANmodule = hCANopenHandle->canOpen_Obj->CANmodule;
+
+        if (hCANopenHandle->syncRxIndex < CANmodule->rxSize) {
+                uint32_t age = CO_CAN_TIME_US() - CANmodule->rxArray[hCANopenHandle->syncRxIndex].rxTime_us;
+
+                if (age <= elapsed_us) {
+                        if (age < hCANopenHandle->syncTpdoMin_us) {
+                                hCANopenHandle->syncTpdoMin_us = age;
+                        }
+                        if (age > hCANopenHandle->syncTpdoMax_us) {
+                                hCANopenHandle->syncTpdoMax_us = age;
+                        }
+                }
+        }
+}
+#endif
+
+#if CO_APP_SYNC_OFFSET_US > 0
+/* Software generated compare event of CO_APP_SYNC_CHANNEL */
+#define CO_APP_SYNC_EVENT (TIM_EGR_CC1G << (CO_APP_SYNC_CHANNEL / 4U))
+
+/* Synchronous TPDOs of a received SYNC are sampled CO_APP_SYNC_OFFSET_US
+ * after its reception, when compare of CO_APP_SYNC_CHANNEL runs
+ * CANopenNode_IRQ() again. SYNC itself and RPDOs are processed right away.
+ * Called with CO_LOCK_OD after CO_process_SYNC(), returns true when
+ * synchronous TPDOs are due. */
+static bool_t prv_sync_tpdo(CANopenNodeHandle *hCANopenHandle, bool_t syncWas, uint32_t time_current) {
+        if (syncWas) {
+                uint32_t age = 0;
+#if CO_CAN_RX_TIMESTAMP
+                const CO_CANmodule_t *CANmodule = hCANopenHandle->canOpen_Obj->CANmodule;
+
+                if (hCANopenHandle->syncRxIndex < CANmodule->rxSize) {
+                        age = CO_CAN_TIME_US() - CANmodule->rxArray[hCANopenHandle->syncRxIndex].rxTime_us;
+                }
+#endif
+                if (age >= CO_APP_SYNC_OFFSET_US) {
+                        hCANopenHandle->syncHeld = false;
+                        return true;
+                }
+                hCANopenHandle->syncAt = time_current - age + CO_APP_SYNC_OFFSET_US;
+                hCANopenHandle->syncHeld = true;
+                __HAL_TIM_SET_COMPARE(hCANopenHandle->timerHandle, CO_APP_SYNC_CHANNEL, hCANopenHandle->syncAt);
+                if ((int32_t)(hCANopenHandle->syncAt - prv_time_us(hCANopenHandle)) <= 0) {
+                        hCANopenHandle->timerHandle->Instance->EGR = CO_APP_SYNC_EVENT;
+                }
+        }
+        if (!hCANopenHandle->syncHeld || (int32_t)(time_current - hCANopenHandle->syncAt) < 0) {
+                return false;
+        }
+        hCANopenHandle->syncHeld = false;
+        return true;
+}
+#endif
+
+#if CO_APP_PROCESS_IMAGE
+/* Copy Object Dictionary variables into process image buffer */
+static void prv_pi_gather(const CO_app_PI_t *pi, uint8_t *buffer) {
+        for (uint8_t i = 0; i < pi->entriesCount; i++) {
+                memcpy(buffer, pi->entries[i].odVariable, pi->entries[i].length);
+                buffer += pi->entries[i].length;
+        }
+}
+
+/* Copy process image buffer into Object Dictionary variables */
+static void prv_pi_scatter(const CO_app_PI_t *pi, const uint8_t *buffer) {
+        for (uint8_t i = 0; i < pi->entriesCount; i++) {
+                memcpy(pi->entries[i].odVariable, buffer, pi->entries[i].length);
+                buffer += pi->entries[i].length;
+        }
+}
+
+/* Gather inputs into buffer, which is not read by application, if gather
+ * is true, and scatter published outputs into Object Dictionary. Returns
+ * true, if the inputs must be published by a swap. */
+static bool_t prv_pi_exchange(CANopenNodeHandle *hCANopenHandle, bool_t gather) {
+        CO_app_PI_t *piIn = hCANopenHandle->piInputs;
+        CO_app_PI_t *piOut = hCANopenHandle->piOutputs;
+        bool_t publish = false;
+
+        if (gather && piIn != NULL && piIn->held != (piIn->front ^ 1U)) {
+                prv_pi_gather(piIn, piIn->buffer[piIn->front ^ 1U]);
+                __DMB();
+                publish = true;
+        }
+        if (piOut != NULL && piOut->fresh) {
+                piOut->fresh = false;
+                prv_pi_scatter(piOut, piOut->buffer[piOut->front]);
+        }
+        return publish;
+}
+
+const uint8_t *CANopenNode_PI_acquireInputs(CANopenNodeHandle *hCANopenHandle) {
+        CO_app_PI_t *pi = hCANopenHandle->piInputs;
+        uint8_t front;
+
+        /* CANopenNode_IRQ never writes the held buffer. If it swapped before
+         * hold was visible, take the newer one. */
+        do {
+                front = pi->front;
+                pi->held = front;
+                __DMB();
+        } while (front != pi->front);
+        return pi->buffer[front];
+}
+
+void CANopenNode_PI_releaseInputs(CANopenNodeHandle *hCANopenHandle) {
+        hCANopenHandle->piInputs->held = 0xFF;
+}
+
+uint8_t *CANopenNode_PI_outputs(CANopenNodeHandle *hCANopenHandle) {
+        CO_app_PI_t *pi = hCANopenHandle->piOutputs;
+        return pi->buffer[pi->front ^ 1U];
+}
+
+void CANopenNode_PI_publishOutputs(CANopenNodeHandle *hCANopenHandle) {
+        CO_app_PI_t *pi = hCANopenHandle->piOutputs;
+        __DMB();
+        pi->front ^= 1U;
+        pi->fresh = true;
+}
+#endif /* CO_APP_PROCESS_IMAGE */
+
+#ifdef CO_LOCK_BASEPRI
+/* Timer interrupt must not be more urgent than CO_LOCK_PRIORITY, or
+ * CO_LOCK_ENTER() would not mask it */
+static bool_t prv_timer_priority_ok(const TIM_TypeDef *instance) {
+#define PRV_TIMER_IRQ_CHECK(INSTANCE, IRQ) \
+        if (instance == (INSTANCE)) { \
+                return NVIC_GetPriority(IRQ) >= CO_LOCK_PRIORITY; \
+        }
+        CO_APP_TIMER_IRQS(PRV_TIMER_IRQ_CHECK)
+#undef PRV_TIMER_IRQ_CHECK
+        return false;
+}
+#endif
+
 /* This function will basically setup the CANopen node */
 CO_app_Status CANopenNode_Init(CANopenNodeHandle *hCANopenNode) {
-        hCANopenNode_List[hCANopenNode_Counter++] = hCANopenNode;
+#ifdef CO_LOCK_BASEPRI
+        if (!prv_timer_priority_ok(hCANopenNode->timerHandle->Instance)) {
+                CAN_OPEN_NODE_PRINTF("Error: Timer interrupt priority is more urgent than CO_LOCK_PRIORITY\n");
+                return CO_APP_ERROR;
+        }
+#endif
+#if CO_APP_TICKLESS
+        if (__HAL_TIM_GET_AUTORELOAD(hCANopenNode->timerHandle) != 0xFFFFFFFFU) {
+                CAN_OPEN_NODE_PRINTF("Error: Timer must be free running 32-bit\n");
+                return CO_APP_ERROR;
+        }
+#endif
+        /* Route slot is shared by peripherals 32 kB apart, which no STM32 has,
+         * but a different layout must not silently steal interrupts */
+        CANopenNodeHandle *routed = hCANopenNode_Route[CO_APP_ROUTE(hCANopenNode->CANHandle->Instance)];
+        if (routed != NULL && routed != hCANopenNode
+            && routed->CANHandle->Instance != hCANopenNode->CANHandle->Instance) {
+                CAN_OPEN_NODE_PRINTF("Error: CO_APP_ROUTE slot of CAN peripheral is used by another one\n");
+                return CO_APP_ERROR;
+        }
+        hCANopenNode_Route[CO_APP_ROUTE(hCANopenNode->CANHandle->Instance)] = hCANopenNode;
         hCANopenNode->activeNodeID = 0;
         hCANopenNode->canOpen_Obj = NULL;
         hCANopenNode->canOpen_Config = NULL;
         hCANopenNode->canOpen_HeapMemoryUsed = 0;
         hCANopenNode->canOpen_PrevProcessTime = 0;
-
-#if (CO_CONFIG_STORAGE) & CO_CONFIG_STORAGE_ENABLE
-        CO_storage_t storage;
-        CO_storage_entry_t storageEntries[] = {{.addr = &OD_PERSIST_COMM,
-                                                .len = sizeof(OD_PERSIST_COMM),
-                                                .subIndexOD = 2,
-                                                .attr = CO_storage_cmd | CO_storage_restore,
-                                                .addrNV = NULL}};
-        uint8_t storageEntriesCount = sizeof(storageEntries) / sizeof(storageEntries[0]);
-        uint32_t storageInitError = 0;
+        hCANopenNode->warmReset = false;
+        hCANopenNode->resetTime = 0;
+#if CO_APP_TICKLESS
+        hCANopenNode->wakeup = true;
+#endif
+#if CO_APP_PROCESS_IMAGE
+        if (hCANopenNode->piInputs != NULL) {
+                hCANopenNode->piInputs->front = 0;
+                hCANopenNode->piInputs->held = 0xFF;
+        }
+        if (hCANopenNode->piOutputs != NULL) {
+                hCANopenNode->piOutputs->front = 0;
+                hCANopenNode->piOutputs->fresh = false;
+        }
+        hCANopenNode->piStale = true;
+        hCANopenNode->piRxDelivered = 0;
 #endif
+
+        /* Port descriptor of the peripheral */
+        uint8_t port = 0;
+        while (port < CO_APP_PORT_COUNT && prv_portTable[port].instance != NULL
+               && prv_portTable[port].instance != hCANopenNode->CANHandle->Instance) {
+                port++;
+        }
+        if (port >= CO_APP_PORT_COUNT || (prv_handles[port] != NULL && prv_handles[port] != hCANopenNode)) {
+                CAN_OPEN_NODE_PRINTF("Error: CAN peripheral is not in CO_APP_PORTS or already used\n");
+                return CO_APP_ERROR;
+        }
+        prv_handles[port] = hCANopenNode;
+        hCANopenNode->port = &prv_portTable[port];
+
         /* Allocate memory */
 #ifdef CO_MULTIPLE_OD
-        hCANopenNode->canOpen_Config = malloc(sizeof(CO_config_t));
-        if (hCANopenNode->CANHandle->Instance == CAN1) {
-                OD1_INIT_CONFIG(*hCANopenNode->canOpen_Config);
-        } else if (hCANopenNode->CANHandle->Instance == CAN2) {
-                OD2_INIT_CONFIG(*hCANopenNode->canOpen_Config);
-        }
+        hCANopenNode->canOpen_Config = &prv_config[port];
+        hCANopenNode->port->initConfig(hCANopenNode->canOpen_Config);
 
         hCANopenNode->canOpen_Config->CNT_LEDS = true;
         hCANopenNode->canOpen_Config->CNT_LSS_SLV = true;
 #endif /* CO_MULTIPLE_OD */
 
+#if CO_ARENA_SIZE > 0
+        prv_arenaActive = hCANopenNode->port->arena;
+        prv_arenaWords = hCANopenNode->port->arenaWords;
+        prv_arenaUsed = 0;
+#else
+        (void) port;
+#endif
         hCANopenNode->canOpen_Obj = CO_new(hCANopenNode->canOpen_Config, &hCANopenNode->canOpen_HeapMemoryUsed);
+#if CO_ARENA_SIZE > 0
+        prv_arenaActive = NULL;
+        hCANopenNode->canOpen_HeapMemoryUsed = prv_arenaUsed * 8U;
+#endif
         if (hCANopenNode->canOpen_Obj == NULL) {
                 CAN_OPEN_NODE_PRINTF("Error: Can't allocate memory\n");
                 return CO_APP_ERROR_CAN_NOT_ALLOCATE_MEMORY;
         } else {
+#if CO_ARENA_SIZE > 0
+                CAN_OPEN_NODE_PRINTF("Allocated %u of %u bytes arena for CANopen objects\n",
+                                     (unsigned) hCANopenNode->canOpen_HeapMemoryUsed,
+                                     (unsigned) (prv_arenaWords * 8U));
+#else
                 CAN_OPEN_NODE_PRINTF("Allocated %u bytes for CANopen objects\n", hCANopenNode->canOpen_HeapMemoryUsed);
+#endif
         }
 
 #if (CO_CONFIG_STORAGE) & CO_CONFIG_STORAGE_ENABLE
-        err = CO_storageBlank_init(&storage, CO->CANmodule, OD_ENTRY_H1010_storeParameters,
-                                   OD_ENTRY_H1011_restoreDefaultParameters, storageEntries, storageEntriesCount,
-                                   &storageInitError);
+        /* Restore communication parameters before CO_CANopenInit() uses them */
+        hCANopenNode->storageInitError = 0;
+        if (hCANopenNode->storageRegion != NULL) {
+                CO_storage_entry_t *entry = &hCANopenNode->storageEntries[0];
+                OD_t *od = *hCANopenNode->port->od;
+
+                entry->addr = hCANopenNode->port->persistComm;
+                entry->len = hCANopenNode->port->persistCommSize;
+                entry->subIndexOD = 2;
+                entry->attr = CO_APP_STORAGE_ATTR;
+                CO_ReturnError_t err = CO_storageFlash_init(
+                        &hCANopenNode->storageFlash, &hCANopenNode->storage, hCANopenNode->canOpen_Obj->CANmodule,
+                        OD_find(od, 0x1010), OD_find(od, 0x1011), hCANopenNode->storageRegion,
+                        hCANopenNode->storageEntries, CO_APP_STORAGE_ENTRIES, &hCANopenNode->storageInitError);
 
-        if (err != CO_ERROR_NO && err != CO_ERROR_DATA_CORRUPT) {
-            CAN_OPEN_NODE_PRINTF("Error: Storage %d\n", storageInitError);
-            return 2;
+                if (err != CO_ERROR_NO && err != CO_ERROR_DATA_CORRUPT) {
+                        CAN_OPEN_NODE_PRINTF("Error: Storage %d: %d\n", (int) hCANopenNode->storageInitError, err);
+                        return CO_APP_ERROR;
+                }
         }
 #endif
 
@@ -136,9 +567,11 @@ CANopenNode_ResetCommunication(CANopenNodeHandle *hCANopenHandle) {
         /* Wait rt_thread. */
         hCANopenHandle->canOpen_Obj->CANmodule->CANnormal = false;
 
-        /* Enter CAN configuration. */
-        CO_CANsetConfigurationMode((void *) hCANopenHandle);
-        CO_CANmodule_disable(hCANopenHandle->canOpen_Obj->CANmodule);
+        /* Enter CAN configuration, unless warm reset keeps CAN running. */
+        if (!hCANopenHandle->warmReset) {
+                CO_CANsetConfigurationMode((void *) hCANopenHandle);
+                CO_CANmodule_disable(hCANopenHandle->canOpen_Obj->CANmodule);
+        }
 
         /* initialize CANopen */
         CO_ReturnError_t err = CO_CANinit(hCANopenHandle->canOpen_Obj,
@@ -149,29 +582,15 @@ CANopenNode_ResetCommunication(CANopenNodeHandle *hCANopenHandle) {
                 return 1;
         }
 
-#ifdef CO_MULTIPLE_OD
-        CO_LSS_address_t lssAddress = {0};
-        if (hCANopenHandle->CANHandle->Instance == CAN1) {
-                lssAddress.identity.vendorID = OD1_PERSIST_COMM.x1018_identity.vendor_ID;
-                lssAddress.identity.productCode = OD1_PERSIST_COMM.x1018_identity.productCode;
-                lssAddress.identity.revisionNumber = OD1_PERSIST_COMM.x1018_identity.revisionNumber;
-                lssAddress.identity.serialNumber = OD1_PERSIST_COMM.x1018_identity.serialNumber;
-        } else if (hCANopenHandle->CANHandle->Instance == CAN2) {
-                lssAddress.identity.vendorID = OD2_PERSIST_COMM.x1018_identity.vendor_ID;
-                lssAddress.identity.productCode = OD2_PERSIST_COMM.x1018_identity.productCode;
-                lssAddress.identity.revisionNumber = OD2_PERSIST_COMM.x1018_identity.revisionNumber;
-                lssAddress.identity.serialNumber = OD2_PERSIST_COMM.x1018_identity.serialNumber;
-        }
-#else
+        const CO_app_port_t *port = hCANopenHandle->port;
         CO_LSS_address_t lssAddress = {
                 .identity = {
-                        .vendorID = OD_PERSIST_COMM.x1018_identity.vendor_ID,
-                        .productCode = OD_PERSIST_COMM.x1018_identity.productCode,
-                        .revisionNumber = OD_PERSIST_COMM.x1018_identity.revisionNumber,
-                        .serialNumber = OD_PERSIST_COMM.x1018_identity.serialNumber
+                        .vendorID = *port->identity[0],
+                        .productCode = *port->identity[1],
+                        .revisionNumber = *port->identity[2],
+                        .serialNumber = *port->identity[3]
                 }
         };
-#endif
         err = CO_LSSinit(
                 hCANopenHandle->canOpen_Obj,
                 &lssAddress,
@@ -186,39 +605,10 @@ CANopenNode_ResetCommunication(CANopenNodeHandle *hCANopenHandle) {
         hCANopenHandle->activeNodeID = hCANopenHandle->desiredNodeID;
         uint32_t errInfo = 0;
 
-#ifdef CO_MULTIPLE_OD
-        if (hCANopenHandle->CANHandle->Instance == CAN1)
-                err = CO_CANopenInit(
-                        hCANopenHandle->canOpen_Obj,                   /* CANopen object */
-                        NULL,                 /* alternate NMT */
-                        NULL,                 /* alternate em */
-                        OD1,                   /* Object dictionary */
-                        OD_STATUS_BITS,       /* Optional OD_statusBits */
-                        NMT_CONTROL,          /* CO_NMT_control_t */
-                        FIRST_HB_TIME,        /* firstHBTime_ms */
-                        SDO_SRV_TIMEOUT_TIME, /* SDOserverTimeoutTime_ms */
-                        SDO_CLI_TIMEOUT_TIME, /* SDOclientTimeoutTime_ms */
-                        SDO_CLI_BLOCK,        /* SDOclientBlockTransfer */
-                        hCANopenHandle->activeNodeID, &errInfo);
-        else if (hCANopenHandle->CANHandle->Instance == CAN2) {
-                err = CO_CANopenInit(
-                        hCANopenHandle->canOpen_Obj,                   /* CANopen object */
-                        NULL,                 /* alternate NMT */
-                        NULL,                 /* alternate em */
-                        OD2,                   /* Object dictionary */
-                        OD_STATUS_BITS,       /* Optional OD_statusBits */
-                        NMT_CONTROL,          /* CO_NMT_control_t */
-                        FIRST_HB_TIME,        /* firstHBTime_ms */
-                        SDO_SRV_TIMEOUT_TIME, /* SDOserverTimeoutTime_ms */
-                        SDO_CLI_TIMEOUT_TIME, /* SDOclientTimeoutTime_ms */
-                        SDO_CLI_BLOCK,        /* SDOclientBlockTransfer */
-                        hCANopenHandle->activeNodeID, &errInfo);
-        }
-#else
         err = CO_CANopenInit(hCANopenHandle->canOpen_Obj,                   /* CANopen object */
                          NULL,                 /* alternate NMT */
                          NULL,                 /* alternate em */
-                         OD,                   /* Object dictionary */
+                         *port->od,            /* Object dictionary */
                          OD_STATUS_BITS,       /* Optional OD_statusBits */
                          NMT_CONTROL,          /* CO_NMT_control_t */
                          FIRST_HB_TIME,        /* firstHBTime_ms */
@@ -226,7 +616,6 @@ CANopenNode_ResetCommunication(CANopenNodeHandle *hCANopenHandle) {
                          SDO_CLI_TIMEOUT_TIME, /* SDOclientTimeoutTime_ms */
                          SDO_CLI_BLOCK,        /* SDOclientBlockTransfer */
                          hCANopenHandle->activeNodeID, &errInfo);
-#endif
         if (err != CO_ERROR_NO && err != CO_ERROR_NODE_ID_UNCONFIGURED_LSS) {
                 if (err == CO_ERROR_OD_PARAMETERS) {
                         CAN_OPEN_NODE_PRINTF("Error: Object Dictionary entry 0x%X\n", errInfo);
@@ -236,19 +625,8 @@ CANopenNode_ResetCommunication(CANopenNodeHandle *hCANopenHandle) {
                 return 3;
         }
 
-#ifdef CO_MULTIPLE_OD
-        if (hCANopenHandle->CANHandle->Instance == CAN1) {
-                err = CO_CANopenInitPDO(hCANopenHandle->canOpen_Obj,
-                                        hCANopenHandle->canOpen_Obj->em, OD1,
-                                        hCANopenHandle->activeNodeID, &errInfo);
-        } else if (hCANopenHandle->CANHandle->Instance == CAN2) {
-                err = CO_CANopenInitPDO(hCANopenHandle->canOpen_Obj,
-                                        hCANopenHandle->canOpen_Obj->em, OD2,
-                                        hCANopenHandle->activeNodeID, &errInfo);
-        }
-#else
-        err = CO_CANopenInitPDO(hCANopenHandle->canOpen_Obj, hCANopenHandle->canOpen_Obj->em, OD, hCANopenHandle->activeNodeID, &errInfo);
-#endif
+        err = CO_CANopenInitPDO(hCANopenHandle->canOpen_Obj, hCANopenHandle->canOpen_Obj->em, *port->od,
+                                hCANopenHandle->activeNodeID, &errInfo);
         if (err != CO_ERROR_NO) {
                 if (err == CO_ERROR_OD_PARAMETERS) {
                         CAN_OPEN_NODE_PRINTF("Error: Object Dictionary entry 0x%X\n", errInfo);
@@ -258,9 +636,75 @@ CANopenNode_ResetCommunication(CANopenNodeHandle *hCANopenHandle) {
                 return 4;
         }
 
+#if CO_CAN_RX_TIMESTAMP
+        hCANopenHandle->syncRxIndex = 0xFFFF;
+        hCANopenHandle->hbRxIndex = 0xFFFF;
+#if (CO_CONFIG_SYNC) & CO_CONFIG_SYNC_ENABLE
+        if (hCANopenHandle->canOpen_Obj->SYNC != NULL) {
+                hCANopenHandle->syncRxIndex = prv_rx_index(hCANopenHandle->canOpen_Obj->CANmodule,
+                                                           hCANopenHandle->canOpen_Obj->SYNC);
+        }
+#endif
+        hCANopenHandle->syncTpdoMin_us = UINT32_MAX;
+        hCANopenHandle->syncTpdoMax_us = 0;
+        hCANopenHandle->syncRxChecked_us = CO_CAN_TIME_US();
+        hCANopenHandle->syncLag_us = 0;
+        hCANopenHandle->hbRxCount = 0;
+        hCANopenHandle->hbRxChecked_us = hCANopenHandle->syncRxChecked_us;
+        hCANopenHandle->hbLag_us = 0;
+#if (CO_CONFIG_HB_CONS) & CO_CONFIG_HB_CONS_ENABLE
+        /* Nodes have consecutive receive buffers */
+        if (hCANopenHandle->canOpen_Obj->HBcons != NULL
+            && hCANopenHandle->canOpen_Obj->HBcons->numberOfMonitoredNodes > 0) {
+                hCANopenHandle->hbRxIndex = prv_rx_index(hCANopenHandle->canOpen_Obj->CANmodule,
+                                                         &hCANopenHandle->canOpen_Obj->HBcons->monitoredNodes[0]);
+                hCANopenHandle->hbRxCount = hCANopenHandle->canOpen_Obj->HBcons->numberOfMonitoredNodes;
+        }
+#endif
+#endif
 
-        /* Configure Timer interrupt function for execution every 1 millisecond */
-        HAL_TIM_Base_Start_IT(hCANopenHandle->timerHandle); //1ms interrupt
+#if CO_DIAG_STM32
+        CO_diag_init(&hCANopenHandle->diag, hCANopenHandle->canOpen_Obj->CANmodule, hCANopenHandle->canOpen_Obj->em,
+                     *port->od);
+#endif
+
+#if CO_GATEWAY_STM32
+        /* CO_CANmodule_init() has cleared receive taps of gateway routes */
+        if (prv_gateway != NULL) {
+                err = CO_gateway_attach(prv_gateway, (uint8_t)(port - prv_portTable),
+                                        hCANopenHandle->canOpen_Obj->CANmodule);
+                if (err != CO_ERROR_NO) {
+                        CAN_OPEN_NODE_PRINTF("Error: Gateway port %d: %d\n", (int)(port - prv_portTable), err);
+                        return 5;
+                }
+        }
+#endif
+
+#if CO_APP_SYNC_OFFSET_US > 0
+        hCANopenHandle->syncHeld = false;
+#endif
+
+        /* Timer keeps running over warm reset */
+        if (!hCANopenHandle->warmReset) {
+#if CO_APP_TICKLESS
+                /* Free running microsecond counter, compare interrupt at the
+                 * nearest deadline, first one right now */
+                HAL_TIM_Base_Start(hCANopenHandle->timerHandle);
+                CO_LOCK_OD(hCANopenHandle->canOpen_Obj->CANmodule);
+                hCANopenHandle->timerPrevIRQ = prv_time_us(hCANopenHandle);
+                hCANopenHandle->timerNextIRQ = hCANopenHandle->timerPrevIRQ;
+                hCANopenHandle->timerNextProcess = hCANopenHandle->timerPrevIRQ;
+                prv_timer_schedule(hCANopenHandle);
+                CO_UNLOCK_OD(hCANopenHandle->canOpen_Obj->CANmodule);
+                HAL_TIM_OC_Start_IT(hCANopenHandle->timerHandle, CO_APP_TIMER_CHANNEL);
+#if CO_APP_SYNC_OFFSET_US > 0
+                HAL_TIM_OC_Start_IT(hCANopenHandle->timerHandle, CO_APP_SYNC_CHANNEL);
+#endif
+#else
+                /* Configure Timer interrupt function for execution every 1 millisecond */
+                HAL_TIM_Base_Start_IT(hCANopenHandle->timerHandle); //1ms interrupt
+#endif
+        }
 
         /* Configure CAN transmit and receive interrupt */
 
@@ -268,8 +712,9 @@ CANopenNode_ResetCommunication(CANopenNodeHandle *hCANopenHandle) {
         if (!hCANopenHandle->canOpen_Obj->nodeIdUnconfigured) {
 
 #if (CO_CONFIG_STORAGE) & CO_CONFIG_STORAGE_ENABLE
-                if (storageInitError != 0) {
-                    CO_errorReport(CO->em, CO_EM_NON_VOLATILE_MEMORY, CO_EMC_HARDWARE, storageInitError);
+                if (hCANopenHandle->storageInitError != 0) {
+                        CO_errorReport(hCANopenHandle->canOpen_Obj->em, CO_EM_NON_VOLATILE_MEMORY, CO_EMC_HARDWARE,
+                                       hCANopenHandle->storageInitError);
                 }
 #endif
         } else {
@@ -281,119 +726,356 @@ CANopenNode_ResetCommunication(CANopenNodeHandle *hCANopenHandle) {
 
         CAN_OPEN_NODE_PRINTF("CANopenNode - Running...\n");
         fflush(stdout);
+#if CO_APP_TICKLESS
+        hCANopenHandle->canOpen_PrevProcessTime = prv_time_us(hCANopenHandle);
+#else
         hCANopenHandle->canOpen_PrevProcessTime = HAL_GetTick();
+#endif
         return 0;
 }
 
+/* Time for CO_process(), heartbeat consumer timeouts count from reception
+ * of heartbeat */
+static uint32_t
+prv_process_time(CANopenNodeHandle *hCANopenHandle, uint32_t elapsed_us) {
+#if CO_CAN_RX_TIMESTAMP
+        return prv_rx_split(hCANopenHandle->canOpen_Obj->CANmodule, hCANopenHandle->hbRxIndex,
+                            hCANopenHandle->hbRxCount, elapsed_us, &hCANopenHandle->hbRxChecked_us,
+                            &hCANopenHandle->hbLag_us);
+#else
+        (void) hCANopenHandle;
+        return elapsed_us;
+#endif
+}
+
+/* Handle reset request of CO_process() */
+static void
+prv_process_reset(CANopenNodeHandle *hCANopenHandle, CO_NMT_reset_cmd_t reset_status, uint32_t *timerNext_us) {
+        while (reset_status == CO_RESET_COMM) {
+                /* Objects are kept and initialized again, nothing is allocated */
+                uint32_t resetStart = CO_CAN_CLOCK();
+#ifdef CAN_OPEN_NODE_PRINTF
+                CAN_OPEN_NODE_PRINTF("CANopenNode Reset Communication request\n");
+#endif
+                hCANopenHandle->warmReset = CO_APP_WARM_RESET != 0;
+                CANopenNode_ResetCommunication(
+                        hCANopenHandle); // Reset Communication routine
+                hCANopenHandle->warmReset = false;
+
+                /* Boot-up is sent by the first CO_process() call, do not wait for the next one */
+                reset_status = CO_process(hCANopenHandle->canOpen_Obj, false, 0U, timerNext_us);
+                hCANopenHandle->resetTime = CO_CAN_CLOCK() - resetStart;
+        }
+        if (reset_status == CO_RESET_APP) {
+#ifdef CAN_OPEN_NODE_PRINTF
+                CAN_OPEN_NODE_PRINTF("CANopenNode Device Reset\n");
+#endif
+                HAL_NVIC_SystemReset(); // Reset the STM32 Microcontroller
+        }
+}
+
 void
 CANopenNode_Process(CANopenNodeHandle *hCANopenHandle) {
         /* loop for normal program execution ******************************************/
+#if CO_APP_TICKLESS
+        /* Interrupts from now on need another call */
+        hCANopenHandle->wakeup = false;
+#endif
+
+#if CO_CAN_RX_DEFERRED
+        /* CANopen receive callbacks, deferred from CAN interrupt */
+        CO_CANrxProcess(hCANopenHandle->canOpen_Obj->CANmodule);
+#endif
+
         /* get time difference since last function call */
-        uint32_t time_current = HAL_GetTick();
+#if CO_APP_TICKLESS
+        uint32_t time_current = prv_time_us(hCANopenHandle);
+        uint32_t timeDifference_us = time_current - hCANopenHandle->canOpen_PrevProcessTime;
+        uint32_t timerNext_us = CO_APP_SLEEP_MAX_US;
 
+        hCANopenHandle->canOpen_PrevProcessTime = time_current;
+        prv_process_reset(hCANopenHandle, CO_process(hCANopenHandle->canOpen_Obj, false,
+                                                     prv_process_time(hCANopenHandle, timeDifference_us),
+                                                     &timerNext_us), &timerNext_us);
+#if CO_CAN_RX_TIMESTAMP
+        prv_timer_lag(&timerNext_us, hCANopenHandle->hbLag_us);
+#endif
+
+        CO_LOCK_OD(hCANopenHandle->canOpen_Obj->CANmodule);
+        hCANopenHandle->timerNextProcess = time_current + timerNext_us;
+        prv_timer_schedule(hCANopenHandle);
+        CO_UNLOCK_OD(hCANopenHandle->canOpen_Obj->CANmodule);
+#else
+        uint32_t time_current = HAL_GetTick();
         uint32_t time_old = hCANopenHandle->canOpen_PrevProcessTime;
 
         if ((time_current - time_old) > 0) { // Make sure more than 1ms elapsed
                 /* CANopen process */
-                CO_NMT_reset_cmd_t reset_status;
                 uint32_t timeDifference_us = (time_current - time_old) * 1000;
                 hCANopenHandle->canOpen_PrevProcessTime = time_current;
-                reset_status = CO_process(hCANopenHandle->canOpen_Obj, false,
-                                          timeDifference_us, NULL);
-
-                if (reset_status == CO_RESET_COMM) {
-                        /* delete objects from memory */
-                        CO_CANsetConfigurationMode((void *) hCANopenHandle);
-                        CO_delete(hCANopenHandle->canOpen_Obj);
-#ifdef CAN_OPEN_NODE_PRINTF
-                        CAN_OPEN_NODE_PRINTF("CANopenNode Reset Communication request\n");
+                prv_process_reset(hCANopenHandle, CO_process(hCANopenHandle->canOpen_Obj, false,
+                                                             prv_process_time(hCANopenHandle, timeDifference_us),
+                                                             NULL), NULL);
+        }
 #endif
-                        CANopenNode_ResetCommunication(
-                                hCANopenHandle); // Reset Communication routine
-                } else if (reset_status == CO_RESET_APP) {
-#ifdef CAN_OPEN_NODE_PRINTF
-                        CAN_OPEN_NODE_PRINTF("CANopenNode Device Reset\n");
+
+#if (CO_CONFIG_STORAGE) & CO_CONFIG_STORAGE_ENABLE
+        /* Auto store and erase of flash page in background, in small steps */
+        if (hCANopenHandle->storageRegion != NULL
+            && !CO_storageFlash_process(&hCANopenHandle->storageFlash, CO_APP_STORAGE_BUDGET)) {
+                CO_errorReport(hCANopenHandle->canOpen_Obj->em, CO_EM_NON_VOLATILE_MEMORY, CO_EMC_HARDWARE, 0);
+        }
 #endif
-                        HAL_NVIC_SystemReset(); // Reset the STM32 Microcontroller
+}
+
+#if CO_APP_TICKLESS
+/* Any node requested another CANopenNode_Process() call */
+static bool_t prv_wakeup_any(const CANopenNodeHandle *hCANopenHandle) {
+        if (hCANopenHandle->wakeup) {
+                return true;
+        }
+        for (uint8_t port = 0; port < CO_APP_PORT_COUNT; port++) {
+                if (prv_handles[port] != NULL && prv_handles[port]->wakeup) {
+                        return true;
                 }
         }
+        return false;
+}
+
+void
+CANopenNode_Sleep(CANopenNodeHandle *hCANopenHandle) {
+        uint32_t lockState;
+
+#ifdef CO_LOCK_BASEPRI
+        /* Interrupts masked by BASEPRI do not end WFI. With SEVONPEND each
+         * of them sets the event on becoming pending, which ends WFE. Event
+         * is cleared before the check, so none after it is lost. */
+        SET_BIT(SCB->SCR, SCB_SCR_SEVONPEND_Msk);
+        __SEV();
+        __WFE();
+#endif
+        /* Interrupt after the check stays pending in the lock and ends the
+         * sleep, its handler runs after CO_LOCK_LEAVE() */
+        CO_LOCK_ENTER(lockState);
+        if (!prv_wakeup_any(hCANopenHandle)) {
+                uint32_t sleepStart = prv_time_us(hCANopenHandle);
+#ifdef CO_LOCK_BASEPRI
+                __WFE();
+#else
+                __WFI();
+#endif
+                hCANopenHandle->sleepTime_us += prv_time_us(hCANopenHandle) - sleepStart;
+                hCANopenHandle->sleepCount++;
+        }
+        CO_LOCK_LEAVE(lockState);
 }
+#endif
 
 /* Thread function executes in constant intervals, this function can be called from FreeRTOS tasks or Timers ********/
 void
 CANopenNode_IRQ(CANopenNodeHandle *hCANopenHandle) {
+        /* get time difference since last function call */
+#if CO_APP_TICKLESS
+        uint32_t time_current = prv_time_us(hCANopenHandle);
+        uint32_t timeDifference_us = time_current - hCANopenHandle->timerPrevIRQ;
+        uint32_t timerNext_us = CO_APP_SLEEP_MAX_US;
+        uint32_t *pTimerNext_us = &timerNext_us;
+
+        hCANopenHandle->timerPrevIRQ = time_current;
+        hCANopenHandle->wakeup = true; /* main loop may have waited for this deadline */
+#else
+        uint32_t timeDifference_us = CO_APP_IRQ_PERIOD_US;
+        uint32_t *pTimerNext_us = NULL;
+#endif
+
+        /* SYNC, RPDO and TPDO processing read and write Object Dictionary
+         * variables and PDO state, which SDO and NMT in CANopenNode_Process()
+         * access too, so CANopenNode requires CO_LOCK_OD around them. Only
+         * the process image copy can run outside of it. */
         CO_LOCK_OD(hCANopenHandle->canOpen_Obj->CANmodule);
-        if (!hCANopenHandle->canOpen_Obj->nodeIdUnconfigured &&
-            hCANopenHandle->canOpen_Obj->CANmodule->CANnormal) {
-                bool_t syncWas = false;
-                /* get time difference since last function call */
-                #if BOARD_TYPE==BOARD_TYPE_CENTRAL_BOARD
-                uint32_t timeDifference_us = 10000; // 1ms second
-                #else
-                uint32_t timeDifference_us = 1000; // 1ms second
-                #endif
+        bool_t running = !hCANopenHandle->canOpen_Obj->nodeIdUnconfigured &&
+                         hCANopenHandle->canOpen_Obj->CANmodule->CANnormal;
+        bool_t syncWas = false;
+#if CO_APP_PROCESS_IMAGE
+        /* Frames delivered before this point are processed below, later ones
+         * in the next cycle */
+        uint32_t rxDelivered = hCANopenHandle->canOpen_Obj->CANmodule->rxDelivered;
+#endif
 
+        if (running) {
 #if (CO_CONFIG_SYNC) & CO_CONFIG_SYNC_ENABLE
-                syncWas = CO_process_SYNC(hCANopenHandle->canOpen_Obj,
-                                          timeDifference_us, NULL);
+#if CO_CAN_RX_TIMESTAMP
+                /* SYNC window and timeout count from reception of SYNC */
+                uint32_t syncTime_us = prv_rx_split(hCANopenHandle->canOpen_Obj->CANmodule,
+                                                    hCANopenHandle->syncRxIndex, 1, timeDifference_us,
+                                                    &hCANopenHandle->syncRxChecked_us,
+                                                    &hCANopenHandle->syncLag_us);
+#else
+                uint32_t syncTime_us = timeDifference_us;
+#endif
+#if CO_CAN_RX_TIMESTAMP && CO_APP_TICKLESS
+                uint32_t syncNext_us = CO_APP_SLEEP_MAX_US;
+
+                syncWas = CO_process_SYNC(hCANopenHandle->canOpen_Obj, syncTime_us, &syncNext_us);
+                prv_timer_lag(&syncNext_us, hCANopenHandle->syncLag_us);
+                if (syncNext_us < timerNext_us) {
+                        timerNext_us = syncNext_us;
+                }
+#else
+                syncWas = CO_process_SYNC(hCANopenHandle->canOpen_Obj, syncTime_us, pTimerNext_us);
+#endif
 #endif
 #if (CO_CONFIG_PDO) & CO_CONFIG_RPDO_ENABLE
                 CO_process_RPDO(hCANopenHandle->canOpen_Obj, syncWas,
-                                timeDifference_us, NULL);
+                                timeDifference_us, pTimerNext_us);
+#endif
+        }
+#if CO_APP_SYNC_OFFSET_US > 0
+        bool_t syncTpdo = running && prv_sync_tpdo(hCANopenHandle, syncWas, time_current);
+#else
+        bool_t syncTpdo = syncWas;
+#endif
+#if CO_APP_PROCESS_IMAGE
+        /* Copy process image with interrupts above CANopenNode_IRQ enabled.
+         * Contexts, which access Object Dictionary, run at lower priority and
+         * are preempted, only the swap of inputs is done under the lock.
+         * Inputs change only with SYNC or a received RPDO. */
+        CO_app_PI_t *piIn = hCANopenHandle->piInputs;
+        bool_t piPublish = false;
+
+        if (syncWas || rxDelivered != hCANopenHandle->piRxDelivered) {
+                hCANopenHandle->piRxDelivered = rxDelivered;
+                hCANopenHandle->piStale = true;
+        }
+        CO_UNLOCK_OD(hCANopenHandle->canOpen_Obj->CANmodule);
+        if (running) {
+                piPublish = prv_pi_exchange(hCANopenHandle, hCANopenHandle->piStale);
+        }
+        CO_LOCK_OD(hCANopenHandle->canOpen_Obj->CANmodule);
+        if (piPublish) {
+                piIn->front ^= 1U;
+                hCANopenHandle->piStale = false;
+        }
 #endif
+        if (running) {
 #if (CO_CONFIG_PDO) & CO_CONFIG_TPDO_ENABLE
-                CO_process_TPDO(hCANopenHandle->canOpen_Obj, syncWas,
-                                timeDifference_us, NULL);
+                CO_process_TPDO(hCANopenHandle->canOpen_Obj, syncTpdo,
+                                timeDifference_us, pTimerNext_us);
+#endif
+#if CO_CAN_RX_TIMESTAMP
+                if (syncTpdo) {
+                        prv_sync_tpdo_time(hCANopenHandle, timeDifference_us + CO_APP_SYNC_OFFSET_US);
+                }
 #endif
 
                 /* Further I/O or nonblocking application code may go here. */
         }
+#if CO_CAN_BUS_LOAD
+        CO_diag_process(&hCANopenHandle->diag, timeDifference_us);
+#endif
+#if CO_APP_TICKLESS
+        hCANopenHandle->timerNextIRQ = time_current + timerNext_us;
+        prv_timer_schedule(hCANopenHandle);
+#endif
         CO_UNLOCK_OD(hCANopenHandle->canOpen_Obj->CANmodule);
 }
 
-#ifndef CAN_OPEN_NODE_CALLBACKS_OVERRIDE 
-void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
-#ifdef CO_MULTIPLE_OD
-        for (uint8_t i=0; i<CO_OD_COUNT; i++) {
-                if (hcan == hCANopenNode_List[i]->CANHandle) {
-                        CO_CANinterrupt_TX(hCANopenNode_List[i]->canOpen_Obj->CANmodule, CAN_TX_MAILBOX0);
-                        break;
+#if CO_GATEWAY_STM32
+void
+CANopenNode_SetGateway(CO_gateway_t *gateway) {
+        prv_gateway = gateway;
+}
+#endif
+
+void
+CANopenNode_ProcessAll(void) {
+        for (uint8_t port = 0; port < CO_APP_PORT_COUNT; port++) {
+                if (prv_handles[port] != NULL && prv_handles[port]->canOpen_Obj != NULL) {
+                        CANopenNode_Process(prv_handles[port]);
                 }
         }
-#else
-        if (hcan == hCANopenNode_List[0]->CANHandle) {
-                CO_CANinterrupt_TX(hCANopenNode_List[0]->canOpen_Obj->CANmodule, CAN_TX_MAILBOX0);
+}
+
+void
+CANopenNode_IRQAll(void) {
+        for (uint8_t port = 0; port < CO_APP_PORT_COUNT; port++) {
+                if (prv_handles[port] != NULL && prv_handles[port]->canOpen_Obj != NULL) {
+                        CANopenNode_IRQ(prv_handles[port]);
+                }
         }
-#endif
 }
 
-void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan){
-        #ifdef CO_MULTIPLE_OD
-        for (uint8_t i=0; i<CO_OD_COUNT; i++) {
-                if (hcan == hCANopenNode_List[i]->CANHandle) {
-                        CO_CANinterrupt_TX(hCANopenNode_List[i]->canOpen_Obj->CANmodule, CAN_TX_MAILBOX1);
-                        break;
+void
+CANopenNode_TimerIRQ(TIM_HandleTypeDef *htim) {
+        for (uint8_t port = 0; port < CO_APP_PORT_COUNT; port++) {
+                if (prv_handles[port] != NULL && prv_handles[port]->timerHandle == htim
+                    && prv_handles[port]->canOpen_Obj != NULL) {
+                        CANopenNode_IRQ(prv_handles[port]);
                 }
         }
-        #else
-        if (hcan == hCANopenNode_List[0]->CANHandle) {
-                CO_CANinterrupt_TX(hCANopenNode_List[0]->canOpen_Obj->CANmodule, CAN_TX_MAILBOX1);
+}
+
+#ifndef CAN_OPEN_NODE_CALLBACKS_OVERRIDE 
+#ifdef CO_STM32_FDCAN_Driver
+void HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes) {
+        CO_CANmodule_t *CANmodule = prv_route(hfdcan->Instance);
+        if (CANmodule != NULL) {
+                CO_CANinterrupt_TX(CANmodule, BufferIndexes);
+        }
+}
+
+#if CO_CAN_TX_LATENCY
+void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t TxEventFifoITs) {
+        CO_CANmodule_t *CANmodule = prv_route(hfdcan->Instance);
+        if (CANmodule != NULL && (TxEventFifoITs & FDCAN_IT_TX_EVT_FIFO_NEW_DATA)) {
+                CO_CANinterrupt_TXevent(CANmodule);
         }
+}
 #endif
+
+uint32_t can_timeInterruptPoint=0;
+
+void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs) {
+//Watchdog protection
+        can_timeInterruptPoint = HAL_GetTick();
+//Watchdog protection
+        CO_CANmodule_t *CANmodule = prv_route(hfdcan->Instance);
+        if (CANmodule != NULL && (RxFifo0ITs & FDCAN_IT_RX_FIFO0_NEW_MESSAGE)) {
+                CO_CANinterrupt_RX(CANmodule, FDCAN_RX_FIFO0);
+                prv_rx_wakeup(CANmodule, 0);
+        }
 }
 
-void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan){
-        #ifdef CO_MULTIPLE_OD
-        for (uint8_t i=0; i<CO_OD_COUNT; i++) {
-                if (hcan == hCANopenNode_List[i]->CANHandle) {
-                        CO_CANinterrupt_TX(hCANopenNode_List[i]->canOpen_Obj->CANmodule, CAN_TX_MAILBOX2);
-                        break;
-                }
+void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo1ITs) {
+//Watchdog protection
+        can_timeInterruptPoint = HAL_GetTick();
+//Watchdog protection
+        CO_CANmodule_t *CANmodule = prv_route(hfdcan->Instance);
+        if (CANmodule != NULL && (RxFifo1ITs & FDCAN_IT_RX_FIFO1_NEW_MESSAGE)) {
+                CO_CANinterrupt_RX(CANmodule, FDCAN_RX_FIFO1);
+                prv_rx_wakeup(CANmodule, 1);
         }
-        #else
-        CO_CANinterrupt_TX(hCANopenNode_List[0]->canOpen_Obj->CANmodule, CAN_TX_MAILBOX2);
+}
+#else
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
+        CO_CANmodule_t *CANmodule = prv_route(hcan->Instance);
+        if (CANmodule != NULL) {
+                CO_CANinterrupt_TX(CANmodule, CAN_TX_MAILBOX0);
+        }
+}
 
-#endif
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan){
+        CO_CANmodule_t *CANmodule = prv_route(hcan->Instance);
+        if (CANmodule != NULL) {
+                CO_CANinterrupt_TX(CANmodule, CAN_TX_MAILBOX1);
+        }
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan){
+        CO_CANmodule_t *CANmodule = prv_route(hcan->Instance);
+        if (CANmodule != NULL) {
+                CO_CANinterrupt_TX(CANmodule, CAN_TX_MAILBOX2);
+        }
 }
 
 uint32_t can_timeInterruptPoint=0;
@@ -402,32 +1084,22 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan){
 //Watchdog protection
         can_timeInterruptPoint = HAL_GetTick();
 //Watchdog protection
-        #ifdef CO_MULTIPLE_OD
-        for (uint8_t i=0; i<CO_OD_COUNT; i++) {
-                if (hcan == hCANopenNode_List[i]->CANHandle) {
-                        CO_CANinterrupt_RX(hCANopenNode_List[i]->canOpen_Obj->CANmodule, CAN_RX_FIFO0);
-                        break;
-                }
+        CO_CANmodule_t *CANmodule = prv_route(hcan->Instance);
+        if (CANmodule != NULL) {
+                CO_CANinterrupt_RX(CANmodule, CAN_RX_FIFO0);
+                prv_rx_wakeup(CANmodule, 0);
         }
-        #else
-        CO_CANinterrupt_RX(hCANopenNode_List[0]->canOpen_Obj->CANmodule, CAN_RX_FIFO0);
-#endif
 }
 
 void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan){
 //Watchdog protection
         can_timeInterruptPoint = HAL_GetTick();
 //Watchdog protection
-        #ifdef CO_MULTIPLE_OD
-        for (uint8_t i=0; i<CO_OD_COUNT; i++) {
-                if (hcan == hCANopenNode_List[i]->CANHandle) {
-                        CO_CANinterrupt_RX(hCANopenNode_List[i]->canOpen_Obj->CANmodule, CAN_RX_FIFO1);
-                        break;
-                }
+        CO_CANmodule_t *CANmodule = prv_route(hcan->Instance);
+        if (CANmodule != NULL) {
+                CO_CANinterrupt_RX(CANmodule, CAN_RX_FIFO1);
+                prv_rx_wakeup(CANmodule, 1);
         }
-        #else
-        CO_CANinterrupt_RX(hCANopenNode_List[0]->canOpen_Obj->CANmodule, CAN_RX_FIFO1);
-
-#endif
 }
 #endif
+#endif
@@ -12,15 +12,19 @@
  * interrupt for tmrThread function,
  * please note that CANOpenSTM32 Library will override
  * HAL_TIM_PeriodElapsedCallback function, if you also need this function
- * in your codes, please take required steps
+ * in your codes, please take required steps. With CO_APP_TICKLESS it is
+ * a free running microsecond timer instead, see below.
  */
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#include "main.h"
+#include "CO_driver_stm32.h"
 #include "CANopen.h"
+#include "CO_diag_STM32.h"
+#include "CO_gateway_STM32.h"
+#include "CO_storageFlash.h"
 
 typedef enum CO_app_Status {
         CO_APP_UNDEFINED,
@@ -29,6 +33,319 @@ typedef enum CO_app_Status {
         CO_APP_ERROR_CAN_NOT_ALLOCATE_MEMORY
 } CO_app_Status;
 
+/* Double buffered process image. RPDO mapped inputs are copied from Object
+ * Dictionary into one of two buffers in CANopenNode_IRQ() after SYNC and RPDO
+ * processing, when SYNC came or a frame was received since the last cycle,
+ * and the buffers are swapped. Application reads consistent snapshot of all
+ * inputs without CO_LOCK_OD. Inputs written by SDO show with the next SYNC or
+ * received frame. TPDO mapped outputs are written by application into its
+ * buffer and published with a swap. */
+#ifndef CO_APP_PROCESS_IMAGE
+#define CO_APP_PROCESS_IMAGE 0
+#endif
+
+/* Tickless timing. timerHandle is a free running 32-bit timer (TIM2 or TIM5
+ * on most STM32) counting microseconds, with channel CO_APP_TIMER_CHANNEL in
+ * output compare timing mode and its interrupt enabled. Each CAN port needs
+ * its own timer. Elapsed time is read from the counter and the compare is
+ * set to the nearest deadline, which the stack reports through timerNext_us
+ * (enable CO_CONFIG_GLOBAL_FLAG_TIMERNEXT in CANopenNode configuration).
+ * Call CANopenNode_TimerIRQ() from HAL_TIM_OC_DelayElapsedCallback() and
+ * CANopenNode_Sleep() from the main loop after CANopenNode_Process(). */
+#ifndef CO_APP_TICKLESS
+#define CO_APP_TICKLESS 0
+#endif
+
+#if CO_APP_TICKLESS
+#ifndef CO_APP_TIMER_CHANNEL
+#define CO_APP_TIMER_CHANNEL TIM_CHANNEL_1
+#endif
+/* Longest time between calls of CANopenNode_Process() and CANopenNode_IRQ() */
+#ifndef CO_APP_SLEEP_MAX_US
+#define CO_APP_SLEEP_MAX_US 100000U
+#endif
+#endif
+
+#ifdef CO_LOCK_BASEPRI
+/* Interrupt line of each timer, X(instance, IRQn), which CANopenNode_Init()
+ * checks against CO_LOCK_PRIORITY. Defaults cover TIM2 to TIM5, define
+ * CO_APP_TIMER_IRQS(X) for other timers. A timer, which is not listed, fails
+ * the check. */
+#ifndef CO_APP_TIMER_IRQS
+#ifdef TIM5
+#define CO_APP_TIMER_IRQS_5(X) X(TIM5, TIM5_IRQn)
+#else
+#define CO_APP_TIMER_IRQS_5(X)
+#endif
+#define CO_APP_TIMER_IRQS(X) X(TIM2, TIM2_IRQn) X(TIM3, TIM3_IRQn) X(TIM4, TIM4_IRQn) CO_APP_TIMER_IRQS_5(X)
+#endif
+#endif
+
+/* Synchronous TPDOs at a fixed offset after SYNC. SYNC and synchronous RPDOs
+ * are processed when SYNC is received. TPDO mapped data is sampled into
+ * transmit mailboxes CO_APP_SYNC_OFFSET_US microseconds after reception of
+ * SYNC (receive timestamp with CO_CAN_RX_TIMESTAMP, otherwise CANopenNode_IRQ()
+ * run by the receive interrupt), so TPDOs do not move with SYNC interrupt
+ * latency and other load. Compare of CO_APP_SYNC_CHANNEL runs
+ * CANopenNode_IRQ() at that time, through HAL_TIM_OC_DelayElapsedCallback()
+ * and CANopenNode_TimerIRQ(). Offset must be shorter than SYNC period and
+ * SYNC window length. Requires CO_APP_TICKLESS, the channel in output compare
+ * timing mode with interrupt enabled. 0 samples TPDOs right away. */
+#ifndef CO_APP_SYNC_OFFSET_US
+#define CO_APP_SYNC_OFFSET_US 0
+#endif
+
+#if CO_APP_SYNC_OFFSET_US > 0
+#if !CO_APP_TICKLESS
+#error CO_APP_SYNC_OFFSET_US requires CO_APP_TICKLESS
+#endif
+#ifndef CO_APP_SYNC_CHANNEL
+#define CO_APP_SYNC_CHANNEL TIM_CHANNEL_2
+#endif
+#endif
+
+/* Warm communication reset. NMT reset communication command keeps the CAN
+ * peripheral running: bit timing, global configuration and unchanged
+ * acceptance filters stay, only CANopen objects are initialized again.
+ * Boot-up message is sent before CANopenNode_Process() returns. Set to 0
+ * to stop and initialize the peripheral (CANInitFunction) on every reset. */
+#ifndef CO_APP_WARM_RESET
+#define CO_APP_WARM_RESET 1
+#endif
+
+/* Parameters are stored in internal flash pages, given by storageRegion of
+ * the handle, see CO_storageFlash.h. Every port needs its own pages. Entry
+ * of each port is its communication parameters (persistComm of the port).
+ * On devices with flash ECC, NMI_Handler() must call
+ * CO_storageFlash_STM32NMI(), see there. */
+#define CO_APP_STORAGE_ENTRIES 1
+
+/* Attributes of the entry. Add CO_storage_auto to store changed parameters
+ * from CANopenNode_Process() without "Store parameters" command. */
+#ifndef CO_APP_STORAGE_ATTR
+#define CO_APP_STORAGE_ATTR (CO_storage_cmd | CO_storage_restore)
+#endif
+
+/* Time, which CANopenNode_Process() may spend writing flash, in
+ * CO_CAN_CLOCK() ticks (100 us with DWT cycle counter). */
+#ifndef CO_APP_STORAGE_BUDGET
+#define CO_APP_STORAGE_BUDGET (SystemCoreClock / 10000U)
+#endif
+
+#if CO_APP_PROCESS_IMAGE
+/* Object Dictionary variable, which is part of process image */
+typedef struct {
+        void *odVariable;
+        size_t length;
+} CO_app_PIentry_t;
+
+/* Process image of one direction. buffer[0] and buffer[1] must have size of
+ * all entries together, data of entries follow each other in order. */
+typedef struct {
+        const CO_app_PIentry_t *entries;
+        uint8_t entriesCount;
+        uint8_t *buffer[2];
+        volatile uint8_t front; /* Buffer with the latest published data */
+        volatile uint8_t held;  /* Buffer used by reader or 0xFF */
+        volatile bool_t fresh;  /* Outputs were published, but not copied into OD yet */
+} CO_app_PI_t;
+#endif
+
+/* Port table. Each CAN peripheral, which runs a CANopen node, is bound to
+ * its Object Dictionary at compile time by CO_APP_PORTS(X), with one
+ * X(instance, od, initConfig, persistComm, filterFirst, filterCount) per
+ * port. With CO_MULTIPLE_OD it is defined in a header named by
+ * CO_APP_PORTS_HEADER, which also includes all Object Dictionaries:
+ *
+ *   #include "OD1.h"
+ *   #include "OD2.h"
+ *   #include "OD3.h"
+ *   #define CO_APP_PORTS(X)                                                  \
+ *           X(FDCAN1, OD1, OD1_INIT_CONFIG, OD1_PERSIST_COMM, 0, 0)         \
+ *           X(FDCAN2, OD2, OD2_INIT_CONFIG, OD2_PERSIST_COMM, 0, 0)         \
+ *           X(FDCAN3, OD3, OD3_INIT_CONFIG, OD3_PERSIST_COMM, 0, 0)
+ *
+ * filterFirst and filterCount select own bxCAN filter banks (FDCAN standard
+ * filter elements) of the port, others are left to the application. Use 0
+ * and 0 for all banks of the instance. Default table binds OD1 to CAN1
+ * (FDCAN1) and OD2 to CAN2 (FDCAN2). Without CO_MULTIPLE_OD the only port
+ * runs OD on any peripheral (instance NULL). */
+#if CO_ARENA_SIZE > 0
+/* Memory, which CO_new() takes from the arena for Object Dictionary od, in
+ * bytes. Follows allocations of CO_new() in CANopenNode v4: objects counted
+ * by od_CNT_* (OD_CNT_* for the single Object Dictionary), where enabled by
+ * CO_CONFIG_*, and their CAN receive and transmit buffers. Each allocation is
+ * 8-byte aligned, as in CO_arena_alloc(). Counts of the single Object
+ * Dictionary, which OD.h does not define, are 0 (see CO_app_STM32.c). With
+ * CO_MULTIPLE_OD, header of each Object Dictionary must define od_CNT_* of
+ * all objects used below, 0 for missing ones. CANopenNode_Init() reports the
+ * memory actually used in canOpen_HeapMemoryUsed. */
+#define CO_APP_ARENA_ITEM(count, type) ((((size_t) (count) * sizeof(type)) + 7U) / 8U * 8U)
+#define CO_APP_CNT(od, obj)            (od##_CNT_##obj)
+
+#if (CO_CONFIG_NMT) & CO_CONFIG_NMT_MASTER
+#define CO_APP_TX_NMT_MST(od) 1U
+#else
+#define CO_APP_TX_NMT_MST(od) 0U
+#endif
+#if (CO_CONFIG_HB_CONS) & CO_CONFIG_HB_CONS_ENABLE
+#define CO_APP_RX_HB_CONS(od) (CO_APP_CNT(od, HB_CONS) * CO_APP_CNT(od, ARR_1016))
+#define CO_APP_MEM_HB_CONS(od)                                                                                         \
+        (CO_APP_ARENA_ITEM(CO_APP_CNT(od, HB_CONS), CO_HBconsumer_t)                                                   \
+         + CO_APP_ARENA_ITEM(CO_APP_RX_HB_CONS(od), CO_HBconsNode_t))
+#else
+#define CO_APP_RX_HB_CONS(od)  0U
+#define CO_APP_MEM_HB_CONS(od) 0U
+#endif
+#if (CO_CONFIG_EM) & CO_CONFIG_EM_CONSUMER
+#define CO_APP_RX_EM(od) CO_APP_CNT(od, EM)
+#else
+#define CO_APP_RX_EM(od) 0U
+#endif
+#if (CO_CONFIG_EM) & CO_CONFIG_EM_PRODUCER
+#define CO_APP_TX_EM(od) CO_APP_CNT(od, EM)
+#else
+#define CO_APP_TX_EM(od) 0U
+#endif
+#if (CO_CONFIG_EM) & (CO_CONFIG_EM_PRODUCER | CO_CONFIG_EM_HISTORY)
+/* Error FIFO has one more entry than 0x1003, none without 0x1003 */
+#define CO_APP_MEM_EM_FIFO(od)                                                                                         \
+        (CO_APP_CNT(od, EM) != 0 && CO_APP_CNT(od, ARR_1003) != 0                                                      \
+                 ? CO_APP_ARENA_ITEM(CO_APP_CNT(od, ARR_1003) + 1U, CO_EM_fifo_t)                                      \
+                 : 0U)
+#else
+#define CO_APP_MEM_EM_FIFO(od) 0U
+#endif
+#if (CO_CONFIG_SDO_CLI) & CO_CONFIG_SDO_CLI_ENABLE
+#define CO_APP_RXTX_SDO_CLI(od) CO_APP_CNT(od, SDO_CLI)
+#define CO_APP_MEM_SDO_CLI(od)  CO_APP_ARENA_ITEM(CO_APP_CNT(od, SDO_CLI), CO_SDOclient_t)
+#else
+#define CO_APP_RXTX_SDO_CLI(od) 0U
+#define CO_APP_MEM_SDO_CLI(od)  0U
+#endif
+#if (CO_CONFIG_SYNC) & CO_CONFIG_SYNC_ENABLE
+#define CO_APP_RX_SYNC(od)  CO_APP_CNT(od, SYNC)
+#define CO_APP_MEM_SYNC(od) CO_APP_ARENA_ITEM(CO_APP_CNT(od, SYNC), CO_SYNC_t)
+#else
+#define CO_APP_RX_SYNC(od)  0U
+#define CO_APP_MEM_SYNC(od) 0U
+#endif
+#if ((CO_CONFIG_SYNC) & CO_CONFIG_SYNC_ENABLE) && ((CO_CONFIG_SYNC) & CO_CONFIG_SYNC_PRODUCER)
+#define CO_APP_TX_SYNC(od) CO_APP_CNT(od, SYNC)
+#else
+#define CO_APP_TX_SYNC(od) 0U
+#endif
+#if (CO_CONFIG_TIME) & CO_CONFIG_TIME_ENABLE
+#define CO_APP_RX_TIME(od)  CO_APP_CNT(od, TIME)
+#define CO_APP_MEM_TIME(od) CO_APP_ARENA_ITEM(CO_APP_CNT(od, TIME), CO_TIME_t)
+#if (CO_CONFIG_TIME) & CO_CONFIG_TIME_PRODUCER
+#define CO_APP_TX_TIME(od) CO_APP_CNT(od, TIME)
+#else
+#define CO_APP_TX_TIME(od) 0U
+#endif
+#else
+#define CO_APP_RX_TIME(od)  0U
+#define CO_APP_TX_TIME(od)  0U
+#define CO_APP_MEM_TIME(od) 0U
+#endif
+#if (CO_CONFIG_PDO) & CO_CONFIG_RPDO_ENABLE
+#define CO_APP_RX_RPDO(od)  CO_APP_CNT(od, RPDO)
+#define CO_APP_MEM_RPDO(od) CO_APP_ARENA_ITEM(CO_APP_CNT(od, RPDO), CO_RPDO_t)
+#else
+#define CO_APP_RX_RPDO(od)  0U
+#define CO_APP_MEM_RPDO(od) 0U
+#endif
+#if (CO_CONFIG_PDO) & CO_CONFIG_TPDO_ENABLE
+#define CO_APP_TX_TPDO(od)  CO_APP_CNT(od, TPDO)
+#define CO_APP_MEM_TPDO(od) CO_APP_ARENA_ITEM(CO_APP_CNT(od, TPDO), CO_TPDO_t)
+#else
+#define CO_APP_TX_TPDO(od)  0U
+#define CO_APP_MEM_TPDO(od) 0U
+#endif
+#if (CO_CONFIG_LEDS) & CO_CONFIG_LEDS_ENABLE
+#define CO_APP_MEM_LEDS(od) CO_APP_ARENA_ITEM(1U, CO_LEDs_t)
+#else
+#define CO_APP_MEM_LEDS(od) 0U
+#endif
+#if (CO_CONFIG_GFC) & CO_CONFIG_GFC_ENABLE
+#define CO_APP_RXTX_GFC(od) CO_APP_CNT(od, GFC)
+#define CO_APP_MEM_GFC(od)  CO_APP_ARENA_ITEM(CO_APP_CNT(od, GFC), CO_GFC_t)
+#else
+#define CO_APP_RXTX_GFC(od) 0U
+#define CO_APP_MEM_GFC(od)  0U
+#endif
+#if (CO_CONFIG_SRDO) & CO_CONFIG_SRDO_ENABLE
+/* Each SRDO has two frames in each direction, guard is shared */
+#define CO_APP_RXTX_SRDO(od) (2U * CO_APP_CNT(od, SRDO))
+#define CO_APP_MEM_SRDO(od)                                                                                            \
+        ((CO_APP_CNT(od, SRDO) != 0 ? CO_APP_ARENA_ITEM(1U, CO_SRDOGuard_t) : 0U)                                      \
+         + CO_APP_ARENA_ITEM(CO_APP_CNT(od, SRDO), CO_SRDO_t))
+#else
+#define CO_APP_RXTX_SRDO(od) 0U
+#define CO_APP_MEM_SRDO(od)  0U
+#endif
+#if (CO_CONFIG_LSS) & CO_CONFIG_LSS_SLAVE
+#define CO_APP_RXTX_LSS_SLV(od) 1U
+#define CO_APP_MEM_LSS_SLV(od)  CO_APP_ARENA_ITEM(1U, CO_LSSslave_t)
+#else
+#define CO_APP_RXTX_LSS_SLV(od) 0U
+#define CO_APP_MEM_LSS_SLV(od)  0U
+#endif
+#if (CO_CONFIG_LSS) & CO_CONFIG_LSS_MASTER
+#define CO_APP_RXTX_LSS_MST(od) 1U
+#define CO_APP_MEM_LSS_MST(od)  CO_APP_ARENA_ITEM(1U, CO_LSSmaster_t)
+#else
+#define CO_APP_RXTX_LSS_MST(od) 0U
+#define CO_APP_MEM_LSS_MST(od)  0U
+#endif
+#if (CO_CONFIG_GTW) & CO_CONFIG_GTW_ASCII
+#define CO_APP_MEM_GTWA(od) CO_APP_ARENA_ITEM(1U, CO_GTWA_t)
+#else
+#define CO_APP_MEM_GTWA(od) 0U
+#endif
+#if (CO_CONFIG_TRACE) & CO_CONFIG_TRACE_ENABLE
+#error CO_ARENA_SIZE does not cover trace buffers, which are sized by the Object Dictionary
+#endif
+
+#define CO_APP_RX_CNT(od)                                                                                              \
+        (CO_APP_CNT(od, NMT) + CO_APP_RX_SYNC(od) + CO_APP_RX_EM(od) + CO_APP_RX_TIME(od) + CO_APP_RXTX_GFC(od)        \
+         + CO_APP_RXTX_SRDO(od) + CO_APP_RX_RPDO(od) + CO_APP_CNT(od, SDO_SRV) + CO_APP_RXTX_SDO_CLI(od)               \
+         + CO_APP_RX_HB_CONS(od) + CO_APP_RXTX_LSS_SLV(od) + CO_APP_RXTX_LSS_MST(od))
+#define CO_APP_TX_CNT(od)                                                                                              \
+        (CO_APP_TX_NMT_MST(od) + CO_APP_TX_SYNC(od) + CO_APP_TX_EM(od) + CO_APP_TX_TIME(od) + CO_APP_RXTX_GFC(od)      \
+         + CO_APP_RXTX_SRDO(od) + CO_APP_TX_TPDO(od) + CO_APP_CNT(od, SDO_SRV) + CO_APP_RXTX_SDO_CLI(od)               \
+         + CO_APP_CNT(od, HB_PROD) + CO_APP_RXTX_LSS_SLV(od) + CO_APP_RXTX_LSS_MST(od))
+#define CO_APP_ARENA_NEED(od)                                                                                          \
+        (CO_APP_ARENA_ITEM(1U, CO_t) + CO_APP_ARENA_ITEM(1U, CO_CANmodule_t)                                           \
+         + CO_APP_ARENA_ITEM(CO_APP_RX_CNT(od), CO_CANrx_t) + CO_APP_ARENA_ITEM(CO_APP_TX_CNT(od), CO_CANtx_t)         \
+         + CO_APP_ARENA_ITEM(CO_APP_CNT(od, NMT), CO_NMT_t) + CO_APP_MEM_HB_CONS(od)                                   \
+         + CO_APP_ARENA_ITEM(CO_APP_CNT(od, EM), CO_EM_t) + CO_APP_MEM_EM_FIFO(od)                                     \
+         + CO_APP_ARENA_ITEM(CO_APP_CNT(od, SDO_SRV), CO_SDOserver_t) + CO_APP_MEM_SDO_CLI(od) + CO_APP_MEM_SYNC(od)   \
+         + CO_APP_MEM_TIME(od) + CO_APP_MEM_RPDO(od) + CO_APP_MEM_TPDO(od) + CO_APP_MEM_LEDS(od) + CO_APP_MEM_GFC(od)   \
+         + CO_APP_MEM_SRDO(od) + CO_APP_MEM_LSS_SLV(od) + CO_APP_MEM_LSS_MST(od) + CO_APP_MEM_GTWA(od))
+
+/* Arena of each port: CO_APP_ARENA_NEED() of its Object Dictionary, or
+ * CO_ARENA_SIZE, if bigger, in 8-byte words */
+#define CO_APP_ARENA_WORDS(od)                                                                                         \
+        (((CO_APP_ARENA_NEED(od) > (size_t) (CO_ARENA_SIZE) ? CO_APP_ARENA_NEED(od) : (size_t) (CO_ARENA_SIZE)) + 7U) \
+         / 8U)
+#endif /* CO_ARENA_SIZE > 0 */
+
+typedef struct {
+        const void *instance;                    /* CAN or FDCAN peripheral, NULL matches any */
+        OD_t **od;                               /* Object Dictionary */
+        void (*initConfig)(CO_config_t *config); /* CO_new() configuration, CO_MULTIPLE_OD only */
+        const uint32_t *identity[4];             /* LSS address, 0x1018 sub-indexes 1..4 */
+        void *persistComm;                       /* Communication parameters for storage */
+        size_t persistCommSize;
+        uint8_t filterFirst;                     /* First own acceptance filter bank (element) */
+        uint8_t filterCount;                     /* Number of own banks (elements) or 0 for all */
+#if CO_ARENA_SIZE > 0
+        uint64_t *arena;                         /* Static memory for CO_new() */
+        size_t arenaWords;                       /* CO_APP_ARENA_WORDS() of od */
+#endif
+} CO_app_port_t;
+
 typedef struct {
         uint8_t desiredNodeID;
         uint8_t activeNodeID; /* Assigned Node ID */
@@ -41,16 +358,58 @@ typedef struct {
 #endif
 
         void (*CANInitFunction)(void);
+#if CO_CAN_FD
+        const CO_CANfdRule_t *fdRules; /* Frame format of transmit COB-IDs or NULL for classic frames */
+        uint8_t fdRulesCount;
+#endif
 
+        const CO_app_port_t *port; /* Set by CANopenNode_Init() */
         CO_t *canOpen_Obj;
         CO_config_t *canOpen_Config;
         uint32_t canOpen_HeapMemoryUsed;
-        uint32_t canOpen_PrevProcessTime;
-} CANopenNodeHandle;
-
-#ifndef CO_CAN_MAX_RETRY
-#define CO_CAN_MAX_RETRY 15000
+        uint32_t canOpen_PrevProcessTime; /* HAL_GetTick() or microseconds with CO_APP_TICKLESS */
+        bool_t warmReset;   /* Communication reset in progress keeps CAN peripheral running */
+        uint32_t resetTime; /* CO_CAN_CLOCK() ticks from NMT reset communication to boot-up */
+#if CO_APP_TICKLESS
+        uint32_t timerPrevIRQ;              /* Time of last CANopenNode_IRQ() */
+        volatile uint32_t timerNextProcess; /* Deadline of CANopenNode_Process() */
+        volatile uint32_t timerNextIRQ;     /* Deadline of CANopenNode_IRQ() */
+        volatile bool_t wakeup;             /* Interrupt requested another CANopenNode_Process() */
+        uint32_t sleepCount;                /* Number of wakeups from CANopenNode_Sleep() */
+        uint32_t sleepTime_us;              /* Total time spent in CANopenNode_Sleep() */
+#endif
+#if CO_APP_SYNC_OFFSET_US > 0
+        bool_t syncHeld; /* SYNC received, its TPDOs wait for syncAt */
+        uint32_t syncAt; /* Time of TPDO sampling, reception plus CO_APP_SYNC_OFFSET_US */
+#endif
+#if CO_CAN_RX_TIMESTAMP
+        uint16_t syncRxIndex;      /* Receive buffer of SYNC, its reception time corrects SYNC timer */
+        uint16_t hbRxIndex;        /* Receive buffer of the first heartbeat consumer node */
+        uint8_t hbRxCount;         /* Number of heartbeat consumer nodes */
+        uint32_t syncRxChecked_us; /* CO_CAN_TIME_US() of the last look at SYNC reception */
+        uint32_t syncLag_us;       /* Time after SYNC reception, given with the next CO_process_SYNC() */
+        uint32_t hbRxChecked_us;   /* Same for heartbeat receptions and CO_process() */
+        uint32_t hbLag_us;
+        uint32_t syncTpdoMin_us;   /* Time from SYNC reception to TPDOs in mailboxes, jitter is max - min */
+        uint32_t syncTpdoMax_us;
+#endif
+#if (CO_CONFIG_STORAGE) & CO_CONFIG_STORAGE_ENABLE
+        const CO_storageFlash_region_t *storageRegion; /* Flash pages for 0x1010 or NULL, set before CANopenNode_Init() */
+        CO_storage_t storage;
+        CO_storageFlash_t storageFlash;
+        CO_storage_entry_t storageEntries[CO_APP_STORAGE_ENTRIES];
+        uint32_t storageInitError;
+#endif
+#if CO_DIAG_STM32
+        CO_diag_t diag; /* Driver statistics and bus load in Object Dictionary */
 #endif
+#if CO_APP_PROCESS_IMAGE
+        CO_app_PI_t *piInputs;  /* RPDO mapped variables or NULL, set before CANopenNode_Init() */
+        CO_app_PI_t *piOutputs; /* TPDO mapped variables or NULL, set before CANopenNode_Init() */
+        uint32_t piRxDelivered; /* CANmodule->rxDelivered at the last look for new inputs */
+        bool_t piStale;         /* Inputs changed since they were gathered */
+#endif
+} CANopenNodeHandle;
 
 /* This function will initialize the required CANOpen Stack objects,
  * allocate the memory and prepare stack for communication reset*/
@@ -69,6 +428,48 @@ void CANopenNode_Process(CANopenNodeHandle *hCANopenHandle);
  * from FreeRTOS tasks or Timers ********/
 void CANopenNode_IRQ(CANopenNodeHandle *canopenSTM32);
 
+/* CANopenNode_Process() and CANopenNode_IRQ() of all initialized ports,
+ * in order of CO_APP_PORTS */
+void CANopenNode_ProcessAll(void);
+void CANopenNode_IRQAll(void);
+
+/* CANopenNode_IRQ() of the ports, which use timer htim. Call it from
+ * HAL_TIM_PeriodElapsedCallback(), with CO_APP_TICKLESS from
+ * HAL_TIM_OC_DelayElapsedCallback(). HAL calls the latter for compare of
+ * CO_APP_TIMER_CHANNEL and CO_APP_SYNC_CHANNEL alike. */
+void CANopenNode_TimerIRQ(TIM_HandleTypeDef *htim);
+
+#if CO_GATEWAY_STM32
+/* Forward frames between ports with gateway, initialized with
+ * CO_gateway_init(). Gateway port is index of the port in CO_APP_PORTS.
+ * Set it before CANopenNode_Init(), ports are attached on every
+ * communication reset. */
+void CANopenNode_SetGateway(CO_gateway_t *gateway);
+#endif
+
+#if CO_APP_TICKLESS
+/* Wait for interrupt, unless an interrupt since the last CANopenNode_Process()
+ * of any node requested another call. Wakes up at the nearest CANopen
+ * deadline of the nodes or on CAN reception. With more ports call it once,
+ * with any handle. Idle time and wakeups are counted in sleepTime_us and
+ * sleepCount of the handle. Enters the sleep under CO_LOCK_ENTER(): WFI with
+ * PRIMASK lock, WFE with SEVONPEND with CO_LOCK_BASEPRI. */
+void CANopenNode_Sleep(CANopenNodeHandle *hCANopenHandle);
+#endif
+
+
+#if CO_APP_PROCESS_IMAGE
+/* Get the latest snapshot of inputs. Buffer stays valid and unchanged until
+ * CANopenNode_PI_releaseInputs() is called. Must not be called from
+ * higher priority context than CANopenNode_IRQ. */
+const uint8_t *CANopenNode_PI_acquireInputs(CANopenNodeHandle *hCANopenHandle);
+void CANopenNode_PI_releaseInputs(CANopenNodeHandle *hCANopenHandle);
+
+/* Get buffer for outputs, fill it completely and publish it. Outputs are
+ * copied into Object Dictionary before next TPDO processing. */
+uint8_t *CANopenNode_PI_outputs(CANopenNodeHandle *hCANopenHandle);
+void CANopenNode_PI_publishOutputs(CANopenNodeHandle *hCANopenHandle);
+#endif
 
 static inline bool CANopenNode_is_operational(CANopenNodeHandle *self) {
         return (self->canOpen_Obj->NMT->operatingState == CO_NMT_OPERATIONAL);
@@ -0,0 +1,400 @@
+/*
+ * CAN driver statistics and bus load meter for STM32, exposed in Object Dictionary
+ *
+ * @file        CO_diag_STM32.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "CO_diag_STM32.h"
+
+#if CO_DIAG_STM32
+
+/*
+ * Read and write functions are called by SDO server with CO_LOCK_OD() held.
+ * It also blocks CAN interrupts, so multi-word values are read consistently.
+ */
+
+/* Copy value of the size of OD variable into buf */
+static ODR_t
+prv_read_value(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead, const void* value,
+               OD_size_t size) {
+    if (stream->dataLength != size) {
+        return ODR_TYPE_MISMATCH;
+    }
+    if (count < size) {
+        return ODR_DEV_INCOMPAT;
+    }
+    memcpy(buf, value, size);
+    *countRead = size;
+    return ODR_OK;
+}
+
+#if CO_CAN_STATISTICS
+/* Average, min and max of interrupt time, sub-index 0..2 */
+static uint32_t
+prv_isr_value(const CO_CANisrStats_t* stats, uint8_t item) {
+    if (stats->count == 0U) {
+        return 0U;
+    }
+    switch (item) {
+        case 0: return stats->min;
+        case 1: return (uint32_t)(stats->sum / stats->count);
+        default: return stats->max;
+    }
+}
+
+static ODR_t
+prv_read_driver(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead) {
+    if (stream == NULL || buf == NULL || countRead == NULL) {
+        return ODR_DEV_INCOMPAT;
+    }
+    if (stream->subIndex == 0U) {
+        return OD_readOriginal(stream, buf, count, countRead);
+    }
+
+    CO_CANmodule_t* CANmodule = ((CO_diag_t*)stream->object)->CANmodule;
+    uint32_t value;
+
+    switch (stream->subIndex) {
+        case 1: value = CANmodule->rxUnmatched; break;
+        case 2: value = CANmodule->rxOverrun[0]; break;
+        case 3: value = CANmodule->rxOverrun[1]; break;
+        case 4: value = CANmodule->txStats.highWater; break;
+        case 5:
+        case 6:
+        case 7: value = prv_isr_value(&CANmodule->isrRx, stream->subIndex - 5U); break;
+        case 8:
+        case 9:
+        case 10: value = prv_isr_value(&CANmodule->isrTx, stream->subIndex - 8U); break;
+        default: return ODR_SUB_NOT_EXIST;
+    }
+    value = CO_SWAP_32(value);
+    return prv_read_value(stream, buf, count, countRead, &value, sizeof(value));
+}
+
+static ODR_t
+prv_read_rx_buffers(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead) {
+    if (stream == NULL || buf == NULL || countRead == NULL) {
+        return ODR_DEV_INCOMPAT;
+    }
+    if (stream->subIndex == 0U) {
+        return OD_readOriginal(stream, buf, count, countRead);
+    }
+
+    CO_CANmodule_t* CANmodule = ((CO_diag_t*)stream->object)->CANmodule;
+    uint16_t index = stream->subIndex - 1U;
+    uint64_t value = 0U;
+
+    if (index < CANmodule->rxSize && CANmodule->rxArray[index].CANrx_callback != NULL) {
+        const CO_CANrx_t* buffer = &CANmodule->rxArray[index];
+        value = ((uint64_t)buffer->ident << 32) | buffer->count;
+    }
+    value = CO_SWAP_64(value);
+    return prv_read_value(stream, buf, count, countRead, &value, sizeof(value));
+}
+
+static ODR_t
+prv_read_tx_buffers(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead) {
+    if (stream == NULL || buf == NULL || countRead == NULL) {
+        return ODR_DEV_INCOMPAT;
+    }
+    if (stream->subIndex == 0U) {
+        return OD_readOriginal(stream, buf, count, countRead);
+    }
+
+    CO_CANmodule_t* CANmodule = ((CO_diag_t*)stream->object)->CANmodule;
+    uint16_t index = stream->subIndex - 1U;
+    uint64_t value = 0U;
+
+    if (index < CANmodule->txSize) {
+        const CO_CANtx_t* buffer = &CANmodule->txArray[index];
+        value = ((uint64_t)(buffer->ident & 0xFFFFU) << 32) | buffer->count;
+    }
+    value = CO_SWAP_64(value);
+    return prv_read_value(stream, buf, count, countRead, &value, sizeof(value));
+}
+#endif /* CO_CAN_STATISTICS */
+
+#if CO_CAN_TX_LATENCY
+static ODR_t
+prv_read_tx_latency(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead) {
+    if (stream == NULL || buf == NULL || countRead == NULL) {
+        return ODR_DEV_INCOMPAT;
+    }
+    if (stream->subIndex == 0U) {
+        return OD_readOriginal(stream, buf, count, countRead);
+    }
+
+    CO_diag_t* diag = stream->object;
+    const CO_CANtxLatency_t* latency = &diag->CANmodule->txLatency[diag->txLatencyClass];
+    uint32_t value = 0U;
+
+    if (stream->subIndex == 1U) {
+        return prv_read_value(stream, buf, count, countRead, &diag->txLatencyClass, sizeof(diag->txLatencyClass));
+    } else if (stream->subIndex == 2U) {
+        for (uint8_t i = 0U; i < CO_CAN_TX_LATENCY_BUCKETS; i++) {
+            value += latency->bucket[i];
+        }
+    } else if (stream->subIndex == 3U) {
+        value = latency->max;
+    } else if (stream->subIndex < 4U + CO_CAN_TX_LATENCY_BUCKETS) {
+        value = latency->bucket[stream->subIndex - 4U];
+    } else {
+        return ODR_SUB_NOT_EXIST;
+    }
+    value = CO_SWAP_32(value);
+    return prv_read_value(stream, buf, count, countRead, &value, sizeof(value));
+}
+
+static ODR_t
+prv_write_tx_latency(OD_stream_t* stream, const void* buf, OD_size_t count, OD_size_t* countWritten) {
+    if (stream == NULL || buf == NULL || countWritten == NULL) {
+        return ODR_DEV_INCOMPAT;
+    }
+
+    CO_diag_t* diag = stream->object;
+
+    switch (stream->subIndex) {
+        case 1: {
+            uint8_t value;
+
+            if (count != sizeof(value) || stream->dataLength != sizeof(value)) {
+                return ODR_TYPE_MISMATCH;
+            }
+            memcpy(&value, buf, sizeof(value));
+            if (value >= CO_CAN_TX_LATENCY_CLASSES) {
+                return ODR_VALUE_HIGH;
+            }
+            diag->txLatencyClass = value;
+            break;
+        }
+        case 2: {
+            uint32_t value;
+
+            if (count != sizeof(value) || stream->dataLength != sizeof(value)) {
+                return ODR_TYPE_MISMATCH;
+            }
+            memcpy(&value, buf, sizeof(value));
+            if (value != 0U) {
+                return ODR_INVALID_VALUE;
+            }
+            memset(diag->CANmodule->txLatency, 0, sizeof(diag->CANmodule->txLatency));
+            break;
+        }
+        default: return ODR_READONLY;
+    }
+    *countWritten = count;
+    return ODR_OK;
+}
+#endif /* CO_CAN_TX_LATENCY */
+
+#if CO_CAN_BUS_LOAD
+static ODR_t
+prv_read_bus_load(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead) {
+    if (stream == NULL || buf == NULL || countRead == NULL) {
+        return ODR_DEV_INCOMPAT;
+    }
+    if (stream->subIndex == 0U) {
+        return OD_readOriginal(stream, buf, count, countRead);
+    }
+
+    CO_diag_t* diag = stream->object;
+    uint16_t value;
+
+    switch (stream->subIndex) {
+        case 1:
+        case 2:
+        case 3: value = diag->busLoad[stream->subIndex - 1U]; break;
+        case 4: value = diag->busPeak; break;
+        case 5: value = diag->busThreshold; break;
+        default: return ODR_SUB_NOT_EXIST;
+    }
+    value = CO_SWAP_16(value);
+    return prv_read_value(stream, buf, count, countRead, &value, sizeof(value));
+}
+
+static ODR_t
+prv_write_bus_load(OD_stream_t* stream, const void* buf, OD_size_t count, OD_size_t* countWritten) {
+    if (stream == NULL || buf == NULL || countWritten == NULL) {
+        return ODR_DEV_INCOMPAT;
+    }
+
+    CO_diag_t* diag = stream->object;
+    uint16_t value;
+
+    if (count != sizeof(value) || stream->dataLength != sizeof(value)) {
+        return ODR_TYPE_MISMATCH;
+    }
+    memcpy(&value, buf, sizeof(value));
+    value = CO_SWAP_16(value);
+
+    switch (stream->subIndex) {
+        case 4:
+            if (value != 0U) {
+                return ODR_INVALID_VALUE;
+            }
+            diag->busPeak = 0U;
+            break;
+        case 5: diag->busThreshold = value; break;
+        default: return ODR_READONLY;
+    }
+    /* Keep value in Object Dictionary, so threshold may be stored */
+    return OD_writeOriginal(stream, buf, count, countWritten);
+}
+
+/* Load of window in 0.1 %, window of level is 10 slots of 10^level ms */
+static uint16_t
+prv_bus_load(const CO_diag_t* diag, uint8_t level) {
+    static const uint8_t scale[3] = {100U, 10U, 1U};
+    uint32_t capacity = (uint32_t)diag->CANmodule->busBitRate * 16U;
+
+    if (capacity == 0U) {
+        return 0U;
+    }
+    uint32_t load = diag->busSum[level] * scale[level] / capacity;
+    return load > 0xFFFFU ? 0xFFFFU : (uint16_t)load;
+}
+
+/* Close 1 ms slot. Full window of one level is the next slot of the next level. */
+static void
+prv_bus_slot(CO_diag_t* diag, uint32_t bits) {
+    for (uint8_t level = 0U; level < 3U; level++) {
+        uint8_t pos = diag->busPos[level];
+
+        diag->busSum[level] += bits - diag->busSlot[level][pos];
+        diag->busSlot[level][pos] = bits;
+        diag->busLoad[level] = prv_bus_load(diag, level);
+        if (++pos < CO_DIAG_BUS_SLOTS) {
+            diag->busPos[level] = pos;
+            break;
+        }
+        diag->busPos[level] = 0U;
+        bits = diag->busSum[level];
+    }
+    if (diag->busLoad[0] > diag->busPeak) {
+        diag->busPeak = diag->busLoad[0];
+    }
+}
+#endif /* CO_CAN_BUS_LOAD */
+
+void
+CO_diag_init(CO_diag_t* diag, CO_CANmodule_t* CANmodule, CO_EM_t* em, OD_t* od) {
+    if (diag == NULL || CANmodule == NULL || od == NULL) {
+        return;
+    }
+    diag->CANmodule = CANmodule;
+
+#if CO_CAN_STATISTICS
+    diag->OD_driverExt.object = diag;
+    diag->OD_driverExt.read = prv_read_driver;
+    diag->OD_driverExt.write = NULL;
+    OD_extension_init(OD_find(od, CO_DIAG_OD_DRIVER), &diag->OD_driverExt);
+
+    diag->OD_rxBuffersExt.object = diag;
+    diag->OD_rxBuffersExt.read = prv_read_rx_buffers;
+    diag->OD_rxBuffersExt.write = NULL;
+    OD_extension_init(OD_find(od, CO_DIAG_OD_RX_BUFFERS), &diag->OD_rxBuffersExt);
+
+    diag->OD_txBuffersExt.object = diag;
+    diag->OD_txBuffersExt.read = prv_read_tx_buffers;
+    diag->OD_txBuffersExt.write = NULL;
+    OD_extension_init(OD_find(od, CO_DIAG_OD_TX_BUFFERS), &diag->OD_txBuffersExt);
+#endif
+
+#if CO_CAN_TX_LATENCY
+    diag->txLatencyClass = 0U;
+    diag->OD_txLatencyExt.object = diag;
+    diag->OD_txLatencyExt.read = prv_read_tx_latency;
+    diag->OD_txLatencyExt.write = prv_write_tx_latency;
+    OD_extension_init(OD_find(od, CO_DIAG_OD_TX_LATENCY), &diag->OD_txLatencyExt);
+#endif
+
+#if CO_CAN_BUS_LOAD
+    OD_entry_t* entry = OD_find(od, CO_DIAG_OD_BUS_LOAD);
+
+    diag->em = em;
+    memset(diag->busSlot, 0, sizeof(diag->busSlot));
+    for (uint8_t level = 0U; level < 3U; level++) {
+        diag->busSum[level] = 0U;
+        diag->busPos[level] = 0U;
+        diag->busLoad[level] = 0U;
+    }
+    diag->busBitsOld = 0U; /* Driver counters are reset in CO_CANmodule_init() */
+    diag->busTime_us = 0U;
+    diag->busPeak = 0U;
+    diag->busThreshold = 0U;
+    diag->busOverload = false;
+    (void)OD_get_u16(entry, 5, &diag->busThreshold, true);
+
+    diag->OD_busLoadExt.object = diag;
+    diag->OD_busLoadExt.read = prv_read_bus_load;
+    diag->OD_busLoadExt.write = prv_write_bus_load;
+    OD_extension_init(entry, &diag->OD_busLoadExt);
+#else
+    (void)em;
+#endif
+}
+
+void
+CO_diag_process(CO_diag_t* diag, uint32_t timeDifference_us) {
+#if CO_CAN_BUS_LOAD
+    CO_CANmodule_t* CANmodule = diag->CANmodule;
+
+    if (CANmodule == NULL) {
+        return;
+    }
+    uint32_t total = CANmodule->busBitsRx[0] + CANmodule->busBitsRx[1] + CANmodule->busBitsTx;
+    uint32_t bits = total - diag->busBitsOld;
+
+    /* After a long pause, older slots are empty anyway, drop their share */
+    diag->busTime_us += timeDifference_us;
+    if (diag->busTime_us > 1000000U) {
+        bits = (uint32_t)((uint64_t)bits * 1000000U / diag->busTime_us);
+        diag->busBitsOld = total - bits;
+        diag->busTime_us = 1000000U;
+    }
+    /* Frames since the last slot are spread evenly over the time, tickless
+     * CANopenNode_IRQ() closes several slots at once */
+    while (diag->busTime_us >= 1000U) {
+        uint32_t share = (uint32_t)((uint64_t)bits * 1000U / diag->busTime_us);
+
+        diag->busTime_us -= 1000U;
+        bits -= share;
+        diag->busBitsOld += share;
+        prv_bus_slot(diag, share);
+    }
+
+    if (diag->em != NULL) {
+        bool_t overload = diag->busThreshold != 0U && diag->busLoad[1] > diag->busThreshold;
+
+        if (overload && !diag->busOverload) {
+            CO_errorReport(diag->em, CO_DIAG_BUS_LOAD_EMCY_BIT, CO_EMC_COMMUNICATION, diag->busLoad[1]);
+        } else if (!overload && diag->busOverload) {
+            CO_errorReset(diag->em, CO_DIAG_BUS_LOAD_EMCY_BIT, diag->busLoad[1]);
+        }
+        diag->busOverload = overload;
+    }
+#else
+    (void)diag;
+    (void)timeDifference_us;
+#endif
+}
+
+#endif /* CO_DIAG_STM32 */
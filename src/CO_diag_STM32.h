@@ -0,0 +1,160 @@
+/*
+ * CAN driver statistics and bus load meter for STM32, exposed in Object Dictionary
+ *
+ * @file        CO_diag_STM32.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CO_DIAG_STM32_H
+#define CO_DIAG_STM32_H
+
+#include "301/CO_driver.h"
+#include "301/CO_ODinterface.h"
+#include "301/CO_Emergency.h"
+
+/* Driver statistics, bus load meter or transmit latency is enabled */
+#define CO_DIAG_STM32 (CO_CAN_STATISTICS || CO_CAN_BUS_LOAD || CO_CAN_TX_LATENCY)
+
+#if CO_DIAG_STM32 || defined CO_DOXYGEN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Driver statistics (CO_CAN_STATISTICS) are read by SDO from manufacturer
+ * specific Object Dictionary entries. Entries are optional, add them to the
+ * device description (with the CANopenEditor) as needed:
+ *
+ * CO_DIAG_OD_DRIVER, RECORD, all sub-indexes UNSIGNED32, read-only:
+ *  - 1: frames without receive buffer
+ *  - 2, 3: RX FIFO0 and RX FIFO1 overruns
+ *  - 4: high-water mark of transmit backlog
+ *  - 5, 6, 7: min, average and max time of CAN receive interrupt
+ *  - 8, 9, 10: min, average and max time of CAN transmit interrupt
+ *
+ * CO_DIAG_OD_RX_BUFFERS and CO_DIAG_OD_TX_BUFFERS, ARRAY of UNSIGNED64,
+ * read-only, sub-index N is buffer N-1 of rxArray or txArray. Value is
+ * COB-ID (with RTR flag 0x8000) in upper 32 bits and number of frames in
+ * lower 32 bits. Sub-indexes beyond number of buffers read 0.
+ *
+ * Times are in CO_CAN_CLOCK() ticks, CPU cycles with default DWT clock.
+ *
+ * Bus load meter (CO_CAN_BUS_LOAD) in CO_DIAG_OD_BUS_LOAD, RECORD, all
+ * sub-indexes UNSIGNED16, load in 0.1 % of bit rate:
+ *  - 1, 2, 3: load in the last 10 ms, 100 ms and 1 s, read-only
+ *  - 4: peak of 10 ms load, write 0 to reset it
+ *  - 5: threshold of 100 ms load for emergency message, 0 disables,
+ *       read-write, initial value from Object Dictionary
+ *
+ * Windows slide in 1/10 of their length. While 100 ms load is above the
+ * threshold, error CO_DIAG_BUS_LOAD_EMCY_BIT is reported with load as
+ * additional information.
+ *
+ * Transmit latency (CO_CAN_TX_LATENCY) in CO_DIAG_OD_TX_LATENCY, RECORD:
+ *  - 1: CANopen function code (COB-ID >> 7) of the histogram below,
+ *       UNSIGNED8, read-write, 0 after reset
+ *  - 2: frames in the histogram, UNSIGNED32, write 0 to reset histograms
+ *       of all function codes
+ *  - 3: max latency, UNSIGNED32, read-only
+ *  - 4 .. 3 + CO_CAN_TX_LATENCY_BUCKETS: frames in log2 buckets,
+ *       UNSIGNED32, read-only, see CO_CAN_TX_LATENCY_SHIFT
+ *
+ * For example function code 3 is TPDO1, 1 is SYNC and EMCY. */
+#ifndef CO_DIAG_OD_DRIVER
+#define CO_DIAG_OD_DRIVER 0x2F00U
+#endif
+#ifndef CO_DIAG_OD_RX_BUFFERS
+#define CO_DIAG_OD_RX_BUFFERS 0x2F01U
+#endif
+#ifndef CO_DIAG_OD_TX_BUFFERS
+#define CO_DIAG_OD_TX_BUFFERS 0x2F02U
+#endif
+#ifndef CO_DIAG_OD_TX_LATENCY
+#define CO_DIAG_OD_TX_LATENCY 0x2F03U
+#endif
+#ifndef CO_DIAG_OD_BUS_LOAD
+#define CO_DIAG_OD_BUS_LOAD 0x2F10U
+#endif
+#ifndef CO_DIAG_BUS_LOAD_EMCY_BIT
+#define CO_DIAG_BUS_LOAD_EMCY_BIT CO_EM_MANUFACTURER_START
+#endif
+
+/* Number of slots of each bus load window */
+#define CO_DIAG_BUS_SLOTS 10U
+
+/* Statistics object */
+typedef struct {
+    CO_CANmodule_t* CANmodule;
+#if CO_CAN_STATISTICS
+    OD_extension_t OD_driverExt;
+    OD_extension_t OD_rxBuffersExt;
+    OD_extension_t OD_txBuffersExt;
+#endif
+#if CO_CAN_TX_LATENCY
+    OD_extension_t OD_txLatencyExt;
+    uint8_t txLatencyClass; /* Function code of histogram in Object Dictionary */
+#endif
+#if CO_CAN_BUS_LOAD
+    CO_EM_t* em;
+    OD_extension_t OD_busLoadExt;
+    uint32_t busSlot[3][CO_DIAG_BUS_SLOTS]; /* Frame lengths in slots of 1 ms, 10 ms and 100 ms */
+    uint32_t busSum[3];                     /* Sum of all slots of each window */
+    uint8_t busPos[3];                      /* Current slot of each window */
+    uint32_t busBitsOld;                    /* Driver frame length counters, part in closed slots */
+    uint32_t busTime_us;                    /* Time since last slot */
+    uint16_t busLoad[3];                    /* Load of 10 ms, 100 ms and 1 s window, in 0.1 % */
+    uint16_t busPeak;                       /* Peak of 10 ms load */
+    uint16_t busThreshold;                  /* Emergency threshold of 100 ms load or 0 */
+    bool_t busOverload;                     /* Emergency is reported */
+#endif
+} CO_diag_t;
+
+/**
+ * Initialize statistics object
+ *
+ * Registers OD extensions of the statistics entries, which exist in od.
+ * Must be called after CO_CANopenInit(), statistics are reset with
+ * CO_CANmodule_init() on every communication reset.
+ *
+ * @param diag This object will be initialized.
+ * @param CANmodule CAN module, which statistics are exposed.
+ * @param em Emergency object for bus load threshold, may be NULL.
+ * @param od Object Dictionary.
+ */
+void CO_diag_init(CO_diag_t* diag, CO_CANmodule_t* CANmodule, CO_EM_t* em, OD_t* od);
+
+/**
+ * Process bus load meter
+ *
+ * Must be called cyclically, with CO_LOCK_OD() held, for example from
+ * CANopenNode_IRQ(). Does nothing without CO_CAN_BUS_LOAD. Calls may be
+ * several milliseconds apart, frames since the previous call are spread
+ * evenly over the elapsed slots.
+ *
+ * @param diag This object.
+ * @param timeDifference_us Time difference from previous function call.
+ */
+void CO_diag_process(CO_diag_t* diag, uint32_t timeDifference_us);
+
+#ifdef __cplusplus
+}
+#endif /*__cplusplus*/
+
+#endif /* CO_DIAG_STM32 */
+
+#endif /* CO_DIAG_STM32_H */
@@ -29,28 +29,649 @@
  *
  * Implementation Author:               Tilen Majerle <tilen@majerle.eu>
  */
+#include <string.h>
+
 #include "301/CO_driver.h"
 #include "CO_app_STM32.h"
 
-#if defined(FDCAN) || defined(FDCAN1) || defined(FDCAN2) || defined(FDCAN3)
-#define CO_STM32_FDCAN_Driver 1
-#elif defined(CAN) || defined(CAN1) || defined(CAN2) || defined(CAN3)
-#define CO_STM32_CAN_Driver 1
-#else
-#error This STM32 Do not support CAN or FDCAN
+#if CO_CAN_DIRECT_REGISTERS && defined(CO_STM32_FDCAN_Driver)
+#ifndef SRAMCAN_BASE
+#error CO_CAN_DIRECT_REGISTERS supports FDCAN with fixed message RAM layout (STM32G4) only
+#endif
+/* Message RAM element of RX FIFO and TX FIFO: two header words and 64 data bytes */
+#define CO_FDCAN_ELEMENT_SIZE (18U * 4U)
+#define CO_FDCAN_ID_Pos       18U
+#define CO_FDCAN_RTR          (1UL << 29)
+#define CO_FDCAN_XTD          (1UL << 30)
+#define CO_FDCAN_DLC_Pos      16U
+#define CO_FDCAN_DLC          (0xFUL << CO_FDCAN_DLC_Pos)
+#define CO_FDCAN_BRS          (1UL << 20)
+#define CO_FDCAN_FDF          (1UL << 21)
+#define CO_FDCAN_FIDX_Pos     24U
+#define CO_FDCAN_FIDX         (0x7FUL << CO_FDCAN_FIDX_Pos)
+#define CO_FDCAN_ANMF         (1UL << 31)
+#define CO_FDCAN_EFC          (1UL << 23)
+#define CO_FDCAN_RXTS         0xFFFFUL
+#define CO_FDCAN_MM_Pos       24U
 #endif
 
 /* CAN masks for identifiers */
 #define CANID_MASK 0x07FF /*!< CAN standard ID mask */
 #define FLAG_RTR   0x8000 /*!< RTR flag, part of identifier */
 
+/* Set or clear pending transmit bit of buffer rank */
+#define CO_CAN_TX_PENDING_SET(CANmodule, rank) ((CANmodule)->txPending[(rank) >> 5] |= 1UL << ((rank) & 31U))
+#define CO_CAN_TX_PENDING_CLR(CANmodule, rank) ((CANmodule)->txPending[(rank) >> 5] &= ~(1UL << ((rank) & 31U)))
+
+/* Statistics hooks, they expand to nothing without CO_CAN_STATISTICS */
+#if CO_CAN_STATISTICS
+#define CO_CAN_STAT_INC(counter)     ((counter)++)
+#define CO_CAN_STAT_ISR_ENTER()      uint32_t isrEnter = CO_CAN_CLOCK()
+#define CO_CAN_STAT_ISR_LEAVE(stats) prv_isr_stats(&(stats), CO_CAN_CLOCK() - isrEnter)
+#else
+#define CO_CAN_STAT_INC(counter)
+#define CO_CAN_STAT_ISR_ENTER()
+#define CO_CAN_STAT_ISR_LEAVE(stats)
+#endif
+
+#ifdef CO_STM32_FDCAN_Driver
+/* Number of data bytes of DLC code, classic frames have 8 bytes above 8 */
+static const uint8_t prv_dlc_bytes[2][16] = {
+    {0U, 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 8U, 8U, 8U, 8U, 8U, 8U, 8U},
+    {0U, 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 12U, 16U, 20U, 24U, 32U, 48U, 64U},
+};
+
+/**
+ * \brief           Get DLC code of the shortest frame, which holds number of bytes
+ */
+static uint32_t
+prv_dlc_code(uint8_t bytes) {
+    uint32_t code = bytes < 8U ? bytes : 8U;
+
+    while (prv_dlc_bytes[1][code] < bytes) {
+        code++;
+    }
+    return code;
+}
+#endif
+
+/* End of dispatch index list and marker for buffer not linked in any list */
+#define CO_CAN_RX_NONE     0xFFFFU
+#define CO_CAN_RX_UNLINKED 0xFFFEU
+
+#if CO_CAN_RX_HASH_SIZE > 0
+/* Bucket of 11-bit identifier. Folds function code into node-ID bits, so
+ * RPDOs, SDO and heartbeat of the same node do not share a bucket. */
+#define CO_CAN_RX_HASH(ident) ((((ident) & CANID_MASK) ^ (((ident) & CANID_MASK) >> 7) * 37U) & (CO_CAN_RX_HASH_SIZE - 1U))
+
+/**
+ * \brief           Get dispatch index list, where buffer with ident and mask belongs to
+ */
+static uint16_t*
+prv_rx_list(CO_CANmodule_t* CANmodule, uint16_t ident, uint16_t mask) {
+    if ((mask & CANID_MASK) == CANID_MASK) {
+        return &CANmodule->rxHash[CO_CAN_RX_HASH(ident)];
+    }
+    return &CANmodule->rxMasked;
+}
+
+/**
+ * \brief           Remove buffer from its dispatch index list
+ * Must be called with CO_LOCK_CAN_SEND held.
+ */
+static void
+prv_rx_unlink(CO_CANmodule_t* CANmodule, uint16_t index) {
+    CO_CANrx_t* buffer = &CANmodule->rxArray[index];
+    uint16_t* link;
+
+    if (buffer->next == CO_CAN_RX_UNLINKED) {
+        return;
+    }
+    link = prv_rx_list(CANmodule, buffer->ident, buffer->mask);
+    while (*link != CO_CAN_RX_NONE && *link != index) {
+        link = &CANmodule->rxArray[*link].next;
+    }
+    if (*link == index) {
+        *link = buffer->next;
+    }
+    buffer->next = CO_CAN_RX_UNLINKED;
+}
+
+/**
+ * \brief           Insert buffer into its dispatch index list
+ * Lists are kept sorted by index, so lookup keeps priority of linear scan.
+ * Must be called with CO_LOCK_CAN_SEND held.
+ */
+static void
+prv_rx_link(CO_CANmodule_t* CANmodule, uint16_t index) {
+    CO_CANrx_t* buffer = &CANmodule->rxArray[index];
+    uint16_t* link = prv_rx_list(CANmodule, buffer->ident, buffer->mask);
+
+    while (*link != CO_CAN_RX_NONE && *link < index) {
+        link = &CANmodule->rxArray[*link].next;
+    }
+    buffer->next = *link;
+    *link = index;
+}
+
+/**
+ * \brief           Find buffer with the lowest index, which matches identifier
+ * \return          Pointer to buffer or NULL if not found
+ */
+static CO_CANrx_t*
+prv_rx_find(CO_CANmodule_t* CANmodule, uint32_t rcvMsgIdent) {
+    CO_CANrx_t* rxArray = CANmodule->rxArray;
+    uint16_t found = CO_CAN_RX_NONE;
+    uint16_t i;
+
+    for (i = CANmodule->rxHash[CO_CAN_RX_HASH(rcvMsgIdent)]; i != CO_CAN_RX_NONE; i = rxArray[i].next) {
+        if (((rcvMsgIdent ^ rxArray[i].ident) & rxArray[i].mask) == 0U) {
+            found = i;
+            break;
+        }
+    }
+    /* Buffers with partial mask are few, they are checked only up to the found one */
+    for (i = CANmodule->rxMasked; i != CO_CAN_RX_NONE && i < found; i = rxArray[i].next) {
+        if (((rcvMsgIdent ^ rxArray[i].ident) & rxArray[i].mask) == 0U) {
+            found = i;
+            break;
+        }
+    }
+    return found != CO_CAN_RX_NONE ? &rxArray[found] : NULL;
+}
+#endif /* CO_CAN_RX_HASH_SIZE > 0 */
+
+/**
+ * \brief           Match received identifier with receive buffers in software
+ * \return          Pointer to buffer with the lowest index or NULL if not found
+ */
+static CO_CANrx_t*
+prv_rx_lookup(CO_CANmodule_t* CANmodule, uint32_t rcvMsgIdent) {
+#if CO_CAN_RX_HASH_SIZE > 0
+    return prv_rx_find(CANmodule, rcvMsgIdent);
+#else
+    CO_CANrx_t* buffer = CANmodule->rxArray;
+    for (uint16_t index = CANmodule->rxSize; index > 0U; --index, ++buffer) {
+        if (((rcvMsgIdent ^ buffer->ident) & buffer->mask) == 0U) {
+            return buffer;
+        }
+    }
+    return NULL;
+#endif
+}
+
+/* Handle of CAN peripheral of CAN module */
+#define prv_hcan(CANmodule) (((CANopenNodeHandle*)(CANmodule)->CANptr)->CANHandle)
+
+/* Interrupts of CAN peripheral used by driver */
+#ifdef CO_STM32_FDCAN_Driver
+#define CO_CAN_NOTIFICATIONS                                                                                           \
+    (FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_NEW_MESSAGE | FDCAN_IT_TX_COMPLETE | FDCAN_IT_TX_FIFO_EMPTY     \
+     | FDCAN_IT_BUS_OFF | FDCAN_IT_ARB_PROTOCOL_ERROR | FDCAN_IT_DATA_PROTOCOL_ERROR | FDCAN_IT_ERROR_PASSIVE         \
+     | FDCAN_IT_ERROR_WARNING | CO_CAN_TX_EVENT_IT)
+#if CO_CAN_TX_LATENCY
+#define CO_CAN_TX_EVENT_IT FDCAN_IT_TX_EVT_FIFO_NEW_DATA
+#else
+#define CO_CAN_TX_EVENT_IT 0U
+#endif
+#else
+#define CO_CAN_NOTIFICATIONS (CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING | CAN_IT_TX_MAILBOX_EMPTY)
+#endif
+
+#ifndef CO_STM32_FDCAN_Driver
+/* 16-bit scale filter register value of identifier and mask, IDE bit must be 0 */
+#define CO_CAN_FILTER16_ID(ident)  ((((ident) & CANID_MASK) << 5) | (((ident) & FLAG_RTR) ? 0x10U : 0x00U))
+#define CO_CAN_FILTER16_MASK(mask) (CO_CAN_FILTER16_ID(mask) | 0x08U)
+#endif
+
+#if CO_CAN_RX_FIFO_SPLIT
+/* RX FIFO of COB-ID: NMT, SYNC, EMCY, TIME and PDOs go to FIFO0, SDO,
+ * heartbeat and LSS (0x580 and above) to FIFO1 */
+#define CO_CAN_RX_FIFO_OF(ident) (((ident) & CANID_MASK) >= 0x580U ? 1U : 0U)
+#else
+#define CO_CAN_RX_FIFO_OF(ident) 0U
+#endif
+
+#if CO_CAN_RX_FILTERS
+
+#ifndef CO_STM32_FDCAN_Driver
+/* Number of bxCAN filter banks, shared by CAN1 and CAN2 */
+#if defined(CAN2)
+#define CO_CAN_FILTER_BANKS 28U
+#else
+#define CO_CAN_FILTER_BANKS 14U
+#endif
+#endif
+
+#define prv_filter_exact(f) ((f).mask == (CANID_MASK | FLAG_RTR))
+
+/* Incremented on every filter compilation. bxCAN filter match index depends
+ * also on banks of the other CAN instance, so their base must be refreshed. */
+static volatile uint32_t prv_filter_generation;
+
+/**
+ * \brief           Get number of hardware filters (banks, elements), needed for filters
+ */
+static uint16_t
+prv_filter_cost(uint16_t nExact, uint16_t nMasked) {
+#ifdef CO_STM32_FDCAN_Driver
+    /* One element per mask, two exact identifiers per dual element */
+    return nMasked + (nExact + 1U) / 2U;
+#else
+    /* Two masks per 16-bit mask bank, odd one shares bank with one identifier.
+     * Remaining identifiers go four per 16-bit list bank. */
+    uint16_t shared = nMasked & 1U;
+    return (nMasked + 1U) / 2U + (nExact > shared ? (nExact - shared + 3U) / 4U : 0U);
+#endif
+}
+
+/**
+ * \brief           Get number of hardware filters needed for filters of both FIFOs
+ */
+static uint16_t
+prv_filter_cost_all(const CO_CANrxFilter_t* filters, uint16_t count) {
+    uint16_t nExact[2] = {0U, 0U}, nMasked[2] = {0U, 0U};
+
+    for (uint16_t i = 0U; i < count; i++) {
+        if (prv_filter_exact(filters[i])) {
+            nExact[filters[i].fifo]++;
+        } else {
+            nMasked[filters[i].fifo]++;
+        }
+    }
+    return prv_filter_cost(nExact[0], nMasked[0]) + prv_filter_cost(nExact[1], nMasked[1]);
+}
+
+/**
+ * \brief           Merge two filters, which are closest to each other, into one wider mask
+ * Order of filters is preserved, merged filter takes the place of the first one.
+ * Filters of the same FIFO are merged first, merged filters of both FIFOs go to FIFO0.
+ */
+static void
+prv_filter_merge(CO_CANrxFilter_t* filters, uint16_t* count) {
+    uint16_t bestA = 0U, bestB = 1U, bestMask = 0U;
+    int bestBits = -1;
+
+    for (uint16_t a = 0U; a < *count; a++) {
+        for (uint16_t b = a + 1U; b < *count; b++) {
+            uint16_t mask = filters[a].mask & filters[b].mask & (uint16_t)~(filters[a].ident ^ filters[b].ident);
+            /* Same FIFO always wins over crossing FIFOs */
+            int bits = __builtin_popcount(mask) + (filters[a].fifo == filters[b].fifo ? 16 : 0);
+            if (bits > bestBits) {
+                bestBits = bits;
+                bestMask = mask;
+                bestA = a;
+                bestB = b;
+            }
+        }
+    }
+    filters[bestA].mask = bestMask;
+    filters[bestA].ident &= bestMask;
+    filters[bestA].index = CO_CAN_RX_NONE;
+    if (filters[bestA].fifo != filters[bestB].fifo) {
+        filters[bestA].fifo = 0U;
+    }
+    for (uint16_t i = bestB + 1U; i < *count; i++) {
+        filters[i - 1U] = filters[i];
+    }
+    (*count)--;
+}
+
+#ifndef CO_STM32_FDCAN_Driver
+/**
+ * \brief           Get bxCAN instance, which holds filter registers of CAN module
+ */
+static CAN_TypeDef*
+prv_filter_ip(CO_CANmodule_t* CANmodule) {
+#if defined(CAN3)
+    if (prv_hcan(CANmodule)->Instance == CAN3) {
+        return CAN3;
+    }
+#endif
+#if defined(CAN1)
+    return CAN1;
+#else
+    return CAN;
+#endif
+}
+#endif
+
+/**
+ * \brief           Write filter element, unless message RAM holds the same one
+ *
+ * Warm communication reset compiles the same filters again, only elements of
+ * changed (node-ID dependent) identifiers are written.
+ *
+ * \return          true, if element was written
+ */
+#ifdef CO_STM32_FDCAN_Driver
+static bool_t
+prv_filter_write(CO_CANmodule_t* CANmodule, FDCAN_FilterTypeDef* FilterConfig) {
+    FDCAN_HandleTypeDef* hfdcan = prv_hcan(CANmodule);
+    uint32_t element = *(const volatile uint32_t*)(uintptr_t)(hfdcan->msgRam.StandardFilterSA
+                                                              + FilterConfig->FilterIndex * 4U);
+
+    /* Standard filter element: SFT, SFEC, SFID1 and SFID2, same as HAL writes it */
+    if (FilterConfig->FilterConfig == FDCAN_FILTER_DISABLE) {
+        if (((element >> 27) & 0x7U) == FDCAN_FILTER_DISABLE) {
+            return false;
+        }
+    } else if (element
+               == ((FilterConfig->FilterType << 30) | (FilterConfig->FilterConfig << 27) | (FilterConfig->FilterID1 << 16)
+                   | FilterConfig->FilterID2)) {
+        return false;
+    }
+    HAL_FDCAN_ConfigFilter(hfdcan, FilterConfig);
+    return true;
+}
+#else
+/*
+ * HAL_CAN_ConfigFilter() enters filter initialization mode, which deactivates
+ * reception of all bxCAN instances for a moment, so skipping unchanged banks
+ * also keeps running CAN ports undisturbed. Only 16-bit scale is compared.
+ */
+static bool_t
+prv_filter_write(CO_CANmodule_t* CANmodule, CAN_FilterTypeDef* FilterConfig) {
+    const CAN_TypeDef* can_ip = prv_filter_ip(CANmodule);
+    uint32_t bank = FilterConfig->FilterBank;
+    uint32_t bit = 1UL << bank;
+
+    if ((can_ip->FA1R & bit) == 0U) {
+        if (FilterConfig->FilterActivation == DISABLE) {
+            return false;
+        }
+    } else if (FilterConfig->FilterActivation != DISABLE && FilterConfig->FilterScale == CAN_FILTERSCALE_16BIT
+               && (can_ip->FS1R & bit) == 0U
+               && ((can_ip->FM1R & bit) != 0U) == (FilterConfig->FilterMode == CAN_FILTERMODE_IDLIST)
+               && ((can_ip->FFA1R & bit) != 0U) == (FilterConfig->FilterFIFOAssignment == CAN_FILTER_FIFO1)
+               && can_ip->sFilterRegister[bank].FR1
+                      == (((FilterConfig->FilterMaskIdLow & 0xFFFFU) << 16) | (FilterConfig->FilterIdLow & 0xFFFFU))
+               && can_ip->sFilterRegister[bank].FR2
+                      == (((FilterConfig->FilterMaskIdHigh & 0xFFFFU) << 16) | (FilterConfig->FilterIdHigh & 0xFFFFU))) {
+        return false;
+    }
+    HAL_CAN_ConfigFilter(prv_hcan(CANmodule), FilterConfig);
+    return true;
+}
+#endif
+
+/**
+ * \brief           Calculate filter match index of first own filter in each FIFO
+ *
+ * bxCAN numbers filters per FIFO over all lower banks, active or not. Each bank
+ * holds 1 (32-bit mask), 2 (32-bit list, 16-bit mask) or 4 (16-bit list) filters.
+ */
+static void
+prv_rx_filters_base(CO_CANmodule_t* CANmodule) {
+    CANmodule->rxFilterGeneration = prv_filter_generation;
+#ifdef CO_STM32_FDCAN_Driver
+    /* Each FDCAN has its own elements, filter index is element index */
+    CANmodule->rxFilterBase[0] = CANmodule->rxFilterFirst;
+    CANmodule->rxFilterBase[1] = CANmodule->rxFilterFirst;
+#else
+    CAN_TypeDef* can_ip = prv_filter_ip(CANmodule);
+    uint8_t base[2] = {0U, 0U};
+
+    for (uint8_t bank = 0U; bank < CANmodule->rxFilterFirst; bank++) {
+        uint32_t bit = 1UL << bank;
+        uint8_t n = (can_ip->FS1R & bit) ? 1U : 2U;
+
+        if (can_ip->FM1R & bit) {
+            n *= 2U;
+        }
+        base[(can_ip->FFA1R & bit) ? 1U : 0U] += n;
+    }
+    CANmodule->rxFilterBase[0] = base[0];
+    CANmodule->rxFilterBase[1] = base[1];
+#endif
+}
+
+/**
+ * \brief           Add filter of receive buffer or tap to filter candidates
+ *
+ * Filter covered by filter of lower index can never be matched, it does not
+ * need its own one.
+ */
+static void
+prv_filter_add(CO_CANrxFilter_t* filters, uint16_t* count, uint16_t ident, uint16_t mask, uint16_t index) {
+    for (uint16_t j = 0U; j < *count; j++) {
+        if ((filters[j].mask & (uint16_t)~mask) == 0U && ((ident ^ filters[j].ident) & filters[j].mask) == 0U) {
+            return;
+        }
+    }
+    if (*count == CO_CAN_RX_FILTER_MAP_SIZE) {
+        prv_filter_merge(filters, count);
+    }
+    filters[*count].ident = ident;
+    filters[*count].mask = mask;
+    filters[*count].index = index;
+    filters[*count].fifo = CO_CAN_RX_FIFO_OF(ident);
+    (*count)++;
+}
+
+/**
+ * \brief           Compile receive buffers into hardware acceptance filters
+ *
+ * Called before CAN is started and from CO_CANmodule_process() after receive
+ * buffers were reconfigured. Each buffer gets its own filter, if possible, and
+ * its filter match index is mapped directly to rxArray. If filters do not fit
+ * into own banks (elements), the closest ones are merged and frames accepted by
+ * merged filter are matched in software.
+ */
+static void
+prv_rx_filters_compile(CO_CANmodule_t* CANmodule) {
+    CO_CANrxFilter_t* filters = CANmodule->rxFilterWork;
+    uint16_t* order = CANmodule->rxFilterOrder;
+    uint16_t count = 0U, i, j;
+    bool_t written = false;
+
+    CANmodule->rxFiltersDirty = false;
+
+    /* Collect filters in index order, taps follow receive buffers */
+    for (i = 0U; i < CANmodule->rxSize; i++) {
+        CO_CANrx_t* buffer = &CANmodule->rxArray[i];
+
+        if (buffer->CANrx_callback != NULL) {
+            prv_filter_add(filters, &count, buffer->ident, buffer->mask, i);
+        }
+    }
+#if CO_CAN_RX_TAPS > 0
+    /* Frames of tap filter are matched in software */
+    for (i = 0U; i < CO_CAN_RX_TAPS; i++) {
+        CO_CANrxTap_t* tap = &CANmodule->rxTaps[i];
+
+        if (tap->callback != NULL) {
+            prv_filter_add(filters, &count, tap->ident, tap->mask, CO_CAN_RX_NONE);
+        }
+    }
+#endif
+
+    /* Merge filters until they fit into own banks (elements) */
+    while (count > 1U && prv_filter_cost_all(filters, count) > CANmodule->rxFilterCount) {
+        prv_filter_merge(filters, &count);
+    }
+
+    for (i = 0U; i < CO_CAN_RX_FILTER_MAP_SIZE; i++) {
+        CANmodule->rxFilterMap[0][i] = CO_CAN_RX_NONE;
+        CANmodule->rxFilterMap[1][i] = CO_CAN_RX_NONE;
+    }
+
+#ifdef CO_STM32_FDCAN_Driver
+    /* Elements are evaluated in order and first match wins, so they keep index
+     * order. Exact identifiers of the same FIFO are paired into dual elements
+     * only if needed. Pair moves the second identifier ahead of filters between
+     * them, mapped buffer is verified and software matching resolves that. */
+    FDCAN_FilterTypeDef FilterConfig = {0};
+    uint16_t duals = count > CANmodule->rxFilterCount ? (uint16_t)(count - CANmodule->rxFilterCount) : 0U;
+    uint16_t element = 0U;
+
+    for (i = 0U; i < count; i++) {
+        order[i] = 0U; /* Not paired */
+    }
+    FilterConfig.IdType = FDCAN_STANDARD_ID;
+    for (i = 0U; i < count; i++) {
+        if (order[i] != 0U) {
+            continue;
+        }
+        FilterConfig.FilterIndex = CANmodule->rxFilterFirst + element;
+        FilterConfig.FilterConfig = filters[i].fifo == 0U ? FDCAN_FILTER_TO_RXFIFO0 : FDCAN_FILTER_TO_RXFIFO1;
+        FilterConfig.FilterID1 = filters[i].ident & CANID_MASK;
+        FilterConfig.FilterType = FDCAN_FILTER_MASK;
+        FilterConfig.FilterID2 = filters[i].mask & CANID_MASK;
+        if (prv_filter_exact(filters[i]) && duals > 0U) {
+            for (j = i + 1U; j < count; j++) {
+                if (order[j] == 0U && prv_filter_exact(filters[j]) && filters[j].fifo == filters[i].fifo) {
+                    /* Filter index does not tell which of both, first one is verified */
+                    FilterConfig.FilterType = FDCAN_FILTER_DUAL;
+                    FilterConfig.FilterID2 = filters[j].ident & CANID_MASK;
+                    order[j] = 1U;
+                    duals--;
+                    break;
+                }
+            }
+        }
+        if (element < CO_CAN_RX_FILTER_MAP_SIZE) {
+            CANmodule->rxFilterMap[0][element] = filters[i].index;
+        }
+        written |= prv_filter_write(CANmodule, &FilterConfig);
+        element++;
+    }
+    for (; element < CANmodule->rxFilterCount; element++) {
+        FilterConfig.FilterIndex = CANmodule->rxFilterFirst + element;
+        FilterConfig.FilterConfig = FDCAN_FILTER_DISABLE;
+        written |= prv_filter_write(CANmodule, &FilterConfig);
+    }
+#else
+    /* Banks of each FIFO hold masks in index order, so lower filter number
+     * wins on overlap. Identifier, which shares mask bank with odd mask, goes
+     * first: mask of lower index, which matches it, would cover it. Other
+     * identifiers go into list banks, they have priority over masks anyway. */
+    uint8_t fmi[2] = {0U, 0U};
+    uint8_t bank = CANmodule->rxFilterFirst;
+    CAN_FilterTypeDef FilterConfig;
+
+    FilterConfig.FilterScale = CAN_FILTERSCALE_16BIT;
+    FilterConfig.SlaveStartFilterBank = CO_CAN_SLAVE_START_FILTER_BANK;
+    for (uint8_t fifo = 0U; fifo < 2U; fifo++) {
+        uint16_t nSorted = 0U, shared = count;
+        uint16_t nExact = 0U, nMaskMode = 0U;
+
+        for (i = 0U; i < count; i++) {
+            if (filters[i].fifo == fifo) {
+                if (prv_filter_exact(filters[i])) {
+                    nExact++;
+                } else {
+                    nMaskMode++;
+                }
+            }
+        }
+        if ((nMaskMode & 1U) != 0U && nExact > 0U) {
+            for (shared = 0U; filters[shared].fifo != fifo || !prv_filter_exact(filters[shared]); shared++) {}
+            order[nSorted++] = shared;
+            nMaskMode++;
+        }
+        for (i = 0U; i < count; i++) {
+            if (filters[i].fifo == fifo && !prv_filter_exact(filters[i])) {
+                order[nSorted++] = i;
+            }
+        }
+        for (i = 0U; i < count; i++) {
+            if (filters[i].fifo == fifo && prv_filter_exact(filters[i]) && i != shared) {
+                order[nSorted++] = i;
+            }
+        }
+
+        for (i = 0U; i < nSorted; bank++) {
+            CO_CANrxFilter_t* slot[4];
+            uint8_t nSlots = i < nMaskMode ? 2U : 4U;
+
+            /* Unused slots repeat the last filter */
+            for (j = 0U; j < nSlots; j++) {
+                slot[j] = &filters[order[(i + j) < nSorted ? (i + j) : (nSorted - 1U)]];
+            }
+            FilterConfig.FilterBank = bank;
+            FilterConfig.FilterFIFOAssignment = fifo == 0U ? CAN_FILTER_FIFO0 : CAN_FILTER_FIFO1;
+            FilterConfig.FilterActivation = ENABLE;
+            if (nSlots == 2U) {
+                FilterConfig.FilterMode = CAN_FILTERMODE_IDMASK;
+                FilterConfig.FilterIdLow = CO_CAN_FILTER16_ID(slot[0]->ident);
+                FilterConfig.FilterMaskIdLow = CO_CAN_FILTER16_MASK(slot[0]->mask);
+                FilterConfig.FilterIdHigh = CO_CAN_FILTER16_ID(slot[1]->ident);
+                FilterConfig.FilterMaskIdHigh = CO_CAN_FILTER16_MASK(slot[1]->mask);
+            } else {
+                FilterConfig.FilterMode = CAN_FILTERMODE_IDLIST;
+                FilterConfig.FilterIdLow = CO_CAN_FILTER16_ID(slot[0]->ident);
+                FilterConfig.FilterMaskIdLow = CO_CAN_FILTER16_ID(slot[1]->ident);
+                FilterConfig.FilterIdHigh = CO_CAN_FILTER16_ID(slot[2]->ident);
+                FilterConfig.FilterMaskIdHigh = CO_CAN_FILTER16_ID(slot[3]->ident);
+            }
+            for (j = 0U; j < nSlots; j++, fmi[fifo]++) {
+                if (fmi[fifo] < CO_CAN_RX_FILTER_MAP_SIZE) {
+                    CANmodule->rxFilterMap[fifo][fmi[fifo]] = slot[j]->index;
+                }
+            }
+            i += nSlots;
+            written |= prv_filter_write(CANmodule, &FilterConfig);
+        }
+    }
+    /* Deactivate remaining own banks */
+    for (; bank < CANmodule->rxFilterFirst + CANmodule->rxFilterCount; bank++) {
+        FilterConfig.FilterBank = bank;
+        FilterConfig.FilterActivation = DISABLE;
+        written |= prv_filter_write(CANmodule, &FilterConfig);
+    }
+#endif
+
+    if (written) {
+        prv_filter_generation++;
+    }
+    prv_rx_filters_base(CANmodule);
+}
+
+/**
+ * \brief           Find receive buffer by hardware filter match index
+ *
+ * Mapped buffer is verified, so stale or ambiguous mapping falls back to
+ * software matching.
+ */
+static CO_CANrx_t*
+prv_rx_filter_find(CO_CANmodule_t* CANmodule, uint32_t fifo, uint32_t filterIndex, uint32_t rcvMsgIdent) {
+    uint32_t slot = filterIndex - CANmodule->rxFilterBase[fifo];
+
+    if (slot < CO_CAN_RX_FILTER_MAP_SIZE) {
+        uint16_t index = CANmodule->rxFilterMap[fifo][slot];
+
+        if (index < CANmodule->rxSize) {
+            CO_CANrx_t* buffer = &CANmodule->rxArray[index];
+
+            if (((rcvMsgIdent ^ buffer->ident) & buffer->mask) == 0U) {
+                return buffer;
+            }
+        }
+    }
+    return prv_rx_lookup(CANmodule, rcvMsgIdent);
+}
+#endif /* CO_CAN_RX_FILTERS */
+
+/**
+ * \brief           Check if CAN peripheral is started
+ */
+static bool_t
+prv_can_running(void* CANptr) {
+#ifdef CO_STM32_FDCAN_Driver
+    return ((CANopenNodeHandle*)CANptr)->CANHandle->State == HAL_FDCAN_STATE_BUSY;
+#else
+    return ((CANopenNodeHandle*)CANptr)->CANHandle->State == HAL_CAN_STATE_LISTENING;
+#endif
+}
+
 /******************************************************************************/
 void
 CO_CANsetConfigurationMode(void* CANptr) {
-    /* Put CAN module in configuration mode */
-    if (CANptr != NULL) {
+    /* Put CAN module in configuration mode, warm communication reset keeps it on the bus */
+    if (CANptr != NULL && !((CANopenNodeHandle*)CANptr)->warmReset) {
 #ifdef CO_STM32_FDCAN_Driver
-        HAL_FDCAN_Stop(((CANopenNodeSTM32*)CANptr)->CANHandle);
+        HAL_FDCAN_Stop(((CANopenNodeHandle*)CANptr)->CANHandle);
 #else
         HAL_CAN_Stop(((CANopenNodeHandle*)CANptr)->CANHandle);
 #endif
@@ -62,27 +683,102 @@ void
 CO_CANsetNormalMode(CO_CANmodule_t* CANmodule) {
     /* Put CAN module in normal mode */
     if (CANmodule->CANptr != NULL) {
+#if CO_CAN_RX_FILTERS
+        if (CANmodule->useCANrxFilters && CANmodule->rxFiltersDirty) {
+            prv_rx_filters_compile(CANmodule);
+        }
+#endif
+        if (CANmodule->CANwarm) {
+            /* Frames received during warm communication reset wait in RX FIFO */
+            CANmodule->CANwarm = false;
 #ifdef CO_STM32_FDCAN_Driver
-        if (HAL_FDCAN_Start(((CANopenNodeSTM32*)CANmodule->CANptr)->CANHandle) == HAL_OK)
+            HAL_FDCAN_ActivateNotification(prv_hcan(CANmodule), CO_CAN_NOTIFICATIONS, 0xFFFFFFFF);
 #else
-        if (HAL_CAN_Start(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle) == HAL_OK)
+            HAL_CAN_ActivateNotification(prv_hcan(CANmodule), CO_CAN_NOTIFICATIONS);
 #endif
-        {
+        }
+        /* HAL refuses to start peripheral, which is already running */
+        if (prv_can_running(CANmodule->CANptr)
+#ifdef CO_STM32_FDCAN_Driver
+            || HAL_FDCAN_Start(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle) == HAL_OK
+#else
+            || HAL_CAN_Start(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle) == HAL_OK
+#endif
+        ) {
             CANmodule->CANnormal = true;
         }
     }
 }
 
+#if CO_CAN_BUS_LOAD || CO_CAN_RX_TIMESTAMP
+/**
+ * \brief           Length of nominal bit in (FD)CAN kernel clock cycles, from peripheral bit timing
+ */
+static uint32_t
+prv_nominal_bit(CO_CANmodule_t* CANmodule) {
+#ifdef CO_STM32_FDCAN_Driver
+    /* HAL keeps prescalers and segments in time quanta */
+    const FDCAN_InitTypeDef* init = &prv_hcan(CANmodule)->Init;
+    return init->NominalPrescaler * (1U + init->NominalTimeSeg1 + init->NominalTimeSeg2);
+#else
+    /* Bit timing register, initialized by CANInitFunction() */
+    uint32_t btr = prv_hcan(CANmodule)->Instance->BTR;
+    return ((btr & CAN_BTR_BRP) + 1U)
+           * (3U + ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) + ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos));
+#endif
+}
+#endif
+
+#ifdef CO_LOCK_BASEPRI
+/**
+ * \brief           Check NVIC priority of interrupt lines of CAN peripheral against CO_LOCK_PRIORITY
+ * \return          `false` if a line is more urgent, so CO_LOCK_ENTER() would not mask it, or peripheral is not
+ *                  in CO_CAN_IRQS()
+ */
+static bool_t
+prv_irq_priorities_ok(const void* instance) {
+#define PRV_CAN_IRQ_CHECK(INSTANCE, ...)                                                                               \
+    if (instance == (const void*)(INSTANCE)) {                                                                         \
+        const IRQn_Type irqs[] = {__VA_ARGS__};                                                                        \
+        for (size_t i = 0U; i < sizeof(irqs) / sizeof(irqs[0]); i++) {                                                 \
+            if (NVIC_GetPriority(irqs[i]) < CO_LOCK_PRIORITY) {                                                        \
+                return false;                                                                                          \
+            }                                                                                                          \
+        }                                                                                                              \
+        return true;                                                                                                   \
+    }
+    CO_CAN_IRQS(PRV_CAN_IRQ_CHECK)
+#undef PRV_CAN_IRQ_CHECK
+    return false;
+}
+#endif
+
 /******************************************************************************/
 CO_ReturnError_t
 CO_CANmodule_init(CO_CANmodule_t* CANmodule, void* CANptr, CO_CANrx_t rxArray[], uint16_t rxSize, CO_CANtx_t txArray[],
                   uint16_t txSize, uint16_t CANbitRate) {
 
     /* verify arguments */
-    if (CANmodule == NULL || rxArray == NULL || txArray == NULL) {
+    if (CANmodule == NULL || rxArray == NULL || txArray == NULL || rxSize >= CO_CAN_RX_UNLINKED
+        || txSize > CO_CAN_TX_SIZE_MAX) {
         return CO_ERROR_ILLEGAL_ARGUMENT;
     }
 
+    /*
+     * Warm communication reset: peripheral stays on the bus with its bit
+     * timing, global filter and interrupt configuration. Only the driver
+     * state is reset. Interrupts are held until CO_CANsetNormalMode(),
+     * frames in mailboxes are still sent.
+     */
+    bool_t warm = ((CANopenNodeHandle*)CANptr)->warmReset && prv_can_running(CANptr);
+    if (warm) {
+#ifdef CO_STM32_FDCAN_Driver
+        HAL_FDCAN_DeactivateNotification(((CANopenNodeHandle*)CANptr)->CANHandle, CO_CAN_NOTIFICATIONS);
+#else
+        HAL_CAN_DeactivateNotification(((CANopenNodeHandle*)CANptr)->CANHandle, CO_CAN_NOTIFICATIONS);
+#endif
+    }
+
     /* Hold CANModule variable */
     CANmodule->CANptr = CANptr;
 
@@ -93,11 +789,15 @@ CO_CANmodule_init(CO_CANmodule_t* CANmodule, void* CANptr, CO_CANrx_t rxArray[],
     CANmodule->txSize = txSize;
     CANmodule->CANerrorStatus = 0;
     CANmodule->CANnormal = false;
-    CANmodule->useCANrxFilters = false; /* Do not use HW filters */
+    CANmodule->CANwarm = warm;
+    CANmodule->useCANrxFilters = CO_CAN_RX_FILTERS != 0; /* HW filters are compiled before CAN is started */
     CANmodule->bufferInhibitFlag = false;
     CANmodule->firstCANtxMessage = true;
     CANmodule->CANtxCount = 0U;
     CANmodule->errOld = 0U;
+    CANmodule->rxOverrun[0] = 0U;
+    CANmodule->rxOverrun[1] = 0U;
+    CANmodule->rxDelivered = 0U;
 
     /* Reset all variables */
     for (uint16_t i = 0U; i < rxSize; i++) {
@@ -105,75 +805,274 @@ CO_CANmodule_init(CO_CANmodule_t* CANmodule, void* CANptr, CO_CANrx_t rxArray[],
         rxArray[i].mask = 0xFFFFU;
         rxArray[i].object = NULL;
         rxArray[i].CANrx_callback = NULL;
+        rxArray[i].next = CO_CAN_RX_UNLINKED;
     }
+#if CO_CAN_RX_DEFERRED
+    for (uint8_t i = 0U; i < 2U; i++) {
+        CANmodule->rxQueue[i].head = 0U;
+        CANmodule->rxQueue[i].tail = 0U;
+        CANmodule->rxQueue[i].overflow = 0U;
+    }
+#endif
+#if CO_CAN_RX_HASH_SIZE > 0
+    for (uint16_t i = 0U; i < CO_CAN_RX_HASH_SIZE; i++) {
+        CANmodule->rxHash[i] = CO_CAN_RX_NONE;
+    }
+    CANmodule->rxMasked = CO_CAN_RX_NONE;
+#endif
     for (uint16_t i = 0U; i < txSize; i++) {
+        txArray[i].ident = CANID_MASK | FLAG_RTR; /* lowest priority until initialized */
         txArray[i].bufferFull = false;
+        txArray[i].rank = i;
+        CANmodule->txByRank[i] = i;
+    }
+    for (uint16_t i = 0U; i < CO_CAN_TX_PENDING_WORDS; i++) {
+        CANmodule->txPending[i] = 0U;
+    }
+#if CO_CAN_RX_TAPS > 0
+    for (uint8_t i = 0U; i < CO_CAN_RX_TAPS; i++) {
+        CANmodule->rxTaps[i].callback = NULL;
+    }
+    CANmodule->txIdle = NULL;
+#endif
+    CANmodule->txStats.highWater = 0U;
+    CANmodule->txStats.waitMax = 0U;
+    CANmodule->txStats.waitSum = 0U;
+    CANmodule->txStats.waitCount = 0U;
+#if CO_CAN_TX_LATENCY
+    memset(CANmodule->txLatency, 0, sizeof(CANmodule->txLatency));
+    memset(CANmodule->txSlot, 0, sizeof(CANmodule->txSlot));
+    CANmodule->txMarker = 0U;
+#endif
+#if CO_CAN_STATISTICS
+    for (uint16_t i = 0U; i < rxSize; i++) {
+        rxArray[i].count = 0U;
+    }
+    for (uint16_t i = 0U; i < txSize; i++) {
+        txArray[i].count = 0U;
     }
+    CANmodule->rxUnmatched = 0U;
+    CANmodule->isrRx.min = CANmodule->isrTx.min = UINT32_MAX;
+    CANmodule->isrRx.max = CANmodule->isrTx.max = 0U;
+    CANmodule->isrRx.sum = CANmodule->isrTx.sum = 0U;
+    CANmodule->isrRx.count = CANmodule->isrTx.count = 0U;
+#endif
+    CO_CAN_CLOCK_INIT();
 
     /***************************************/
     /* STM32 related configuration */
     /***************************************/
-    ((CANopenNodeHandle*)CANptr)->CANInitFunction();
+    if (!warm) {
+        ((CANopenNodeHandle*)CANptr)->CANInitFunction();
+    }
+#ifdef CO_LOCK_BASEPRI
+    /* NVIC priorities are set in HAL MSP init, called by CANInitFunction() */
+    if (!prv_irq_priorities_ok(prv_hcan(CANmodule)->Instance)) {
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+#endif
+#if defined(CO_STM32_FDCAN_Driver) && !CO_CAN_FD
+    /* Received FD frame would not fit into CO_CANrxMsg_t */
+    if (((CANopenNodeHandle*)CANptr)->CANHandle->Init.FrameFormat != FDCAN_FRAME_CLASSIC) {
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+#endif
+#if CO_CAN_RX_TIMESTAMP
+    CANmodule->rxStampScale = 0U;
+    CANmodule->rxStampLast = 0U;
+    CANmodule->rxStampTime = CO_CAN_TIME_US();
+#ifndef CO_STM32_FDCAN_Driver
+    if (((CANopenNodeHandle*)CANptr)->CANHandle->Init.TimeTriggeredMode == ENABLE)
+#endif
+    {
+        /* Counter counts nominal bit times */
+        uint32_t nominalBit = prv_nominal_bit(CANmodule);
+        uint32_t clock = CO_CAN_KERNEL_CLOCK();
+
+        if (clock > 0U) {
+            CANmodule->rxStampScale = (uint32_t)(((uint64_t)nominalBit * 1000000U << 16) / clock);
+        }
+    }
+#endif
+#if CO_CAN_BUS_LOAD
+    CANmodule->busBitsRx[0] = 0U;
+    CANmodule->busBitsRx[1] = 0U;
+    CANmodule->busBitsTx = 0U;
+    {
+        uint32_t nominalBit = prv_nominal_bit(CANmodule);
+#if CO_CAN_FD
+        /* HAL keeps prescalers and segments in time quanta */
+        const FDCAN_InitTypeDef* init = &((CANopenNodeHandle*)CANptr)->CANHandle->Init;
+        uint32_t dataBit = init->DataPrescaler * (1U + init->DataTimeSeg1 + init->DataTimeSeg2);
+        CANmodule->busDataBit = nominalBit > 0U ? (uint16_t)((dataBit * 16U + nominalBit / 2U) / nominalBit) : 16U;
+#endif
+        if (CANbitRate == 0U && nominalBit > 0U) {
+            CANbitRate = (uint16_t)((CO_CAN_KERNEL_CLOCK() / nominalBit + 500U) / 1000U);
+        }
+        CANmodule->busBitRate = CANbitRate;
+    }
+#endif
+
+#if CO_CAN_RX_FILTERS
+    /* Own filter banks (elements), filters are compiled in CO_CANsetNormalMode() */
+    CANmodule->rxFiltersDirty = true;
+#ifdef CO_STM32_FDCAN_Driver
+    CANmodule->rxFilterFirst = 0U;
+    CANmodule->rxFilterCount = (uint8_t)((CANopenNodeHandle*)CANptr)->CANHandle->Init.StdFiltersNbr;
+#else
+    CANmodule->rxFilterFirst = 0U;
+    CANmodule->rxFilterCount = CO_CAN_FILTER_BANKS;
+#if defined(CAN2)
+    /* CAN1 and CAN2 share banks, CAN3 has its own 14 banks */
+    if (((CANopenNodeHandle*)CANptr)->CANHandle->Instance == CAN2) {
+        CANmodule->rxFilterFirst = CO_CAN_SLAVE_START_FILTER_BANK;
+        CANmodule->rxFilterCount = CO_CAN_FILTER_BANKS - CO_CAN_SLAVE_START_FILTER_BANK;
+    } else if (prv_filter_ip(CANmodule) == CAN1) {
+        CANmodule->rxFilterCount = CO_CAN_SLAVE_START_FILTER_BANK;
+    } else {
+        CANmodule->rxFilterCount = 14U;
+    }
+#endif
+#endif
+    /* Part of them given to the port in CO_APP_PORTS, the rest is left to application */
+    const CO_app_port_t* port = ((CANopenNodeHandle*)CANptr)->port;
+    if (port != NULL && port->filterCount != 0U) {
+        if (port->filterFirst < CANmodule->rxFilterFirst
+            || port->filterFirst + port->filterCount > CANmodule->rxFilterFirst + CANmodule->rxFilterCount) {
+            return CO_ERROR_ILLEGAL_ARGUMENT;
+        }
+        CANmodule->rxFilterFirst = port->filterFirst;
+        CANmodule->rxFilterCount = port->filterCount;
+    }
+    if (CANmodule->rxFilterCount == 0U) {
+        CANmodule->useCANrxFilters = false;
+    }
+#endif /* CO_CAN_RX_FILTERS */
+
+    if (warm) {
+        /* Filters are compiled in CO_CANsetNormalMode(), only changed ones are written */
+        return CO_ERROR_NO;
+    }
+
+    /* Peripheral is in initialization mode now. Let hardware send pending
+     * mailboxes by identifier priority, same as software backlog. */
+#ifdef CO_STM32_FDCAN_Driver
+    ((CANopenNodeHandle*)CANptr)->CANHandle->Init.TxFifoQueueMode = FDCAN_TX_QUEUE_OPERATION;
+    SET_BIT(((CANopenNodeHandle*)CANptr)->CANHandle->Instance->TXBC, FDCAN_TXBC_TFQM);
+#if CO_CAN_RX_TIMESTAMP
+    /* Timestamp counter runs with nominal bit time */
+    if (HAL_FDCAN_ConfigTimestampCounter(((CANopenNodeHandle*)CANptr)->CANHandle, FDCAN_TIMESTAMP_PRESC_1) != HAL_OK
+        || HAL_FDCAN_EnableTimestampCounter(((CANopenNodeHandle*)CANptr)->CANHandle, FDCAN_TIMESTAMP_INTERNAL)
+               != HAL_OK) {
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+#endif
+#else
+    ((CANopenNodeHandle*)CANptr)->CANHandle->Init.TransmitFifoPriority = DISABLE;
+    CLEAR_BIT(((CANopenNodeHandle*)CANptr)->CANHandle->Instance->MCR, CAN_MCR_TXFP);
+#endif
 
     /*
      * Configure global filter that is used as last check if message did not pass any of other filters:
      *
-     * We do not rely on hardware filters in this example
-     * and are performing software filters instead
+     * Without hardware filters all standard ID messages are accepted
+     * and software filters are performed instead
      *
-     * Accept non-matching standard ID messages
      * Reject non-matching extended ID messages
      */
 
 #ifdef CO_STM32_FDCAN_Driver
-    if (HAL_FDCAN_ConfigGlobalFilter(((CANopenNodeHandle*)CANptr)->CANHandle, FDCAN_ACCEPT_IN_RX_FIFO0, FDCAN_REJECT,
+    if (HAL_FDCAN_ConfigGlobalFilter(((CANopenNodeHandle*)CANptr)->CANHandle,
+                                     CANmodule->useCANrxFilters ? FDCAN_REJECT : FDCAN_ACCEPT_IN_RX_FIFO0, FDCAN_REJECT,
                                      FDCAN_FILTER_REMOTE, FDCAN_FILTER_REMOTE)
         != HAL_OK) {
         return CO_ERROR_ILLEGAL_ARGUMENT;
     }
+#if CO_CAN_RX_FIFO_SPLIT
+    if (!CANmodule->useCANrxFilters && ((CANopenNodeHandle*)CANptr)->CANHandle->Init.StdFiltersNbr > 0U) {
+        /* SDO, heartbeat and LSS to FIFO1, the rest falls through to FIFO0 */
+        FDCAN_FilterTypeDef FilterConfig = {0};
+
+        FilterConfig.IdType = FDCAN_STANDARD_ID;
+        FilterConfig.FilterIndex = 0U;
+        FilterConfig.FilterType = FDCAN_FILTER_RANGE;
+        FilterConfig.FilterConfig = FDCAN_FILTER_TO_RXFIFO1;
+        FilterConfig.FilterID1 = 0x580U;
+        FilterConfig.FilterID2 = CANID_MASK;
+        if (HAL_FDCAN_ConfigFilter(((CANopenNodeHandle*)CANptr)->CANHandle, &FilterConfig) != HAL_OK) {
+            return CO_ERROR_ILLEGAL_ARGUMENT;
+        }
+    }
+    /* FIFO1 on interrupt line 1, so it may have lower NVIC priority than FIFO0 */
+#ifdef FDCAN_IT_GROUP_RX_FIFO1
+    HAL_FDCAN_ConfigInterruptLines(((CANopenNodeHandle*)CANptr)->CANHandle, FDCAN_IT_GROUP_RX_FIFO1,
+                                   FDCAN_INTERRUPT_LINE1);
 #else
+    HAL_FDCAN_ConfigInterruptLines(((CANopenNodeHandle*)CANptr)->CANHandle, FDCAN_IT_RX_FIFO1_NEW_MESSAGE,
+                                   FDCAN_INTERRUPT_LINE1);
+#endif
+#endif
+#else
+    /*
+     * Accept all standard frames into FIFO0. With FIFO split, two 32-bit
+     * masks send 0x580..0x5FF and 0x600..0x7FF into FIFO1 first: 32-bit
+     * filters have priority over 16-bit ones.
+     */
+    static const struct {
+        uint8_t scale, fifo;
+        uint16_t id, mask;
+    } acceptAll[] = {
+#if CO_CAN_RX_FIFO_SPLIT
+        {CAN_FILTERSCALE_32BIT, CAN_FILTER_FIFO1, 0x580U, 0x780U},
+        {CAN_FILTERSCALE_32BIT, CAN_FILTER_FIFO1, 0x600U, 0x600U},
+#endif
+        {CAN_FILTERSCALE_16BIT, CAN_FILTER_FIFO0, 0x000U, 0x000U},
+    };
     CAN_FilterTypeDef FilterConfig;
-#if defined(CAN)
-    FilterConfig.FilterBank = 0;
+#if CO_CAN_RX_FILTERS
+    FilterConfig.FilterBank = CANmodule->rxFilterFirst;
 #else
-    if (((CAN_HandleTypeDef*)((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle)->Instance == CAN1) {
-        FilterConfig.FilterBank = 0;
-    } else {
-        FilterConfig.FilterBank = 14;
+    FilterConfig.FilterBank = 0;
+#if defined(CAN2)
+    if (((CAN_HandleTypeDef*)((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle)->Instance == CAN2) {
+        FilterConfig.FilterBank = CO_CAN_SLAVE_START_FILTER_BANK;
     }
+#endif
 #endif
     FilterConfig.FilterMode = CAN_FILTERMODE_IDMASK;
-    FilterConfig.FilterScale = CAN_FILTERSCALE_32BIT;
-    FilterConfig.FilterIdHigh = 0x0;
-    FilterConfig.FilterIdLow = 0x0;
-    FilterConfig.FilterMaskIdHigh = 0x0;
-    FilterConfig.FilterMaskIdLow = 0x0;
-    FilterConfig.FilterFIFOAssignment = CAN_RX_FIFO0;
-
-    FilterConfig.FilterActivation = ENABLE;
-    FilterConfig.SlaveStartFilterBank = 14;
-
-    if (HAL_CAN_ConfigFilter(((CANopenNodeHandle*)CANptr)->CANHandle, &FilterConfig) != HAL_OK) {
-        return CO_ERROR_ILLEGAL_ARGUMENT;
+    FilterConfig.FilterActivation = CANmodule->useCANrxFilters ? DISABLE : ENABLE;
+    FilterConfig.SlaveStartFilterBank = CO_CAN_SLAVE_START_FILTER_BANK;
+
+    for (uint8_t i = 0U; i < sizeof(acceptAll) / sizeof(acceptAll[0]); i++, FilterConfig.FilterBank++) {
+        FilterConfig.FilterScale = acceptAll[i].scale;
+        FilterConfig.FilterFIFOAssignment = acceptAll[i].fifo;
+        if (acceptAll[i].scale == CAN_FILTERSCALE_32BIT) {
+            /* Standard identifier in bits 31..21, IDE (bit 2) must be 0 */
+            FilterConfig.FilterIdHigh = (uint32_t)acceptAll[i].id << 5;
+            FilterConfig.FilterMaskIdHigh = (uint32_t)acceptAll[i].mask << 5;
+            FilterConfig.FilterIdLow = 0x0U;
+            FilterConfig.FilterMaskIdLow = 0x4U;
+        } else {
+            /* Both 16-bit filters accept any standard identifier, IDE (bit 3) must be 0 */
+            FilterConfig.FilterIdHigh = CO_CAN_FILTER16_ID(acceptAll[i].id);
+            FilterConfig.FilterMaskIdHigh = CO_CAN_FILTER16_MASK(acceptAll[i].mask);
+            FilterConfig.FilterIdLow = FilterConfig.FilterIdHigh;
+            FilterConfig.FilterMaskIdLow = FilterConfig.FilterMaskIdHigh;
+        }
+        if (HAL_CAN_ConfigFilter(((CANopenNodeHandle*)CANptr)->CANHandle, &FilterConfig) != HAL_OK) {
+            return CO_ERROR_ILLEGAL_ARGUMENT;
+        }
     }
 #endif
     /* Enable notifications */
     /* Activate the CAN notification interrupts */
 #ifdef CO_STM32_FDCAN_Driver
-    if (HAL_FDCAN_ActivateNotification(((CANopenNodeHandle*)CANptr)->CANHandle,
-                                       0 | FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_NEW_MESSAGE
-                                           | FDCAN_IT_TX_COMPLETE | FDCAN_IT_TX_FIFO_EMPTY | FDCAN_IT_BUS_OFF
-                                           | FDCAN_IT_ARB_PROTOCOL_ERROR | FDCAN_IT_DATA_PROTOCOL_ERROR
-                                           | FDCAN_IT_ERROR_PASSIVE | FDCAN_IT_ERROR_WARNING,
-                                       0xFFFFFFFF)
+    if (HAL_FDCAN_ActivateNotification(((CANopenNodeHandle*)CANptr)->CANHandle, CO_CAN_NOTIFICATIONS, 0xFFFFFFFF)
         != HAL_OK) {
         return CO_ERROR_ILLEGAL_ARGUMENT;
     }
 #else
-    if (HAL_CAN_ActivateNotification(((CANopenNodeHandle*)CANptr)->CANHandle, CAN_IT_RX_FIFO0_MSG_PENDING
-                                                                                 | CAN_IT_RX_FIFO1_MSG_PENDING
-                                                                                 | CAN_IT_TX_MAILBOX_EMPTY)
-        != HAL_OK) {
+    if (HAL_CAN_ActivateNotification(((CANopenNodeHandle*)CANptr)->CANHandle, CO_CAN_NOTIFICATIONS) != HAL_OK) {
         return CO_ERROR_ILLEGAL_ARGUMENT;
     }
 #endif
@@ -203,6 +1102,12 @@ CO_CANrxBufferInit(CO_CANmodule_t* CANmodule, uint16_t index, uint16_t ident, ui
     if (CANmodule != NULL && object != NULL && CANrx_callback != NULL && index < CANmodule->rxSize) {
         CO_CANrx_t* buffer = &CANmodule->rxArray[index];
 
+        /* Buffer may be reconfigured while CAN is running (RPDO COB-ID change) */
+        CO_LOCK_CAN_SEND(CANmodule);
+#if CO_CAN_RX_HASH_SIZE > 0
+        prv_rx_unlink(CANmodule, index);
+#endif
+
         /* Configure object variables */
         buffer->object = object;
         buffer->CANrx_callback = CANrx_callback;
@@ -215,10 +1120,18 @@ CO_CANrxBufferInit(CO_CANmodule_t* CANmodule, uint16_t index, uint16_t ident, ui
         buffer->ident = (ident & CANID_MASK) | (rtr ? FLAG_RTR : 0x00);
         buffer->mask = (mask & CANID_MASK) | FLAG_RTR;
 
-        /* Set CAN hardware module filter and mask. */
+#if CO_CAN_RX_HASH_SIZE > 0
+        prv_rx_link(CANmodule, index);
+#endif
+        CO_UNLOCK_CAN_SEND(CANmodule);
+
+        /* Set CAN hardware module filter and mask. Filters are compiled together
+         * for all buffers, before CAN is started or in CO_CANmodule_process(). */
+#if CO_CAN_RX_FILTERS
         if (CANmodule->useCANrxFilters) {
-            __NOP();
+            CANmodule->rxFiltersDirty = true;
         }
+#endif
     } else {
         ret = CO_ERROR_ILLEGAL_ARGUMENT;
     }
@@ -226,42 +1139,329 @@ CO_CANrxBufferInit(CO_CANmodule_t* CANmodule, uint16_t index, uint16_t ident, ui
     return ret;
 }
 
+#if CO_CAN_RX_TAPS > 0
+/******************************************************************************/
+bool_t
+CO_CANrxTapInit(CO_CANmodule_t* CANmodule, uint8_t index, uint16_t ident, uint16_t mask, void* object,
+                void (*callback)(void* object, const CO_CANrxMsg_t* msg)) {
+    if (CANmodule == NULL || index >= CO_CAN_RX_TAPS) {
+        return false;
+    }
+    CO_CANrxTap_t* tap = &CANmodule->rxTaps[index];
+
+    CO_LOCK_CAN_SEND(CANmodule);
+    tap->ident = ident & CANID_MASK;
+    tap->mask = (mask & CANID_MASK) | FLAG_RTR;
+    tap->object = object;
+    tap->callback = callback;
+    CO_UNLOCK_CAN_SEND(CANmodule);
+
+#if CO_CAN_RX_FILTERS
+    if (CANmodule->useCANrxFilters) {
+        CANmodule->rxFiltersDirty = true;
+    }
+#endif
+    return true;
+}
+
+/******************************************************************************/
+void
+CO_CANtxIdleInit(CO_CANmodule_t* CANmodule, void* object, void (*callback)(void* object)) {
+    if (CANmodule != NULL) {
+        CO_LOCK_CAN_SEND(CANmodule);
+        CANmodule->txIdleObject = object;
+        CANmodule->txIdle = callback;
+        CO_UNLOCK_CAN_SEND(CANmodule);
+    }
+}
+#endif /* CO_CAN_RX_TAPS */
+
+/**
+ * \brief           Check if transmit buffer a has higher bus priority than b
+ * Lower identifier wins arbitration, data frame wins over remote frame.
+ */
+static bool_t
+prv_tx_before(const CO_CANtx_t* txArray, uint16_t a, uint16_t b) {
+    uint32_t prioA = ((txArray[a].ident & CANID_MASK) << 1) | ((txArray[a].ident & FLAG_RTR) ? 1U : 0U);
+    uint32_t prioB = ((txArray[b].ident & CANID_MASK) << 1) | ((txArray[b].ident & FLAG_RTR) ? 1U : 0U);
+
+    return prioA < prioB || (prioA == prioB && a < b);
+}
+
+/**
+ * \brief           Move transmit buffer to its place in priority order
+ * Must be called with CO_LOCK_CAN_SEND held, buffer must not be pending.
+ */
+static void
+prv_tx_rank(CO_CANmodule_t* CANmodule, uint16_t index) {
+    CO_CANtx_t* txArray = CANmodule->txArray;
+    uint16_t* txByRank = CANmodule->txByRank;
+    uint16_t rank = txArray[index].rank;
+
+    while (rank > 0U && prv_tx_before(txArray, index, txByRank[rank - 1U])) {
+        txByRank[rank] = txByRank[rank - 1U];
+        txArray[txByRank[rank]].rank = rank;
+        rank--;
+    }
+    while ((rank + 1U) < CANmodule->txSize && prv_tx_before(txArray, txByRank[rank + 1U], index)) {
+        txByRank[rank] = txByRank[rank + 1U];
+        txArray[txByRank[rank]].rank = rank;
+        rank++;
+    }
+    txByRank[rank] = index;
+    txArray[index].rank = rank;
+
+    /* Ranks of other buffers moved, rebuild pending bits */
+    for (uint16_t i = 0U; i < CO_CAN_TX_PENDING_WORDS; i++) {
+        CANmodule->txPending[i] = 0U;
+    }
+    for (uint16_t i = 0U; i < CANmodule->txSize; i++) {
+        if (txArray[i].bufferFull) {
+            CO_CAN_TX_PENDING_SET(CANmodule, txArray[i].rank);
+        }
+    }
+}
+
+/**
+ * \brief           Get pending transmit buffer with the highest priority
+ * \return          Pointer to buffer or NULL if none is pending
+ */
+static CO_CANtx_t*
+prv_tx_next(CO_CANmodule_t* CANmodule) {
+    for (uint16_t i = 0U; i < CO_CAN_TX_PENDING_WORDS; i++) {
+        uint32_t bits = CANmodule->txPending[i];
+
+        if (bits != 0U) {
+            return &CANmodule->txArray[CANmodule->txByRank[(i << 5) + (uint16_t)__builtin_ctz(bits)]];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * \brief           Set identifier, length and frame format of transmit buffer
+ */
+static void
+prv_tx_header(CO_CANmodule_t* CANmodule, CO_CANtx_t* buffer, uint16_t ident, bool_t rtr, uint8_t noOfBytes) {
+    /* CAN identifier, DLC and rtr, bit aligned with CAN module transmit buffer */
+    buffer->ident = ((uint32_t)ident & CANID_MASK) | ((uint32_t)(rtr ? FLAG_RTR : 0x00));
+    buffer->DLC = noOfBytes;
+#if CO_CAN_FD
+    buffer->fdFlags = noOfBytes > 8U ? CO_CAN_FD_FORMAT : 0U;
+    for (uint8_t i = 0U; i < ((CANopenNodeHandle*)CANmodule->CANptr)->fdRulesCount; i++) {
+        const CO_CANfdRule_t* rule = &((CANopenNodeHandle*)CANmodule->CANptr)->fdRules[i];
+        if (((ident ^ rule->ident) & rule->mask & CANID_MASK) == 0U) {
+            buffer->fdFlags |= rule->flags;
+            break;
+        }
+    }
+    if ((buffer->fdFlags & CO_CAN_FD_FORMAT) == 0U) {
+        buffer->fdFlags = 0U; /* No BRS in classic frame */
+    }
+#else
+    (void)CANmodule;
+#endif
+#if CO_CAN_DIRECT_REGISTERS
+#ifdef CO_STM32_FDCAN_Driver
+    buffer->hwHeader[0] = ((uint32_t)(ident & CANID_MASK) << CO_FDCAN_ID_Pos) | (rtr ? CO_FDCAN_RTR : 0U);
+    buffer->hwHeader[1] = prv_dlc_code(noOfBytes) << CO_FDCAN_DLC_Pos;
+#if CO_CAN_FD
+    if (buffer->fdFlags & CO_CAN_FD_FORMAT) {
+        buffer->hwHeader[1] |= CO_FDCAN_FDF;
+    }
+    if (buffer->fdFlags & CO_CAN_FD_BRS) {
+        buffer->hwHeader[1] |= CO_FDCAN_BRS;
+    }
+#endif
+#else
+    buffer->hwHeader[0] = ((uint32_t)(ident & CANID_MASK) << CAN_TI0R_STID_Pos) | (rtr ? CAN_TI0R_RTR : 0U);
+    buffer->hwHeader[1] = (uint32_t)noOfBytes & CAN_TDT0R_DLC;
+#endif
+#endif
+}
+
 /******************************************************************************/
 CO_CANtx_t*
 CO_CANtxBufferInit(CO_CANmodule_t* CANmodule, uint16_t index, uint16_t ident, bool_t rtr, uint8_t noOfBytes,
                    bool_t syncFlag) {
     CO_CANtx_t* buffer = NULL;
 
-    if (CANmodule != NULL && index < CANmodule->txSize) {
+    if (CANmodule != NULL && index < CANmodule->txSize && noOfBytes <= CO_CAN_DATA_MAX) {
         buffer = &CANmodule->txArray[index];
 
-        /* CAN identifier, DLC and rtr, bit aligned with CAN module transmit buffer */
-        buffer->ident = ((uint32_t)ident & CANID_MASK) | ((uint32_t)(rtr ? FLAG_RTR : 0x00));
-        buffer->DLC = noOfBytes;
+        /* Buffer may be reconfigured while CAN is running (TPDO COB-ID change) */
+        CO_LOCK_CAN_SEND(CANmodule);
+        if (buffer->bufferFull) {
+            CO_CAN_TX_PENDING_CLR(CANmodule, buffer->rank);
+            CANmodule->CANtxCount--;
+        }
+
+        prv_tx_header(CANmodule, buffer, ident, rtr, noOfBytes);
         buffer->bufferFull = false;
         buffer->syncFlag = syncFlag;
+
+        prv_tx_rank(CANmodule, index);
+        CO_UNLOCK_CAN_SEND(CANmodule);
+    }
+    return buffer;
+}
+
+#if CO_CAN_RX_TAPS > 0
+/******************************************************************************/
+void
+CO_CANtxFrameInit(CO_CANmodule_t* CANmodule, CO_CANtx_t* frame, uint16_t ident, bool_t rtr, uint8_t noOfBytes) {
+    prv_tx_header(CANmodule, frame, ident, rtr, noOfBytes > CO_CAN_DATA_MAX ? CO_CAN_DATA_MAX : noOfBytes);
+    frame->bufferFull = false;
+    frame->syncFlag = false;
+}
+#endif
+
+#if CO_CAN_BUS_LOAD
+/**
+ * \brief           Length of standard frame on the bus, with worst case stuff bits
+ * \param[in]       ident: Identifier with RTR flag, remote frame carries no data
+ * \param[in]       bytes: Number of data bytes
+ * \param[in]       fdFlags: CO_CAN_FD_FORMAT and CO_CAN_FD_BRS, 0 for classic frame
+ * \return          Length in 1/16 of nominal bit time
+ */
+static uint32_t
+prv_frame_bits(const CO_CANmodule_t* CANmodule, uint32_t ident, uint32_t bytes, uint8_t fdFlags) {
+    uint32_t data = (ident & FLAG_RTR) ? 0U : bytes * 8U;
+
+#if CO_CAN_FD
+    if (fdFlags & CO_CAN_FD_FORMAT) {
+        /* SOF to BRS with stuff bits, CRC delimiter to end of intermission */
+        uint32_t nominal = 17U + 4U + 13U;
+        /* ESI, DLC and data with stuff bits, stuff count, CRC with fixed stuff bits */
+        uint32_t crc = bytes <= 16U ? 17U : 21U;
+        uint32_t phase = 5U + data + (4U + data) / 4U + 4U + crc + (crc + 7U) / 4U;
+
+        return nominal * 16U + phase * ((fdFlags & CO_CAN_FD_BRS) ? CANmodule->busDataBit : 16U);
+    }
+#else
+    (void)CANmodule;
+    (void)fdFlags;
+#endif
+    /* 47 bits of frame and data, stuff bits in 34 bits from SOF to CRC and data */
+    return (47U + data + (33U + data) / 4U) * 16U;
+}
+#endif
+
+#if CO_CAN_TX_LATENCY
+/**
+ * \brief           Add latency of frame on the bus to histogram of its function code
+ * This function must be called with atomic access.
+ * \param[in]       slot: Mailbox number (bxCAN) or message marker (FDCAN)
+ * \param[in]       now: CO_CAN_CLOCK() at transmit interrupt
+ */
+static void
+prv_tx_latency_done(CO_CANmodule_t* CANmodule, uint32_t slot, uint32_t now) {
+    CO_CANtxSlot_t* txSlot = &CANmodule->txSlot[slot & (CO_CAN_TX_LATENCY_SLOTS - 1U)];
+
+    /* Slot may be reused by a newer frame already, see prv_tx_latency_sent() */
+    if (!txSlot->used || txSlot->marker != (uint8_t)slot) {
+        return;
+    }
+    txSlot->used = false;
+
+    CO_CANtxLatency_t* latency = &CANmodule->txLatency[(txSlot->ident & CANID_MASK) >> 7];
+    uint32_t ticks = now - txSlot->sentAt;
+    uint32_t scaled = ticks >> CO_CAN_TX_LATENCY_SHIFT;
+    uint32_t bucket = scaled == 0U ? 0U : 32U - (uint32_t)__builtin_clz(scaled);
+
+    latency->bucket[bucket < CO_CAN_TX_LATENCY_BUCKETS ? bucket : CO_CAN_TX_LATENCY_BUCKETS - 1U]++;
+    if (ticks > latency->max) {
+        latency->max = ticks;
+    }
+}
+
+/**
+ * \brief           Remember frame, which was put into mailbox
+ * This function must be called with atomic access.
+ */
+static void
+prv_tx_latency_sent(CO_CANmodule_t* CANmodule, uint32_t slot, const CO_CANtx_t* buffer) {
+    CO_CANtxSlot_t* txSlot = &CANmodule->txSlot[slot & (CO_CAN_TX_LATENCY_SLOTS - 1U)];
+
+    /* Mailbox is free, so its previous frame is done, even if its interrupt
+     * was not served yet. bxCAN clears the interrupt flag with the new request. */
+    if (txSlot->used) {
+        prv_tx_latency_done(CANmodule, txSlot->marker, CO_CAN_CLOCK());
     }
-    return buffer;
+    txSlot->sentAt = buffer->queuedAt;
+    txSlot->ident = (uint16_t)buffer->ident;
+    txSlot->marker = (uint8_t)slot;
+    txSlot->used = true;
 }
+#endif
 
 /**
- * \brief           Send CAN message to network
+ * \brief           Send CAN message to network, if there is free mailbox
  * This function must be called with atomic access.
  *
  * \param[in]       CANmodule: CAN module instance
  * \param[in]       buffer: Pointer to buffer to transmit
+ * \return          1 if message was put into mailbox, 0 otherwise
  */
-uint32_t retry_count = 0;
-
 static uint8_t
 prv_send_can_message(CO_CANmodule_t* CANmodule, CO_CANtx_t* buffer) {
 
     uint8_t success = 0;
+#if CO_CAN_TX_LATENCY
+#ifdef CO_STM32_FDCAN_Driver
+    uint32_t txSlot = CANmodule->txMarker;
+#else
+    uint32_t txSlot = 0U;
+#endif
+#endif
 
-    /* Check if TX FIFO is ready to accept more messages */
+#if CO_CAN_DIRECT_REGISTERS
 #ifdef CO_STM32_FDCAN_Driver
+    FDCAN_HandleTypeDef* hfdcan = ((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle;
+    uint32_t txfqs = hfdcan->Instance->TXFQS;
+    if ((txfqs & FDCAN_TXFQS_TFQF) == 0U) {
+        uint32_t put = (txfqs & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+        volatile uint32_t* element = (volatile uint32_t*)(uintptr_t)(hfdcan->msgRam.TxFIFOQSA + put * CO_FDCAN_ELEMENT_SIZE);
+        uint32_t words = (prv_dlc_bytes[1][(buffer->hwHeader[1] & CO_FDCAN_DLC) >> CO_FDCAN_DLC_Pos] + 3U) / 4U;
+
+        element[0] = buffer->hwHeader[0];
+#if CO_CAN_TX_LATENCY
+        element[1] = buffer->hwHeader[1] | CO_FDCAN_EFC | (txSlot << CO_FDCAN_MM_Pos);
+#else
+        element[1] = buffer->hwHeader[1];
+#endif
+        for (uint32_t i = 0U; i < words; i++) {
+            uint32_t word;
+            memcpy(&word, &buffer->data[i * 4U], sizeof(word));
+            element[2U + i] = word;
+        }
+        WRITE_REG(hfdcan->Instance->TXBAR, 1UL << put);
+        success = 1;
+    }
+#else
+    uint32_t data[2];
+    memcpy(data, buffer->data, sizeof(data));
+    CAN_TypeDef* can = ((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle->Instance;
+    uint32_t tsr = can->TSR;
+    if ((tsr & CAN_TSR_TME) != 0U) {
+        /* Code is number of a free mailbox */
+        CAN_TxMailBox_TypeDef* mailbox = &can->sTxMailBox[(tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos];
+#if CO_CAN_TX_LATENCY
+        txSlot = (tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+#endif
+
+        WRITE_REG(mailbox->TDTR, buffer->hwHeader[1]);
+        WRITE_REG(mailbox->TDLR, data[0]);
+        WRITE_REG(mailbox->TDHR, data[1]);
+        WRITE_REG(mailbox->TIR, buffer->hwHeader[0] | CAN_TI0R_TXRQ);
+        success = 1;
+    }
+#endif
+#elif defined(CO_STM32_FDCAN_Driver)
+    /* Check if TX queue is ready to accept more messages. Free level reads 0
+     * in queue mode, which CO_CANmodule_init() selects, test full flag */
     static FDCAN_TxHeaderTypeDef tx_hdr;
-    if (HAL_FDCAN_GetTxFifoFreeLevel(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle) > 0) {
+    if ((((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle->Instance->TXFQS & FDCAN_TXFQS_TFQF) == 0U) {
         /*
          * RTR flag is part of identifier value
          * hence it needs to be properly decoded
@@ -269,43 +1469,24 @@ prv_send_can_message(CO_CANmodule_t* CANmodule, CO_CANtx_t* buffer) {
         tx_hdr.Identifier = buffer->ident & CANID_MASK;
         tx_hdr.TxFrameType = (buffer->ident & FLAG_RTR) ? FDCAN_REMOTE_FRAME : FDCAN_DATA_FRAME;
         tx_hdr.IdType = FDCAN_STANDARD_ID;
+#if CO_CAN_FD
+        tx_hdr.FDFormat = (buffer->fdFlags & CO_CAN_FD_FORMAT) ? FDCAN_FD_CAN : FDCAN_CLASSIC_CAN;
+        tx_hdr.BitRateSwitch = (buffer->fdFlags & CO_CAN_FD_BRS) ? FDCAN_BRS_ON : FDCAN_BRS_OFF;
+#else
         tx_hdr.FDFormat = FDCAN_CLASSIC_CAN;
         tx_hdr.BitRateSwitch = FDCAN_BRS_OFF;
-        tx_hdr.MessageMarker = 0;
+#endif
         tx_hdr.ErrorStateIndicator = FDCAN_ESI_ACTIVE;
+#if CO_CAN_TX_LATENCY
+        /* TX event of the frame carries its marker back */
+        tx_hdr.MessageMarker = txSlot;
+        tx_hdr.TxEventFifoControl = FDCAN_STORE_TX_EVENTS;
+#else
+        tx_hdr.MessageMarker = 0;
         tx_hdr.TxEventFifoControl = FDCAN_NO_TX_EVENTS;
-
-        switch (buffer->DLC) {
-            case 0:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_0;
-                break;
-            case 1:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_1;
-                break;
-            case 2:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_2;
-                break;
-            case 3:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_3;
-                break;
-            case 4:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_4;
-                break;
-            case 5:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_5;
-                break;
-            case 6:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_6;
-                break;
-            case 7:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_7;
-                break;
-            case 8:
-                tx_hdr.DataLength = FDCAN_DLC_BYTES_8;
-                break;
-            default: /* Hard error... */
-                break;
-        }
+#endif
+        /* Older HAL versions keep DLC code shifted by 16, newer ones not */
+        tx_hdr.DataLength = prv_dlc_code(buffer->DLC) * FDCAN_DLC_BYTES_1;
 
         /* Now add message to FIFO. Should not fail */
         success =
@@ -316,16 +1497,12 @@ prv_send_can_message(CO_CANmodule_t* CANmodule, CO_CANtx_t* buffer) {
     static CAN_TxHeaderTypeDef tx_hdr;
     /* Check if TX FIFO is ready to accept more messages */
 
-        retry_count = 0;
-        while (HAL_CAN_GetTxMailboxesFreeLevel(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle) <= 0) {
-                if (retry_count++ > CO_CAN_MAX_RETRY)
-                        return success;
-        }
-
+    /* Never wait for a mailbox, caller puts the buffer into backlog */
+    if (HAL_CAN_GetTxMailboxesFreeLevel(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle) > 0) {
         /*
-                 * RTR flag is part of identifier value
-                 * hence it needs to be properly decoded
-                 */
+         * RTR flag is part of identifier value
+         * hence it needs to be properly decoded
+         */
         tx_hdr.ExtId = 0u;
         tx_hdr.IDE = CAN_ID_STD;
         tx_hdr.DLC = buffer->DLC;
@@ -338,10 +1515,55 @@ prv_send_can_message(CO_CANmodule_t* CANmodule, CO_CANtx_t* buffer) {
         success = HAL_CAN_AddTxMessage(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle, &tx_hdr, buffer->data,
                                        &TxMailboxNum)
                   == HAL_OK;
+#if CO_CAN_TX_LATENCY
+        /* Mailbox bit, as in CO_CANinterrupt_TX() */
+        txSlot = success ? (uint32_t)__builtin_ctz(TxMailboxNum) : 0U;
+#endif
+    }
+#endif
+    if (success) {
+        CO_CAN_STAT_INC(buffer->count);
+#if CO_CAN_TX_LATENCY
+        prv_tx_latency_sent(CANmodule, txSlot, buffer);
+#ifdef CO_STM32_FDCAN_Driver
+        CANmodule->txMarker++;
+#endif
+#endif
+#if CO_CAN_BUS_LOAD
+#if CO_CAN_FD
+        CANmodule->busBitsTx += prv_frame_bits(CANmodule, buffer->ident, buffer->DLC, buffer->fdFlags);
+#else
+        CANmodule->busBitsTx += prv_frame_bits(CANmodule, buffer->ident, buffer->DLC, 0U);
+#endif
 #endif
+    }
     return success;
 }
 
+/**
+ * \brief           Send buffers from backlog, highest priority first, while there are free mailboxes
+ * This function must be called with atomic access.
+ */
+static void
+prv_tx_refill(CO_CANmodule_t* CANmodule) {
+    CO_CANtx_t* buffer;
+
+    while ((buffer = prv_tx_next(CANmodule)) != NULL && prv_send_can_message(CANmodule, buffer)) {
+        uint32_t wait = CO_CAN_CLOCK() - buffer->queuedAt;
+
+        buffer->bufferFull = false;
+        CO_CAN_TX_PENDING_CLR(CANmodule, buffer->rank);
+        CANmodule->CANtxCount--;
+        CANmodule->bufferInhibitFlag = buffer->syncFlag;
+
+        if (wait > CANmodule->txStats.waitMax) {
+            CANmodule->txStats.waitMax = wait;
+        }
+        CANmodule->txStats.waitSum += wait;
+        CANmodule->txStats.waitCount++;
+    }
+}
+
 /******************************************************************************/
 CO_ReturnError_t
 CO_CANsend(CO_CANmodule_t* CANmodule, CO_CANtx_t* buffer) {
@@ -362,17 +1584,42 @@ CO_CANsend(CO_CANmodule_t* CANmodule, CO_CANtx_t* buffer) {
      * Lock interrupts for atomic operation
      */
     CO_LOCK_CAN_SEND(CANmodule);
-    if (prv_send_can_message(CANmodule, buffer)) {
-        CANmodule->bufferInhibitFlag = buffer->syncFlag;
+    if (buffer->bufferFull) {
+        /* Still waiting in backlog, it will be sent with new data */
     } else {
-        buffer->bufferFull = true;
-        CANmodule->CANtxCount++;
+        /* Latency of the frame is measured from here */
+        buffer->queuedAt = CO_CAN_CLOCK();
+        if (CANmodule->CANtxCount == 0U && prv_send_can_message(CANmodule, buffer)) {
+            CANmodule->bufferInhibitFlag = buffer->syncFlag;
+        } else {
+            /* Put into backlog. If backlog was not empty, mailbox may have freed
+             * meanwhile, so send from backlog to keep priority order. */
+            buffer->bufferFull = true;
+            CO_CAN_TX_PENDING_SET(CANmodule, buffer->rank);
+            CANmodule->CANtxCount++;
+            if (CANmodule->CANtxCount > CANmodule->txStats.highWater) {
+                CANmodule->txStats.highWater = CANmodule->CANtxCount;
+            }
+            if (CANmodule->CANtxCount > 1U) {
+                prv_tx_refill(CANmodule);
+            }
+        }
     }
     CO_UNLOCK_CAN_SEND(CANmodule);
 
     return err;
 }
 
+#if CO_CAN_RX_TAPS > 0
+/******************************************************************************/
+bool_t
+CO_CANsendFrame(CO_CANmodule_t* CANmodule, CO_CANtx_t* frame) {
+    /* CANopen buffers waiting in backlog have priority */
+    frame->queuedAt = CO_CAN_CLOCK();
+    return CANmodule->CANnormal && CANmodule->CANtxCount == 0U && prv_send_can_message(CANmodule, frame);
+}
+#endif
+
 /******************************************************************************/
 void
 CO_CANclearPendingSyncPDOs(CO_CANmodule_t* CANmodule) {
@@ -387,14 +1634,19 @@ CO_CANclearPendingSyncPDOs(CO_CANmodule_t* CANmodule) {
         tpdoDeleted = 1U;
     }
     /* delete also pending synchronous TPDOs in TX buffers */
-    if (CANmodule->CANtxCount > 0) {
-        for (uint16_t i = CANmodule->txSize; i > 0U; --i) {
-            if (CANmodule->txArray[i].bufferFull) {
-                if (CANmodule->txArray[i].syncFlag) {
-                    CANmodule->txArray[i].bufferFull = false;
-                    CANmodule->CANtxCount--;
-                    tpdoDeleted = 2U;
-                }
+    for (uint16_t i = 0U; CANmodule->CANtxCount > 0U && i < CO_CAN_TX_PENDING_WORDS; i++) {
+        uint32_t bits = CANmodule->txPending[i];
+
+        while (bits != 0U) {
+            uint16_t rank = (i << 5) + (uint16_t)__builtin_ctz(bits);
+            CO_CANtx_t* buffer = &CANmodule->txArray[CANmodule->txByRank[rank]];
+
+            bits &= bits - 1U;
+            if (buffer->syncFlag) {
+                buffer->bufferFull = false;
+                CO_CAN_TX_PENDING_CLR(CANmodule, rank);
+                CANmodule->CANtxCount--;
+                tpdoDeleted = 2U;
             }
         }
     }
@@ -413,8 +1665,24 @@ void
 CO_CANmodule_process(CO_CANmodule_t* CANmodule) {
     uint32_t err = 0;
 
+#if !CO_CAN_TIME_SYSTICK && defined(CO_CAN_CLOCK_HZ)
+    /* Time is extended from CO_CAN_CLOCK(), which must not wrap between calls */
+    (void)CO_CANtime_us();
+#endif
+
+#if CO_CAN_RX_FILTERS
+    /* Receive buffers were reconfigured or filters of the other CAN changed */
+    if (CANmodule->useCANrxFilters) {
+        if (CANmodule->rxFiltersDirty) {
+            prv_rx_filters_compile(CANmodule);
+        } else if (CANmodule->rxFilterGeneration != prv_filter_generation) {
+            prv_rx_filters_base(CANmodule);
+        }
+    }
+#endif
+
     // CANOpen just care about Bus_off, Warning, Passive and Overflow
-    // I didn't find overflow error register in STM32, if you find it please let me know
+    // Overflow (RX FIFO overrun) is detected in CO_CANinterrupt_RX()
 
 #ifdef CO_STM32_FDCAN_Driver
 
@@ -485,106 +1753,444 @@ CO_CANmodule_process(CO_CANmodule_t* CANmodule) {
 #endif
 }
 
-#include "main.h"
+#if CO_CAN_RX_DEFERRED
 /**
- * \brief           Read message from RX FIFO
- * \param           hfdcan: pointer to an FDCAN_HandleTypeDef structure that contains
- *                      the configuration information for the specified FDCAN.
- * \param[in]       fifo: Fifo number to use for read
- * \param[in]       fifo_isrs: List of interrupts for respected FIFO
+ * \brief           Put received message into queue of RX FIFO
+ * Called from RX FIFO interrupt or from CO_CANinject_RX() with CAN
+ * interrupts masked, so there is a single producer at a time.
+ */
+static void
+prv_rx_queue_put(CO_CANmodule_t* CANmodule, uint32_t fifo, CO_CANrx_t* buffer, const CO_CANrxMsg_t* rcvMsg) {
+    CO_CANrxQueue_t* queue = &CANmodule->rxQueue[fifo & 1U];
+    uint16_t head = queue->head;
+
+    if ((uint16_t)(head - queue->tail) >= CO_CAN_RX_QUEUE_SIZE) {
+        queue->overflow++;
+        CANmodule->CANerrorStatus |= CO_CAN_ERRRX_OVERFLOW;
+        return;
+    }
+    queue->msg[head & (CO_CAN_RX_QUEUE_SIZE - 1U)] = *rcvMsg;
+    queue->index[head & (CO_CAN_RX_QUEUE_SIZE - 1U)] = (uint16_t)(buffer - CANmodule->rxArray);
+    __DMB(); /* message must be written before it is published */
+    queue->head = head + 1U;
+}
+
+/**
+ * \brief           Process messages received since last call
+ *
+ * Calls CANopen receive callbacks outside of interrupt context. Queue of time
+ * critical RX FIFO0 is processed first. Messages of the same COB-ID always
+ * use the same FIFO, so their order is kept.
+ *
+ * \param[in]       CANmodule: CAN module instance
  */
-#ifdef CO_STM32_FDCAN_Driver
 void
-CO_CANinterrupt_RX(CO_CANmodule_t* CANmodule, uint32_t fifo, uint32_t fifo_isrs)
+CO_CANrxProcess(CO_CANmodule_t* CANmodule) {
+    for (uint8_t fifo = 0U; fifo < 2U; fifo++) {
+        CO_CANrxQueue_t* queue = &CANmodule->rxQueue[fifo];
+        uint16_t tail = queue->tail;
+
+        while (tail != queue->head) {
+            __DMB(); /* head must be read before message */
+            CO_CANrxMsg_t* rcvMsg = &queue->msg[tail & (CO_CAN_RX_QUEUE_SIZE - 1U)];
+            uint16_t index = queue->index[tail & (CO_CAN_RX_QUEUE_SIZE - 1U)];
+            CO_CANrx_t* buffer = &CANmodule->rxArray[index];
+
+            /* Buffer may be reconfigured meanwhile */
+            if (index >= CANmodule->rxSize || ((rcvMsg->ident ^ buffer->ident) & buffer->mask) != 0U) {
+                buffer = prv_rx_lookup(CANmodule, rcvMsg->ident);
+            }
+            if (buffer != NULL && buffer->CANrx_callback != NULL) {
+                buffer->CANrx_callback(buffer->object, (void*)rcvMsg);
+                CANmodule->rxDelivered++;
+            }
+            tail++;
+            queue->tail = tail;
+        }
+    }
+}
+#endif /* CO_CAN_RX_DEFERRED */
+
+#if CO_CAN_STATISTICS
+/**
+ * \brief           Add execution time of one interrupt to statistics
+ */
+static void
+prv_isr_stats(CO_CANisrStats_t* stats, uint32_t ticks) {
+    if (ticks < stats->min) {
+        stats->min = ticks;
+    }
+    if (ticks > stats->max) {
+        stats->max = ticks;
+    }
+    stats->sum += ticks;
+    stats->count++;
+}
+#endif
+
+#if CO_CAN_RX_TIMESTAMP
+/**
+ * \brief           Reception time of frame in microseconds of CO_CAN_TIME_US()
+ * \param[in]       stamp: 16-bit hardware timestamp of the frame, captured at start of frame
+ */
+static uint32_t
+prv_rx_time(CO_CANmodule_t* CANmodule, uint32_t stamp) {
+    uint32_t now = CO_CAN_TIME_US();
+    uint32_t scale = CANmodule->rxStampScale;
+
+    if (scale == 0U) {
+        return now; /* No hardware timestamps, time of reading */
+    }
+#ifdef CO_STM32_FDCAN_Driver
+    /* Age of frame from the running timestamp counter */
+    uint32_t age = (prv_hcan(CANmodule)->Instance->TSCV - stamp) & 0xFFFFU;
+
+    return now - (uint32_t)(((uint64_t)age * scale) >> 16);
 #else
-void
-CO_CANinterrupt_RX(CO_CANmodule_t* CANmodule, uint32_t fifo)
+    /*
+     * bxCAN counter can not be read. Distance from the previous frame is
+     * exact, whole counter periods (scale microseconds) are taken from the
+     * clock: frame is not newer than now and not older than one period.
+     * Interrupt latency of the first frame fades out with later frames.
+     * FIFO0 and FIFO1 interrupts may nest, each takes the previous frame.
+     */
+    uint32_t lock;
+    uint32_t time;
+
+    CO_LOCK_ENTER(lock);
+    time = CANmodule->rxStampTime
+           + (uint32_t)(((uint64_t)((stamp - CANmodule->rxStampLast) & 0xFFFFU) * scale) >> 16);
+    if ((int32_t)(time - now) > 0) {
+        time -= scale; /* Older frame from the other FIFO */
+    }
+    if ((int32_t)(time - now) > 0) {
+        time = now;
+    } else {
+        time += (now - time) / scale * scale;
+    }
+    CANmodule->rxStampLast = stamp;
+    CANmodule->rxStampTime = time;
+    CO_LOCK_LEAVE(lock);
+    return time;
+#endif
+}
+#endif
+
+/**
+ * \brief           Pass received message to its buffer, directly or through deferred queue
+ * \return          `true` if message matched a buffer with callback
+ */
+static bool_t
+prv_rx_dispatch(CO_CANmodule_t* CANmodule, uint32_t fifo, CO_CANrx_t* buffer, CO_CANrxMsg_t* rcvMsg) {
+    /* Call specific function, which will process the message */
+    if (buffer != NULL && buffer->CANrx_callback != NULL) {
+        CO_CAN_STAT_INC(buffer->count);
+#if CO_CAN_RX_TIMESTAMP
+        buffer->rxTime_us = rcvMsg->timestamp_us;
+#endif
+#if CO_CAN_RX_DEFERRED
+        prv_rx_queue_put(CANmodule, fifo, buffer, rcvMsg);
+#else
+        (void)fifo;
+        buffer->CANrx_callback(buffer->object, (void*)rcvMsg);
+        CANmodule->rxDelivered++;
+#endif
+        return true;
+    }
+    CO_CAN_STAT_INC(CANmodule->rxUnmatched);
+    return false;
+}
+
+/**
+ * \brief           Get number of messages in RX FIFO
+ */
+static uint32_t
+prv_rx_fill_level(CO_CANmodule_t* CANmodule, uint32_t fifo) {
+#if CO_CAN_DIRECT_REGISTERS
+#ifdef CO_STM32_FDCAN_Driver
+    FDCAN_GlobalTypeDef* can = ((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle->Instance;
+    return fifo == FDCAN_RX_FIFO0 ? (can->RXF0S & FDCAN_RXF0S_F0FL) : (can->RXF1S & FDCAN_RXF1S_F1FL);
+#else
+    CAN_TypeDef* can = ((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle->Instance;
+    return fifo == CAN_RX_FIFO0 ? (can->RF0R & CAN_RF0R_FMP0) : (can->RF1R & CAN_RF1R_FMP1);
+#endif
+#elif defined(CO_STM32_FDCAN_Driver)
+    return HAL_FDCAN_GetRxFifoFillLevel(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle, fifo);
+#else
+    return HAL_CAN_GetRxFifoFillLevel(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle, fifo);
 #endif
-{
+}
 
+/**
+ * \brief           Read one message from RX FIFO and dispatch it
+ * FIFO must not be empty, when registers are accessed directly.
+ * \param[in]       CANmodule: CAN module
+ * \param[in]       fifo: Fifo number to use for read
+ * \return          `false` if FIFO is empty, `true` otherwise
+ */
+static bool_t
+prv_rx_read(CO_CANmodule_t* CANmodule, uint32_t fifo) {
     CO_CANrxMsg_t rcvMsg;
     CO_CANrx_t* buffer = NULL; /* receive message buffer from CO_CANmodule_t object. */
-    uint16_t index;            /* index of received message */
     uint32_t rcvMsgIdent;      /* identifier of the received message */
-    uint8_t messageFound = 0;
+#if CO_CAN_BUS_LOAD
+    uint8_t fdFlags = 0U; /* format of the received message */
+#endif
+#if CO_CAN_RX_FILTERS
+    uint32_t filterFifo = fifo; /* FIFO of hardware filter match index */
+    uint32_t filterIndex;       /* hardware filter match index */
+#endif
 
+#if CO_CAN_DIRECT_REGISTERS
 #ifdef CO_STM32_FDCAN_Driver
+    FDCAN_HandleTypeDef* hfdcan = ((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle;
+    uint32_t get;
+    uint32_t r0, r1;
+    const volatile uint32_t* element;
+
+    if (fifo == FDCAN_RX_FIFO0) {
+        get = (hfdcan->Instance->RXF0S & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+        element = (const volatile uint32_t*)(uintptr_t)(hfdcan->msgRam.RxFIFO0SA + get * CO_FDCAN_ELEMENT_SIZE);
+    } else {
+        get = (hfdcan->Instance->RXF1S & FDCAN_RXF1S_F1GI) >> FDCAN_RXF1S_F1GI_Pos;
+        element = (const volatile uint32_t*)(uintptr_t)(hfdcan->msgRam.RxFIFO1SA + get * CO_FDCAN_ELEMENT_SIZE);
+    }
+    r0 = element[0];
+    r1 = element[1];
+#if CO_CAN_RX_TIMESTAMP
+    rcvMsg.timestamp_us = prv_rx_time(CANmodule, r1 & CO_FDCAN_RXTS);
+#endif
+    rcvMsg.dlc = prv_dlc_bytes[(r1 & CO_FDCAN_FDF) ? 1 : 0][(r1 & CO_FDCAN_DLC) >> CO_FDCAN_DLC_Pos];
+#if CO_CAN_BUS_LOAD && CO_CAN_FD
+    fdFlags = ((r1 & CO_FDCAN_FDF) ? CO_CAN_FD_FORMAT : 0U) | ((r1 & CO_FDCAN_BRS) ? CO_CAN_FD_BRS : 0U);
+#endif
+    for (uint32_t i = 0U; i < (rcvMsg.dlc + 3U) / 4U && i < CO_CAN_DATA_MAX / 4U; i++) {
+        uint32_t word = element[2U + i];
+        memcpy(&rcvMsg.data[i * 4U], &word, sizeof(word));
+    }
+    /* Release element */
+    if (fifo == FDCAN_RX_FIFO0) {
+        WRITE_REG(hfdcan->Instance->RXF0A, get);
+    } else {
+        WRITE_REG(hfdcan->Instance->RXF1A, get);
+    }
+    if ((r0 & CO_FDCAN_XTD) != 0U) {
+        return true; /* Extended frames are not used by CANopen */
+    }
+    rcvMsg.ident = ((r0 >> CO_FDCAN_ID_Pos) & CANID_MASK) | ((r0 & CO_FDCAN_RTR) ? FLAG_RTR : 0x00);
+#if CO_CAN_RX_FILTERS
+    filterIndex = (r1 & CO_FDCAN_ANMF) ? CO_CAN_RX_NONE : (r1 & CO_FDCAN_FIDX) >> CO_FDCAN_FIDX_Pos;
+    filterFifo = 0U;
+#endif
+#else
+    uint32_t data[2];
+    CAN_TypeDef* can = ((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle->Instance;
+    const CAN_FIFOMailBox_TypeDef* mailbox = &can->sFIFOMailBox[fifo];
+    uint32_t rir = mailbox->RIR;
+    uint32_t rdtr = mailbox->RDTR;
+
+    data[0] = mailbox->RDLR;
+    data[1] = mailbox->RDHR;
+    /* Release output mailbox, other bits are write 1 to clear */
+    if (fifo == CAN_RX_FIFO0) {
+        WRITE_REG(can->RF0R, CAN_RF0R_RFOM0);
+    } else {
+        WRITE_REG(can->RF1R, CAN_RF1R_RFOM1);
+    }
+    if ((rir & CAN_RI0R_IDE) != 0U) {
+        return true; /* Extended frames are not used by CANopen */
+    }
+    rcvMsg.ident = (rir >> CAN_RI0R_STID_Pos) | ((rir & CAN_RI0R_RTR) ? FLAG_RTR : 0x00);
+    rcvMsg.dlc = (uint8_t)(rdtr & CAN_RDT0R_DLC);
+    memcpy(rcvMsg.data, data, sizeof(data));
+#if CO_CAN_RX_TIMESTAMP
+    rcvMsg.timestamp_us = prv_rx_time(CANmodule, (rdtr & CAN_RDT0R_TIME) >> CAN_RDT0R_TIME_Pos);
+#endif
+#if CO_CAN_RX_FILTERS
+    filterIndex = (rdtr & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos;
+#endif
+#endif
+    rcvMsgIdent = rcvMsg.ident;
+#elif defined(CO_STM32_FDCAN_Driver)
     static FDCAN_RxHeaderTypeDef rx_hdr;
+#if CO_CAN_DATA_MAX < 64
+    /* HAL copies as many bytes as the DLC code has in a CAN FD frame, up to
+     * 64, also for classic frames with DLC above 8 */
+    uint8_t rx_data[64];
+#else
+    uint8_t* rx_data = rcvMsg.data;
+#endif
     /* Read received message from FIFO */
-    if (HAL_FDCAN_GetRxMessage(hfdcan, fifo, &rx_hdr, rcvMsg.data) != HAL_OK) {
-        return;
+    if (HAL_FDCAN_GetRxMessage(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle, fifo, &rx_hdr, rx_data)
+        != HAL_OK) {
+        return false;
     }
-    /* Setup identifier (with RTR) and length */
-    rcvMsg.ident = rx_hdr.Identifier | (rx_hdr.RxFrameType == FDCAN_REMOTE_FRAME ? FLAG_RTR : 0x00);
-    switch (rx_hdr.DataLength) {
-        case FDCAN_DLC_BYTES_0:
-            rcvMsg.dlc = 0;
-            break;
-        case FDCAN_DLC_BYTES_1:
-            rcvMsg.dlc = 1;
-            break;
-        case FDCAN_DLC_BYTES_2:
-            rcvMsg.dlc = 2;
-            break;
-        case FDCAN_DLC_BYTES_3:
-            rcvMsg.dlc = 3;
-            break;
-        case FDCAN_DLC_BYTES_4:
-            rcvMsg.dlc = 4;
-            break;
-        case FDCAN_DLC_BYTES_5:
-            rcvMsg.dlc = 5;
-            break;
-        case FDCAN_DLC_BYTES_6:
-            rcvMsg.dlc = 6;
-            break;
-        case FDCAN_DLC_BYTES_7:
-            rcvMsg.dlc = 7;
-            break;
-        case FDCAN_DLC_BYTES_8:
-            rcvMsg.dlc = 8;
-            break;
-        default:
-            rcvMsg.dlc = 0;
-            break; /* Invalid length when more than 8 */
+    if (rx_hdr.IdType != FDCAN_STANDARD_ID) {
+        return true; /* Extended frames are not used by CANopen */
     }
+    /* Setup identifier (with RTR) and length, DLC code is shifted by 16 in older HAL versions */
+    rcvMsg.ident = rx_hdr.Identifier | (rx_hdr.RxFrameType == FDCAN_REMOTE_FRAME ? FLAG_RTR : 0x00);
+    rcvMsg.dlc = prv_dlc_bytes[rx_hdr.FDFormat == FDCAN_FD_CAN ? 1 : 0][(rx_hdr.DataLength / FDCAN_DLC_BYTES_1) & 0xFU];
+#if CO_CAN_DATA_MAX < 64
+    memcpy(rcvMsg.data, rx_data, rcvMsg.dlc < CO_CAN_DATA_MAX ? rcvMsg.dlc : CO_CAN_DATA_MAX);
+#endif
+#if CO_CAN_RX_TIMESTAMP
+    rcvMsg.timestamp_us = prv_rx_time(CANmodule, rx_hdr.RxTimestamp);
+#endif
+#if CO_CAN_BUS_LOAD && CO_CAN_FD
+    fdFlags = (rx_hdr.FDFormat == FDCAN_FD_CAN ? CO_CAN_FD_FORMAT : 0U)
+              | (rx_hdr.BitRateSwitch == FDCAN_BRS_ON ? CO_CAN_FD_BRS : 0U);
+#endif
     rcvMsgIdent = rcvMsg.ident;
+#if CO_CAN_RX_FILTERS
+    filterIndex = rx_hdr.IsFilterMatchingFrame ? CO_CAN_RX_NONE : rx_hdr.FilterIndex;
+    filterFifo = 0U; /* Filter index is element index, common to both FIFOs */
+#endif
 #else
     static CAN_RxHeaderTypeDef rx_hdr;
     /* Read received message from FIFO */
     if (HAL_CAN_GetRxMessage(((CANopenNodeHandle*)CANmodule->CANptr)->CANHandle, fifo, &rx_hdr, rcvMsg.data) != HAL_OK) {
-        return;
+        return false;
     }
     /* Setup identifier (with RTR) and length */
     rcvMsg.ident = rx_hdr.StdId | (rx_hdr.RTR == CAN_RTR_REMOTE ? FLAG_RTR : 0x00);
     rcvMsg.dlc = (uint8_t)rx_hdr.DLC;
     rcvMsgIdent = rcvMsg.ident;
+#if CO_CAN_RX_TIMESTAMP
+    rcvMsg.timestamp_us = prv_rx_time(CANmodule, rx_hdr.Timestamp);
+#endif
+#if CO_CAN_RX_FILTERS
+    filterIndex = rx_hdr.FilterMatchIndex;
+#endif
 #endif
 
-    /*
-     * Hardware filters are not used for the moment
-     * \todo: Implement hardware filters...
-     */
+#if CO_CAN_BUS_LOAD
+    CANmodule->busBitsRx[fifo & 1U] += prv_frame_bits(CANmodule, rcvMsgIdent, rcvMsg.dlc, fdFlags);
+#endif
+
+#if CO_CAN_RX_FILTERS
     if (CANmodule->useCANrxFilters) {
-        __BKPT(0);
-    } else {
+        /* Filter match index points directly to receive buffer */
+        buffer = prv_rx_filter_find(CANmodule, filterFifo, filterIndex, rcvMsgIdent);
+    } else
+#endif
+    {
         /*
          * We are not using hardware filters, hence it is necessary
-         * to manually match received message ID with all buffers
+         * to manually match received message ID with buffers
          */
-        buffer = CANmodule->rxArray;
-        for (index = CANmodule->rxSize; index > 0U; --index, ++buffer) {
-            if (((rcvMsgIdent ^ buffer->ident) & buffer->mask) == 0U) {
-                messageFound = 1;
-                break;
-            }
+        buffer = prv_rx_lookup(CANmodule, rcvMsgIdent);
+    }
+
+#if CO_CAN_RX_TAPS > 0
+    for (uint8_t i = 0U; i < CO_CAN_RX_TAPS; i++) {
+        const CO_CANrxTap_t* tap = &CANmodule->rxTaps[i];
+
+        if (tap->callback != NULL && ((rcvMsgIdent ^ tap->ident) & tap->mask) == 0U) {
+            tap->callback(tap->object, &rcvMsg);
         }
     }
+#endif
 
-    /* Call specific function, which will process the message */
-    if (messageFound && buffer != NULL && buffer->CANrx_callback != NULL) {
-        buffer->CANrx_callback(buffer->object, (void*)&rcvMsg);
+    prv_rx_dispatch(CANmodule, fifo, buffer, &rcvMsg);
+    return true;
+}
+
+/**
+ * \brief           Read and clear overrun flag of RX FIFO
+ * \param[in]       CANmodule: CAN module
+ * \param[in]       fifo: Fifo number
+ * \return          `true` if frames were lost since the last call
+ */
+static bool_t
+prv_rx_lost(CO_CANmodule_t* CANmodule, uint32_t fifo) {
+    bool_t lost;
+
+#ifdef CO_STM32_FDCAN_Driver
+    uint32_t lostFlag = fifo == FDCAN_RX_FIFO0 ? FDCAN_IR_RF0L : FDCAN_IR_RF1L;
+    lost = (prv_hcan(CANmodule)->Instance->IR & lostFlag) != 0U;
+    if (lost) {
+        WRITE_REG(prv_hcan(CANmodule)->Instance->IR, lostFlag);
+    }
+#else
+    if (fifo == CAN_RX_FIFO0) {
+        lost = (prv_hcan(CANmodule)->Instance->RF0R & CAN_RF0R_FOVR0) != 0U;
+        if (lost) {
+            WRITE_REG(prv_hcan(CANmodule)->Instance->RF0R, CAN_RF0R_FOVR0);
+        }
+    } else {
+        lost = (prv_hcan(CANmodule)->Instance->RF1R & CAN_RF1R_FOVR1) != 0U;
+        if (lost) {
+            WRITE_REG(prv_hcan(CANmodule)->Instance->RF1R, CAN_RF1R_FOVR1);
+        }
+    }
+#endif
+    return lost;
+}
+
+/**
+ * \brief           Read all messages from RX FIFO
+ *
+ * FIFO is drained completely, including frames received meanwhile, so
+ * back-to-back frames do not pay interrupt entry and exit each.
+ *
+ * \param[in]       CANmodule: CAN module
+ * \param[in]       fifo: Fifo number to use for read
+ */
+void
+CO_CANinterrupt_RX(CO_CANmodule_t* CANmodule, uint32_t fifo) {
+    bool_t lost;
+    CO_CAN_STAT_ISR_ENTER();
+
+    /* HAL releases bxCAN FIFO with SET_BIT() on RFxR, which writes set FOVR
+     * back and so clears it. Flag is sampled before each release then.
+     * Otherwise it stays set until read after the FIFO is drained. */
+    lost = false;
+    while (prv_rx_fill_level(CANmodule, fifo) > 0U) {
+#if !CO_CAN_DIRECT_REGISTERS && !defined(CO_STM32_FDCAN_Driver)
+        if (!lost) {
+            lost = prv_rx_lost(CANmodule, fifo);
+        }
+#endif
+        if (!prv_rx_read(CANmodule, fifo)) {
+            break;
+        }
     }
+#if CO_CAN_DIRECT_REGISTERS || defined(CO_STM32_FDCAN_Driver)
+    lost = prv_rx_lost(CANmodule, fifo);
+#endif
+    if (lost) {
+        CANmodule->rxOverrun[fifo & 1U]++;
+        CANmodule->CANerrorStatus |= CO_CAN_ERRRX_OVERFLOW;
+    }
+    CO_CAN_STAT_ISR_LEAVE(CANmodule->isrRx);
+}
+
+/**
+ * \brief           Process message, which was not received by the peripheral
+ *
+ * Message takes the same path as received one, matched in software. Used
+ * to replay recorded traffic or to feed frames from another interface.
+ * May be called from any context: dispatch runs with CAN interrupts masked
+ * by CO_LOCK_ENTER(), so deferred queue keeps a single producer at a time.
+ * With CO_LOCK_BASEPRI, CAN interrupts must be at CO_LOCK_BASEPRI priority
+ * or lower, as required for the other locks.
+ *
+ * \param[in]       CANmodule: CAN module
+ * \param[in]       fifo: RX FIFO, which would receive the message
+ * \param[in]       msg: Message, ident includes RTR flag, dlc is number of bytes
+ * \return          `true` if message matched a receive buffer
+ */
+bool_t
+CO_CANinject_RX(CO_CANmodule_t* CANmodule, uint32_t fifo, const CO_CANrxMsg_t* msg) {
+    CO_CANrxMsg_t rcvMsg = *msg;
+    uint32_t lock;
+    bool_t matched;
+
+    CO_LOCK_ENTER(lock);
+    matched = prv_rx_dispatch(CANmodule, fifo, prv_rx_lookup(CANmodule, rcvMsg.ident), &rcvMsg);
+    CO_LOCK_LEAVE(lock);
+    return matched;
 }
 
 /**
@@ -595,15 +2201,22 @@ CO_CANinterrupt_RX(CO_CANmodule_t* CANmodule, uint32_t fifo)
  */
 void
 CO_CANinterrupt_TX(CO_CANmodule_t* CANmodule, uint32_t MailboxNumber) {
+    CO_CAN_STAT_ISR_ENTER();
+#if CO_CAN_TX_LATENCY && !defined(CO_STM32_FDCAN_Driver)
+    uint32_t txTime = CO_CAN_CLOCK();
+
+    /* MailboxNumber is CAN_TX_MAILBOXx bit */
+    CO_LOCK_CAN_SEND(CANmodule);
+    prv_tx_latency_done(CANmodule, (uint32_t)__builtin_ctz(MailboxNumber), txTime);
+    CO_UNLOCK_CAN_SEND(CANmodule);
+#endif
 
     CANmodule->firstCANtxMessage = false;            /* First CAN message (bootup) was sent successfully */
     CANmodule->bufferInhibitFlag = false;            /* Clear flag from previous message */
     if (CANmodule->CANtxCount > 0U) {                /* Are there any new messages waiting to be send */
-        CO_CANtx_t* buffer = &CANmodule->txArray[0]; /* Start with first buffer handle */
-        uint16_t i;
-
         /*
-		 * Try to send more buffers, process all empty ones
+		 * Try to send more buffers, highest priority (lowest COB-ID) first,
+		 * until there is no free mailbox
 		 *
 		 * This function is always called from interrupt,
 		 * however to make sure no preemption can happen, interrupts are anyway locked
@@ -611,20 +2224,97 @@ CO_CANinterrupt_TX(CO_CANmodule_t* CANmodule, uint32_t MailboxNumber) {
 		 *  then no need to lock interrupts..)
 		 */
         CO_LOCK_CAN_SEND(CANmodule);
-        for (i = CANmodule->txSize; i > 0U; --i, ++buffer) {
-            /* Try to send message */
-            if (buffer->bufferFull) {
-                if (prv_send_can_message(CANmodule, buffer)) {
-                    buffer->bufferFull = false;
-                    CANmodule->CANtxCount--;
-                    CANmodule->bufferInhibitFlag = buffer->syncFlag;
-                }
-            }
-        }
-        /* Clear counter if no more messages */
-        if (i == 0U) {
-            CANmodule->CANtxCount = 0U;
-        }
+        prv_tx_refill(CANmodule);
         CO_UNLOCK_CAN_SEND(CANmodule);
     }
+#if CO_CAN_RX_TAPS > 0
+    /* CANopen backlog is empty, mailboxes are free for frames of other users */
+    if (CANmodule->CANtxCount == 0U && CANmodule->txIdle != NULL) {
+        CANmodule->txIdle(CANmodule->txIdleObject);
+    }
+#endif
+    CO_CAN_STAT_ISR_LEAVE(CANmodule->isrTx);
+}
+
+#if CO_CAN_TX_LATENCY && defined(CO_STM32_FDCAN_Driver)
+/**
+ * \brief           TX event FIFO has new events, frames with message marker are on the bus
+ * \param[in]       CANmodule: CAN module
+ */
+void
+CO_CANinterrupt_TXevent(CO_CANmodule_t* CANmodule) {
+    uint32_t txTime = CO_CAN_CLOCK();
+    FDCAN_TxEventFifoTypeDef event;
+
+    CO_LOCK_CAN_SEND(CANmodule);
+    while ((prv_hcan(CANmodule)->Instance->TXEFS & FDCAN_TXEFS_EFFL) != 0U
+           && HAL_FDCAN_GetTxEvent(prv_hcan(CANmodule), &event) == HAL_OK) {
+        prv_tx_latency_done(CANmodule, event.MessageMarker, txTime);
+    }
+    CO_UNLOCK_CAN_SEND(CANmodule);
+}
+#endif
+
+#if CO_CAN_TIME_SYSTICK
+/**
+ * \brief           Free running microsecond clock from HAL tick and SysTick counter
+ *
+ * HAL tick must run at 1 kHz from SysTick. Tick interrupt held by a critical
+ * section is taken into account.
+ *
+ * \return          Microseconds, wraps around at 32 bits
+ */
+uint32_t
+CO_CANtime_us(void) {
+    uint32_t tick;
+    uint32_t count;
+    bool_t pending;
+    uint32_t load = SysTick->LOAD + 1U;
+
+    do {
+        tick = HAL_GetTick();
+        count = SysTick->VAL;
+        pending = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0U;
+    } while (tick != HAL_GetTick());
+    /* Counter reloaded, but tick interrupt did not run yet */
+    if (pending && count > load / 2U) {
+        tick++;
+    }
+    return tick * 1000U + (uint32_t)(((uint64_t)(load - 1U - count) * 1000U) / load);
 }
+#elif defined(CO_CAN_CLOCK_HZ)
+/* CO_CAN_CLOCK() at the last call, time and remaining ticks below a microsecond */
+static uint32_t prv_time_clock;
+static uint32_t prv_time_us;
+static uint32_t prv_time_rest;
+
+/**
+ * \brief           Free running microsecond clock, extended from CO_CAN_CLOCK()
+ *
+ * Must be called at least once per CO_CAN_CLOCK() period.
+ *
+ * \return          Microseconds, wraps around at 32 bits
+ */
+uint32_t
+CO_CANtime_us(void) {
+    uint32_t ticksPerUs = CO_CAN_CLOCK_HZ / 1000000U;
+    uint32_t lock;
+    uint32_t clock;
+    uint32_t ticks;
+    uint32_t time;
+
+    CO_LOCK_ENTER(lock);
+    clock = CO_CAN_CLOCK();
+    ticks = clock - prv_time_clock;
+    prv_time_clock = clock;
+    prv_time_us += ticks / ticksPerUs;
+    prv_time_rest += ticks % ticksPerUs;
+    if (prv_time_rest >= ticksPerUs) {
+        prv_time_rest -= ticksPerUs;
+        prv_time_us++;
+    }
+    time = prv_time_us;
+    CO_LOCK_LEAVE(lock);
+    return time;
+}
+#endif
@@ -5,45 +5,295 @@
 #ifndef TEST_CAN_CO_DRIVER_STM32_H
 #define TEST_CAN_CO_DRIVER_STM32_H
 
-#include "main.h"
+/* Device header with HAL and CMSIS definitions, CubeMX main.h by default.
+ * Off-target builds may point it to a stand-in header. */
+#ifndef CO_STM32_HAL_HEADER
+#define CO_STM32_HAL_HEADER "main.h"
+#endif
+#include CO_STM32_HAL_HEADER
 
-/* (un)lock critical section in CO_CANsend() */
-// Why disabling the whole Interrupt
-#define CO_LOCK_CAN_SEND(CAN_MODULE)                                                                                   \
-    do {                                                                                                               \
-        (CAN_MODULE)->primask_send = __get_PRIMASK();                                                                  \
-        __disable_irq();                                                                                               \
-    } while (0)
-#define CO_UNLOCK_CAN_SEND(CAN_MODULE) __set_PRIMASK((CAN_MODULE)->primask_send)
+/* CAN peripheral IP of this STM32 */
+#if defined(FDCAN) || defined(FDCAN1) || defined(FDCAN2) || defined(FDCAN3)
+#define CO_STM32_FDCAN_Driver 1
+#elif defined(CAN) || defined(CAN1) || defined(CAN2) || defined(CAN3)
+#define CO_STM32_CAN_Driver 1
+#else
+#error This STM32 Do not support CAN or FDCAN
+#endif
 
-/* (un)lock critical section in CO_errorReport() or CO_errorReset() */
-#define CO_LOCK_EMCY(CAN_MODULE)                                                                                       \
-    do {                                                                                                               \
-        (CAN_MODULE)->primask_emcy = __get_PRIMASK();                                                                  \
-        __disable_irq();                                                                                               \
-    } while (0)
-#define CO_UNLOCK_EMCY(CAN_MODULE) __set_PRIMASK((CAN_MODULE)->primask_emcy)
+/*
+ * STM32 driver configuration. All options may be overridden from the
+ * compiler command line or from CO_STM32_HAL_HEADER.
+ */
 
-/* (un)lock critical section when accessing Object Dictionary */
-#define CO_LOCK_OD(CAN_MODULE)                                                                                         \
-    do {                                                                                                               \
-        (CAN_MODULE)->primask_od = __get_PRIMASK();                                                                    \
-        __disable_irq();                                                                                               \
-    } while (0)
-#define CO_UNLOCK_OD(CAN_MODULE) __set_PRIMASK((CAN_MODULE)->primask_od)
+/* Number of buckets of the receive dispatch index (power of 2).
+ * CO_CANrxBufferInit() hashes every buffer with a full 11-bit mask into
+ * a bucket, buffers with partial masks go to a short fallback list.
+ * Set to 0 to use the plain linear scan over rxArray. */
+#ifndef CO_CAN_RX_HASH_SIZE
+#define CO_CAN_RX_HASH_SIZE 64
+#endif
+#if (CO_CAN_RX_HASH_SIZE & (CO_CAN_RX_HASH_SIZE - 1)) != 0
+#error CO_CAN_RX_HASH_SIZE must be power of 2
+#endif
 
-/* Synchronization between CAN receive and message processing threads. */
-#define CO_MemoryBarrier()
-#define CO_FLAG_READ(rxNew) ((rxNew) != NULL)
-#define CO_FLAG_SET(rxNew)                                                                                             \
-    do {                                                                                                               \
-        CO_MemoryBarrier();                                                                                            \
-        rxNew = (void*)1L;                                                                                             \
-    } while (0)
-#define CO_FLAG_CLEAR(rxNew)                                                                                           \
+/* Use hardware acceptance filters. Registered receive buffers are compiled
+ * into bxCAN filter banks or FDCAN standard filter elements. If they do not
+ * fit, filters are merged into wider masks and software matching finishes
+ * the job. Default 0 accepts all standard frames and matches in software. */
+#ifndef CO_CAN_RX_FILTERS
+#define CO_CAN_RX_FILTERS 0
+#endif
+
+/* Split received frames by priority: NMT, SYNC, EMCY, TIME and PDOs go to
+ * RX FIFO0, SDO, heartbeat and LSS to RX FIFO1. FIFO1 interrupt (bxCAN
+ * CANx_RX1, FDCAN interrupt line 1) may then have lower NVIC priority, so
+ * SDO bursts do not delay or overrun time critical frames. Default 0 puts
+ * all frames into RX FIFO0. */
+#ifndef CO_CAN_RX_FIFO_SPLIT
+#define CO_CAN_RX_FIFO_SPLIT 0
+#endif
+
+/* First bxCAN filter bank of CAN2, banks below belong to CAN1 */
+#ifndef CO_CAN_SLAVE_START_FILTER_BANK
+#define CO_CAN_SLAVE_START_FILTER_BANK 14
+#endif
+
+/* Max number of hardware filters per FIFO, which map directly to rxArray.
+ * Filters with higher match index are resolved in software. */
+#ifndef CO_CAN_RX_FILTER_MAP_SIZE
+#define CO_CAN_RX_FILTER_MAP_SIZE 64
+#endif
+
+/* Deferred receive processing. CAN receive interrupt only copies matched
+ * frames into a lock-free queue per RX FIFO and CANopen callbacks run from
+ * CO_CANrxProcess(), called by CANopenNode_Process() or by a task. */
+#ifndef CO_CAN_RX_DEFERRED
+#define CO_CAN_RX_DEFERRED 0
+#endif
+
+/* Depth of deferred receive queue per RX FIFO (power of 2) */
+#ifndef CO_CAN_RX_QUEUE_SIZE
+#define CO_CAN_RX_QUEUE_SIZE 16
+#endif
+#if CO_CAN_RX_DEFERRED && ((CO_CAN_RX_QUEUE_SIZE & (CO_CAN_RX_QUEUE_SIZE - 1)) != 0 || CO_CAN_RX_QUEUE_SIZE > 0x8000)
+#error CO_CAN_RX_QUEUE_SIZE must be power of 2
+#endif
+
+/* Max number of transmit buffers. Waiting buffers are kept in a bitmap
+ * ordered by COB-ID, so the highest priority one is sent first. */
+#ifndef CO_CAN_TX_SIZE_MAX
+#define CO_CAN_TX_SIZE_MAX 128
+#endif
+#define CO_CAN_TX_PENDING_WORDS ((CO_CAN_TX_SIZE_MAX + 31) / 32)
+
+/* Access (FD)CAN registers and message RAM directly in receive and transmit
+ * path instead of HAL_CAN_AddTxMessage(), HAL_CAN_GetRxMessage() and their
+ * FDCAN counterparts. Transmit header words are prepared once per buffer in
+ * CO_CANtxBufferInit(). FDCAN is supported with fixed message RAM layout
+ * (STM32G4) only. Set to 0 to use HAL. */
+#ifndef CO_CAN_DIRECT_REGISTERS
+#define CO_CAN_DIRECT_REGISTERS 0
+#endif
+
+/* CAN FD frames with up to 64 data bytes. Frame format and bit rate switch
+ * of transmit buffers are selected per COB-ID by CANopenNodeHandle.fdRules.
+ * FDCAN must be configured for FD frames (with data bit timing for BRS) in
+ * CubeMX. Received frames are accepted in both formats. */
+#ifndef CO_CAN_FD
+#define CO_CAN_FD 0
+#endif
+#if CO_CAN_FD && !defined(CO_STM32_FDCAN_Driver)
+#error CO_CAN_FD requires FDCAN peripheral
+#endif
+#if CO_CAN_FD
+#define CO_CAN_DATA_MAX 64
+#else
+#define CO_CAN_DATA_MAX 8
+#endif
+
+/* Free running clock for driver statistics. DWT cycle counter by default,
+ * Cortex-M0 has none. May be redefined, for example to a microsecond timer,
+ * together with its frequency CO_CAN_CLOCK_HZ. */
+#ifndef CO_CAN_CLOCK
+#if defined(DWT) && (__CORTEX_M >= 3)
+#define CO_CAN_CLOCK()    (DWT->CYCCNT)
+#define CO_CAN_CLOCK_HZ   SystemCoreClock
+#define CO_CAN_CLOCK_INIT()                                                                                            \
     do {                                                                                                               \
-        CO_MemoryBarrier();                                                                                            \
-        rxNew = NULL;                                                                                                  \
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;                                                                \
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;                                                                           \
     } while (0)
+#else
+#define CO_CAN_CLOCK() 0U
+#endif
+#endif
+#ifndef CO_CAN_CLOCK_INIT
+#define CO_CAN_CLOCK_INIT()
+#endif
+
+/* Traffic counters per receive and transmit buffer, count of frames without
+ * receive buffer and execution time of CAN interrupts in CO_CAN_CLOCK()
+ * ticks. CO_diag_STM32.c exposes them in manufacturer specific Object
+ * Dictionary entries. Set to 0 to remove all counting from the driver. */
+#ifndef CO_CAN_STATISTICS
+#define CO_CAN_STATISTICS 0
+#endif
+
+/* Bus load meter. Length of every received and transmitted standard frame,
+ * with worst case stuff bits, is added up in CAN interrupts and compared
+ * with the bit rate by CO_diag_process(). Bit rate is given to
+ * CO_CANmodule_init() or, if 0, calculated from peripheral bit timing and
+ * CO_CAN_KERNEL_CLOCK(). Frames rejected by hardware acceptance filters are
+ * not seen, so CO_CAN_RX_FILTERS is refused unless CO_CAN_BUS_LOAD_ACCEPTED. */
+#ifndef CO_CAN_BUS_LOAD
+#define CO_CAN_BUS_LOAD 0
+#endif
+
+/* Set to 1 to confirm, that with CO_CAN_RX_FILTERS the bus load meter
+ * counts only frames accepted by the node, not the load of the bus. */
+#ifndef CO_CAN_BUS_LOAD_ACCEPTED
+#define CO_CAN_BUS_LOAD_ACCEPTED 0
+#endif
+#if CO_CAN_BUS_LOAD && CO_CAN_RX_FILTERS && !CO_CAN_BUS_LOAD_ACCEPTED
+#error CO_CAN_BUS_LOAD does not see frames rejected by CO_CAN_RX_FILTERS, disable filters or set CO_CAN_BUS_LOAD_ACCEPTED
+#endif
+
+/* Clock of (FD)CAN peripheral in Hz */
+#ifndef CO_CAN_KERNEL_CLOCK
+#ifdef CO_STM32_FDCAN_Driver
+#define CO_CAN_KERNEL_CLOCK() HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_FDCAN)
+#else
+#define CO_CAN_KERNEL_CLOCK() HAL_RCC_GetPCLK1Freq()
+#endif
+#endif
+
+/* Transmit latency histograms. Every frame is stamped in CO_CANsend() and
+ * matched when the peripheral reports it on the wire: bxCAN transmit mailbox
+ * interrupt, or FDCAN TX event FIFO, with message marker of the frame. Time
+ * from CO_CANsend() to transmit interrupt, software backlog and mailbox
+ * included, goes into a log2 histogram of the CANopen function code
+ * (COB-ID bits 10..7: SYNC/EMCY, TPDO1, SDO ...). CO_diag_STM32.c exposes
+ * histograms in Object Dictionary. FDCAN needs TX event FIFO elements (fixed
+ * on STM32G4) and CO_CANinterrupt_TXevent() called from
+ * HAL_FDCAN_TxEventFifoCallback(). Set to 0 to remove. */
+#ifndef CO_CAN_TX_LATENCY
+#define CO_CAN_TX_LATENCY 0
+#endif
+
+/* Bucket 0 counts latencies below 2^CO_CAN_TX_LATENCY_SHIFT CO_CAN_CLOCK()
+ * ticks, bucket N latencies from 2^(SHIFT + N - 1), the last bucket counts
+ * all longer ones. Default is 6 us buckets up to 0.2 s at 170 MHz. */
+#ifndef CO_CAN_TX_LATENCY_SHIFT
+#define CO_CAN_TX_LATENCY_SHIFT 10
+#endif
+#ifndef CO_CAN_TX_LATENCY_BUCKETS
+#define CO_CAN_TX_LATENCY_BUCKETS 16
+#endif
+#if CO_CAN_TX_LATENCY_BUCKETS < 2 || CO_CAN_TX_LATENCY_BUCKETS > 32
+#error CO_CAN_TX_LATENCY_BUCKETS must be between 2 and 32
+#endif
+
+/* Receive timestamps. Every received frame carries its reception time in
+ * microseconds of CO_CAN_TIME_US(), CO_CANrxMsg_readTime() reads it. Time
+ * is taken from the hardware timestamp captured at start of frame: FDCAN
+ * timestamp counter (enabled by the driver) or bxCAN time triggered
+ * communication counter (enable Time Triggered Communication Mode in
+ * CubeMX, otherwise time of reading is used). Counter counts bit times, it
+ * is extended to 32-bit microseconds with CO_CAN_TIME_US(). Receive buffers
+ * keep time of their last frame, CO_app_STM32.c uses it for SYNC window and
+ * heartbeat consumer timeouts. */
+#ifndef CO_CAN_RX_TIMESTAMP
+#define CO_CAN_RX_TIMESTAMP 0
+#endif
+
+/* Free running 32-bit microsecond clock. CO_CANtime_us() extends
+ * CO_CAN_CLOCK() by default, CO_CAN_CLOCK_HZ must be whole megahertz. It must
+ * be called at least once per CO_CAN_CLOCK() period (25 s of DWT at 170 MHz),
+ * CO_CANmodule_process() does. May be redefined to a 1 MHz 32-bit timer.
+ * Without CO_CAN_CLOCK() (Cortex-M0) set CO_CAN_TIME_SYSTICK to 1 to read HAL
+ * tick and SysTick counter, if SysTick is the 1 kHz HAL timebase. It is not
+ * with an RTOS, which takes SysTick and moves HAL timebase to a TIMx. */
+#ifndef CO_CAN_TIME_SYSTICK
+#define CO_CAN_TIME_SYSTICK 0
+#endif
+#if !defined(CO_CAN_TIME_US) && (CO_CAN_TIME_SYSTICK || defined(CO_CAN_CLOCK_HZ))
+#define CO_CAN_TIME_US() CO_CANtime_us()
+#endif
+#if CO_CAN_RX_TIMESTAMP && !defined(CO_CAN_TIME_US)
+#error CO_CAN_RX_TIMESTAMP requires CO_CAN_TIME_US(), CO_CAN_CLOCK_HZ or CO_CAN_TIME_SYSTICK
+#endif
+
+/* Receive taps per CAN module. Tap is an extra acceptance filter with its
+ * own callback, which is called from CAN receive interrupt with every
+ * matching frame, before the frame goes to CANopen receive buffers. Used by
+ * CO_gateway_STM32.c to forward frames between CAN ports. Set to 0 to remove
+ * taps from the driver. */
+#ifndef CO_CAN_RX_TAPS
+#define CO_CAN_RX_TAPS 0
+#endif
+
+/* Static memory arena of each CAN port. It holds all CANopen objects created
+ * by CO_new() (CO_alloc() below), communication reset reuses them, so heap is
+ * not used at all. Arena of each port is sized exactly for its Object
+ * Dictionary and CO_CONFIG_* (CO_APP_ARENA_NEED() in CO_app_STM32.h), or
+ * CO_ARENA_SIZE bytes, if bigger. Set to 1 for the exact size only, to 0 to
+ * allocate with calloc(). */
+#ifndef CO_ARENA_SIZE
+#define CO_ARENA_SIZE 0
+#endif
+
+/* NVIC priority of CANopen critical sections (CO_LOCK_xx). If defined,
+ * critical sections raise BASEPRI to this priority, so only interrupts with
+ * the same or lower urgency are blocked: CAN and CANopen timer interrupts
+ * must not be more urgent. Real-time interrupts with more urgent priority
+ * (lower number) keep running, they must not call CANopen functions.
+ * If not defined, or on Cortex-M0/M0+ without BASEPRI, all interrupts are
+ * disabled with PRIMASK. */
+#if defined(CO_LOCK_PRIORITY) && (__CORTEX_M >= 3)
+#if CO_LOCK_PRIORITY <= 0 || CO_LOCK_PRIORITY >= (1 << __NVIC_PRIO_BITS)
+#error CO_LOCK_PRIORITY must be between 1 and lowest NVIC priority, BASEPRI 0 masks nothing
+#endif
+#define CO_LOCK_BASEPRI (CO_LOCK_PRIORITY << (8U - __NVIC_PRIO_BITS))
+
+/* NVIC priorities, configured for CAN and CANopen timer interrupts (in
+ * CubeMX), must be provided to verify them against the lock priority. At run
+ * time CO_CANmodule_init() and CANopenNode_Init() fail, if NVIC_GetPriority()
+ * of any of these interrupts is more urgent than CO_LOCK_PRIORITY. */
+#if !defined(CO_CAN_IRQ_PRIORITY) || !defined(CO_TIMER_IRQ_PRIORITY)
+#error CO_LOCK_PRIORITY requires CO_CAN_IRQ_PRIORITY and CO_TIMER_IRQ_PRIORITY, NVIC priorities of CAN and CANopen timer
+#elif CO_CAN_IRQ_PRIORITY < CO_LOCK_PRIORITY
+#error CO_CAN_IRQ_PRIORITY is more urgent than CO_LOCK_PRIORITY, CAN interrupt would break critical sections
+#elif CO_TIMER_IRQ_PRIORITY < CO_LOCK_PRIORITY
+#error CO_TIMER_IRQ_PRIORITY is more urgent than CO_LOCK_PRIORITY, CANopen timer interrupt would break critical sections
+#endif
+
+/* Interrupt lines of each CAN peripheral, X(instance, IRQn...), which
+ * CO_CANmodule_init() checks. Defaults are names of STM32F4/F7 bxCAN and
+ * STM32G4/H7 FDCAN, define CO_CAN_IRQS(X) for other devices. A peripheral,
+ * which is not listed, fails the check. */
+#ifndef CO_CAN_IRQS
+#ifdef CO_STM32_FDCAN_Driver
+#ifdef FDCAN2
+#define CO_CAN_IRQS_2(X) X(FDCAN2, FDCAN2_IT0_IRQn, FDCAN2_IT1_IRQn)
+#else
+#define CO_CAN_IRQS_2(X)
+#endif
+#ifdef FDCAN3
+#define CO_CAN_IRQS_3(X) X(FDCAN3, FDCAN3_IT0_IRQn, FDCAN3_IT1_IRQn)
+#else
+#define CO_CAN_IRQS_3(X)
+#endif
+#define CO_CAN_IRQS(X) X(FDCAN1, FDCAN1_IT0_IRQn, FDCAN1_IT1_IRQn) CO_CAN_IRQS_2(X) CO_CAN_IRQS_3(X)
+#else
+#ifdef CAN2
+#define CO_CAN_IRQS_2(X) X(CAN2, CAN2_TX_IRQn, CAN2_RX0_IRQn, CAN2_RX1_IRQn)
+#else
+#define CO_CAN_IRQS_2(X)
+#endif
+#define CO_CAN_IRQS(X) X(CAN1, CAN1_TX_IRQn, CAN1_RX0_IRQn, CAN1_RX1_IRQn) CO_CAN_IRQS_2(X)
+#endif
+#endif
+#endif
 
 #endif //TEST_CAN_CO_DRIVER_STM32_H
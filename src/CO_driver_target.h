@@ -29,14 +29,23 @@ typedef double float64_t;
  */
 typedef struct {
     uint32_t ident;  /*!< Standard identifier */
-    uint8_t dlc;     /*!< Data length */
-    uint8_t data[8]; /*!< Received data */
+    uint8_t dlc;                   /*!< Data length in bytes, also for CAN FD frames */
+    uint8_t data[CO_CAN_DATA_MAX]; /*!< Received data */
+#if CO_CAN_RX_TIMESTAMP
+    uint32_t timestamp_us; /*!< Reception time, CO_CAN_TIME_US() at start of frame */
+#endif
 } CO_CANrxMsg_t;
 
-/* Access to received CAN message */
+/* Access to received CAN message, DLC is number of data bytes also for CAN FD DLC codes above 8 */
 #define CO_CANrxMsg_readIdent(msg) ((uint16_t)(((CO_CANrxMsg_t*)(msg)))->ident)
 #define CO_CANrxMsg_readDLC(msg)   ((uint8_t)(((CO_CANrxMsg_t*)(msg)))->dlc)
 #define CO_CANrxMsg_readData(msg)  ((uint8_t*)(((CO_CANrxMsg_t*)(msg)))->data)
+/* Reception time in microseconds, time of reading without CO_CAN_RX_TIMESTAMP */
+#if CO_CAN_RX_TIMESTAMP
+#define CO_CANrxMsg_readTime(msg) (((CO_CANrxMsg_t*)(msg))->timestamp_us)
+#else
+#define CO_CANrxMsg_readTime(msg) CO_CAN_TIME_US()
+#endif
 
 /* Received message object */
 typedef struct {
@@ -44,17 +53,120 @@ typedef struct {
     uint16_t mask;
     void* object;
     void (*CANrx_callback)(void* object, void* message);
+    uint16_t next; /* Next buffer in the same dispatch index list */
+#if CO_CAN_RX_TIMESTAMP
+    uint32_t rxTime_us; /* Reception time of the last frame */
+#endif
+#if CO_CAN_STATISTICS
+    uint32_t count; /* Number of received frames */
+#endif
 } CO_CANrx_t;
 
+#if CO_CAN_RX_DEFERRED
+/* Single producer (RX FIFO interrupt or CO_CANinject_RX() under lock), single consumer queue of received messages */
+typedef struct {
+    CO_CANrxMsg_t msg[CO_CAN_RX_QUEUE_SIZE];
+    uint16_t index[CO_CAN_RX_QUEUE_SIZE]; /* rxArray index matched in interrupt */
+    volatile uint16_t head;               /* Written by producer only */
+    volatile uint16_t tail;               /* Written by consumer only */
+    uint32_t overflow;                    /* Number of messages lost, because queue was full */
+} CO_CANrxQueue_t;
+#endif
+
 /* Transmit message object */
 typedef struct {
     uint32_t ident;
-    uint8_t DLC;
-    uint8_t data[8];
+    uint8_t DLC; /* Number of data bytes */
+    uint8_t data[CO_CAN_DATA_MAX];
     volatile bool_t bufferFull;
     volatile bool_t syncFlag;
+    uint16_t rank;     /* Position in COB-ID priority order */
+    uint32_t queuedAt; /* CO_CAN_CLOCK() value, when buffer was given to CO_CANsend() */
+#if CO_CAN_FD
+    uint8_t fdFlags; /* CO_CAN_FD_FORMAT, CO_CAN_FD_BRS */
+#endif
+#if CO_CAN_DIRECT_REGISTERS
+    uint32_t hwHeader[2]; /* TIR and TDTR (bxCAN) or T0 and T1 (FDCAN) of the message */
+#endif
+#if CO_CAN_STATISTICS
+    uint32_t count; /* Number of frames passed to mailbox */
+#endif
 } CO_CANtx_t;
 
+#if CO_CAN_FD
+/* Frame format flags of transmit buffer */
+#define CO_CAN_FD_FORMAT 0x01U /* CAN FD frame, sent automatically if data is longer than 8 bytes */
+#define CO_CAN_FD_BRS    0x02U /* Data phase with data bit rate, CAN FD frames only */
+
+/* Frame format rule. CO_CANtxBufferInit() applies flags of the first rule,
+ * which matches (ident & mask) == (rule.ident & rule.mask). */
+typedef struct {
+    uint16_t ident;
+    uint16_t mask;
+    uint8_t flags;
+} CO_CANfdRule_t;
+#endif
+
+#if CO_CAN_RX_TAPS > 0
+/* Receive tap, see CO_CAN_RX_TAPS */
+typedef struct {
+    uint16_t ident; /* Data frames only */
+    uint16_t mask;
+    void* object;
+    void (*callback)(void* object, const CO_CANrxMsg_t* msg);
+} CO_CANrxTap_t;
+#endif
+
+#if CO_CAN_RX_FILTERS
+/* Candidate for hardware filter, ident and mask are in rxArray format */
+typedef struct {
+    uint16_t ident;
+    uint16_t mask;
+    uint16_t index; /* rxArray index or CO_CAN_RX_NONE, if filter was merged from more buffers */
+    uint8_t fifo;   /* RX FIFO of matched frames */
+} CO_CANrxFilter_t;
+#endif
+
+/* Statistics of software transmit backlog, times are in CO_CAN_CLOCK() ticks */
+typedef struct {
+    uint16_t highWater; /* Max number of buffers waiting at once */
+    uint32_t waitMax;   /* Longest wait for mailbox */
+    uint32_t waitSum;   /* Sum of all waits, average is waitSum / waitCount */
+    uint32_t waitCount; /* Number of buffers, which waited */
+} CO_CANtxStats_t;
+
+#if CO_CAN_STATISTICS
+/* Execution time of CAN interrupt, in CO_CAN_CLOCK() ticks */
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;   /* Average is sum / count */
+    uint32_t count; /* Number of interrupts */
+} CO_CANisrStats_t;
+#endif
+
+#if CO_CAN_TX_LATENCY
+/* Transmit latency classes, one per CANopen function code */
+#define CO_CAN_TX_LATENCY_CLASSES 16U
+
+/* Frames on the way to the bus, indexed by bxCAN mailbox or FDCAN message marker */
+#define CO_CAN_TX_LATENCY_SLOTS 32U
+
+/* Histogram of transmit latency, in CO_CAN_CLOCK() ticks */
+typedef struct {
+    uint32_t bucket[CO_CAN_TX_LATENCY_BUCKETS]; /* See CO_CAN_TX_LATENCY_SHIFT */
+    uint32_t max;
+} CO_CANtxLatency_t;
+
+/* Frame in transmit mailbox */
+typedef struct {
+    uint32_t sentAt; /* queuedAt of its buffer */
+    uint16_t ident;
+    uint8_t marker; /* FDCAN message marker */
+    bool_t used;
+} CO_CANtxSlot_t;
+#endif
+
 /* CAN module object */
 typedef struct {
     void* CANptr;
@@ -64,16 +176,69 @@ typedef struct {
     uint16_t txSize;
     uint16_t CANerrorStatus;
     volatile bool_t CANnormal;
+    bool_t CANwarm; /* Peripheral kept running over communication reset, interrupts held until normal mode */
     volatile bool_t useCANrxFilters;
     volatile bool_t bufferInhibitFlag;
     volatile bool_t firstCANtxMessage;
     volatile uint16_t CANtxCount;
     uint32_t errOld;
+    uint32_t rxOverrun[2]; /* Number of RX FIFO0 and FIFO1 overruns */
+    volatile uint32_t rxDelivered; /* Frames passed to receive callbacks, free running */
+#if CO_CAN_RX_HASH_SIZE > 0
+    uint16_t rxHash[CO_CAN_RX_HASH_SIZE]; /* First buffer of each hash bucket */
+    uint16_t rxMasked;                    /* First buffer with partial mask */
+#endif
+#if CO_CAN_RX_FILTERS
+    uint16_t rxFilterMap[2][CO_CAN_RX_FILTER_MAP_SIZE]; /* Filter match index to rxArray index, per FIFO */
+    uint8_t rxFilterBase[2];                            /* Match index of first own filter, per FIFO */
+    uint8_t rxFilterFirst;                              /* First own filter bank (element) */
+    uint8_t rxFilterCount;                              /* Number of own filter banks (elements) */
+    uint32_t rxFilterGeneration;                        /* Value of global filter generation at last compile */
+    volatile bool_t rxFiltersDirty;                     /* Receive buffers changed, filters must be recompiled */
+    /* Work area of filter compilation, kept off the stack of the caller */
+    CO_CANrxFilter_t rxFilterWork[CO_CAN_RX_FILTER_MAP_SIZE];
+    uint16_t rxFilterOrder[CO_CAN_RX_FILTER_MAP_SIZE]; /* bxCAN: filters of one FIFO in bank order, FDCAN: paired */
+#endif
+#if CO_CAN_RX_DEFERRED
+    CO_CANrxQueue_t rxQueue[2]; /* Deferred received messages, per RX FIFO */
+#endif
+    uint32_t txPending[CO_CAN_TX_PENDING_WORDS]; /* Bit per rank of buffer waiting for mailbox */
+    uint16_t txByRank[CO_CAN_TX_SIZE_MAX];       /* txArray index of each rank */
+    CO_CANtxStats_t txStats;
+#if CO_CAN_BUS_LOAD
+    /* Free running sums of frame lengths in 1/16 of nominal bit time */
+    uint32_t busBitsRx[2]; /* Per RX FIFO, each has own interrupt */
+    uint32_t busBitsTx;
+    uint16_t busBitRate; /* Nominal bit rate in kbit/s */
+#if CO_CAN_FD
+    uint16_t busDataBit; /* Data phase bit time in 1/16 of nominal bit time */
+#endif
+#endif
+#if CO_CAN_RX_TIMESTAMP
+    uint32_t rxStampScale; /* Microseconds per counter tick in 1/65536, 0 without hardware timestamps */
+    uint32_t rxStampLast;  /* bxCAN: counter value of the last frame */
+    uint32_t rxStampTime;  /* bxCAN: reception time of the last frame */
+#endif
+#if CO_CAN_RX_TAPS > 0
+    CO_CANrxTap_t rxTaps[CO_CAN_RX_TAPS];
+    void* txIdleObject;
+    void (*txIdle)(void* object); /* Called from transmit interrupt with empty backlog */
+#endif
+#if CO_CAN_TX_LATENCY
+    CO_CANtxLatency_t txLatency[CO_CAN_TX_LATENCY_CLASSES];
+    CO_CANtxSlot_t txSlot[CO_CAN_TX_LATENCY_SLOTS];
+    uint8_t txMarker; /* FDCAN message marker of the next frame */
+#endif
+#if CO_CAN_STATISTICS
+    uint32_t rxUnmatched;   /* Received frames without receive buffer */
+    CO_CANisrStats_t isrRx; /* CO_CANinterrupt_RX() */
+    CO_CANisrStats_t isrTx; /* CO_CANinterrupt_TX() */
+#endif
 
-    /* STM32 specific features */
+    /* STM32 specific features, saved PRIMASK (or BASEPRI with CO_LOCK_PRIORITY) */
     uint32_t primask_send; /* Primask register for interrupts for send operation */
     uint32_t primask_emcy; /* Primask register for interrupts for emergency operation */
-    uint32_t primask_od;   /* Primask register for interrupts for send operation */
+    uint32_t primask_od;   /* Primask register for interrupts for OD access */
 
 } CO_CANmodule_t;
 
@@ -84,33 +249,46 @@ typedef struct {
     uint8_t subIndexOD;
     uint8_t attr;
     /* Additional variables (target specific) */
-    void* addrNV;
+    void* storageModule; /* CO_storageFlash_t of the entry */
+    uint32_t recordAddr; /* Flash address of the newest record or 0 */
 } CO_storage_entry_t;
 
-/* (un)lock critical section in CO_CANsend() */
-// Why disabling the whole Interrupt
-#define CO_LOCK_CAN_SEND(CAN_MODULE)                                                                                   \
+#if CO_ARENA_SIZE > 0
+/* Memory for CO_new() from static arena of the port, see CO_app_STM32.c.
+ * Objects live until reset of the device, CO_delete() frees nothing. */
+void* CO_arena_alloc(size_t num, size_t size);
+#define CO_alloc(num, size) CO_arena_alloc((num), (size))
+#define CO_free(ptr)        ((void)(ptr))
+#endif
+
+/* Enter and leave critical section, previous mask is saved into STATE */
+#ifdef CO_LOCK_BASEPRI
+#define CO_LOCK_ENTER(STATE)                                                                                           \
     do {                                                                                                               \
-        (CAN_MODULE)->primask_send = __get_PRIMASK();                                                                  \
-        __disable_irq();                                                                                               \
+        (STATE) = __get_BASEPRI();                                                                                     \
+        __set_BASEPRI_MAX(CO_LOCK_BASEPRI);                                                                            \
     } while (0)
-#define CO_UNLOCK_CAN_SEND(CAN_MODULE) __set_PRIMASK((CAN_MODULE)->primask_send)
-
-/* (un)lock critical section in CO_errorReport() or CO_errorReset() */
-#define CO_LOCK_EMCY(CAN_MODULE)                                                                                       \
+#define CO_LOCK_LEAVE(STATE) __set_BASEPRI(STATE)
+#else
+#define CO_LOCK_ENTER(STATE)                                                                                           \
     do {                                                                                                               \
-        (CAN_MODULE)->primask_emcy = __get_PRIMASK();                                                                  \
+        (STATE) = __get_PRIMASK();                                                                                     \
         __disable_irq();                                                                                               \
     } while (0)
-#define CO_UNLOCK_EMCY(CAN_MODULE) __set_PRIMASK((CAN_MODULE)->primask_emcy)
+#define CO_LOCK_LEAVE(STATE) __set_PRIMASK(STATE)
+#endif
+
+/* (un)lock critical section in CO_CANsend() */
+#define CO_LOCK_CAN_SEND(CAN_MODULE)   CO_LOCK_ENTER((CAN_MODULE)->primask_send)
+#define CO_UNLOCK_CAN_SEND(CAN_MODULE) CO_LOCK_LEAVE((CAN_MODULE)->primask_send)
+
+/* (un)lock critical section in CO_errorReport() or CO_errorReset() */
+#define CO_LOCK_EMCY(CAN_MODULE)   CO_LOCK_ENTER((CAN_MODULE)->primask_emcy)
+#define CO_UNLOCK_EMCY(CAN_MODULE) CO_LOCK_LEAVE((CAN_MODULE)->primask_emcy)
 
 /* (un)lock critical section when accessing Object Dictionary */
-#define CO_LOCK_OD(CAN_MODULE)                                                                                         \
-    do {                                                                                                               \
-        (CAN_MODULE)->primask_od = __get_PRIMASK();                                                                    \
-        __disable_irq();                                                                                               \
-    } while (0)
-#define CO_UNLOCK_OD(CAN_MODULE) __set_PRIMASK((CAN_MODULE)->primask_od)
+#define CO_LOCK_OD(CAN_MODULE)   CO_LOCK_ENTER((CAN_MODULE)->primask_od)
+#define CO_UNLOCK_OD(CAN_MODULE) CO_LOCK_LEAVE((CAN_MODULE)->primask_od)
 
 /* Synchronization between CAN receive and message processing threads. */
 #define CO_MemoryBarrier()
@@ -127,7 +305,22 @@ typedef struct {
     } while (0)
 
 void CO_CANinterrupt_TX(CO_CANmodule_t* CANmodule, uint32_t MailboxNumber);
+uint32_t CO_CANtime_us(void);
+#if CO_CAN_TX_LATENCY && defined(CO_STM32_FDCAN_Driver)
+void CO_CANinterrupt_TXevent(CO_CANmodule_t* CANmodule);
+#endif
 void CO_CANinterrupt_RX(CO_CANmodule_t* hcan, uint32_t fifo);
+bool_t CO_CANinject_RX(CO_CANmodule_t* CANmodule, uint32_t fifo, const CO_CANrxMsg_t* msg);
+#if CO_CAN_RX_DEFERRED
+void CO_CANrxProcess(CO_CANmodule_t* CANmodule);
+#endif
+#if CO_CAN_RX_TAPS > 0
+bool_t CO_CANrxTapInit(CO_CANmodule_t* CANmodule, uint8_t index, uint16_t ident, uint16_t mask, void* object,
+                       void (*callback)(void* object, const CO_CANrxMsg_t* msg));
+void CO_CANtxIdleInit(CO_CANmodule_t* CANmodule, void* object, void (*callback)(void* object));
+void CO_CANtxFrameInit(CO_CANmodule_t* CANmodule, CO_CANtx_t* frame, uint16_t ident, bool_t rtr, uint8_t noOfBytes);
+bool_t CO_CANsendFrame(CO_CANmodule_t* CANmodule, CO_CANtx_t* frame);
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,210 @@
+/*
+ * CAN to CAN gateway between ports of STM32 CANopenNode
+ *
+ * @file        CO_gateway_STM32.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "CO_gateway_STM32.h"
+
+#if CO_GATEWAY_STM32
+
+#ifndef CO_CAN_TIME_US
+#error CO_GATEWAY_STM32 requires CO_CAN_TIME_US(), CO_CAN_CLOCK_HZ or CO_CAN_TIME_SYSTICK
+#endif
+
+#define CO_GATEWAY_IDENT_MASK 0x07FFU
+
+/* Longest burst of token bucket, keeps credit within 31 bits */
+#define CO_GATEWAY_CREDIT_MAX 0x7FFFFFFFU
+
+/* Burst of route in microseconds of credit */
+static uint32_t
+prv_burst_us(const CO_gateway_route_t* route) {
+    return (1000000U / route->rate) * (route->burst > 0U ? route->burst : 1U);
+}
+
+/*
+ * Token bucket with credit in microseconds, refilled lazily from
+ * CO_CAN_TIME_US(), so rates above 1000 frames per second get credit between
+ * frames. Called only from receive interrupt of the source port.
+ */
+static bool_t
+prv_rate_check(CO_gateway_routeState_t* state) {
+    const CO_gateway_route_t* route = state->route;
+
+    if (route->rate == 0U) {
+        return true;
+    }
+    uint32_t cost_us = 1000000U / route->rate;
+    uint32_t burst_us = prv_burst_us(route);
+    uint32_t now_us = CO_CAN_TIME_US();
+    uint32_t elapsed_us = now_us - state->creditTime_us;
+
+    state->creditTime_us = now_us;
+    if (elapsed_us >= burst_us - state->credit_us) {
+        state->credit_us = burst_us;
+    } else {
+        state->credit_us += elapsed_us;
+    }
+    if (state->credit_us < cost_us) {
+        return false;
+    }
+    state->credit_us -= cost_us;
+    return true;
+}
+
+/* Frame is in transmit mailbox, called with CO_LOCK_CAN_SEND() of destination */
+static void
+prv_forwarded(CO_gateway_routeState_t* state, uint32_t rxTime) {
+    CO_gateway_stats_t* stats = &state->stats;
+    uint32_t latency = CO_CAN_CLOCK() - rxTime;
+
+    stats->forwarded++;
+    stats->latencySum += latency;
+    if (latency < stats->latencyMin) {
+        stats->latencyMin = latency;
+    }
+    if (latency > stats->latencyMax) {
+        stats->latencyMax = latency;
+    }
+}
+
+/* Receive tap of route, called from receive interrupt of the source port */
+static void
+prv_rx_tap(void* object, const CO_CANrxMsg_t* msg) {
+    uint32_t rxTime = CO_CAN_CLOCK();
+    CO_gateway_routeState_t* state = object;
+    const CO_gateway_route_t* route = state->route;
+    CO_gateway_port_t* port = &state->gw->ports[route->dstPort];
+    CO_CANmodule_t* CANmodule = port->CANmodule;
+
+    if (CANmodule == NULL) {
+        state->stats.dropped++;
+        return;
+    }
+
+    CO_LOCK_CAN_SEND(CANmodule);
+    if (!prv_rate_check(state)) {
+        state->stats.limited++;
+    } else if (!CANmodule->CANnormal || port->count == CO_GATEWAY_QUEUE_SIZE) {
+        state->stats.dropped++;
+    } else {
+        /* Build frame in place, in free entry of the destination queue */
+        CO_gateway_entry_t* entry = &port->queue[port->tail];
+        uint16_t ident = (uint16_t)((msg->ident & ~route->rewriteMask) | (route->rewriteIdent & route->rewriteMask));
+        uint8_t dlc = msg->dlc > CO_CAN_DATA_MAX ? CO_CAN_DATA_MAX : msg->dlc;
+
+        CO_CANtxFrameInit(CANmodule, &entry->frame, ident & CO_GATEWAY_IDENT_MASK, false, dlc);
+        memcpy(entry->frame.data, msg->data, dlc);
+
+        if (port->count == 0U && CO_CANsendFrame(CANmodule, &entry->frame)) {
+            prv_forwarded(state, rxTime);
+        } else {
+            entry->rxTime = rxTime;
+            entry->route = state;
+            port->tail = (uint8_t)((port->tail + 1U) & (CO_GATEWAY_QUEUE_SIZE - 1U));
+            port->count++;
+        }
+    }
+    CO_UNLOCK_CAN_SEND(CANmodule);
+}
+
+/* Transmit idle callback of the destination port */
+static void
+prv_tx_idle(void* object) {
+    CO_gateway_port_t* port = object;
+    CO_CANmodule_t* CANmodule = port->CANmodule;
+
+    CO_LOCK_CAN_SEND(CANmodule);
+    while (port->count > 0U) {
+        CO_gateway_entry_t* entry = &port->queue[port->head];
+
+        if (!CO_CANsendFrame(CANmodule, &entry->frame)) {
+            break;
+        }
+        prv_forwarded(entry->route, entry->rxTime);
+        port->head = (uint8_t)((port->head + 1U) & (CO_GATEWAY_QUEUE_SIZE - 1U));
+        port->count--;
+    }
+    CO_UNLOCK_CAN_SEND(CANmodule);
+}
+
+CO_ReturnError_t
+CO_gateway_init(CO_gateway_t* gw, const CO_gateway_route_t* routes, uint8_t routeCount) {
+    if (gw == NULL || (routes == NULL && routeCount > 0U) || routeCount > CO_GATEWAY_ROUTES) {
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+    for (uint8_t i = 0U; i < routeCount; i++) {
+        const CO_gateway_route_t* route = &routes[i];
+
+        if (route->srcPort >= CO_GATEWAY_PORTS || route->dstPort >= CO_GATEWAY_PORTS
+            || (route->rate > 0U && route->burst > CO_GATEWAY_CREDIT_MAX / (1000000U / route->rate))) {
+            return CO_ERROR_ILLEGAL_ARGUMENT;
+        }
+    }
+
+    memset(gw, 0, sizeof(*gw));
+    gw->routeCount = routeCount;
+    for (uint8_t i = 0U; i < routeCount; i++) {
+        CO_gateway_routeState_t* state = &gw->routes[i];
+
+        state->gw = gw;
+        state->route = &routes[i];
+        state->stats.latencyMin = UINT32_MAX;
+        if (routes[i].rate > 0U) {
+            state->credit_us = prv_burst_us(&routes[i]);
+        }
+        state->creditTime_us = CO_CAN_TIME_US();
+    }
+    return CO_ERROR_NO;
+}
+
+CO_ReturnError_t
+CO_gateway_attach(CO_gateway_t* gw, uint8_t port, CO_CANmodule_t* CANmodule) {
+    if (gw == NULL || port >= CO_GATEWAY_PORTS || CANmodule == NULL) {
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+    CO_gateway_port_t* gwPort = &gw->ports[port];
+    uint8_t tap = 0U;
+
+    CO_LOCK_CAN_SEND(CANmodule);
+    gwPort->CANmodule = CANmodule;
+    gwPort->head = 0U;
+    gwPort->tail = 0U;
+    gwPort->count = 0U;
+    CO_UNLOCK_CAN_SEND(CANmodule);
+
+    for (uint8_t i = 0U; i < gw->routeCount; i++) {
+        const CO_gateway_route_t* route = gw->routes[i].route;
+
+        if (route->srcPort != port) {
+            continue;
+        }
+        if (!CO_CANrxTapInit(CANmodule, tap, route->ident, route->mask, &gw->routes[i], prv_rx_tap)) {
+            return CO_ERROR_ILLEGAL_ARGUMENT;
+        }
+        tap++;
+    }
+    CO_CANtxIdleInit(CANmodule, gwPort, prv_tx_idle);
+    return CO_ERROR_NO;
+}
+
+#endif /* CO_GATEWAY_STM32 */
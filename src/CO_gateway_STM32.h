@@ -0,0 +1,160 @@
+/*
+ * CAN to CAN gateway between ports of STM32 CANopenNode
+ *
+ * @file        CO_gateway_STM32.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CO_GATEWAY_STM32_H
+#define CO_GATEWAY_STM32_H
+
+#include "301/CO_driver.h"
+
+/* Gateway uses receive taps of the driver */
+#define CO_GATEWAY_STM32 (CO_CAN_RX_TAPS > 0)
+
+#if CO_GATEWAY_STM32 || defined CO_DOXYGEN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frames received on one CAN port are forwarded to another port directly
+ * from the CAN receive interrupt, with no CANopen object or application in
+ * between. Every route of the routing table takes one receive tap
+ * (CO_CAN_RX_TAPS) of its source port. Matching frame is written into the
+ * transmit frame of the destination queue and sent from there, into a free
+ * mailbox right away if the destination has no CANopen frames waiting, or
+ * from the destination transmit interrupt later. CANopen frames of the
+ * destination node always go first.
+ *
+ * Times are in CO_CAN_CLOCK() ticks, CPU cycles with default DWT clock. */
+
+/* Number of CAN ports of the gateway */
+#ifndef CO_GATEWAY_PORTS
+#define CO_GATEWAY_PORTS 2
+#endif
+
+/* Max number of routes */
+#ifndef CO_GATEWAY_ROUTES
+#define CO_GATEWAY_ROUTES CO_CAN_RX_TAPS
+#endif
+
+/* Frames waiting for a free mailbox per destination port (power of 2) */
+#ifndef CO_GATEWAY_QUEUE_SIZE
+#define CO_GATEWAY_QUEUE_SIZE 16
+#endif
+#if (CO_GATEWAY_QUEUE_SIZE & (CO_GATEWAY_QUEUE_SIZE - 1)) != 0 || CO_GATEWAY_QUEUE_SIZE > 0x100
+#error CO_GATEWAY_QUEUE_SIZE must be power of 2
+#endif
+
+/* Route of routing table */
+typedef struct {
+    uint8_t srcPort;       /* Port of received frame */
+    uint8_t dstPort;       /* Port to forward the frame to, may be the same port */
+    uint16_t ident;        /* COB-ID of received data frames */
+    uint16_t mask;         /* Bits of ident, which must match */
+    uint16_t rewriteIdent; /* Bits of rewriteMask replace bits of forwarded COB-ID */
+    uint16_t rewriteMask;  /* 0 keeps COB-ID */
+    uint16_t rate;         /* Max frames per second, 0 for no limit */
+    uint16_t burst;        /* Frames, which may be forwarded at once after a pause, at least 1 */
+} CO_gateway_route_t;
+
+/* Counters of route */
+typedef struct {
+    uint32_t forwarded;    /* Frames handed over to a transmit mailbox */
+    uint32_t dropped;      /* Destination queue was full or port not operational */
+    uint32_t limited;      /* Frames over the rate limit */
+    uint32_t latencyMin;   /* Time from receive interrupt to transmit mailbox */
+    uint32_t latencyMax;
+    uint64_t latencySum;   /* Average is latencySum / forwarded */
+} CO_gateway_stats_t;
+
+struct CO_gateway;
+
+/* Route state, object of its receive tap */
+typedef struct {
+    struct CO_gateway* gw;
+    const CO_gateway_route_t* route;
+    CO_gateway_stats_t stats;
+    uint32_t credit_us;     /* Token bucket of rate limit */
+    uint32_t creditTime_us; /* CO_CAN_TIME_US() of last refill */
+} CO_gateway_routeState_t;
+
+/* Frame waiting for transmission */
+typedef struct {
+    CO_CANtx_t frame;
+    uint32_t rxTime;
+    CO_gateway_routeState_t* route;
+} CO_gateway_entry_t;
+
+/* Port, queue is protected with CO_LOCK_CAN_SEND() of its CAN module */
+typedef struct {
+    CO_CANmodule_t* CANmodule;
+    CO_gateway_entry_t queue[CO_GATEWAY_QUEUE_SIZE];
+    uint8_t head; /* Next entry to send */
+    uint8_t tail; /* Next free entry */
+    uint8_t count;
+} CO_gateway_port_t;
+
+/* Gateway object */
+typedef struct CO_gateway {
+    CO_gateway_routeState_t routes[CO_GATEWAY_ROUTES];
+    uint8_t routeCount;
+    CO_gateway_port_t ports[CO_GATEWAY_PORTS];
+} CO_gateway_t;
+
+/**
+ * Initialize gateway object
+ *
+ * Ports are not forwarding until they are attached.
+ *
+ * @param gw This object will be initialized.
+ * @param routes Routing table, must stay valid. Routes of one source port
+ * are applied in table order, frame may match several routes.
+ * @param routeCount Number of routes, max CO_GATEWAY_ROUTES.
+ *
+ * @return #CO_ReturnError_t: CO_ERROR_NO or CO_ERROR_ILLEGAL_ARGUMENT.
+ */
+CO_ReturnError_t CO_gateway_init(CO_gateway_t* gw, const CO_gateway_route_t* routes, uint8_t routeCount);
+
+/**
+ * Attach CAN module to gateway port
+ *
+ * Registers receive taps of routes with this source port and transmit idle
+ * callback of the CAN module. CO_CANmodule_init() clears both, so the port
+ * must be attached again after every communication reset, after
+ * CO_CANopenInit() and before CO_CANsetNormalMode(). Frames still waiting
+ * for this port are discarded.
+ *
+ * @param gw This object.
+ * @param port Port index, lower than CO_GATEWAY_PORTS.
+ * @param CANmodule CAN module of the port.
+ *
+ * @return #CO_ReturnError_t: CO_ERROR_NO or CO_ERROR_ILLEGAL_ARGUMENT, if
+ * routes of the port need more than CO_CAN_RX_TAPS taps.
+ */
+CO_ReturnError_t CO_gateway_attach(CO_gateway_t* gw, uint8_t port, CO_CANmodule_t* CANmodule);
+
+#ifdef __cplusplus
+}
+#endif /*__cplusplus*/
+
+#endif /* CO_GATEWAY_STM32 */
+
+#endif /* CO_GATEWAY_STM32_H */
@@ -0,0 +1,836 @@
+/*
+ * CANopen data storage object in internal flash of STM32
+ *
+ * @file        CO_storageFlash.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "CO_storageFlash.h"
+#include "301/crc16-ccitt.h"
+
+#if (CO_CONFIG_STORAGE) & CO_CONFIG_STORAGE_ENABLE
+
+#if !((CO_CONFIG_CRC16) & CO_CONFIG_CRC16_ENABLE)
+#error CO_storageFlash requires CO_CONFIG_CRC16_ENABLE
+#endif
+
+#define CO_FLASH_PAGE_MAGIC   0x464C4F43UL /* "COLF" */
+#define CO_FLASH_RECORD_MAGIC 0xC0DEU
+#define CO_FLASH_RECORD_EMPTY 0x01U /* Entry was restored to default values */
+#define CO_FLASH_ALIGN_UP(x)  (((x) + CO_STORAGE_FLASH_ALIGN - 1U) & ~(uint32_t)(CO_STORAGE_FLASH_ALIGN - 1U))
+
+/* Page header takes two programming units. The first one, with erase count,
+ * is written after erase, the second one, with page sequence number and its
+ * complement, when the page is opened for records. */
+#define CO_FLASH_PAGE_SEQ  CO_STORAGE_FLASH_ALIGN
+#define CO_FLASH_PAGE_DATA (2U * CO_STORAGE_FLASH_ALIGN)
+
+typedef CO_storageFlash_record_t prv_record_t;
+#define CO_FLASH_RECORD_CRC 10U
+_Static_assert(sizeof(prv_record_t) == 12U, "Record header must be packed");
+
+/* State of page */
+typedef enum {
+    PRV_PAGE_BLANK,   /* Erased, without header */
+    PRV_PAGE_SPARE,   /* Erased, with erase count */
+    PRV_PAGE_USED,    /* Opened for records */
+    PRV_PAGE_CORRUPT, /* Interrupted erase or open, must be erased */
+} prv_page_t;
+
+static inline uint32_t
+prv_page_addr(const CO_storageFlash_t* flash, uint8_t page) {
+    return flash->region->base + (uint32_t)page * flash->region->pageSize;
+}
+
+static inline uint8_t
+prv_page_next(const CO_storageFlash_t* flash, uint8_t page) {
+    return (uint8_t)((page + 1U) % flash->region->pageCount);
+}
+
+static inline uint32_t
+prv_record_size(uint32_t len) {
+    return CO_FLASH_ALIGN_UP(sizeof(prv_record_t) + len);
+}
+
+static bool_t
+prv_program(CO_storageFlash_t* flash, uint32_t addr, const void* data, uint32_t len) {
+    flash->stats.bytes += len;
+    return flash->region->program(flash->region->object, addr, data, len);
+}
+
+/* Check if flash is erased */
+static bool_t
+prv_blank(const CO_storageFlash_t* flash, uint32_t addr, uint32_t len) {
+    uint8_t buf[32];
+
+    while (len > 0U) {
+        uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+
+        if (!flash->region->read(flash->region->object, addr, buf, n)) {
+            return false;
+        }
+        for (uint32_t i = 0U; i < n; i++) {
+            if (buf[i] != 0xFFU) {
+                return false;
+            }
+        }
+        addr += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* Compare flash with data */
+static bool_t
+prv_equal(const CO_storageFlash_t* flash, uint32_t addr, const uint8_t* data, uint32_t len) {
+    uint8_t buf[32];
+
+    while (len > 0U) {
+        uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+
+        if (!flash->region->read(flash->region->object, addr, buf, n) || memcmp(buf, data, n) != 0) {
+            return false;
+        }
+        addr += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* Erase page and write its erase count */
+static bool_t
+prv_format(CO_storageFlash_t* flash, uint8_t page) {
+    uint32_t addr = prv_page_addr(flash, page);
+    uint32_t unit[CO_STORAGE_FLASH_ALIGN / 4U];
+
+    flash->eraseCount[page]++;
+    if (!flash->region->erase(flash->region->object, addr)) {
+        return false;
+    }
+    memset(unit, 0xFF, sizeof(unit));
+    unit[0] = CO_FLASH_PAGE_MAGIC;
+    unit[1] = flash->eraseCount[page];
+    return prv_program(flash, addr, unit, sizeof(unit));
+}
+
+/* Read page header */
+static prv_page_t
+prv_page_state(CO_storageFlash_t* flash, uint8_t page, uint32_t* pageSeq) {
+    uint32_t addr = prv_page_addr(flash, page);
+    uint32_t header[2];
+    uint32_t seq[2];
+
+    if (!flash->region->read(flash->region->object, addr, header, sizeof(header))
+        || !flash->region->read(flash->region->object, addr + CO_FLASH_PAGE_SEQ, seq, sizeof(seq))) {
+        return PRV_PAGE_CORRUPT;
+    }
+    if (header[0] != CO_FLASH_PAGE_MAGIC) {
+        return prv_blank(flash, addr, flash->region->pageSize) ? PRV_PAGE_BLANK : PRV_PAGE_CORRUPT;
+    }
+    flash->eraseCount[page] = header[1];
+    if (seq[0] == 0xFFFFFFFFUL && seq[1] == 0xFFFFFFFFUL) {
+        return PRV_PAGE_SPARE;
+    }
+    if ((seq[0] ^ seq[1]) != 0xFFFFFFFFUL) {
+        return PRV_PAGE_CORRUPT;
+    }
+    *pageSeq = seq[0];
+    return PRV_PAGE_USED;
+}
+
+/* Open spare page for records */
+static bool_t
+prv_open(CO_storageFlash_t* flash, uint8_t page) {
+    uint32_t unit[CO_STORAGE_FLASH_ALIGN / 4U];
+
+    memset(unit, 0xFF, sizeof(unit));
+    unit[0] = flash->pageSeq + 1U;
+    unit[1] = ~unit[0];
+    if (!prv_program(flash, prv_page_addr(flash, page) + CO_FLASH_PAGE_SEQ, unit, sizeof(unit))) {
+        return false;
+    }
+    flash->pageSeq++;
+    flash->head = page;
+    flash->writeAddr = prv_page_addr(flash, page) + CO_FLASH_PAGE_DATA;
+    flash->compactPending = prv_page_next(flash, page) == flash->tail;
+    return true;
+}
+
+/* Verify CRC of record */
+static bool_t
+prv_record_valid(const CO_storageFlash_t* flash, uint32_t addr, const prv_record_t* record) {
+    uint16_t crc = crc16_ccitt((const uint8_t*)record, CO_FLASH_RECORD_CRC, 0);
+    uint8_t buf[32];
+
+    addr += sizeof(prv_record_t);
+    for (uint32_t len = record->len; len > 0U;) {
+        uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+
+        if (!flash->region->read(flash->region->object, addr, buf, n)) {
+            return false;
+        }
+        crc = crc16_ccitt(buf, n, crc);
+        addr += n;
+        len -= n;
+    }
+    return crc == record->crc;
+}
+
+/*
+ * Copy live records of tail page to head page and erase tail page, one
+ * programming unit per step. Space of a record is reserved when its copy
+ * starts, the last step erases the tail page.
+ */
+static bool_t
+prv_compact_step(CO_storageFlash_t* flash) {
+    uint32_t from = prv_page_addr(flash, flash->tail);
+    uint32_t end = prv_page_addr(flash, flash->head) + flash->region->pageSize;
+    uint8_t unit[CO_STORAGE_FLASH_ALIGN];
+
+    if (flash->compactEntry == 0U && flash->compactPos == 0U) {
+        flash->compactStart = CO_CAN_CLOCK();
+    }
+    while (flash->compactEntry < flash->entriesCount) {
+        CO_storage_entry_t* entry = &flash->entries[flash->compactEntry];
+        uint32_t src = entry->recordAddr;
+
+        if (src < from || src >= from + flash->region->pageSize) {
+            flash->compactEntry++;
+            continue;
+        }
+        /* Record is copied with its sequence number, both copies are equal */
+        uint32_t size = prv_record_size(entry->len);
+
+        if (flash->compactPos == 0U) {
+            if (size > end - flash->writeAddr) {
+                return false;
+            }
+            flash->compactDst = flash->writeAddr;
+            flash->writeAddr += size;
+        }
+        if (!flash->region->read(flash->region->object, src + flash->compactPos, unit, sizeof(unit))
+            || !prv_program(flash, flash->compactDst + flash->compactPos, unit, sizeof(unit))) {
+            return false;
+        }
+        flash->compactPos += CO_STORAGE_FLASH_ALIGN;
+        if (flash->compactPos >= size) {
+            entry->recordAddr = flash->compactDst;
+            flash->compactEntry++;
+            flash->compactPos = 0U;
+        }
+        return true;
+    }
+
+    if (!prv_format(flash, flash->tail)) {
+        return false;
+    }
+    flash->tail = prv_page_next(flash, flash->tail);
+    flash->compactPending = false;
+    flash->compactEntry = 0U;
+    flash->stats.compactions++;
+    flash->stats.compactTime = CO_CAN_CLOCK() - flash->compactStart;
+    return true;
+}
+
+static bool_t
+prv_compact_finish(CO_storageFlash_t* flash) {
+    while (flash->compactPending) {
+        if (!prv_compact_step(flash)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Record is written from staging buffer, one programming unit per step.
+ * Space is reserved when it starts, a torn record is skipped on the next
+ * write and on startup.
+ */
+static bool_t
+prv_job_start(CO_storageFlash_t* flash, CO_storage_entry_t* entry, uint16_t len, uint32_t start) {
+    prv_record_t* record = &flash->jobRecord;
+    uint32_t size = prv_record_size(len);
+
+    /* Erased page must be ready, if this record opens the next page */
+    if (!prv_compact_finish(flash)) {
+        return false;
+    }
+    if (size > prv_page_addr(flash, flash->head) + flash->region->pageSize - flash->writeAddr
+        && !prv_open(flash, prv_page_next(flash, flash->head))) {
+        return false;
+    }
+
+    record->magic = CO_FLASH_RECORD_MAGIC;
+    record->len = len;
+    record->seq = ++flash->seq;
+    record->key = entry->subIndexOD;
+    record->flags = len == 0U ? CO_FLASH_RECORD_EMPTY : 0U;
+    record->crc = crc16_ccitt((const uint8_t*)record, CO_FLASH_RECORD_CRC, 0);
+    if (len > 0U) {
+        record->crc = crc16_ccitt(flash->staging, len, record->crc);
+    }
+    flash->job = entry;
+    flash->jobAddr = flash->writeAddr;
+    flash->jobPos = 0U;
+    flash->jobStart = start;
+    flash->writeAddr += size;
+    return true;
+}
+
+static bool_t
+prv_job_step(CO_storageFlash_t* flash) {
+    const prv_record_t* record = &flash->jobRecord;
+    const uint8_t* header = (const uint8_t*)record;
+    uint32_t total = sizeof(prv_record_t) + record->len;
+    uint32_t addr = flash->jobAddr + flash->jobPos;
+    uint8_t unit[CO_STORAGE_FLASH_ALIGN];
+
+    for (uint32_t i = 0U; i < CO_STORAGE_FLASH_ALIGN; i++, flash->jobPos++) {
+        uint32_t pos = flash->jobPos;
+
+        unit[i] = pos < sizeof(prv_record_t) ? header[pos]
+                  : pos < total              ? flash->staging[pos - sizeof(prv_record_t)]
+                                             : 0xFFU;
+    }
+    if (!prv_program(flash, addr, unit, sizeof(unit))) {
+        flash->job = NULL;
+        return false;
+    }
+    if (flash->jobPos >= total) {
+        flash->job->recordAddr = record->len == 0U ? 0U : flash->jobAddr;
+        flash->job = NULL;
+        flash->stats.stores++;
+        flash->stats.storeTime = CO_CAN_CLOCK() - flash->jobStart;
+        if (flash->stats.storeTime > flash->stats.storeTimeMax) {
+            flash->stats.storeTimeMax = flash->stats.storeTime;
+        }
+    }
+    return true;
+}
+
+static bool_t
+prv_job_finish(CO_storageFlash_t* flash) {
+    while (flash->job != NULL) {
+        if (!prv_job_step(flash)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Copy entry data into staging buffer, return false if it equals the newest record */
+static bool_t
+prv_snapshot(CO_storageFlash_t* flash, CO_storage_entry_t* entry) {
+    CO_LOCK_OD(flash->CANmodule);
+    memcpy(flash->staging, entry->addr, entry->len);
+    CO_UNLOCK_OD(flash->CANmodule);
+
+    if (entry->recordAddr != 0U && prv_equal(flash, entry->recordAddr + sizeof(prv_record_t), flash->staging, entry->len)) {
+        flash->stats.unchanged++;
+        return false;
+    }
+    return true;
+}
+
+/* Compare next chunk of auto entry with its newest record */
+static bool_t
+prv_auto_changed(CO_storageFlash_t* flash, CO_storage_entry_t* entry) {
+    uint8_t index = flash->autoEntry;
+    uint32_t n = entry->len - flash->autoPos;
+
+    if ((entry->attr & CO_storage_auto) == 0U || (index < 32U && (flash->autoDisabled & (1UL << index)) != 0U)) {
+        flash->autoPos = entry->len;
+        return false;
+    }
+    if (n > 32U) {
+        n = 32U;
+    }
+    /* Entry may be written meanwhile, snapshot decides */
+    if (entry->recordAddr == 0U
+        || !prv_equal(flash, entry->recordAddr + sizeof(prv_record_t) + flash->autoPos,
+                      (const uint8_t*)entry->addr + flash->autoPos, n)) {
+        flash->autoPos = entry->len;
+        return true;
+    }
+    flash->autoPos += n;
+    return false;
+}
+
+/*
+ * Function for writing data on "Store parameters" command - OD object 1010
+ *
+ * For more information see file CO_storage.h, CO_storage_entry_t.
+ *
+ * SDO server has no way to send its response later, so the record, and a
+ * pending compaction before it, are written here, outside of the time
+ * budget, and SDO response follows when they are complete. Interrupts are
+ * blocked only for the snapshot, not for flash programming.
+ */
+static ODR_t
+storeFlash(CO_storage_entry_t* entry, CO_CANmodule_t* CANmodule) {
+    CO_storageFlash_t* flash = entry->storageModule;
+    uint32_t start = CO_CAN_CLOCK();
+
+    (void)CANmodule;
+    if (!prv_job_finish(flash)) {
+        return ODR_HW;
+    }
+    if (!prv_snapshot(flash, entry)) {
+        return ODR_OK;
+    }
+    if (!prv_job_start(flash, entry, (uint16_t)entry->len, start) || !prv_job_finish(flash)) {
+        return ODR_HW;
+    }
+    return ODR_OK;
+}
+
+/*
+ * Function for restoring data on "Restore default parameters" command - OD 1011
+ *
+ * For more information see file CO_storage.h, CO_storage_entry_t.
+ */
+static ODR_t
+restoreFlash(CO_storage_entry_t* entry, CO_CANmodule_t* CANmodule) {
+    CO_storageFlash_t* flash = entry->storageModule;
+    uint8_t index = (uint8_t)(entry - flash->entries);
+
+    (void)CANmodule;
+    if (!prv_job_finish(flash)) {
+        return ODR_HW;
+    }
+    /* Auto store would write current values again, stop it until reset */
+    if (index < 32U) {
+        flash->autoDisabled |= 1UL << index;
+    }
+    if (entry->recordAddr == 0U) {
+        flash->stats.unchanged++;
+        return ODR_OK;
+    }
+    /* Empty record, default values will stay after startup */
+    if (!prv_job_start(flash, entry, 0U, CO_CAN_CLOCK()) || !prv_job_finish(flash)) {
+        return ODR_HW;
+    }
+    return ODR_OK;
+}
+
+/*
+ * Find newest records in page, return end of records
+ *
+ * Programming unit torn by power loss may not be readable, ECC error on
+ * STM32G0/G4/L4. Its record is skipped, as with wrong CRC. If the first
+ * unit of a record is torn, length is not known, but the record was the
+ * last one written, so units after it are erased.
+ */
+static uint32_t
+prv_scan(CO_storageFlash_t* flash, uint8_t page) {
+    uint32_t addr = prv_page_addr(flash, page) + CO_FLASH_PAGE_DATA;
+    uint32_t end = prv_page_addr(flash, page) + flash->region->pageSize;
+
+    while (end - addr >= sizeof(prv_record_t)) {
+        prv_record_t record;
+
+        if (!flash->region->read(flash->region->object, addr, &record, CO_STORAGE_FLASH_ALIGN)) {
+            addr += CO_STORAGE_FLASH_ALIGN;
+            continue;
+        }
+        if (record.magic != CO_FLASH_RECORD_MAGIC) {
+            /* Free space or garbage, which is not written over */
+            return prv_blank(flash, addr, CO_STORAGE_FLASH_ALIGN) ? addr : end;
+        }
+        uint32_t size = prv_record_size(record.len);
+
+        if (size > end - addr) {
+            return end;
+        }
+        /* Pages are scanned from the oldest, so the last valid record wins */
+        if (flash->region->read(flash->region->object, addr + CO_STORAGE_FLASH_ALIGN,
+                                (uint8_t*)&record + CO_STORAGE_FLASH_ALIGN, sizeof(record) - CO_STORAGE_FLASH_ALIGN)
+            && prv_record_valid(flash, addr, &record)) {
+            if ((int32_t)(record.seq - flash->seq) > 0) {
+                flash->seq = record.seq;
+            }
+            for (uint8_t i = 0U; i < flash->entriesCount; i++) {
+                CO_storage_entry_t* entry = &flash->entries[i];
+
+                if (entry->subIndexOD == record.key) {
+                    entry->recordAddr = (record.flags & CO_FLASH_RECORD_EMPTY) != 0U ? 0U : addr;
+                }
+            }
+        }
+        addr += size;
+    }
+    return addr;
+}
+
+CO_ReturnError_t
+CO_storageFlash_init(CO_storageFlash_t* storageFlash, CO_storage_t* storage, CO_CANmodule_t* CANmodule,
+                     OD_entry_t* OD_1010_StoreParameters, OD_entry_t* OD_1011_RestoreDefaultParam,
+                     const CO_storageFlash_region_t* region, CO_storage_entry_t* entries, uint8_t entriesCount,
+                     uint32_t* storageInitError) {
+    CO_ReturnError_t ret;
+
+    /* verify arguments */
+    if (storageFlash == NULL || storage == NULL || region == NULL || entries == NULL || entriesCount == 0
+        || storageInitError == NULL || region->pageCount < 2U || region->pageCount > CO_STORAGE_FLASH_PAGES_MAX
+        || (region->pageSize % CO_STORAGE_FLASH_ALIGN) != 0U || region->read == NULL || region->program == NULL
+        || region->erase == NULL) {
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+
+    /* initialize storage and OD extensions */
+    ret = CO_storage_init(storage, CANmodule, OD_1010_StoreParameters, OD_1011_RestoreDefaultParam, storeFlash,
+                          restoreFlash, entries, entriesCount);
+    if (ret != CO_ERROR_NO) {
+        return ret;
+    }
+
+    memset(storageFlash, 0, sizeof(*storageFlash));
+    storageFlash->CANmodule = CANmodule;
+    storageFlash->region = region;
+    storageFlash->entries = entries;
+    storageFlash->entriesCount = entriesCount;
+
+    /* initialize entries. Newest records of all must fit into one page,
+     * with room for two records torn by power loss during compaction. */
+    uint32_t used = CO_FLASH_PAGE_DATA;
+    uint32_t largest = 0U;
+
+    *storageInitError = 0;
+    for (uint8_t i = 0; i < entriesCount; i++) {
+        CO_storage_entry_t* entry = &entries[i];
+
+        if (entry->addr == NULL || entry->len == 0 || entry->len > CO_STORAGE_FLASH_STAGING_SIZE
+            || entry->subIndexOD < 2) {
+            *storageInitError = i;
+            return CO_ERROR_ILLEGAL_ARGUMENT;
+        }
+        entry->storageModule = storageFlash;
+        entry->recordAddr = 0;
+        used += prv_record_size(entry->len);
+        if (prv_record_size(entry->len) > largest) {
+            largest = prv_record_size(entry->len);
+        }
+    }
+    if (used + 2U * largest > region->pageSize) {
+        return CO_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* Pages in use follow each other in circular order, the newest is head */
+    prv_page_t state[CO_STORAGE_FLASH_PAGES_MAX];
+    uint32_t pageSeq[CO_STORAGE_FLASH_PAGES_MAX];
+    uint8_t inUse = 0U;
+
+    for (uint8_t page = 0U; page < region->pageCount; page++) {
+        state[page] = prv_page_state(storageFlash, page, &pageSeq[page]);
+        if (state[page] == PRV_PAGE_USED && (inUse == 0U || (int32_t)(pageSeq[page] - storageFlash->pageSeq) > 0)) {
+            storageFlash->head = page;
+            storageFlash->pageSeq = pageSeq[page];
+            inUse = 1U;
+        }
+    }
+    if (inUse > 0U) {
+        uint8_t tail = storageFlash->head;
+
+        for (;;) {
+            uint8_t prev = (uint8_t)((tail + region->pageCount - 1U) % region->pageCount);
+
+            if (prev == storageFlash->head || state[prev] != PRV_PAGE_USED || pageSeq[prev] != pageSeq[tail] - 1U) {
+                break;
+            }
+            tail = prev;
+            inUse++;
+        }
+        storageFlash->tail = tail;
+    }
+
+    /* Prepare all other pages, erase leftovers of interrupted operations */
+    for (uint8_t i = inUse; i < region->pageCount; i++) {
+        uint8_t page = (uint8_t)((storageFlash->tail + i) % region->pageCount);
+        bool_t ok = true;
+
+        if (inUse == 0U) {
+            page = i;
+        }
+        if (state[page] == PRV_PAGE_BLANK) {
+            uint32_t unit[CO_STORAGE_FLASH_ALIGN / 4U];
+
+            memset(unit, 0xFF, sizeof(unit));
+            unit[0] = CO_FLASH_PAGE_MAGIC;
+            unit[1] = 0U;
+            ok = prv_program(storageFlash, prv_page_addr(storageFlash, page), unit, sizeof(unit));
+        } else if (state[page] != PRV_PAGE_SPARE) {
+            ok = prv_format(storageFlash, page);
+        }
+        if (!ok) {
+            return CO_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    if (inUse == 0U) {
+        /* First use of the region */
+        storageFlash->tail = 0U;
+        if (!prv_open(storageFlash, 0U)) {
+            return CO_ERROR_OUT_OF_MEMORY;
+        }
+    } else {
+        for (uint8_t page = storageFlash->tail;; page = prv_page_next(storageFlash, page)) {
+            storageFlash->writeAddr = prv_scan(storageFlash, page);
+            if (page == storageFlash->head) {
+                break;
+            }
+        }
+        /* Finish interrupted compaction before anything is written */
+        storageFlash->compactPending = prv_page_next(storageFlash, storageFlash->head) == storageFlash->tail;
+        if (!prv_compact_finish(storageFlash)) {
+            return CO_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    /* Restore data of newest records */
+    for (uint8_t i = 0; i < entriesCount; i++) {
+        CO_storage_entry_t* entry = &entries[i];
+        prv_record_t record;
+
+        if (entry->recordAddr == 0U) {
+            continue;
+        }
+        if (!region->read(region->object, entry->recordAddr, &record, sizeof(record)) || record.len != entry->len
+            || !region->read(region->object, entry->recordAddr + sizeof(record), entry->addr, entry->len)) {
+            /* Record of different length, Object Dictionary has changed */
+            entry->recordAddr = 0U;
+            *storageInitError |= i < 32U ? (uint32_t)1U << i : 0x80000000UL;
+            ret = CO_ERROR_DATA_CORRUPT;
+        }
+    }
+
+    return ret;
+}
+
+bool_t
+CO_storageFlash_process(CO_storageFlash_t* storageFlash, uint32_t budget) {
+    uint32_t start = CO_CAN_CLOCK();
+    bool_t compared = false; /* All auto entries were compared in this call */
+
+    if (storageFlash == NULL || storageFlash->region == NULL) {
+        return true;
+    }
+    do {
+        if (storageFlash->job != NULL) {
+            if (!prv_job_step(storageFlash)) {
+                return false;
+            }
+        } else if (storageFlash->compactPending) {
+            if (!prv_compact_step(storageFlash)) {
+                return false;
+            }
+        } else if (!compared) {
+            CO_storage_entry_t* entry = &storageFlash->entries[storageFlash->autoEntry];
+
+            if (prv_auto_changed(storageFlash, entry) && prv_snapshot(storageFlash, entry)
+                && !prv_job_start(storageFlash, entry, (uint16_t)entry->len, CO_CAN_CLOCK())) {
+                return false;
+            }
+            if (storageFlash->autoPos >= entry->len) {
+                storageFlash->autoPos = 0U;
+                if (++storageFlash->autoEntry >= storageFlash->entriesCount) {
+                    storageFlash->autoEntry = 0U;
+                    compared = true;
+                }
+            }
+        } else {
+            break;
+        }
+    } while (CO_CAN_CLOCK() - start < budget);
+    return true;
+}
+
+#if CO_STORAGE_FLASH_SIM
+/* Count operation, return false if power is lost during it */
+static bool_t
+prv_sim_power(CO_storageFlash_sim_t* sim) {
+    sim->operations++;
+    if (sim->powerFail != 0U && --sim->powerFail == 0U) {
+        sim->powerLost = true;
+        return false;
+    }
+    return true;
+}
+
+/* Programming units of the range, which were torn */
+static bool_t
+prv_sim_torn(const CO_storageFlash_sim_t* sim, uint32_t offset, uint32_t len) {
+    for (uint32_t unit = offset / CO_STORAGE_FLASH_ALIGN; unit * CO_STORAGE_FLASH_ALIGN < offset + len; unit++) {
+        if (sim->torn[unit] != 0U) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool_t
+CO_storageFlash_simRead(void* object, uint32_t addr, void* buf, uint32_t len) {
+    CO_storageFlash_sim_t* sim = object;
+
+    if (sim->powerLost || addr < sim->base || len > sim->size || addr - sim->base > sim->size - len) {
+        return false;
+    }
+    if (prv_sim_torn(sim, addr - sim->base, len)) {
+        sim->eccErrors++;
+        return false;
+    }
+    memcpy(buf, &sim->memory[addr - sim->base], len);
+    return true;
+}
+
+bool_t
+CO_storageFlash_simProgram(void* object, uint32_t addr, const void* data, uint32_t len) {
+    CO_storageFlash_sim_t* sim = object;
+
+    if (sim->powerLost || addr < sim->base || len > sim->size || addr - sim->base > sim->size - len
+        || ((addr - sim->base) % CO_STORAGE_FLASH_ALIGN) != 0U || (len % CO_STORAGE_FLASH_ALIGN) != 0U) {
+        return false;
+    }
+    uint32_t offset = addr - sim->base;
+    uint8_t* memory = &sim->memory[offset];
+
+    /* Like STM32, only erased double words may be programmed */
+    if (prv_sim_torn(sim, offset, len)) {
+        return false;
+    }
+    for (uint32_t i = 0U; i < len; i++) {
+        if (memory[i] != 0xFFU) {
+            return false;
+        }
+    }
+    bool_t on = prv_sim_power(sim);
+    uint32_t n = on ? len : (len / CO_STORAGE_FLASH_ALIGN / 2U) * CO_STORAGE_FLASH_ALIGN;
+
+    for (uint32_t i = 0U; i < n; i++) {
+        memory[i] &= ((const uint8_t*)data)[i];
+    }
+    /* Unit being programmed, when power is lost, has no valid ECC */
+    if (!on) {
+        sim->torn[(offset + n) / CO_STORAGE_FLASH_ALIGN] = 1U;
+    }
+    return on;
+}
+
+bool_t
+CO_storageFlash_simErase(void* object, uint32_t addr) {
+    CO_storageFlash_sim_t* sim = object;
+
+    if (sim->powerLost || addr < sim->base || addr - sim->base >= sim->size
+        || ((addr - sim->base) % sim->pageSize) != 0U) {
+        return false;
+    }
+    uint32_t offset = addr - sim->base;
+    uint32_t page = offset / sim->pageSize;
+    bool_t on = prv_sim_power(sim);
+
+    /* Interrupted erase leaves the page unreadable */
+    memset(&sim->memory[offset], 0xFF, sim->pageSize);
+    memset(&sim->torn[offset / CO_STORAGE_FLASH_ALIGN], on ? 0 : 1, sim->pageSize / CO_STORAGE_FLASH_ALIGN);
+    if (page < CO_STORAGE_FLASH_PAGES_MAX) {
+        sim->erases[page]++;
+    }
+    return on;
+}
+#endif /* CO_STORAGE_FLASH_SIM */
+
+#if CO_STORAGE_FLASH_STM32
+#if defined(FLASH_FLAG_ECCD)
+static volatile bool_t prv_stm32Reading; /* Double ECC error now is in a storage read */
+static volatile bool_t prv_stm32Ecc;
+
+bool_t
+CO_storageFlash_STM32NMI(void) {
+    if (!prv_stm32Reading || !__HAL_FLASH_GET_FLAG(FLASH_FLAG_ECCD)) {
+        return false;
+    }
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ECCD);
+    prv_stm32Ecc = true;
+    return true;
+}
+#endif
+
+bool_t
+CO_storageFlash_STM32read(void* object, uint32_t addr, void* buf, uint32_t len) {
+    (void)object;
+#if defined(FLASH_FLAG_ECCD)
+    /* Torn double word raises ECCD and NMI, CO_storageFlash_STM32NMI() clears it */
+    prv_stm32Ecc = false;
+    prv_stm32Reading = true;
+    __DSB();
+    memcpy(buf, (const void*)(uintptr_t)addr, len);
+    __DSB();
+    prv_stm32Reading = false;
+    if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_ECCD)) {
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ECCD);
+        prv_stm32Ecc = true;
+    }
+    return !prv_stm32Ecc;
+#else
+    memcpy(buf, (const void*)(uintptr_t)addr, len);
+    return true;
+#endif
+}
+
+bool_t
+CO_storageFlash_STM32program(void* object, uint32_t addr, const void* data, uint32_t len) {
+    bool_t ok = HAL_FLASH_Unlock() == HAL_OK;
+
+    (void)object;
+    for (uint32_t i = 0U; ok && i < len; i += sizeof(uint64_t)) {
+        uint64_t word;
+
+        memcpy(&word, (const uint8_t*)data + i, sizeof(word));
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, addr + i, word) == HAL_OK;
+    }
+    (void)HAL_FLASH_Lock();
+    return ok;
+}
+
+bool_t
+CO_storageFlash_STM32erase(void* object, uint32_t addr) {
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t pageError = 0U;
+    uint32_t offset = addr - FLASH_BASE;
+    bool_t ok;
+
+    (void)object;
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+#if defined(FLASH_BANK_2) && defined(FLASH_BANK_SIZE)
+    erase.Banks = offset < FLASH_BANK_SIZE ? FLASH_BANK_1 : FLASH_BANK_2;
+    offset %= FLASH_BANK_SIZE;
+#elif defined(FLASH_BANK_1)
+    erase.Banks = FLASH_BANK_1;
+#endif
+    erase.Page = offset / FLASH_PAGE_SIZE;
+    erase.NbPages = 1U;
+
+    ok = HAL_FLASH_Unlock() == HAL_OK && HAL_FLASHEx_Erase(&erase, &pageError) == HAL_OK;
+    (void)HAL_FLASH_Lock();
+    return ok;
+}
+#endif /* CO_STORAGE_FLASH_STM32 */
+
+#endif /* (CO_CONFIG_STORAGE) & CO_CONFIG_STORAGE_ENABLE */
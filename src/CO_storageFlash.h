@@ -0,0 +1,273 @@
+/*
+ * CANopen data storage object in internal flash of STM32
+ *
+ * @file        CO_storageFlash.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CO_STORAGE_FLASH_H
+#define CO_STORAGE_FLASH_H
+
+#include "storage/CO_storage.h"
+
+#if ((CO_CONFIG_STORAGE)&CO_CONFIG_STORAGE_ENABLE) || defined CO_DOXYGEN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Log structured storage. Flash region of two or more pages is a circular
+ * log of records. "Store parameters" appends a record with the entry data,
+ * CRC and sequence number, only if data differs from the newest record of
+ * the entry. Pages are never erased on store: when the page being written
+ * is full, the next (erased) page is opened. When no erased page is left,
+ * live records of the oldest page are copied to the page being written and
+ * the oldest page is erased, in CO_storageFlash_process(). Startup scans
+ * the log and restores the newest record of each entry with valid CRC, so
+ * power loss at any time keeps the previous copy. Torn records, which read
+ * with an ECC error, are skipped. "Restore default
+ * parameters" appends an empty record, entry keeps its default values after
+ * the next reset.
+ *
+ * Entry data is copied into a staging buffer with CO_LOCK_OD() held, flash is
+ * programmed from the staging buffer with interrupts enabled. Entries with
+ * CO_storage_auto are stored by CO_storageFlash_process() when changed, in
+ * small steps within its time budget.
+ *
+ * "Store parameters" (0x1010) and "Restore default parameters" (0x1011)
+ * commands block: SDO server has no deferred response, so the record is
+ * written inside the SDO write, before the response. If compaction of the
+ * oldest page is in progress, it is finished first, including the page
+ * erase. CO_process() and the main loop (CANopenNode_Process()) stop for
+ * the whole time, tens of ms with the page erase on STM32G4. Use
+ * CO_storage_auto entries, where this is not acceptable.
+ *
+ * Newest records of all entries must fit into one page, together with page
+ * header and two more records of the largest entry, torn by power loss.
+ * Requires CO_CONFIG_CRC16_ENABLE in CO_CONFIG_CRC16. */
+
+/* Staging buffer, data of entry is copied into it with CO_LOCK_OD() held and
+ * written to flash from it. Must hold the largest entry. */
+#ifndef CO_STORAGE_FLASH_STAGING_SIZE
+#define CO_STORAGE_FLASH_STAGING_SIZE 512U
+#endif
+#if CO_STORAGE_FLASH_STAGING_SIZE > 0xFFFE
+#error CO_STORAGE_FLASH_STAGING_SIZE is limited by 16-bit record length
+#endif
+
+/* Flash programming unit in bytes, power of 2, 8 for double word of
+ * STM32G0/G4/L4. Records and page headers are aligned to it. */
+#ifndef CO_STORAGE_FLASH_ALIGN
+#define CO_STORAGE_FLASH_ALIGN 8U
+#endif
+#if CO_STORAGE_FLASH_ALIGN < 8 || (CO_STORAGE_FLASH_ALIGN & (CO_STORAGE_FLASH_ALIGN - 1)) != 0
+#error CO_STORAGE_FLASH_ALIGN must be power of 2, at least 8
+#endif
+
+/* Max number of pages of flash region */
+#ifndef CO_STORAGE_FLASH_PAGES_MAX
+#define CO_STORAGE_FLASH_PAGES_MAX 8U
+#endif
+
+/* Access functions of STM32 internal flash, for devices with page erase and
+ * double word programming (STM32G0/G4/L4/WB) */
+#ifndef CO_STORAGE_FLASH_STM32
+#if defined(FLASH_TYPEERASE_PAGES) && defined(FLASH_TYPEPROGRAM_DOUBLEWORD) && defined(FLASH_PAGE_NB)
+#define CO_STORAGE_FLASH_STM32 1
+#else
+#define CO_STORAGE_FLASH_STM32 0
+#endif
+#endif
+
+/* Simulated flash region in RAM, for host builds and power loss tests */
+#ifndef CO_STORAGE_FLASH_SIM
+#define CO_STORAGE_FLASH_SIM 0
+#endif
+
+/* Flash region and its access functions. Functions return false on error.
+ * Addresses and lengths of program() are aligned to CO_STORAGE_FLASH_ALIGN,
+ * program() writes erased memory only. */
+typedef struct {
+    uint32_t base;     /* Address of the first page */
+    uint32_t pageSize; /* Size of erase page */
+    uint8_t pageCount; /* Number of pages, 2 .. CO_STORAGE_FLASH_PAGES_MAX */
+    void* object;      /* Passed to functions */
+    bool_t (*read)(void* object, uint32_t addr, void* buf, uint32_t len);
+    bool_t (*program)(void* object, uint32_t addr, const void* data, uint32_t len);
+    bool_t (*erase)(void* object, uint32_t addr);
+} CO_storageFlash_region_t;
+
+/* Record header in flash, followed by data. Magic, length and sequence
+ * number are in the first programming unit, so a torn record can still be
+ * skipped. */
+typedef struct {
+    uint16_t magic;
+    uint16_t len;
+    uint32_t seq;
+    uint8_t key; /* subIndexOD of entry */
+    uint8_t flags;
+    uint16_t crc; /* CRC16-CCITT of header up to crc and data */
+} CO_storageFlash_record_t;
+
+/* Statistics, times are in CO_CAN_CLOCK() ticks */
+typedef struct {
+    uint32_t stores;       /* Records written by store and restore commands */
+    uint32_t unchanged;    /* Stores skipped, data equal to the newest record */
+    uint32_t bytes;        /* Bytes programmed, including copies and headers */
+    uint32_t compactions;  /* Pages compacted */
+    uint32_t storeTime;    /* Duration of the last record write, from snapshot to the last unit */
+    uint32_t storeTimeMax; /* Longest record write */
+    uint32_t compactTime;  /* Duration of the last compaction, from the first copy to the erase */
+} CO_storageFlash_stats_t;
+
+/* Storage object */
+typedef struct {
+    CO_CANmodule_t* CANmodule;
+    const CO_storageFlash_region_t* region;
+    CO_storage_entry_t* entries;
+    uint8_t entriesCount;
+    uint8_t head;          /* Page being written */
+    uint8_t tail;          /* Oldest page in use */
+    bool_t compactPending; /* No erased page left, compact tail */
+    uint8_t compactEntry;  /* Entry, whose record is being copied from tail */
+    uint32_t compactPos;   /* Bytes of the record copied */
+    uint32_t compactDst;   /* Flash address of the copy */
+    uint32_t compactStart; /* CO_CAN_CLOCK() of the first compaction step */
+    uint32_t writeAddr;    /* Next free address in head page */
+    uint32_t pageSeq;      /* Sequence number of head page */
+    uint32_t seq;          /* Sequence number of the newest record */
+    uint32_t eraseCount[CO_STORAGE_FLASH_PAGES_MAX]; /* Erase count of each page */
+    CO_storage_entry_t* job;          /* Entry, whose record is being written, or NULL */
+    CO_storageFlash_record_t jobRecord;
+    uint32_t jobAddr;                 /* Flash address of the record */
+    uint32_t jobPos;                  /* Bytes of the record written */
+    uint32_t jobStart;                /* CO_CAN_CLOCK() of snapshot */
+    uint8_t autoEntry;                /* Auto entry being compared with flash */
+    uint32_t autoPos;
+    uint32_t autoDisabled;            /* Entries restored to defaults, not auto stored until reset */
+    uint8_t staging[CO_STORAGE_FLASH_STAGING_SIZE];
+    CO_storageFlash_stats_t stats;
+} CO_storageFlash_t;
+
+/**
+ * Initialize data storage object in flash
+ *
+ * Formats flash region on first use, restores newest records into entries
+ * and initializes OD extensions of 0x1010 and 0x1011. Entry data length
+ * must equal the stored record length, otherwise the record is ignored.
+ * Must be called after CO_new() and before CO_CANopenInit().
+ *
+ * @param storageFlash This object will be initialized.
+ * @param storage CANopen storage object will be initialized.
+ * @param CANmodule CAN module for CO_LOCK_OD().
+ * @param OD_1010_StoreParameters OD entry for 0x1010, may be NULL.
+ * @param OD_1011_RestoreDefaultParam OD entry for 0x1011, may be NULL.
+ * @param region Flash region, must stay valid.
+ * @param entries Array of storage entries, subIndexOD of each is its key in
+ * flash, must stay valid.
+ * @param entriesCount Count of storage entries.
+ * @param [out] storageInitError If function returns CO_ERROR_DATA_CORRUPT,
+ * bit N is set for entry N, whose newest record has different length or
+ * can not be read (bit 31 for entries above 31). On
+ * CO_ERROR_ILLEGAL_ARGUMENT index of wrong entry.
+ *
+ * @return CO_ERROR_NO, CO_ERROR_DATA_CORRUPT (these entries keep default values),
+ * CO_ERROR_ILLEGAL_ARGUMENT or CO_ERROR_OUT_OF_MEMORY (entries do not fit
+ * into page or flash error).
+ */
+CO_ReturnError_t CO_storageFlash_init(CO_storageFlash_t* storageFlash, CO_storage_t* storage,
+                                      CO_CANmodule_t* CANmodule, OD_entry_t* OD_1010_StoreParameters,
+                                      OD_entry_t* OD_1011_RestoreDefaultParam,
+                                      const CO_storageFlash_region_t* region, CO_storage_entry_t* entries,
+                                      uint8_t entriesCount, uint32_t* storageInitError);
+
+/**
+ * Auto store and compaction in background
+ *
+ * Entries with CO_storage_auto attribute are compared with their newest
+ * records, a chunk at a time. Changed entry is copied into the staging
+ * buffer and written to flash one programming unit at a time, as long as
+ * the time budget allows. If no erased page is left, live records of the
+ * oldest page are copied, also one unit at a time, and the page is erased;
+ * page erase is one step and may exceed the budget. At least one step is
+ * done in every call.
+ *
+ * Must be called cyclically, from the same thread as CO_process() (which
+ * runs store commands), for example from CANopenNode_Process().
+ *
+ * @param storageFlash This object.
+ * @param budget Time for this call in CO_CAN_CLOCK() ticks.
+ *
+ * @return false on flash error.
+ */
+bool_t CO_storageFlash_process(CO_storageFlash_t* storageFlash, uint32_t budget);
+
+#if CO_STORAGE_FLASH_SIM || defined CO_DOXYGEN
+/* Flash simulated in RAM. Program may only clear bits of erased double
+ * words, like STM32 flash. After powerFail operations (if not 0) every
+ * operation fails. Operation which hits the limit is done partially and
+ * leaves torn units, like ECC of STM32G0/G4/L4: the unit being programmed
+ * or the whole page being erased fails to read until the page is erased. */
+typedef struct {
+    uint8_t* memory;       /* Simulated pages */
+    uint8_t* torn;         /* Flag per programming unit, size / CO_STORAGE_FLASH_ALIGN bytes, zeroed */
+    uint32_t base;         /* Address of memory */
+    uint32_t size;         /* Size of memory, multiple of pageSize */
+    uint32_t pageSize;
+    uint32_t powerFail;    /* Remaining operations until power loss or 0 */
+    bool_t powerLost;      /* All operations fail, until cleared */
+    uint32_t operations;   /* Program and erase operations */
+    uint32_t eccErrors;    /* Reads of torn units */
+    uint32_t erases[CO_STORAGE_FLASH_PAGES_MAX];
+} CO_storageFlash_sim_t;
+
+/* Access functions of simulated flash, object is CO_storageFlash_sim_t */
+bool_t CO_storageFlash_simRead(void* object, uint32_t addr, void* buf, uint32_t len);
+bool_t CO_storageFlash_simProgram(void* object, uint32_t addr, const void* data, uint32_t len);
+bool_t CO_storageFlash_simErase(void* object, uint32_t addr);
+#endif
+
+#if CO_STORAGE_FLASH_STM32
+/* Access functions of STM32 internal flash, object is not used. Read fails
+ * on double ECC error (FLASH_ECCR ECCD) of a double word torn by power loss,
+ * its record is skipped. ECCD also raises NMI, NMI_Handler() must pass it:
+ *
+ *     void NMI_Handler(void) {
+ *         if (CO_storageFlash_STM32NMI()) {
+ *             return;
+ *         }
+ *         ...
+ *     }
+ */
+bool_t CO_storageFlash_STM32read(void* object, uint32_t addr, void* buf, uint32_t len);
+bool_t CO_storageFlash_STM32program(void* object, uint32_t addr, const void* data, uint32_t len);
+bool_t CO_storageFlash_STM32erase(void* object, uint32_t addr);
+#if defined(FLASH_FLAG_ECCD)
+/* Returns true, if NMI is a double ECC error of CO_storageFlash_STM32read(),
+ * which is cleared */
+bool_t CO_storageFlash_STM32NMI(void);
+#endif
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* (CO_CONFIG_STORAGE) & CO_CONFIG_STORAGE_ENABLE */
+
+#endif /* CO_STORAGE_FLASH_H */
@@ -0,0 +1,99 @@
+/*
+ * Test of static memory arena: CO_new() takes exactly CO_APP_ARENA_NEED()
+ * bytes for the Object Dictionary of each port, so the arena sized from
+ * OD_CNT_* and CO_CONFIG_* fits with nothing to spare. Initialization again
+ * starts from the beginning of the arena.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#ifdef CO_MULTIPLE_OD
+#define TEST_PORTS 2U
+#else
+#define TEST_PORTS 1U
+#endif
+
+static CAN_HandleTypeDef prv_hcan[TEST_PORTS];
+static TIM_HandleTypeDef prv_htim[TEST_PORTS];
+static CANopenNodeHandle prv_node[TEST_PORTS];
+
+static void
+prv_can1_init(void) {
+    HAL_CAN_Init(&prv_hcan[0]);
+}
+
+#ifdef CO_MULTIPLE_OD
+static void
+prv_can2_init(void) {
+    HAL_CAN_Init(&prv_hcan[1]);
+}
+#endif
+
+int
+main(void) {
+#ifdef CO_MULTIPLE_OD
+    static void (*const canInit[TEST_PORTS])(void) = {prv_can1_init, prv_can2_init};
+    CAN_TypeDef* const instance[TEST_PORTS] = {CAN1, CAN2};
+    const size_t need[TEST_PORTS] = {CO_APP_ARENA_NEED(OD1), CO_APP_ARENA_NEED(OD2)};
+#else
+    static void (*const canInit[TEST_PORTS])(void) = {prv_can1_init};
+    CAN_TypeDef* const instance[TEST_PORTS] = {CAN1};
+    const size_t need[TEST_PORTS] = {CO_APP_ARENA_NEED(OD)};
+#endif
+
+    co_sim_reset();
+    OD_sim_defaults();
+    for (uint32_t i = 0U; i < TEST_PORTS; i++) {
+        CO_t* co;
+
+        co_sim_can_handle(&prv_hcan[i], instance[i], 500U);
+        co_sim_can_bind(&prv_hcan[i], 1U);
+        prv_htim[i].Instance = i == 0U ? TIM3 : TIM4;
+        prv_htim[i].Init.Prescaler = 83U; /* 1 MHz */
+        prv_htim[i].Init.Period = 999U;
+        HAL_TIM_Base_Init(&prv_htim[i]);
+        co_sim_tim_bind(&prv_htim[i], 2U);
+
+        prv_node[i].desiredNodeID = (uint8_t)(5U + i);
+        prv_node[i].baudrate = 500U;
+        prv_node[i].CANHandle = &prv_hcan[i];
+        prv_node[i].CANInitFunction = canInit[i];
+        prv_node[i].timerHandle = &prv_htim[i];
+        /* Returns 0 from CANopenNode_ResetCommunication() on success */
+        TEST_CHECK(CANopenNode_Init(&prv_node[i]) == 0, "port %u: CANopenNode_Init failed", (unsigned)i);
+        TEST_CHECK(prv_node[i].canOpen_HeapMemoryUsed == need[i], "port %u: CO_new() took %u bytes, expected %u",
+                   (unsigned)i, (unsigned)prv_node[i].canOpen_HeapMemoryUsed, (unsigned)need[i]);
+
+        /* Same objects again */
+        co = prv_node[i].canOpen_Obj;
+        TEST_CHECK(CANopenNode_Init(&prv_node[i]) == 0, "port %u: second CANopenNode_Init failed", (unsigned)i);
+        TEST_CHECK(prv_node[i].canOpen_Obj == co && prv_node[i].canOpen_HeapMemoryUsed == need[i],
+                   "port %u: second CO_new() took %u bytes", (unsigned)i,
+                   (unsigned)prv_node[i].canOpen_HeapMemoryUsed);
+    }
+#ifdef CO_MULTIPLE_OD
+    TEST_CHECK(prv_node[0].canOpen_Obj != prv_node[1].canOpen_Obj, "ports share the arena");
+#endif
+
+    return co_test_result("arena");
+}
@@ -0,0 +1,82 @@
+/*
+ * Test of NVIC priority checks with CO_LOCK_PRIORITY: initialization fails,
+ * if CAN or CANopen timer interrupt is more urgent than the lock priority, so
+ * CO_LOCK_ENTER() would not mask it, and succeeds at the lock priority.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#define TEST_NODE_ID 5U
+
+static TIM_HandleTypeDef prv_htim;
+static CANopenNodeHandle prv_node;
+static uint32_t prv_rx1Priority; /* Set by "MSP init" of CAN */
+
+void
+HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim) {
+    CANopenNode_TimerIRQ(htim);
+}
+
+static void
+prv_can_init(void) {
+    co_test_can_init();
+    HAL_NVIC_SetPriority(CAN1_RX1_IRQn, prv_rx1Priority, 0U);
+}
+
+/* Node initialization with given priorities of CAN FIFO1 line and timer */
+static CO_app_Status
+prv_init(uint32_t rx1Priority, uint32_t timerPriority) {
+    prv_rx1Priority = rx1Priority;
+    co_sim_tim_bind(&prv_htim, timerPriority);
+    return CANopenNode_Init(&prv_node);
+}
+
+int
+main(void) {
+    CO_app_Status status;
+
+    co_sim_reset();
+    OD_sim_defaults();
+    co_sim_can_handle(&co_test_hcan, CAN1, 500U);
+    co_sim_can_bind(&co_test_hcan, CO_CAN_IRQ_PRIORITY);
+    prv_htim.Instance = TIM2;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 0xFFFFFFFFU;
+    HAL_TIM_Base_Init(&prv_htim);
+
+    prv_node.desiredNodeID = TEST_NODE_ID;
+    prv_node.baudrate = 500U;
+    prv_node.CANHandle = &co_test_hcan;
+    prv_node.CANInitFunction = prv_can_init;
+    prv_node.timerHandle = &prv_htim;
+
+    /* Returns 0 from CANopenNode_ResetCommunication() on success */
+    status = prv_init(CO_LOCK_PRIORITY - 1U, CO_TIMER_IRQ_PRIORITY);
+    TEST_CHECK(status != 0, "CAN interrupt above lock priority accepted");
+    status = prv_init(CO_CAN_IRQ_PRIORITY, CO_LOCK_PRIORITY - 1U);
+    TEST_CHECK(status != 0, "timer interrupt above lock priority accepted");
+    status = prv_init(CO_LOCK_PRIORITY, CO_LOCK_PRIORITY);
+    TEST_CHECK(status == 0, "initialization at lock priority failed: %d", (int)status);
+
+    return co_test_result("lock priority");
+}
@@ -0,0 +1,160 @@
+/*
+ * Test of double buffered process image: RPDO data reaches the inputs
+ * snapshot, published outputs reach the next synchronous TPDO, a held
+ * snapshot does not change while CANopenNode_IRQ() runs and inputs are
+ * gathered only after SYNC or received frames.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#define TEST_NODE_ID 5U
+
+static TIM_HandleTypeDef prv_htim;
+static CANopenNodeHandle prv_node;
+static uint8_t prv_tpdo[8];
+static uint32_t prv_tpdoCount;
+
+static CO_app_PIentry_t prv_inEntries[1];
+static CO_app_PIentry_t prv_outEntries[1];
+static uint8_t prv_inBuffer[2][8];
+static uint8_t prv_outBuffer[2][8];
+static CO_app_PI_t prv_piIn = {prv_inEntries, 1U, {prv_inBuffer[0], prv_inBuffer[1]}, 0U, 0xFFU, false};
+static CO_app_PI_t prv_piOut = {prv_outEntries, 1U, {prv_outBuffer[0], prv_outBuffer[1]}, 0U, 0xFFU, false};
+
+void
+HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    if (htim == &prv_htim) {
+        CANopenNode_IRQ(&prv_node);
+    }
+}
+
+static void
+prv_monitor(void* object, const co_sim_frame_t* frame, uint64_t sof_ns, uint64_t eof_ns, int source) {
+    if (source == 0 && frame->id == 0x180U + TEST_NODE_ID) {
+        memcpy(prv_tpdo, frame->data, sizeof(prv_tpdo));
+        prv_tpdoCount++;
+    }
+}
+
+static void
+prv_inject(uint16_t id, uint8_t dlc, uint8_t byte0, uint8_t byte1) {
+    co_sim_frame_t frame = {id, 0U, dlc, {byte0, byte1}};
+
+    co_sim_bus_inject(&frame, co_sim_now_ns());
+}
+
+/* Run main loop for given time */
+static void
+prv_run(uint32_t ms) {
+    uint64_t end = co_sim_now_ns() + (uint64_t)ms * 1000000U;
+
+    while (co_sim_now_ns() < end) {
+        CANopenNode_Process(&prv_node);
+        co_sim_run_until(co_sim_now_ns() + 100000U);
+    }
+}
+
+int
+main(void) {
+    OD_PERSIST_COMM_t* comm = OD->persistComm;
+    const uint8_t* inputs;
+
+    co_sim_reset();
+    OD_sim_defaults();
+    /* Event driven RPDOs, synchronous TPDOs */
+    for (uint8_t i = 0U; i < OD_CNT_RPDO; i++) {
+        comm->x1400_RPDOCommunicationParameter[i].transmissionType = 254U;
+    }
+    for (uint8_t i = 0U; i < OD_CNT_TPDO; i++) {
+        comm->x1800_TPDOCommunicationParameter[i].transmissionType = 1U;
+    }
+    prv_inEntries[0].odVariable = &OD_RAM.x6200_writeOutput8Bit[0];
+    prv_inEntries[0].length = 8U;
+    prv_outEntries[0].odVariable = &OD_RAM.x6000_readInput8Bit[0];
+    prv_outEntries[0].length = 8U;
+
+    co_sim_can_handle(&co_test_hcan, CAN1, 500U);
+    co_sim_can_bind(&co_test_hcan, 1U);
+    co_sim_bus_monitor(prv_monitor, NULL);
+    prv_htim.Instance = TIM3;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 999U;
+    HAL_TIM_Base_Init(&prv_htim);
+    co_sim_tim_bind(&prv_htim, 2U);
+
+    prv_node.desiredNodeID = TEST_NODE_ID;
+    prv_node.baudrate = 500U;
+    prv_node.CANHandle = &co_test_hcan;
+    prv_node.CANInitFunction = co_test_can_init;
+    prv_node.timerHandle = &prv_htim;
+    prv_node.piInputs = &prv_piIn;
+    prv_node.piOutputs = &prv_piOut;
+    /* Returns 0 from CANopenNode_ResetCommunication() on success */
+    if (CANopenNode_Init(&prv_node) != 0) {
+        printf("FAIL: CANopenNode_Init\n");
+        return 1;
+    }
+    prv_inject(0x000U, 2U, CO_NMT_ENTER_OPERATIONAL, 0U);
+    prv_run(5U);
+
+    /* RPDO data in the next snapshot */
+    prv_inject(0x200U + TEST_NODE_ID, 8U, 0x11U, 0xEEU);
+    prv_run(3U);
+    inputs = CANopenNode_PI_acquireInputs(&prv_node);
+    TEST_CHECK(inputs[0] == 0x11U && inputs[1] == 0xEEU, "inputs %02X %02X", inputs[0], inputs[1]);
+
+    /* Held snapshot stays, while newer data is received */
+    prv_inject(0x200U + TEST_NODE_ID, 8U, 0x22U, 0xDDU);
+    prv_run(3U);
+    TEST_CHECK(inputs[0] == 0x11U, "held inputs changed to %02X", inputs[0]);
+    CANopenNode_PI_releaseInputs(&prv_node);
+    prv_run(2U);
+    inputs = CANopenNode_PI_acquireInputs(&prv_node);
+    TEST_CHECK(inputs[0] == 0x22U, "inputs after release %02X", inputs[0]);
+    CANopenNode_PI_releaseInputs(&prv_node);
+
+    /* Inputs are gathered only after SYNC or a received frame, not from
+     * Object Dictionary written by SDO meanwhile */
+    OD_RAM.x6200_writeOutput8Bit[0] = 0x33U;
+    prv_run(3U);
+    inputs = CANopenNode_PI_acquireInputs(&prv_node);
+    TEST_CHECK(inputs[0] == 0x22U, "inputs gathered without SYNC or RPDO: %02X", inputs[0]);
+    CANopenNode_PI_releaseInputs(&prv_node);
+
+    /* Published outputs go with the next SYNC */
+    memset(CANopenNode_PI_outputs(&prv_node), 0x5A, 8U);
+    CANopenNode_PI_publishOutputs(&prv_node);
+    prv_run(2U);
+    prv_tpdoCount = 0U;
+    prv_inject(0x080U, 0U, 0U, 0U);
+    prv_run(3U);
+    TEST_CHECK(CANopenNode_is_operational(&prv_node), "node is not operational");
+    TEST_CHECK(prv_tpdoCount == 1U, "%u TPDOs after SYNC", (unsigned)prv_tpdoCount);
+    TEST_CHECK(prv_tpdo[0] == 0x5AU && prv_tpdo[7] == 0x5AU, "TPDO data %02X .. %02X", prv_tpdo[0], prv_tpdo[7]);
+    inputs = CANopenNode_PI_acquireInputs(&prv_node);
+    TEST_CHECK(inputs[0] == 0x33U, "inputs after SYNC %02X", inputs[0]);
+    CANopenNode_PI_releaseInputs(&prv_node);
+
+    return co_test_result("process image");
+}
@@ -0,0 +1,170 @@
+/*
+ * Test of receive timestamps in tickless mode: SYNC timer and heartbeat
+ * consumer timer count from start of the received frame, not from its
+ * processing, and their timeouts fire at reception plus timeout.
+ *
+ * bxCAN runs in Time Triggered Communication Mode, so frames carry the
+ * hardware timestamp. Processing of a frame comes after its end, about
+ * 100 us after its start at 500 kbit/s.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#define TEST_NODE_ID  5U
+#define TEST_HB_NODE  0x10U
+#define TEST_HB_MS    50U
+#define TEST_SYNC_US  10000U
+#define TEST_TOLERANCE_US 10U /* Timestamp counts 2 us bit times */
+
+static TIM_HandleTypeDef prv_htim;
+static CANopenNodeHandle prv_node;
+static uint64_t prv_syncSof;
+static uint64_t prv_hbSof;
+
+void
+HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim) {
+    if (htim == &prv_htim) {
+        CANopenNode_IRQ(&prv_node);
+    }
+}
+
+static void
+prv_monitor(void* object, const co_sim_frame_t* frame, uint64_t sof_ns, uint64_t eof_ns, int source) {
+    if (source != CO_SIM_EXTERNAL) {
+        return;
+    }
+    if (frame->id == 0x080U) {
+        prv_syncSof = sof_ns;
+    } else if (frame->id == 0x700U + TEST_HB_NODE) {
+        prv_hbSof = sof_ns;
+    }
+}
+
+static void
+prv_inject(uint16_t id, uint8_t dlc, uint8_t byte0, uint64_t at) {
+    co_sim_frame_t frame = {id, 0U, dlc, {byte0}};
+
+    co_sim_bus_inject(&frame, at);
+}
+
+/* Tickless main loop until time or until done() returns true, returns time
+ * of the call after which done() was true */
+static uint64_t
+prv_run(uint64_t end, bool (*done)(void)) {
+    while (co_sim_now_ns() < end) {
+        CANopenNode_Process(&prv_node);
+        if (done != NULL && done()) {
+            return co_sim_now_ns();
+        }
+        CANopenNode_Sleep(&prv_node);
+    }
+    return 0U;
+}
+
+static bool
+prv_hb_timeout(void) {
+    return prv_node.canOpen_Obj->HBcons->timeouts != 0U;
+}
+
+static bool
+prv_sync_timeout(void) {
+    return prv_node.canOpen_Obj->SYNC->timeoutError;
+}
+
+/* Microseconds from start of frame to now */
+static int64_t
+prv_age_us(uint64_t sof) {
+    return (int64_t)(co_sim_now_ns() - sof) / 1000;
+}
+
+int
+main(void) {
+    OD_PERSIST_COMM_t* comm = OD->persistComm;
+    uint64_t t;
+    int64_t expected;
+    uint32_t timer;
+
+    co_sim_reset();
+    OD_sim_defaults();
+    comm->x1006_communicationCyclePeriod = TEST_SYNC_US;
+    comm->x1016_consumerHeartbeatTime[0] = ((uint32_t)TEST_HB_NODE << 16) | TEST_HB_MS;
+
+    co_sim_can_handle(&co_test_hcan, CAN1, 500U);
+    co_test_hcan.Init.TimeTriggeredMode = ENABLE;
+    co_sim_can_bind(&co_test_hcan, 1U);
+    co_sim_bus_monitor(prv_monitor, NULL);
+    prv_htim.Instance = TIM2;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 0xFFFFFFFFU;
+    HAL_TIM_Base_Init(&prv_htim);
+    co_sim_tim_bind(&prv_htim, 2U);
+
+    prv_node.desiredNodeID = TEST_NODE_ID;
+    prv_node.baudrate = 500U;
+    prv_node.CANHandle = &co_test_hcan;
+    prv_node.CANInitFunction = co_test_can_init;
+    prv_node.timerHandle = &prv_htim;
+    /* Returns 0 from CANopenNode_ResetCommunication() on success */
+    if (CANopenNode_Init(&prv_node) != 0) {
+        printf("FAIL: CANopenNode_Init\n");
+        return 1;
+    }
+    prv_inject(0x000U, 2U, CO_NMT_ENTER_OPERATIONAL, co_sim_now_ns());
+
+    /* SYNC and heartbeat at odd phases, timestamps settle with a few frames.
+     * Main loop sleeps until the next frame or deadline, so frames go on
+     * for one more period. */
+    t = co_sim_now_ns();
+    for (uint32_t i = 0U; i < 21U; i++) {
+        prv_inject(0x080U, 0U, 0U, t + i * TEST_SYNC_US * 1000U + 1234567U);
+        prv_inject((uint16_t)(0x700U + TEST_HB_NODE), 1U, CO_NMT_OPERATIONAL, t + i * TEST_SYNC_US * 1000U + 3456789U);
+    }
+    prv_run(t + 20U * TEST_SYNC_US * 1000U, NULL);
+    TEST_CHECK(CANopenNode_is_operational(&prv_node), "node is not operational");
+    TEST_CHECK(!prv_hb_timeout() && !prv_sync_timeout(), "heartbeat or SYNC timeout");
+
+    /* Timers equal the age of the last frame, once the stack got the time */
+    CANopenNode_IRQ(&prv_node);
+    timer = prv_node.canOpen_Obj->SYNC->timer;
+    expected = prv_age_us(prv_syncSof);
+    TEST_CHECK(llabs((int64_t)timer - expected) <= TEST_TOLERANCE_US, "SYNC timer %u us, SYNC %lld us ago",
+               (unsigned)timer, (long long)expected);
+    CANopenNode_Process(&prv_node);
+    timer = prv_node.canOpen_Obj->HBcons->monitoredNodes[0].timeoutTimer;
+    expected = prv_age_us(prv_hbSof);
+    TEST_CHECK(llabs((int64_t)timer - expected) <= TEST_TOLERANCE_US, "heartbeat timer %u us, heartbeat %lld us ago",
+               (unsigned)timer, (long long)expected);
+
+    /* Timeouts from reception, no time lost in the split */
+    t = prv_run(co_sim_now_ns() + 100000000U, prv_sync_timeout);
+    expected = (int64_t)(t - prv_syncSof) / 1000 - (TEST_SYNC_US + TEST_SYNC_US / 2U);
+    TEST_CHECK(t != 0U && expected >= -(int64_t)TEST_TOLERANCE_US && expected <= TEST_TOLERANCE_US,
+               "SYNC timeout %lld us late", (long long)expected);
+    t = prv_run(co_sim_now_ns() + 100000000U, prv_hb_timeout);
+    expected = (int64_t)(t - prv_hbSof) / 1000 - TEST_HB_MS * 1000;
+    TEST_CHECK(t != 0U && expected >= -(int64_t)TEST_TOLERANCE_US && expected <= TEST_TOLERANCE_US,
+               "heartbeat timeout %lld us late", (long long)expected);
+
+    return co_test_result("receive timestamps");
+}
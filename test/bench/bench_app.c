@@ -0,0 +1,273 @@
+/*
+ * Benchmark of CANopen node on simulated bxCAN and 1 ms timer: cost of
+ * CANopenNode_IRQ() from timer interrupt, CANopenNode_Process() from main
+ * loop and CAN interrupts, with SYNC, RPDO and heartbeat traffic on the bus.
+ *
+ * With CO_APP_TICKLESS, timer is free running 32-bit TIM2, main loop sleeps
+ * in CANopenNode_Sleep() and the number of wake-ups and idle time, which the
+ * node counts in sleepTime_us, are reported. Each interrupt and each
+ * CANopenNode_Process() take a fixed virtual CPU time for it.
+ *
+ * Costs are host time without the simulator, see bench_driver.c.
+ *
+ * With CO_CAN_TX_LATENCY, transmit latency histograms of the driver are
+ * dumped per function code. Latency is virtual time from CO_CANsend() to
+ * transmit interrupt, so it shows the wait in software backlog and mailbox
+ * on the simulated bus, not CPU cost.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_sim.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#define BENCH_NODE_ID    5U
+#define BENCH_HB_NODE    0x10U
+#define BENCH_SYNC_US    10000U /* SYNC period */
+#define BENCH_LOOP_US    100U   /* Main loop period */
+#define BENCH_IRQ_NS     2000U  /* Virtual CPU time of an interrupt */
+#define BENCH_PROCESS_NS 10000U /* Virtual CPU time of CANopenNode_Process() */
+
+static uint32_t prv_ms = 10000U;
+static uint32_t prv_injectMs; /* Traffic is put on the bus up to this time */
+static CAN_HandleTypeDef prv_hcan;
+static TIM_HandleTypeDef prv_htim;
+static CANopenNodeHandle prv_node;
+
+#if CO_APP_TICKLESS
+void
+HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim) {
+    if (htim == &prv_htim) {
+        CANopenNode_IRQ(&prv_node);
+    }
+}
+#else
+void
+HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    if (htim == &prv_htim) {
+        CANopenNode_IRQ(&prv_node);
+    }
+}
+#endif
+
+static void
+prv_can_init(void) {
+    HAL_CAN_Init(&prv_hcan);
+}
+
+static void
+prv_inject(uint16_t id, uint8_t dlc, uint8_t byte0, uint8_t byte1, uint64_t at) {
+    co_sim_frame_t frame = {id, 0U, dlc, {byte0, byte1}};
+
+    if (!co_sim_bus_inject(&frame, at)) {
+        fprintf(stderr, "bus injection queue is full\n");
+        exit(1);
+    }
+}
+
+/* RPDO every millisecond, SYNC and heartbeat of the monitored node, some
+ * hundred frames ahead of virtual time */
+static void
+prv_feed(void) {
+    while (prv_injectMs < prv_ms && co_sim_bus_injected() < 512U) {
+        uint32_t ms = prv_injectMs++;
+        uint64_t t = (uint64_t)ms * 1000000U;
+
+        prv_inject((uint16_t)(0x200U + BENCH_NODE_ID), 8U, (uint8_t)ms, 0U, t + 100000U);
+        if ((ms * 1000U) % BENCH_SYNC_US == 0U) {
+            prv_inject(0x080U, 0U, 0U, 0U, t + 300000U);
+        }
+        if (ms % 100U == 0U) {
+            prv_inject((uint16_t)(0x700U + BENCH_HB_NODE), 1U, CO_NMT_OPERATIONAL, 0U, t + 500000U);
+        }
+    }
+}
+
+static uint64_t
+prv_cpu_ns(void) {
+    return co_sim_host_ns() - co_sim_overhead_ns();
+}
+
+#if CO_CAN_TX_LATENCY
+/* Function codes, COB-ID >> 7 */
+static const char* const prv_classNames[CO_CAN_TX_LATENCY_CLASSES] = {
+    "NMT",  "SYNC/EMCY", "TIME",  "TPDO1", "RPDO1", "TPDO2",     "RPDO2", "TPDO3",
+    "RPDO3", "TPDO4",    "RPDO4", "SDO tx", "SDO rx", "0x680",   "HB",    "0x780",
+};
+
+/* Histograms of all function codes with frames, returns number of frames */
+static uint32_t
+prv_print_tx_latency(const CO_CANmodule_t* CANmodule) {
+    double us = 1e6 / SystemCoreClock;
+    uint32_t frames = 0U;
+
+    printf("TX latency, CO_CANsend() to transmit interrupt, buckets of %.1f us doubling:\n",
+           (1U << CO_CAN_TX_LATENCY_SHIFT) * us);
+    for (uint8_t c = 0U; c < CO_CAN_TX_LATENCY_CLASSES; c++) {
+        const CO_CANtxLatency_t* latency = &CANmodule->txLatency[c];
+        uint32_t count = 0U;
+
+        for (uint8_t b = 0U; b < CO_CAN_TX_LATENCY_BUCKETS; b++) {
+            count += latency->bucket[b];
+        }
+        if (count == 0U) {
+            continue;
+        }
+        frames += count;
+        printf("%-15s %7u frames, max %8.1f us:", prv_classNames[c], (unsigned)count, latency->max * us);
+        for (uint8_t b = 0U; b < CO_CAN_TX_LATENCY_BUCKETS; b++) {
+            if (latency->bucket[b] == 0U) {
+                continue;
+            }
+            if (b == CO_CAN_TX_LATENCY_BUCKETS - 1U) {
+                printf(" >=%.0f us %u", (1U << (CO_CAN_TX_LATENCY_SHIFT + b - 1U)) * us, (unsigned)latency->bucket[b]);
+            } else {
+                printf(" <%.0f us %u", (1U << (CO_CAN_TX_LATENCY_SHIFT + b)) * us, (unsigned)latency->bucket[b]);
+            }
+        }
+        printf("\n");
+    }
+    return frames;
+}
+#endif
+
+static void
+prv_print_irq(const char* name, IRQn_Type irq) {
+    const co_sim_irq_stats_t* stats = co_sim_irq_stats(irq);
+
+    printf("%-15s %7u calls, %7.1f ns/call, 99.9 %% %6u ns, max %7.1f ns\n", name, (unsigned)stats->count,
+           stats->count > 0U ? (double)stats->host_ns / stats->count : 0.0,
+           (unsigned)co_sim_irq_percentile_ns(irq, 0.999), (double)stats->host_ns_max);
+}
+
+int
+main(int argc, char* argv[]) {
+    OD_PERSIST_COMM_t* comm = OD->persistComm;
+    uint64_t process = 0U;
+    uint64_t processMax = 0U;
+    uint32_t processCount = 0U;
+    uint64_t end;
+
+    if (argc > 1) {
+        prv_ms = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+
+    /* Synchronous TPDOs, event driven RPDOs, one monitored node */
+    co_sim_reset();
+    co_sim_irq_cost_ns = BENCH_IRQ_NS;
+    OD_sim_defaults();
+    comm->x1006_communicationCyclePeriod = BENCH_SYNC_US;
+    comm->x1016_consumerHeartbeatTime[0] = ((uint32_t)BENCH_HB_NODE << 16) | 500U;
+    for (uint8_t i = 0U; i < OD_CNT_TPDO; i++) {
+        comm->x1800_TPDOCommunicationParameter[i].transmissionType = 1U;
+    }
+
+    co_sim_can_handle(&prv_hcan, CAN1, 500U);
+    co_sim_can_bind(&prv_hcan, 1U);
+#if CO_APP_TICKLESS
+    prv_htim.Instance = TIM2;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 0xFFFFFFFFU;
+#else
+    prv_htim.Instance = TIM3;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 999U;
+#endif
+    HAL_TIM_Base_Init(&prv_htim);
+    co_sim_tim_bind(&prv_htim, 2U);
+
+    prv_node.desiredNodeID = BENCH_NODE_ID;
+    prv_node.baudrate = 500U;
+    prv_node.CANHandle = &prv_hcan;
+    prv_node.CANInitFunction = prv_can_init;
+    prv_node.timerHandle = &prv_htim;
+    /* Returns 0 from CANopenNode_ResetCommunication() on success */
+    if (CANopenNode_Init(&prv_node) != 0) {
+        fprintf(stderr, "CANopenNode_Init failed\n");
+        return 1;
+    }
+    prv_inject(0x000U, 2U, CO_NMT_ENTER_OPERATIONAL, 0U, 0U);
+    co_sim_irq_stats_clear();
+
+    end = (uint64_t)prv_ms * 1000000U;
+    while (co_sim_now_ns() < end) {
+        uint64_t start = prv_cpu_ns();
+        uint64_t elapsed;
+
+        prv_feed();
+        CANopenNode_Process(&prv_node);
+        elapsed = prv_cpu_ns() - start;
+        process += elapsed;
+        processMax = elapsed > processMax ? elapsed : processMax;
+        processCount++;
+        co_sim_busy(BENCH_PROCESS_NS);
+#if CO_APP_TICKLESS
+        CANopenNode_Sleep(&prv_node);
+#else
+        co_sim_run_until(co_sim_now_ns() + BENCH_LOOP_US * 1000U);
+#endif
+    }
+
+    if (!CANopenNode_is_operational(&prv_node)) {
+        fprintf(stderr, "node is not operational\n");
+        return 1;
+    }
+    if (prv_node.canOpen_Obj->HBcons->timeouts != 0U || prv_node.canOpen_Obj->SYNC->timeoutError) {
+        fprintf(stderr, "heartbeat or SYNC timeout\n");
+        return 1;
+    }
+    printf("CANopen node: deferred %d, tickless %d, %u ms, SYNC %u us, %u frames received, %u sent\n",
+           CO_CAN_RX_DEFERRED, CO_APP_TICKLESS, (unsigned)prv_ms, BENCH_SYNC_US, (unsigned)co_sim_can_stats(0)->rx,
+           (unsigned)co_sim_can_stats(0)->tx);
+#if CO_APP_TICKLESS
+    /* Idle time as the node measures it in CANopenNode_Sleep(), the last
+     * sleep may end after the run time */
+    uint64_t elapsed_us = co_sim_now_ns() / 1000U;
+    if (prv_node.sleepTime_us == 0U || prv_node.sleepTime_us > elapsed_us) {
+        fprintf(stderr, "idle %u us in %u us\n", (unsigned)prv_node.sleepTime_us, (unsigned)elapsed_us);
+        return 1;
+    }
+    printf("main loop: %u wake-ups, %.1f per second, idle %.1f ms, %.1f %% of time\n",
+           (unsigned)prv_node.sleepCount, prv_node.sleepCount * 1000.0 / prv_ms, prv_node.sleepTime_us * 1e-3,
+           prv_node.sleepTime_us * 100.0 / elapsed_us);
+    prv_print_irq("CANopenNode_IRQ", TIM2_IRQn);
+#else
+    printf("main loop: every %u us, %u polls, idle 0.0 ms, 0.0 %% of time\n", BENCH_LOOP_US,
+           (unsigned)processCount);
+    prv_print_irq("CANopenNode_IRQ", TIM3_IRQn);
+#endif
+    printf("%-15s %7u calls, %7.1f ns/call, %18s max %7.1f ns\n", "Process", (unsigned)processCount,
+           (double)process / processCount, "", (double)processMax);
+    prv_print_irq("CAN RX0", CAN1_RX0_IRQn);
+    prv_print_irq("CAN RX1", CAN1_RX1_IRQn);
+    prv_print_irq("CAN TX", CAN1_TX_IRQn);
+#if CO_CAN_TX_LATENCY
+    /* Every frame on the bus must be in a histogram, except those still in
+     * the mailboxes */
+    uint32_t frames = prv_print_tx_latency(prv_node.canOpen_Obj->CANmodule);
+    if (frames > co_sim_can_stats(0)->tx || frames + 3U < co_sim_can_stats(0)->tx) {
+        fprintf(stderr, "%u frames in TX latency histograms, %u sent\n", (unsigned)frames,
+                (unsigned)co_sim_can_stats(0)->tx);
+        return 1;
+    }
+#endif
+    return 0;
+}
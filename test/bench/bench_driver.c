@@ -0,0 +1,210 @@
+/*
+ * Benchmark of CAN driver on simulated bxCAN: receive dispatch, transmit
+ * enqueue and transmit complete refill.
+ *
+ * Costs are host time of the driver code, measured around each call or
+ * interrupt, without the simulator overhead of register accesses and
+ * interrupt dispatch. Cycles are host CPU cycles at its nominal clock.
+ * Numbers compare driver configurations with each other, they are not
+ * Cortex-M cycles.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_sim.h"
+#include "CO_app_STM32.h"
+
+#define BENCH_RX_MAX  256U
+#define BENCH_TX_SIZE 32U
+
+static uint32_t prv_frames = 100000U;
+static CAN_HandleTypeDef prv_hcan;
+static CANopenNodeHandle prv_node;
+static CO_CANmodule_t prv_module;
+static CO_CANrx_t prv_rx[BENCH_RX_MAX];
+static CO_CANtx_t prv_tx[BENCH_TX_SIZE];
+static uint16_t prv_ident[BENCH_RX_MAX];
+static uint32_t prv_received;
+
+/* CAN interrupts go straight to the driver, see CAN_OPEN_NODE_CALLBACKS_OVERRIDE */
+void
+HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_RX(&prv_module, CAN_RX_FIFO0);
+}
+
+void
+HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_RX(&prv_module, CAN_RX_FIFO1);
+}
+
+void
+HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX0);
+}
+
+void
+HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX1);
+}
+
+void
+HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX2);
+}
+
+static void
+prv_can_init(void) {
+    HAL_CAN_Init(&prv_hcan);
+}
+
+/* Receive callback with work of a CANopen object, argv[2] iterations */
+static uint32_t prv_callbackWork;
+
+static void
+prv_rx_callback(void* object, void* message) {
+    volatile uint32_t work = 0U;
+
+    for (uint32_t i = 0U; i < prv_callbackWork; i++) {
+        work += i;
+    }
+    (*(uint32_t*)object)++;
+}
+
+/* Receive buffers of a CANopen node: PDOs, SDO and heartbeat consumers */
+static void
+prv_setup(uint16_t rxSize) {
+    static const uint16_t base[5] = {0x180U, 0x200U, 0x280U, 0x300U, 0x700U};
+
+    co_sim_reset();
+    co_sim_can_handle(&prv_hcan, CAN1, 500U);
+    co_sim_can_bind(&prv_hcan, 1U);
+    memset(&prv_node, 0, sizeof(prv_node));
+    prv_node.CANHandle = &prv_hcan;
+    prv_node.CANInitFunction = prv_can_init;
+    if (CO_CANmodule_init(&prv_module, &prv_node, prv_rx, rxSize, prv_tx, BENCH_TX_SIZE, 500U) != CO_ERROR_NO) {
+        fprintf(stderr, "CO_CANmodule_init failed\n");
+        exit(1);
+    }
+    for (uint16_t i = 0U; i < rxSize; i++) {
+        prv_ident[i] = (uint16_t)(base[i % 5U] + 1U + i / 5U);
+        CO_CANrxBufferInit(&prv_module, i, prv_ident[i], 0x7FFU, false, &prv_received, prv_rx_callback);
+    }
+    for (uint16_t i = 0U; i < BENCH_TX_SIZE; i++) {
+        CO_CANtxBufferInit(&prv_module, i, (uint16_t)(0x181U + i), false, 8U, false);
+    }
+    CO_CANsetNormalMode(&prv_module);
+    co_sim_irq_stats_clear();
+    prv_received = 0U;
+}
+
+/* Host time without simulator */
+static uint64_t
+prv_cpu_ns(void) {
+    return co_sim_host_ns() - co_sim_overhead_ns();
+}
+
+static uint64_t
+prv_rx_isr_ns(void) {
+    return co_sim_irq_stats(CAN1_RX0_IRQn)->host_ns + co_sim_irq_stats(CAN1_RX1_IRQn)->host_ns;
+}
+
+/* Frames go into RX FIFO one by one, each is dispatched by its interrupt */
+static void
+prv_bench_rx(uint16_t rxSize, bool matched) {
+    co_sim_frame_t frame = {0};
+    uint64_t start;
+    uint64_t total;
+    uint64_t isr;
+
+    prv_setup(rxSize);
+    frame.dlc = 8U;
+    start = prv_cpu_ns();
+    for (uint32_t i = 0U; i < prv_frames; i++) {
+        frame.id = matched ? prv_ident[i % rxSize] : (uint16_t)(0x500U + (i % 64U));
+        frame.data[0] = (uint8_t)i;
+        co_sim_can_receive(0, &frame);
+#if CO_CAN_RX_DEFERRED
+        CO_CANrxProcess(&prv_module);
+#endif
+    }
+    total = prv_cpu_ns() - start;
+    isr = prv_rx_isr_ns();
+    if (matched && prv_received != prv_frames) {
+        fprintf(stderr, "received %u of %u frames\n", (unsigned)prv_received, (unsigned)prv_frames);
+        exit(1);
+    }
+    printf("rx %-9s rxSize %3u: isr %6.1f ns/frame %6.0f cycles/frame, 99.9 %% %5u ns, total %6.1f ns/frame, "
+           "%9.0f frames/s\n",
+           matched ? "matched" : "unmatched", rxSize, (double)isr / prv_frames,
+           (double)isr * co_sim_host_ghz() / prv_frames, (unsigned)co_sim_irq_percentile_ns(CAN1_RX0_IRQn, 0.999),
+           (double)total / prv_frames, 1e9 * prv_frames / (double)total);
+}
+
+/* All buffers are sent at once, in reverse priority order. Three go into
+ * mailboxes, others wait. Mailboxes are then completed one by one and
+ * transmit interrupt refills them from the backlog. */
+static void
+prv_bench_tx(void) {
+    uint64_t enqueue = 0U;
+    uint32_t sent = 0U;
+    uint32_t rounds = prv_frames / BENCH_TX_SIZE;
+    const co_sim_irq_stats_t* isr = co_sim_irq_stats(CAN1_TX_IRQn);
+
+    prv_setup(8U);
+    for (uint32_t r = 0U; r < rounds; r++) {
+        for (int i = BENCH_TX_SIZE - 1; i >= 0; i--) {
+            uint64_t start = prv_cpu_ns();
+            CO_CANsend(&prv_module, &prv_tx[i]);
+            enqueue += prv_cpu_ns() - start;
+        }
+        while (co_sim_can_tx_complete(0, NULL)) {
+            sent++;
+        }
+    }
+    if (sent != rounds * BENCH_TX_SIZE) {
+        fprintf(stderr, "sent %u of %u frames\n", (unsigned)sent, (unsigned)(rounds * BENCH_TX_SIZE));
+        exit(1);
+    }
+    printf("tx enqueue  txSize %3u: %6.1f ns/frame\n", BENCH_TX_SIZE, (double)enqueue / sent);
+    printf("tx complete txSize %3u: %6.1f ns/frame (interrupt with refill), %9.0f frames/s\n", BENCH_TX_SIZE,
+           (double)isr->host_ns / isr->count, 1e9 * sent / (double)(enqueue + isr->host_ns));
+}
+
+int
+main(int argc, char* argv[]) {
+    static const uint16_t rxSizes[] = {4U, 8U, 16U, 32U, 64U, 128U, 256U};
+
+    if (argc > 1) {
+        prv_frames = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        prv_callbackWork = (uint32_t)strtoul(argv[2], NULL, 0);
+    }
+    printf("CAN driver: hash %d, filters %d, FIFO split %d, deferred %d, direct registers %d, %u frames, "
+           "callback work %u\n",
+           CO_CAN_RX_HASH_SIZE, CO_CAN_RX_FILTERS, CO_CAN_RX_FIFO_SPLIT, CO_CAN_RX_DEFERRED, CO_CAN_DIRECT_REGISTERS,
+           (unsigned)prv_frames, (unsigned)prv_callbackWork);
+    for (size_t i = 0U; i < sizeof(rxSizes) / sizeof(rxSizes[0]); i++) {
+        prv_bench_rx(rxSizes[i], true);
+    }
+    prv_bench_rx(64U, false);
+    prv_bench_tx();
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Benchmark of NMT reset communication on simulated bxCAN: time from the
+ * end of NMT command frame on the bus to the start of boot-up frame, with
+ * warm reset (CO_APP_WARM_RESET) or with full CAN peripheral
+ * re-initialization.
+ *
+ * Command to boot-up is virtual time. It includes the wait for the next
+ * CO_process() call, the reset itself and synchronization of a restarted
+ * controller on the bus. Commands come at varying phase of the 1 ms timer.
+ * The handle's resetTime is in virtual DWT cycles, so it shows only the
+ * waits of the reset. Its CPU cost is host time of the reset call, see
+ * bench_driver.c, and the number of HAL filter configurations.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_sim.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#define BENCH_NODE_ID  5U
+#define BENCH_LOOP_US  100U      /* Main loop period */
+#define BENCH_RESET_NS 10000000U /* Between reset commands */
+
+static uint32_t prv_resets = 1000U;
+static CAN_HandleTypeDef prv_hcan;
+static TIM_HandleTypeDef prv_htim;
+static CANopenNodeHandle prv_node;
+
+/* Bus times of the last reset */
+static uint64_t prv_commandEof;
+static uint64_t prv_bootupSof;
+
+typedef struct {
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} prv_stat_t;
+
+#if CO_APP_TICKLESS
+void
+HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim) {
+    if (htim == &prv_htim) {
+        CANopenNode_IRQ(&prv_node);
+    }
+}
+#else
+void
+HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    if (htim == &prv_htim) {
+        CANopenNode_IRQ(&prv_node);
+    }
+}
+#endif
+
+static void
+prv_can_init(void) {
+    HAL_CAN_Init(&prv_hcan);
+}
+
+static void
+prv_monitor(void* object, const co_sim_frame_t* frame, uint64_t sof_ns, uint64_t eof_ns, int source) {
+    if (source == CO_SIM_EXTERNAL && frame->id == 0x000U && frame->data[0] == CO_NMT_RESET_COMMUNICATION) {
+        prv_commandEof = eof_ns;
+    } else if (source == 0 && frame->id == 0x700U + BENCH_NODE_ID && frame->data[0] == 0U) {
+        prv_bootupSof = sof_ns;
+    }
+}
+
+static uint64_t
+prv_cpu_ns(void) {
+    return co_sim_host_ns() - co_sim_overhead_ns();
+}
+
+static void
+prv_stat_add(prv_stat_t* stat, uint64_t value) {
+    stat->sum += value;
+    stat->min = value < stat->min ? value : stat->min;
+    stat->max = value > stat->max ? value : stat->max;
+}
+
+static void
+prv_stat_print(const char* name, const prv_stat_t* stat, double scale, const char* unit) {
+    printf("%-18s min %8.1f %s, mean %8.1f %s, max %8.1f %s\n", name, (double)stat->min * scale, unit,
+           (double)stat->sum * scale / prv_resets, unit, (double)stat->max * scale, unit);
+}
+
+/* Main loop until boot-up of the reset, host time of the call doing it */
+static uint64_t
+prv_run_reset(uint64_t end) {
+    uint64_t host = 0U;
+
+    while (co_sim_now_ns() < end) {
+        bool resetting = prv_node.canOpen_Obj->NMT->internalCommand == CO_NMT_RESET_COMMUNICATION;
+        uint64_t start = prv_cpu_ns();
+
+        CANopenNode_Process(&prv_node);
+        if (resetting) {
+            host = prv_cpu_ns() - start;
+        }
+#if CO_APP_TICKLESS
+        CANopenNode_Sleep(&prv_node);
+#else
+        co_sim_run_until(co_sim_now_ns() + BENCH_LOOP_US * 1000U);
+#endif
+    }
+    return host;
+}
+
+int
+main(int argc, char* argv[]) {
+    prv_stat_t latency = {0U, UINT64_MAX, 0U};
+    prv_stat_t reset = {0U, UINT64_MAX, 0U};
+    prv_stat_t host = {0U, UINT64_MAX, 0U};
+    uint32_t filterConfigs;
+
+    if (argc > 1) {
+        prv_resets = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+
+    co_sim_reset();
+    OD_sim_defaults();
+    co_sim_can_handle(&prv_hcan, CAN1, 500U);
+    co_sim_can_bind(&prv_hcan, 1U);
+    co_sim_bus_monitor(prv_monitor, NULL);
+#if CO_APP_TICKLESS
+    prv_htim.Instance = TIM2;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 0xFFFFFFFFU;
+#else
+    prv_htim.Instance = TIM3;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 999U;
+#endif
+    HAL_TIM_Base_Init(&prv_htim);
+    co_sim_tim_bind(&prv_htim, 2U);
+
+    prv_node.desiredNodeID = BENCH_NODE_ID;
+    prv_node.baudrate = 500U;
+    prv_node.CANHandle = &prv_hcan;
+    prv_node.CANInitFunction = prv_can_init;
+    prv_node.timerHandle = &prv_htim;
+    /* Returns 0 from CANopenNode_ResetCommunication() on success */
+    if (CANopenNode_Init(&prv_node) != 0) {
+        fprintf(stderr, "CANopenNode_Init failed\n");
+        return 1;
+    }
+    prv_run_reset(BENCH_RESET_NS);
+    filterConfigs = co_sim_filter_configs;
+
+    for (uint32_t i = 0U; i < prv_resets; i++) {
+        /* Phase of the command steps through the 1 ms timer period */
+        uint64_t at = co_sim_now_ns() + (i * 137U % 1000U) * 1000U;
+        co_sim_frame_t command = {0x000U, 0U, 2U, {CO_NMT_RESET_COMMUNICATION, BENCH_NODE_ID}};
+
+        prv_commandEof = 0U;
+        prv_bootupSof = 0U;
+        co_sim_bus_inject(&command, at);
+        prv_stat_add(&host, prv_run_reset(at + BENCH_RESET_NS));
+        if (prv_commandEof == 0U || prv_bootupSof < prv_commandEof) {
+            fprintf(stderr, "no boot-up after reset %u\n", (unsigned)i);
+            return 1;
+        }
+        prv_stat_add(&latency, prv_bootupSof - prv_commandEof);
+        prv_stat_add(&reset, prv_node.resetTime);
+    }
+
+    printf("NMT reset communication: warm %d, tickless %d, filters %d, %u resets\n", CO_APP_WARM_RESET,
+           CO_APP_TICKLESS, CO_CAN_RX_FILTERS, (unsigned)prv_resets);
+    prv_stat_print("command to boot-up", &latency, 1e-3, "us");
+    prv_stat_print("resetTime", &reset, 1e6 / SystemCoreClock, "us");
+    prv_stat_print("reset call", &host, 1.0, "ns");
+    printf("%-18s %.1f per reset\n", "filter configs", (double)(co_sim_filter_configs - filterConfigs) / prv_resets);
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * Benchmark of synchronous TPDO timing on simulated bxCAN: time from start
+ * of SYNC frame on the bus to start of the TPDO, which it triggers, with
+ * 1 ms timer, tickless timing, or TPDOs sampled at CO_APP_SYNC_OFFSET_US.
+ *
+ * SYNC comes at varying phase of the 1 ms timer. RPDOs every millisecond
+ * and the application, which masks interrupts for up to BENCH_LOAD_US after
+ * every wake-up, delay CAN and timer interrupts. Jitter is max - min. It
+ * includes the wait for an RPDO already on the bus, up to one frame time.
+ * The node's syncTpdoMin_us/syncTpdoMax_us (SYNC reception to TPDO in the
+ * mailbox) are reported with CO_CAN_RX_TIMESTAMP.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_sim.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#define BENCH_NODE_ID 5U
+#define BENCH_SYNC_US 10000U /* SYNC period */
+#define BENCH_LOOP_US 100U   /* Main loop period without CO_APP_TICKLESS */
+#define BENCH_LOAD_US 50U    /* Longest application critical section */
+
+static uint32_t prv_syncs = 1000U;
+static uint32_t prv_injected;
+static CAN_HandleTypeDef prv_hcan;
+static TIM_HandleTypeDef prv_htim;
+static CANopenNodeHandle prv_node;
+static uint32_t prv_random = 12345U;
+
+/* Bus times of the last SYNC and its TPDO */
+static uint64_t prv_syncSof;
+static uint64_t prv_tpdoSof;
+
+typedef struct {
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint32_t count;
+} prv_stat_t;
+
+#if CO_APP_TICKLESS
+void
+HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim) {
+    CANopenNode_TimerIRQ(htim);
+}
+#else
+void
+HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    CANopenNode_TimerIRQ(htim);
+}
+#endif
+
+static void
+prv_can_init(void) {
+    HAL_CAN_Init(&prv_hcan);
+}
+
+static void
+prv_monitor(void* object, const co_sim_frame_t* frame, uint64_t sof_ns, uint64_t eof_ns, int source) {
+    if (source == CO_SIM_EXTERNAL && frame->id == 0x080U) {
+        prv_syncSof = sof_ns;
+        prv_tpdoSof = 0U;
+    } else if (source == 0 && frame->id == 0x180U + BENCH_NODE_ID && prv_tpdoSof == 0U) {
+        prv_tpdoSof = sof_ns;
+    }
+}
+
+static uint32_t
+prv_rand(uint32_t range) {
+    prv_random = prv_random * 1103515245U + 12345U;
+    return (prv_random >> 8) % range;
+}
+
+static void
+prv_inject(uint16_t id, uint8_t dlc, uint64_t at) {
+    co_sim_frame_t frame = {id, 0U, dlc, {0}};
+
+    if (!co_sim_bus_inject(&frame, at)) {
+        fprintf(stderr, "bus injection queue is full\n");
+        exit(1);
+    }
+}
+
+/* SYNC at varying phase of the 1 ms timer, RPDOs in between */
+static void
+prv_feed(void) {
+    while (prv_injected < prv_syncs && co_sim_bus_injected() < 256U) {
+        uint64_t t = (uint64_t)(prv_injected + 1U) * BENCH_SYNC_US * 1000U;
+
+        prv_inject(0x080U, 0U, t + (prv_injected * 137U % 1000U) * 1000U);
+        for (uint32_t ms = 0U; ms < BENCH_SYNC_US / 1000U; ms++) {
+            prv_inject((uint16_t)(0x200U + BENCH_NODE_ID), 8U, t + ms * 1000000U + prv_rand(1000U) * 1000U);
+        }
+        prv_injected++;
+    }
+}
+
+static void
+prv_stat_add(prv_stat_t* stat, uint64_t value) {
+    stat->sum += value;
+    stat->min = value < stat->min ? value : stat->min;
+    stat->max = value > stat->max ? value : stat->max;
+    stat->count++;
+}
+
+int
+main(int argc, char* argv[]) {
+    OD_PERSIST_COMM_t* comm = OD->persistComm;
+    prv_stat_t latency = {0U, UINT64_MAX, 0U, 0U};
+    co_sim_frame_t start = {0x000U, 0U, 2U, {CO_NMT_ENTER_OPERATIONAL, BENCH_NODE_ID}};
+    uint64_t lastSync = 0U;
+    uint64_t end;
+
+    if (argc > 1) {
+        prv_syncs = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+
+    /* TPDO1 on every SYNC, other TPDOs do not compete for the bus */
+    co_sim_reset();
+    OD_sim_defaults();
+    comm->x1006_communicationCyclePeriod = BENCH_SYNC_US;
+    for (uint8_t i = 0U; i < OD_CNT_TPDO; i++) {
+        comm->x1800_TPDOCommunicationParameter[i].transmissionType = i == 0U ? 1U : 254U;
+    }
+
+    co_sim_can_handle(&prv_hcan, CAN1, 500U);
+#if CO_CAN_RX_TIMESTAMP
+    prv_hcan.Init.TimeTriggeredMode = ENABLE;
+#endif
+    co_sim_can_bind(&prv_hcan, 1U);
+    co_sim_bus_monitor(prv_monitor, NULL);
+#if CO_APP_TICKLESS
+    prv_htim.Instance = TIM2;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 0xFFFFFFFFU;
+#else
+    prv_htim.Instance = TIM3;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 999U;
+#endif
+    HAL_TIM_Base_Init(&prv_htim);
+    co_sim_tim_bind(&prv_htim, 2U);
+
+    prv_node.desiredNodeID = BENCH_NODE_ID;
+    prv_node.baudrate = 500U;
+    prv_node.CANHandle = &prv_hcan;
+    prv_node.CANInitFunction = prv_can_init;
+    prv_node.timerHandle = &prv_htim;
+    /* Returns 0 from CANopenNode_ResetCommunication() on success */
+    if (CANopenNode_Init(&prv_node) != 0) {
+        fprintf(stderr, "CANopenNode_Init failed\n");
+        return 1;
+    }
+    co_sim_bus_inject(&start, co_sim_now_ns());
+
+    end = (uint64_t)(prv_syncs + 1U) * BENCH_SYNC_US * 1000U + 2000000U;
+    while (co_sim_now_ns() < end) {
+        uint32_t lock;
+
+        prv_feed();
+        CANopenNode_Process(&prv_node);
+        /* Application work with interrupts masked */
+        CO_LOCK_ENTER(lock);
+        co_sim_busy(prv_rand(BENCH_LOAD_US * 1000U));
+        CO_LOCK_LEAVE(lock);
+#if CO_APP_TICKLESS
+        CANopenNode_Sleep(&prv_node);
+#else
+        co_sim_run_until(co_sim_now_ns() + BENCH_LOOP_US * 1000U);
+#endif
+        if (prv_tpdoSof != 0U && prv_syncSof != lastSync) {
+            lastSync = prv_syncSof;
+            prv_stat_add(&latency, prv_tpdoSof - prv_syncSof);
+        }
+    }
+
+    if (latency.count + 1U < prv_syncs) {
+        fprintf(stderr, "%u TPDOs for %u SYNCs\n", (unsigned)latency.count, (unsigned)prv_syncs);
+        return 1;
+    }
+    printf("SYNC to TPDO: tickless %d, offset %u us, timestamps %d, %u SYNCs\n", CO_APP_TICKLESS,
+           (unsigned)CO_APP_SYNC_OFFSET_US, CO_CAN_RX_TIMESTAMP, (unsigned)latency.count);
+    printf("SYNC SOF to TPDO SOF: min %7.1f us, mean %7.1f us, max %7.1f us, jitter %7.1f us\n", latency.min * 1e-3,
+           (double)latency.sum * 1e-3 / latency.count, latency.max * 1e-3, (latency.max - latency.min) * 1e-3);
+#if CO_CAN_RX_TIMESTAMP
+    printf("SYNC reception to TPDO in mailbox: min %u us, max %u us\n", (unsigned)prv_node.syncTpdoMin_us,
+           (unsigned)prv_node.syncTpdoMax_us);
+#endif
+    return 0;
+}
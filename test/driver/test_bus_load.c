@@ -0,0 +1,96 @@
+/*
+ * Test of the bus load meter with calls of CO_diag_process() several
+ * milliseconds apart, as tickless CANopenNode_IRQ() makes them: frames must
+ * be spread over the elapsed 1 ms slots, so constant load reads the same in
+ * every window and the 10 ms peak is not a multiple of it.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#define TEST_KBIT 500U
+
+static CO_CANmodule_t prv_module;
+static CO_diag_t prv_diag;
+
+static void
+prv_setup(void) {
+    memset(&prv_module, 0, sizeof(prv_module));
+    prv_module.busBitRate = TEST_KBIT;
+    CO_diag_init(&prv_diag, &prv_module, NULL, OD);
+}
+
+/* Bus busy for permille of time, in calls period_us apart, for time_ms */
+static void
+prv_run(uint32_t permille, uint32_t period_us, uint32_t time_ms) {
+    uint64_t bits = 0U; /* In 1/16 of bit time, like the driver counts */
+
+    for (uint64_t t = 0U; t < (uint64_t)time_ms * 1000U; t += period_us) {
+        uint64_t next = (t + period_us) * TEST_KBIT * 16U * permille / 1000000U;
+
+        prv_module.busBitsRx[0] += (uint32_t)(next - bits);
+        bits = next;
+        CO_diag_process(&prv_diag, period_us);
+    }
+}
+
+static void
+prv_check(const char* name, uint32_t permille, uint32_t period_us) {
+    prv_setup();
+    prv_run(permille, period_us, 2000U);
+    for (uint8_t level = 0U; level < 3U; level++) {
+        TEST_CHECK(prv_diag.busLoad[level] + 2U >= permille && prv_diag.busLoad[level] <= permille + 2U,
+                   "%s: load of window %u is %u, expected %u", name, (unsigned)level,
+                   (unsigned)prv_diag.busLoad[level], (unsigned)permille);
+    }
+    TEST_CHECK(prv_diag.busPeak <= permille + 2U, "%s: peak %u, expected %u", name, (unsigned)prv_diag.busPeak,
+               (unsigned)permille);
+}
+
+int
+main(void) {
+    /* Periodic 1 ms timer */
+    prv_check("1 ms", 250U, 1000U);
+    /* Tickless, slots close in bunches of varying size */
+    prv_check("2.5 ms", 250U, 2500U);
+    prv_check("50 ms", 250U, 50000U);
+    prv_check("100 ms", 400U, 100000U);
+
+    /* Burst in a long sleep is spread over it */
+    prv_setup();
+    prv_run(0U, 1000U, 100U);
+    prv_module.busBitsRx[1] += 10U * TEST_KBIT * 16U; /* 10 ms of frames */
+    CO_diag_process(&prv_diag, 100000U);
+    TEST_CHECK(prv_diag.busLoad[1] >= 98U && prv_diag.busLoad[1] <= 102U, "burst: 100 ms load %u, expected 100",
+               (unsigned)prv_diag.busLoad[1]);
+    TEST_CHECK(prv_diag.busPeak <= 102U, "burst: peak %u, expected 100", (unsigned)prv_diag.busPeak);
+
+    /* Frames in a sleep longer than the longest window count only partly */
+    prv_setup();
+    prv_module.busBitsTx += 3000U * TEST_KBIT * 16U / 2U; /* 50 % of 3 s */
+    CO_diag_process(&prv_diag, 3000000U);
+    TEST_CHECK(prv_diag.busLoad[2] >= 498U && prv_diag.busLoad[2] <= 502U, "long sleep: 1 s load %u, expected 500",
+               (unsigned)prv_diag.busLoad[2]);
+
+    return co_test_result("bus load");
+}
@@ -0,0 +1,285 @@
+/*
+ * Test of the FDCAN driver on simulated STM32G4 FDCAN: frames through the
+ * transmit FIFO in queue mode, also when it is full, CAN FD frames up to
+ * 64 bytes with DLC codes 9 to 15 and bit rate switching, and reception of
+ * all DLC codes. Classic frames with DLC above 8 carry 8 bytes.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+
+#define TEST_RX_IDENT 0x201U
+#define TEST_FRAMES   16U
+
+static CANopenNodeHandle prv_node;
+static CO_CANmodule_t prv_module;
+static CO_CANrx_t prv_rx[1];
+static CO_CANtx_t prv_tx[TEST_FRAMES];
+
+/* Frames transmitted by the node, in bus order */
+static co_sim_frame_t prv_sent[TEST_FRAMES];
+static uint64_t prv_sentNs[TEST_FRAMES];
+static uint32_t prv_sentCount;
+static uint64_t prv_externalSof;
+
+/* Last received frame */
+static uint32_t prv_received;
+static uint8_t prv_rxDlc;
+static uint8_t prv_rxData[CO_CAN_DATA_MAX];
+#if CO_CAN_RX_TIMESTAMP
+static uint32_t prv_rxTime;
+#endif
+
+#if CO_CAN_FD
+/* Process data objects of node 1 are CAN FD with bit rate switching */
+static const CO_CANfdRule_t prv_fdRules[] = {
+    {0x301U, 0x7FFU, CO_CAN_FD_FORMAT | CO_CAN_FD_BRS},
+    {0x300U, 0x700U, CO_CAN_FD_FORMAT | CO_CAN_FD_BRS},
+};
+#endif
+
+void
+HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs) {
+    if (RxFifo0ITs & FDCAN_IT_RX_FIFO0_NEW_MESSAGE) {
+        CO_CANinterrupt_RX(&prv_module, FDCAN_RX_FIFO0);
+    }
+}
+
+void
+HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo1ITs) {
+    if (RxFifo1ITs & FDCAN_IT_RX_FIFO1_NEW_MESSAGE) {
+        CO_CANinterrupt_RX(&prv_module, FDCAN_RX_FIFO1);
+    }
+}
+
+void
+HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t BufferIndexes) {
+    CO_CANinterrupt_TX(&prv_module, BufferIndexes);
+}
+
+#if CO_CAN_TX_LATENCY
+void
+HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t TxEventFifoITs) {
+    if (TxEventFifoITs & FDCAN_IT_TX_EVT_FIFO_NEW_DATA) {
+        CO_CANinterrupt_TXevent(&prv_module);
+    }
+}
+#endif
+
+static void
+prv_monitor(void* object, const co_sim_frame_t* frame, uint64_t sof_ns, uint64_t eof_ns, int source) {
+    if (source == CO_SIM_EXTERNAL) {
+        prv_externalSof = sof_ns;
+    } else if (source == 0 && prv_sentCount < TEST_FRAMES) {
+        prv_sent[prv_sentCount] = *frame;
+        prv_sentNs[prv_sentCount] = eof_ns - sof_ns;
+        prv_sentCount++;
+    }
+}
+
+static void
+prv_rx_callback(void* object, void* message) {
+    prv_received++;
+    prv_rxDlc = CO_CANrxMsg_readDLC(message);
+    memcpy(prv_rxData, CO_CANrxMsg_readData(message), prv_rxDlc < CO_CAN_DATA_MAX ? prv_rxDlc : CO_CAN_DATA_MAX);
+#if CO_CAN_RX_TIMESTAMP
+    prv_rxTime = CO_CANrxMsg_readTime(message);
+#endif
+}
+
+static void
+prv_setup(void) {
+    co_sim_reset();
+    co_sim_fdcan_handle(&co_test_hcan, FDCAN1, 500U, CO_CAN_FD ? 2000U : 0U);
+    co_sim_fdcan_bind(&co_test_hcan, 1U);
+    co_sim_bus_monitor(prv_monitor, NULL);
+    memset(&prv_node, 0, sizeof(prv_node));
+    prv_node.CANHandle = &co_test_hcan;
+    prv_node.CANInitFunction = co_test_can_init;
+#if CO_CAN_FD
+    prv_node.fdRules = prv_fdRules;
+    prv_node.fdRulesCount = (uint8_t)(sizeof(prv_fdRules) / sizeof(prv_fdRules[0]));
+#endif
+    if (CO_CANmodule_init(&prv_module, &prv_node, prv_rx, 1U, prv_tx, TEST_FRAMES, 500U) != CO_ERROR_NO) {
+        printf("FAIL: CO_CANmodule_init\n");
+        exit(1);
+    }
+    CO_CANrxBufferInit(&prv_module, 0U, TEST_RX_IDENT, 0x7FFU, false, &prv_received, prv_rx_callback);
+    CO_CANsetNormalMode(&prv_module);
+    prv_sentCount = 0U;
+    prv_received = 0U;
+}
+
+/* Send frames of given sizes at once, more than the transmit FIFO holds,
+ * identifiers ascending from ident, and check them on the bus */
+static void
+prv_check_tx(const char* name, uint16_t ident, const uint8_t* bytes, const uint8_t* codes, uint32_t count,
+             uint8_t flags) {
+    uint32_t first = prv_sentCount;
+
+    for (uint32_t i = 0U; i < count; i++) {
+        CO_CANtx_t* buffer = CO_CANtxBufferInit(&prv_module, (uint16_t)(first + i), (uint16_t)(ident + i), false,
+                                                bytes[i], false);
+
+        TEST_CHECK(buffer != NULL, "%s: CO_CANtxBufferInit of %u bytes", name, (unsigned)bytes[i]);
+        if (buffer == NULL) {
+            return;
+        }
+        for (uint32_t b = 0U; b < bytes[i]; b++) {
+            buffer->data[b] = (uint8_t)(ident + i + b);
+        }
+        CO_CANsend(&prv_module, buffer);
+    }
+    co_sim_run_until(co_sim_now_ns() + 10000000U);
+
+    TEST_CHECK(prv_sentCount == first + count, "%s: %u frames on the bus, expected %u", name,
+               (unsigned)(prv_sentCount - first), (unsigned)count);
+    for (uint32_t i = 0U; i < count && first + i < prv_sentCount; i++) {
+        const co_sim_frame_t* frame = &prv_sent[first + i];
+        uint32_t b = 0U;
+
+        TEST_CHECK(frame->id == ident + i, "%s: frame %u has identifier 0x%03X, expected 0x%03X", name, (unsigned)i,
+                   (unsigned)frame->id, (unsigned)(ident + i));
+        TEST_CHECK((frame->dlc & 0x0FU) == codes[i], "%s: %u bytes sent with DLC code %u, expected %u", name,
+                   (unsigned)bytes[i], (unsigned)(frame->dlc & 0x0FU), (unsigned)codes[i]);
+        TEST_CHECK((frame->dlc & (CO_SIM_FDF | CO_SIM_BRS)) == flags, "%s: %u bytes sent with flags 0x%02X", name,
+                   (unsigned)bytes[i], (unsigned)(frame->dlc & (CO_SIM_FDF | CO_SIM_BRS)));
+        while (b < bytes[i] && frame->data[b] == (uint8_t)(frame->id + b)) {
+            b++;
+        }
+        TEST_CHECK(b == bytes[i], "%s: %u bytes sent, byte %u differs", name, (unsigned)bytes[i], (unsigned)b);
+    }
+}
+
+/* Receive a frame with given DLC code, expect it with given number of bytes,
+ * or not at all with 0xFF */
+static void
+prv_check_rx(const char* name, uint8_t dlc, uint8_t expected) {
+    co_sim_frame_t frame = {TEST_RX_IDENT, 0U, dlc, {0}};
+    uint32_t received = prv_received;
+    uint8_t b = 0U;
+
+    for (uint32_t i = 0U; i < sizeof(frame.data); i++) {
+        frame.data[i] = (uint8_t)(0xA5U ^ i);
+    }
+    co_sim_can_receive(0, &frame);
+    co_sim_run_until(co_sim_now_ns() + 100000U);
+
+    if (expected == 0xFFU) {
+        TEST_CHECK(prv_received == received, "%s: frame with DLC code %u received", name, (unsigned)(dlc & 0x0FU));
+        return;
+    }
+    TEST_CHECK(prv_received == received + 1U, "%s: frame with DLC code %u not received", name,
+               (unsigned)(dlc & 0x0FU));
+    TEST_CHECK(prv_rxDlc == expected, "%s: DLC code %u received as %u bytes, expected %u", name,
+               (unsigned)(dlc & 0x0FU), (unsigned)prv_rxDlc, (unsigned)expected);
+    while (b < expected && b < CO_CAN_DATA_MAX && prv_rxData[b] == (uint8_t)(0xA5U ^ b)) {
+        b++;
+    }
+    TEST_CHECK(b == expected || b == CO_CAN_DATA_MAX, "%s: DLC code %u, byte %u differs", name,
+               (unsigned)(dlc & 0x0FU), (unsigned)b);
+}
+
+int
+main(void) {
+    static const uint8_t classicBytes[] = {0U, 1U, 8U, 8U, 8U};
+    static const uint8_t classicCodes[] = {0U, 1U, 8U, 8U, 8U};
+    static const uint8_t fdBytes[] = {10U, 12U, 20U, 48U, 64U};
+    static const uint8_t fdCodes[] = {9U, 9U, 11U, 14U, 15U};
+
+    (void)fdBytes;
+    (void)fdCodes;
+    prv_setup();
+
+    /* Burst of classic frames, transmit FIFO is full after three */
+    prv_check_tx("classic", 0x181U, classicBytes, classicCodes, 5U, 0U);
+
+#if CO_CAN_FD
+    {
+        static const uint8_t longBytes[] = {64U};
+        static const uint8_t longCodes[] = {15U};
+
+        /* 10 bytes have no DLC code, sent with 12 */
+        prv_check_tx("CAN FD with BRS", 0x301U, fdBytes, fdCodes, 5U, CO_SIM_FDF | CO_SIM_BRS);
+        prv_check_tx("CAN FD", 0x481U, longBytes, longCodes, 1U, CO_SIM_FDF);
+        if (prv_sentCount == 11U) {
+            TEST_CHECK(prv_sentNs[9] < prv_sentNs[10] / 2U,
+                       "64 bytes take %u ns with bit rate switching, %u ns without", (unsigned)prv_sentNs[9],
+                       (unsigned)prv_sentNs[10]);
+        }
+    }
+#endif
+
+#if CO_CAN_TX_LATENCY
+    {
+        uint32_t measured = 0U;
+
+        for (uint32_t c = 0U; c < CO_CAN_TX_LATENCY_CLASSES; c++) {
+            for (uint32_t b = 0U; b < CO_CAN_TX_LATENCY_BUCKETS; b++) {
+                measured += prv_module.txLatency[c].bucket[b];
+            }
+        }
+        TEST_CHECK(measured == prv_sentCount, "transmit latency of %u frames, %u sent", (unsigned)measured,
+                   (unsigned)prv_sentCount);
+    }
+#endif
+
+    /* Classic frames, DLC codes 9 to 15 mean 8 bytes */
+    for (uint8_t code = 0U; code < 16U; code++) {
+        prv_check_rx("classic", code, code < 8U ? code : 8U);
+    }
+    /* CAN FD frames are protocol errors without CAN FD operation */
+    for (uint8_t code = 0U; code < 16U; code++) {
+        static const uint8_t fdDlcBytes[16] = {0U, 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 12U, 16U, 20U, 24U, 32U, 48U, 64U};
+
+        prv_check_rx("CAN FD", (uint8_t)(code | CO_SIM_FDF), CO_CAN_FD ? fdDlcBytes[code] : 0xFFU);
+        prv_check_rx("CAN FD with BRS", (uint8_t)(code | CO_SIM_FDF | CO_SIM_BRS), CO_CAN_FD ? fdDlcBytes[code] : 0xFFU);
+    }
+
+    /* Frame of other identifier */
+    {
+        co_sim_frame_t frame = {0x555U, 0U, 8U, {0}};
+        uint32_t received = prv_received;
+
+        co_sim_can_receive(0, &frame);
+        co_sim_run_until(co_sim_now_ns() + 100000U);
+        TEST_CHECK(prv_received == received, "frame of other identifier received");
+#if CO_CAN_RX_FILTERS
+        TEST_CHECK(co_sim_can_stats(0)->filtered == 1U, "%u frames rejected by filters, expected 1",
+                   (unsigned)co_sim_can_stats(0)->filtered);
+#endif
+    }
+
+#if CO_CAN_RX_TIMESTAMP
+    /* Frame time stamped at start of frame */
+    for (uint32_t i = 0U; i < 4U; i++) {
+        co_sim_frame_t frame = {TEST_RX_IDENT, 0U, 8U, {0}};
+
+        co_sim_bus_inject(&frame, co_sim_now_ns() + 123456U * (i + 1U));
+        co_sim_run_until(co_sim_now_ns() + 2000000U);
+    }
+    TEST_CHECK(prv_rxTime + 4U >= prv_externalSof / 1000U && prv_rxTime <= prv_externalSof / 1000U + 4U,
+               "frame at %u us stamped %u us", (unsigned)(prv_externalSof / 1000U), (unsigned)prv_rxTime);
+#endif
+
+    return co_test_result("FDCAN");
+}
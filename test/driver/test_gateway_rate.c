@@ -0,0 +1,129 @@
+/*
+ * Test of gateway rate limit: a route of 5000 frames per second and burst
+ * of 2 must forward the burst at once and then one frame every 200 us. A
+ * limit refilled in whole milliseconds caps it to the burst per millisecond.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+#include "CO_gateway_STM32.h"
+
+#define TEST_IDENT    0x181U
+#define TEST_RATE     5000U
+#define TEST_BURST    2U
+#define TEST_OFFER_NS 100000U /* Frames are offered at twice the rate */
+#define TEST_OFFERED  1000U
+
+static const CO_gateway_route_t prv_routes[1] = {
+    {0U, 0U, TEST_IDENT, 0x7FFU, 0x281U, 0x7FFU, TEST_RATE, TEST_BURST},
+};
+
+static CANopenNodeHandle prv_node;
+static CO_CANmodule_t prv_module;
+static CO_CANrx_t prv_rx[1];
+static CO_CANtx_t prv_tx[1];
+static CO_gateway_t prv_gw;
+static uint32_t prv_sent;
+
+void
+HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_RX(&prv_module, CAN_RX_FIFO0);
+}
+
+void
+HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_RX(&prv_module, CAN_RX_FIFO1);
+}
+
+void
+HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX0);
+}
+
+void
+HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX1);
+}
+
+void
+HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX2);
+}
+
+static void
+prv_monitor(void* object, const co_sim_frame_t* frame, uint64_t sof_ns, uint64_t eof_ns, int source) {
+    if (source == 0 && frame->id == 0x281U) {
+        prv_sent++;
+    }
+}
+
+static void
+prv_offer(uint32_t count, uint64_t interval_ns) {
+    co_sim_frame_t frame = {TEST_IDENT, 0U, 8U, {0}};
+
+    for (uint32_t i = 0U; i < count; i++) {
+        frame.data[0] = (uint8_t)i;
+        co_sim_can_receive(0, &frame);
+        co_sim_run_until(co_sim_now_ns() + interval_ns);
+    }
+}
+
+int
+main(void) {
+    const CO_gateway_stats_t* stats = &prv_gw.routes[0].stats;
+
+    co_sim_reset();
+    co_sim_can_handle(&co_test_hcan, CAN1, 1000U);
+    co_sim_can_bind(&co_test_hcan, 1U);
+    co_sim_bus_monitor(prv_monitor, NULL);
+    prv_node.CANHandle = &co_test_hcan;
+    prv_node.CANInitFunction = co_test_can_init;
+    if (CO_CANmodule_init(&prv_module, &prv_node, prv_rx, 1U, prv_tx, 1U, 1000U) != CO_ERROR_NO
+        || CO_gateway_init(&prv_gw, prv_routes, 1U) != CO_ERROR_NO
+        || CO_gateway_attach(&prv_gw, 0U, &prv_module) != CO_ERROR_NO) {
+        printf("FAIL: init\n");
+        return 1;
+    }
+    CO_CANsetNormalMode(&prv_module);
+    co_sim_run_until(co_sim_now_ns() + 100000U); /* Joined the bus */
+
+    /* Full burst after a pause, then nothing left */
+    prv_offer(TEST_BURST + 1U, 10000U);
+    co_sim_run_until(co_sim_now_ns() + 100000U);
+    TEST_CHECK(stats->forwarded == TEST_BURST && stats->limited == 1U, "burst: forwarded %u, limited %u",
+               (unsigned)stats->forwarded, (unsigned)stats->limited);
+
+    /* Sustained rate, every other frame */
+    co_sim_run_until(co_sim_now_ns() + 10000000U);
+    prv_gw.routes[0].stats.forwarded = 0U;
+    prv_gw.routes[0].stats.limited = 0U;
+    prv_offer(TEST_OFFERED, TEST_OFFER_NS);
+    co_sim_run_until(co_sim_now_ns() + 1000000U);
+    TEST_CHECK(stats->forwarded >= TEST_OFFERED / 2U && stats->forwarded <= TEST_OFFERED / 2U + TEST_BURST,
+               "rate: forwarded %u of %u offered", (unsigned)stats->forwarded, TEST_OFFERED);
+    TEST_CHECK(stats->forwarded + stats->limited == TEST_OFFERED && stats->dropped == 0U,
+               "rate: forwarded %u, limited %u, dropped %u", (unsigned)stats->forwarded, (unsigned)stats->limited,
+               (unsigned)stats->dropped);
+    TEST_CHECK(prv_sent == TEST_BURST + stats->forwarded, "%u frames on the bus", (unsigned)prv_sent);
+
+    return co_test_result("gateway rate");
+}
@@ -0,0 +1,119 @@
+/*
+ * Test of RX FIFO overrun accounting: frames lost on full FIFO must be
+ * counted in rxOverrun and reported by CO_CAN_ERRRX_OVERFLOW, also when the
+ * FIFO overruns while the interrupt drains it. HAL releases bxCAN FIFO with
+ * read-modify-write of RFxR, which clears FOVR, so the flag must be sampled
+ * before each release.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+
+#define TEST_IDENT 0x181U
+
+static CANopenNodeHandle prv_node;
+static CO_CANmodule_t prv_module;
+static CO_CANrx_t prv_rx[1];
+static CO_CANtx_t prv_tx[1];
+static uint32_t prv_received;
+static uint32_t prv_burst; /* Frames received from the callback of the first frame */
+
+void
+HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_RX(&prv_module, CAN_RX_FIFO0);
+}
+
+void
+HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_RX(&prv_module, CAN_RX_FIFO1);
+}
+
+static void
+prv_receive(uint32_t count) {
+    co_sim_frame_t frame = {TEST_IDENT, 0U, 8U, {0}};
+
+    for (uint32_t i = 0U; i < count; i++) {
+        frame.data[0] = (uint8_t)i;
+        co_sim_can_receive(0, &frame);
+    }
+}
+
+static void
+prv_rx_callback(void* object, void* message) {
+    if (prv_received++ == 0U && prv_burst > 0U) {
+        prv_receive(prv_burst);
+    }
+}
+
+static void
+prv_setup(uint32_t burst) {
+    co_sim_reset();
+    co_sim_can_handle(&co_test_hcan, CAN1, 500U);
+    co_sim_can_bind(&co_test_hcan, 1U);
+    memset(&prv_node, 0, sizeof(prv_node));
+    prv_node.CANHandle = &co_test_hcan;
+    prv_node.CANInitFunction = co_test_can_init;
+    if (CO_CANmodule_init(&prv_module, &prv_node, prv_rx, 1U, prv_tx, 1U, 500U) != CO_ERROR_NO) {
+        printf("FAIL: CO_CANmodule_init\n");
+        exit(1);
+    }
+    CO_CANrxBufferInit(&prv_module, 0U, TEST_IDENT, 0x7FFU, false, &prv_received, prv_rx_callback);
+    CO_CANsetNormalMode(&prv_module);
+    prv_received = 0U;
+    prv_burst = burst;
+}
+
+static void
+prv_check(const char* name, uint32_t received, uint32_t lost) {
+#if CO_CAN_RX_DEFERRED
+    CO_CANrxProcess(&prv_module);
+#endif
+    TEST_CHECK(co_sim_can_stats(0)->overrun == lost, "%s: simulator lost %u frames, expected %u", name,
+               (unsigned)co_sim_can_stats(0)->overrun, (unsigned)lost);
+    TEST_CHECK(prv_received == received, "%s: received %u frames, expected %u", name, (unsigned)prv_received,
+               (unsigned)received);
+    TEST_CHECK(prv_module.rxOverrun[0] == 1U, "%s: rxOverrun %u", name, (unsigned)prv_module.rxOverrun[0]);
+    TEST_CHECK((prv_module.CANerrorStatus & CO_CAN_ERRRX_OVERFLOW) != 0U, "%s: CO_CAN_ERRRX_OVERFLOW not set",
+               name);
+}
+
+int
+main(void) {
+    /* Five frames while the interrupt is masked, FIFO keeps three */
+    prv_setup(0U);
+    HAL_NVIC_DisableIRQ(CAN1_RX0_IRQn);
+    prv_receive(5U);
+    HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+    co_sim_run_until(co_sim_now_ns() + 1000000U);
+    prv_check("masked", 3U, 2U);
+
+    /* Callback of the first frame receives a burst: two frames left in FIFO,
+     * burst of three fills it and loses two, before the next release */
+    prv_setup(3U);
+    HAL_NVIC_DisableIRQ(CAN1_RX0_IRQn);
+    prv_receive(3U);
+    HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+    co_sim_run_until(co_sim_now_ns() + 1000000U);
+    prv_check("while draining", 4U, 2U);
+
+    return co_test_result("RX overrun");
+}
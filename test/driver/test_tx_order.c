@@ -0,0 +1,216 @@
+/*
+ * Test of transmit order: with all mailboxes full, frames waiting in the
+ * driver must leave the node in COB-ID order, and the hardware must send
+ * the mailboxes in identifier order too.
+ *
+ * Bus is kept busy by another node, the frames are sent in random order,
+ * then the bus monitor sequence is compared with a model: three mailboxes
+ * filled in the order of CO_CANsend(), lowest identifier of the mailboxes
+ * goes out first and lowest identifier of the backlog refills it.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_test.h"
+#include "CO_app_STM32.h"
+
+#define TEST_TX_SIZE 16U
+#define TEST_ROUNDS  200U
+
+/* Node 5: EMCY, TPDOs, SDO response, heartbeat and a few others */
+static const uint16_t prv_ident[TEST_TX_SIZE] = {0x085U, 0x185U, 0x285U, 0x385U, 0x485U, 0x585U, 0x705U, 0x0FFU,
+                                                 0x100U, 0x101U, 0x1C0U, 0x200U, 0x7E4U, 0x7E5U, 0x001U, 0x600U};
+
+static CANopenNodeHandle prv_node;
+static CO_CANmodule_t prv_module;
+static CO_CANrx_t prv_rx[1];
+static CO_CANtx_t prv_tx[TEST_TX_SIZE];
+static uint16_t prv_sent[TEST_TX_SIZE];
+static uint32_t prv_sentCount;
+
+/* Frame of the other node is received too, unless filtered in hardware */
+void
+HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_RX(&prv_module, CAN_RX_FIFO0);
+}
+
+void
+HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_RX(&prv_module, CAN_RX_FIFO1);
+}
+
+void
+HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX0);
+}
+
+void
+HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX1);
+}
+
+void
+HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CO_CANinterrupt_TX(&prv_module, CAN_TX_MAILBOX2);
+}
+
+static void
+prv_monitor(void* object, const co_sim_frame_t* frame, uint64_t sof_ns, uint64_t eof_ns, int source) {
+    if (source == 0 && prv_sentCount < TEST_TX_SIZE) {
+        prv_sent[prv_sentCount++] = frame->id;
+    }
+}
+
+static void
+prv_setup(void) {
+    co_sim_reset();
+    co_sim_can_handle(&co_test_hcan, CAN1, 500U);
+    /* Driver must clear TXFP, hardware would send mailboxes in request order */
+    co_test_hcan.Init.TransmitFifoPriority = ENABLE;
+    co_sim_can_bind(&co_test_hcan, 1U);
+    co_sim_bus_monitor(prv_monitor, NULL);
+    memset(&prv_node, 0, sizeof(prv_node));
+    prv_node.CANHandle = &co_test_hcan;
+    prv_node.CANInitFunction = co_test_can_init;
+    if (CO_CANmodule_init(&prv_module, &prv_node, prv_rx, 1U, prv_tx, TEST_TX_SIZE, 500U) != CO_ERROR_NO) {
+        printf("FAIL: CO_CANmodule_init\n");
+        exit(1);
+    }
+    for (uint16_t i = 0U; i < TEST_TX_SIZE; i++) {
+        CO_CANtxBufferInit(&prv_module, i, prv_ident[i], false, 8U, false);
+    }
+    CO_CANsetNormalMode(&prv_module);
+    co_sim_run_until(100000U); /* Joined the bus */
+    prv_sentCount = 0U;
+}
+
+/* Expected sequence for buffers sent in given order while the bus is busy */
+static void
+prv_model(const uint16_t order[], uint32_t count, uint16_t expected[]) {
+    uint16_t mailbox[3];
+    uint32_t inMailbox = 0U;
+    bool backlog[TEST_TX_SIZE] = {false};
+    uint32_t out = 0U;
+
+    for (uint32_t i = 0U; i < count; i++) {
+        if (inMailbox < 3U) {
+            mailbox[inMailbox++] = prv_ident[order[i]];
+        } else {
+            backlog[order[i]] = true;
+        }
+    }
+    while (inMailbox > 0U) {
+        uint32_t best = 0U;
+        int refill = -1;
+
+        for (uint32_t k = 1U; k < inMailbox; k++) {
+            best = mailbox[k] < mailbox[best] ? k : best;
+        }
+        expected[out++] = mailbox[best];
+        mailbox[best] = mailbox[--inMailbox];
+        for (int i = 0; i < (int)TEST_TX_SIZE; i++) {
+            if (backlog[i] && (refill < 0 || prv_ident[i] < prv_ident[refill])) {
+                refill = i;
+            }
+        }
+        if (refill >= 0) {
+            backlog[refill] = false;
+            mailbox[inMailbox++] = prv_ident[refill];
+        }
+    }
+}
+
+static void
+prv_test_order(const uint16_t order[], uint32_t count) {
+    co_sim_frame_t busy = {0x7FFU, 0U, 8U, {0}};
+    uint16_t expected[TEST_TX_SIZE];
+    uint16_t last = 0U;
+
+    prv_setup();
+    /* Other node holds the bus, all frames must wait for it */
+    co_sim_bus_inject(&busy, co_sim_now_ns());
+    co_sim_run_until(co_sim_now_ns() + 10U * co_sim_bus_bit_ns());
+    for (uint32_t i = 0U; i < count; i++) {
+        TEST_CHECK(CO_CANsend(&prv_module, &prv_tx[order[i]]) == CO_ERROR_NO, "CO_CANsend 0x%03X",
+                   prv_ident[order[i]]);
+    }
+    TEST_CHECK(co_sim_can_tx_pending(0) == (count < 3U ? count : 3U), "mailboxes %u",
+               (unsigned)co_sim_can_tx_pending(0));
+    co_sim_run_until(co_sim_now_ns() + 100000000U);
+
+    prv_model(order, count, expected);
+    TEST_CHECK(prv_sentCount == count, "sent %u of %u frames", (unsigned)prv_sentCount, (unsigned)count);
+    for (uint32_t i = 0U; i < prv_sentCount && i < count; i++) {
+        TEST_CHECK(prv_sent[i] == expected[i], "frame %u is 0x%03X, expected 0x%03X", (unsigned)i, prv_sent[i],
+                   expected[i]);
+    }
+    /* Frames, which were not in mailboxes at once, leave in COB-ID order */
+    for (uint32_t i = 0U; i < prv_sentCount; i++) {
+        bool inMailbox = false;
+
+        for (uint32_t k = 0U; k < 3U && k < count; k++) {
+            inMailbox |= prv_ident[order[k]] == prv_sent[i];
+        }
+        if (!inMailbox) {
+            TEST_CHECK(prv_sent[i] > last, "backlog frame 0x%03X after 0x%03X", prv_sent[i], last);
+            last = prv_sent[i];
+        }
+    }
+    TEST_CHECK(prv_module.CANtxCount == 0U, "CANtxCount %u", (unsigned)prv_module.CANtxCount);
+}
+
+int
+main(void) {
+    uint16_t order[TEST_TX_SIZE];
+
+    /* Reverse COB-ID order: worst case for a first-in first-out backlog */
+    for (uint16_t i = 0U; i < TEST_TX_SIZE; i++) {
+        order[i] = i;
+    }
+    for (uint16_t i = 0U; i < TEST_TX_SIZE; i++) {
+        for (uint16_t j = (uint16_t)(i + 1U); j < TEST_TX_SIZE; j++) {
+            if (prv_ident[order[j]] > prv_ident[order[i]]) {
+                uint16_t t = order[i];
+                order[i] = order[j];
+                order[j] = t;
+            }
+        }
+    }
+    prv_test_order(order, TEST_TX_SIZE);
+
+    /* Random orders and numbers of frames */
+    srand(1U);
+    for (uint32_t round = 0U; round < TEST_ROUNDS && co_test_failures == 0U; round++) {
+        uint32_t count = 1U + (uint32_t)rand() % TEST_TX_SIZE;
+
+        for (uint16_t i = 0U; i < TEST_TX_SIZE; i++) {
+            order[i] = i;
+        }
+        for (uint16_t i = TEST_TX_SIZE - 1U; i > 0U; i--) {
+            uint16_t j = (uint16_t)((uint32_t)rand() % (i + 1U));
+            uint16_t t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+        prv_test_order(order, count);
+    }
+
+    return co_test_result("transmit order");
+}
@@ -0,0 +1,278 @@
+/*
+ * Replay of recorded CAN traffic into a CANopen node on simulated bxCAN.
+ *
+ * Frames from a candump -L log are put on the simulated bus at their
+ * recorded time, N times faster or back to back, and reach the node through
+ * the RX FIFOs and CO_CANinterrupt_RX(). Main loop calls
+ * CANopenNode_Process() every loop period and a 1 ms timer interrupt calls
+ * CANopenNode_IRQ(), all on virtual time.
+ *
+ *     co_replay [-s speed] [-b kbit] [-n node] [-l loop_us] [-c scale] file.log
+ *
+ * -s 1 is the recorded timing (default), -s 10 ten times faster, -s 0 as
+ * fast as the bus takes them. -c charges each interrupt its host time
+ * multiplied by scale as virtual time, so a slower CPU is modeled and
+ * interrupts delay the main loop and each other.
+ *
+ * Report lists frames dropped in hardware and in the driver, TX backlog
+ * and the host CPU time of each callback without the simulator.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "co_sim.h"
+#include "CO_app_STM32.h"
+#include "OD.h"
+
+#define REPLAY_QUEUE_LOW 1024U      /* Refill bus injection queue below this */
+#define REPLAY_START_NS  1000000U   /* First frame of the log */
+#define REPLAY_TAIL_NS   100000000U /* Run after the last frame */
+
+static CAN_HandleTypeDef prv_hcan;
+static TIM_HandleTypeDef prv_htim;
+static CANopenNodeHandle prv_node;
+
+static struct {
+    FILE* file;
+    double speed;
+    uint32_t line;
+    uint32_t frames;
+    uint32_t skipped;
+    bool first;
+    uint64_t start_us;
+} prv_log;
+
+static struct {
+    uint64_t host_ns;
+    uint64_t host_ns_max;
+    uint32_t count;
+    uint16_t txBacklogMax;
+} prv_process;
+
+void
+HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    if (htim == &prv_htim) {
+        CANopenNode_IRQ(&prv_node);
+    }
+}
+
+static void
+prv_can_init(void) {
+    HAL_CAN_Init(&prv_hcan);
+}
+
+static uint8_t
+prv_hex(char c) {
+    return (uint8_t)(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+}
+
+/* Parse "(seconds.micros) interface ID#DATA", standard identifiers only */
+static bool
+prv_log_parse(const char* line, co_sim_frame_t* frame, uint64_t* time_us) {
+    unsigned long long sec;
+    unsigned long usec;
+    char iface[32];
+    char text[64];
+    const char* p;
+    const char* hash;
+
+    if (sscanf(line, " (%llu.%lu) %31s %63s", &sec, &usec, iface, text) != 4) {
+        return false;
+    }
+    hash = strchr(text, '#');
+    if (hash == NULL || hash - text != 3 || hash[1] == '#') {
+        return false; /* Extended identifier or CAN FD */
+    }
+    memset(frame, 0, sizeof(*frame));
+    frame->id = (uint16_t)strtoul(text, NULL, 16);
+    if (frame->id > 0x7FFU) {
+        return false;
+    }
+    p = hash + 1;
+    if (*p == 'R') {
+        frame->rtr = 1U;
+        frame->dlc = (uint8_t)(p[1] >= '0' && p[1] <= '8' ? p[1] - '0' : 0);
+    } else {
+        while (p[0] != '\0' && p[1] != '\0' && frame->dlc < 8U) {
+            frame->data[frame->dlc++] = (uint8_t)(prv_hex(p[0]) << 4 | prv_hex(p[1]));
+            p += 2;
+        }
+    }
+    *time_us = (uint64_t)sec * 1000000U + usec;
+    return true;
+}
+
+/* Put frames on the bus, up to the size of injection queue */
+static bool
+prv_log_feed(void) {
+    char line[256];
+
+    while (co_sim_bus_injected() < REPLAY_QUEUE_LOW && fgets(line, sizeof(line), prv_log.file) != NULL) {
+        co_sim_frame_t frame;
+        uint64_t time_us;
+        uint64_t release = 0U;
+
+        prv_log.line++;
+        if (!prv_log_parse(line, &frame, &time_us)) {
+            prv_log.skipped++;
+            continue;
+        }
+        if (!prv_log.first) {
+            prv_log.first = true;
+            prv_log.start_us = time_us;
+        }
+        if (prv_log.speed > 0.0) {
+            release = REPLAY_START_NS + (uint64_t)((double)(time_us - prv_log.start_us) * 1000.0 / prv_log.speed);
+        }
+        co_sim_bus_inject(&frame, release);
+        prv_log.frames++;
+    }
+    return co_sim_bus_injected() > 0U || !feof(prv_log.file);
+}
+
+static void
+prv_loop(uint32_t loop_us) {
+    uint64_t start = co_sim_host_ns() - co_sim_overhead_ns();
+    uint64_t elapsed;
+    uint16_t backlog = prv_node.canOpen_Obj->CANmodule->CANtxCount;
+
+    CANopenNode_Process(&prv_node);
+    elapsed = co_sim_host_ns() - co_sim_overhead_ns() - start;
+    prv_process.host_ns += elapsed;
+    prv_process.host_ns_max = elapsed > prv_process.host_ns_max ? elapsed : prv_process.host_ns_max;
+    prv_process.count++;
+    prv_process.txBacklogMax = backlog > prv_process.txBacklogMax ? backlog : prv_process.txBacklogMax;
+    co_sim_busy((uint64_t)loop_us * 1000U);
+}
+
+/* p999 is 99.9 percentile of interrupt time, 0 if not known */
+static void
+prv_print_cpu(const char* name, uint32_t count, uint64_t host_ns, uint64_t host_ns_max, uint64_t p999) {
+    char percentile[32] = "";
+
+    if (p999 > 0U) {
+        snprintf(percentile, sizeof(percentile), "99.9 %% %6u ns,", (unsigned)p999);
+    }
+    printf("  %-16s %9u calls %9.1f ns/call, %-17s max %9.1f ns, total %9.3f ms\n", name, (unsigned)count,
+           count > 0U ? (double)host_ns / count : 0.0, percentile, (double)host_ns_max, (double)host_ns / 1e6);
+}
+
+static void
+prv_print_irq(const char* name, IRQn_Type irq) {
+    const co_sim_irq_stats_t* stats = co_sim_irq_stats(irq);
+
+    prv_print_cpu(name, stats->count, stats->host_ns, stats->host_ns_max, co_sim_irq_percentile_ns(irq, 0.999));
+}
+
+static void
+prv_report(void) {
+    const co_sim_can_stats_t* can = co_sim_can_stats(0);
+    const CO_CANmodule_t* module = prv_node.canOpen_Obj->CANmodule;
+
+    printf("replayed %u frames (%u lines skipped) in %.3f s virtual time\n", (unsigned)prv_log.frames,
+           (unsigned)prv_log.skipped, (double)co_sim_now_ns() / 1e9);
+    printf("received %u, rejected by filters %u, sent %u\n", (unsigned)can->rx, (unsigned)can->filtered,
+           (unsigned)can->tx);
+    printf("dropped: RX FIFO full %u (driver saw %u + %u overruns, FIFO max fill %u)\n", (unsigned)can->overrun,
+           (unsigned)module->rxOverrun[0], (unsigned)module->rxOverrun[1], (unsigned)can->fifoMax);
+#if CO_CAN_RX_DEFERRED
+    printf("dropped: deferred queue full %u + %u\n", (unsigned)module->rxQueue[0].overflow,
+           (unsigned)module->rxQueue[1].overflow);
+#endif
+    printf("TX backlog: max %u buffers waiting (%u at main loop), longest wait %.1f us\n",
+           (unsigned)module->txStats.highWater, (unsigned)prv_process.txBacklogMax,
+           (double)module->txStats.waitMax * 1e6 / SystemCoreClock);
+    printf("CPU time, host ns without simulator:\n");
+    prv_print_irq("CAN RX0", CAN1_RX0_IRQn);
+    prv_print_irq("CAN RX1", CAN1_RX1_IRQn);
+    prv_print_irq("CAN TX", CAN1_TX_IRQn);
+    prv_print_irq("CANopenNode_IRQ", TIM3_IRQn);
+    prv_print_cpu("Process", prv_process.count, prv_process.host_ns, prv_process.host_ns_max, 0U);
+}
+
+static void
+prv_usage(void) {
+    fprintf(stderr, "usage: co_replay [-s speed] [-b kbit] [-n node] [-l loop_us] [-c scale] file.log\n");
+    exit(2);
+}
+
+int
+main(int argc, char* argv[]) {
+    uint32_t kbit = 500U;
+    uint32_t loop_us = 100U;
+    uint8_t nodeId = 5U;
+    uint64_t end;
+    int opt;
+
+    prv_log.speed = 1.0;
+    while ((opt = getopt(argc, argv, "s:b:n:l:c:")) != -1) {
+        switch (opt) {
+            case 's': prv_log.speed = strtod(optarg, NULL); break;
+            case 'b': kbit = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'n': nodeId = (uint8_t)strtoul(optarg, NULL, 0); break;
+            case 'l': loop_us = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'c': co_sim_irq_cost_scale = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default: prv_usage();
+        }
+    }
+    if (optind != argc - 1 || loop_us == 0U || (kbit != 125U && kbit != 250U && kbit != 500U && kbit != 1000U)) {
+        prv_usage();
+    }
+    prv_log.file = fopen(argv[optind], "r");
+    if (prv_log.file == NULL) {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    co_sim_reset();
+    OD_sim_defaults();
+    co_sim_can_handle(&prv_hcan, CAN1, kbit);
+    co_sim_can_bind(&prv_hcan, 1U);
+    prv_htim.Instance = TIM3;
+    prv_htim.Init.Prescaler = 83U; /* 1 MHz */
+    prv_htim.Init.Period = 999U;
+    HAL_TIM_Base_Init(&prv_htim);
+    co_sim_tim_bind(&prv_htim, 2U);
+
+    prv_node.desiredNodeID = nodeId;
+    prv_node.baudrate = (uint16_t)kbit;
+    prv_node.CANHandle = &prv_hcan;
+    prv_node.CANInitFunction = prv_can_init;
+    prv_node.timerHandle = &prv_htim;
+    /* Returns 0 from CANopenNode_ResetCommunication() on success */
+    if (CANopenNode_Init(&prv_node) != 0) {
+        fprintf(stderr, "CANopenNode_Init failed\n");
+        return 1;
+    }
+    co_sim_irq_stats_clear();
+
+    while (prv_log_feed()) {
+        prv_loop(loop_us);
+    }
+    end = co_sim_now_ns() + REPLAY_TAIL_NS;
+    while (co_sim_now_ns() < end) {
+        prv_loop(loop_us);
+    }
+    fclose(prv_log.file);
+    prv_report();
+    return 0;
+}
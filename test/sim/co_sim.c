@@ -0,0 +1,2703 @@
+/*
+ * Host simulator of the STM32 peripherals used by CANopenSTM32.
+ *
+ * @file        co_sim.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "co_sim.h"
+
+/* APB1 clock of CAN, timer clock is twice as fast */
+#define PRV_PCLK1_MHZ      42U
+#define PRV_TIMCLK_MHZ     84U
+#define PRV_IRQ_MAX        16U
+#define PRV_HIST_BINS      1024U /* Histogram of interrupt host time */
+#define PRV_HIST_NS        8U
+#define PRV_NVIC_LINES     96U
+#define PRV_EXT_QUEUE      4096U
+#define PRV_STORM_LIMIT    1000000U
+#define PRV_THREAD         0x100U /* Execution priority of thread mode */
+#define PRV_INTERMISSION   3U
+#define PRV_JOIN_BITS      11U
+#define PRV_FD_ARBITRATION 17U /* SOF to BRS of CAN FD frame */
+#if CO_SIM_FDCAN
+/* FDCAN kernel clock and fields of message RAM elements */
+#define PRV_FDCAN_CLK_MHZ  80U
+#define PRV_FDCAN_FIDX_POS 24U
+#define PRV_FDCAN_ANMF     (1UL << 31) /* Accepted non-matching frame */
+#endif
+
+/* Storage of the simulated registers */
+#if CO_SIM_FDCAN
+co_sim_fdcan_block_t co_sim_fdcan_ip[2] __attribute__((aligned(0x400)));
+uint32_t co_sim_sramcan[2 * SRAMCAN_SIZE / 4U];
+#else
+co_sim_can_block_t co_sim_can_ip[2] __attribute__((aligned(0x400)));
+#endif
+TIM_TypeDef co_sim_tim[4];
+SysTick_Type co_sim_systick;
+SCB_Type co_sim_scb;
+DWT_Type co_sim_dwt;
+CoreDebug_Type co_sim_coredebug;
+uint32_t SystemCoreClock = 168000000U;
+
+uint64_t co_sim_deadline_ns = CO_SIM_NEVER;
+bool co_sim_sleep_timeout;
+uint64_t co_sim_irq_cost_ns;
+uint32_t co_sim_irq_cost_scale;
+void (*co_sim_system_reset)(void);
+uint32_t co_sim_filter_configs;
+
+typedef struct {
+    IRQn_Type irq;
+    void (*handler)(void* object);
+    void* object;
+    co_sim_irq_stats_t stats;
+    uint32_t hist[PRV_HIST_BINS];
+} prv_irq_t;
+
+#if !CO_SIM_FDCAN
+typedef struct {
+    uint32_t RIR, RDTR, RDLR, RDHR;
+} prv_slot_t;
+#endif
+
+typedef struct {
+#if CO_SIM_FDCAN
+    uint32_t txPut; /* Put index of TX FIFO */
+#else
+    prv_slot_t slot[2][3];
+#endif
+    uint64_t txReady[3]; /* Time of transmit request */
+    uint32_t txSeq[3];   /* Order of transmit requests, for TXFP */
+    int txInFlight;      /* Mailbox on the bus or -1 */
+    uint64_t joinAt;     /* Controller takes part in bus activity from this time */
+    co_sim_can_stats_t stats;
+} prv_can_t;
+
+typedef struct {
+    uint64_t t0;       /* Time of counter value cnt0 */
+    uint32_t cnt0;
+    uint64_t lastTick; /* Counter ticks since t0 already processed */
+    bool running;
+} prv_tim_t;
+
+static struct {
+    uint64_t now;
+    uint32_t primask;
+    uint32_t basepri;
+    uint32_t active; /* Current execution priority */
+    bool event;      /* Event register of WFE */
+    uint32_t pendPrev;
+    uint64_t nestedHost;
+    uint64_t nestedSim;
+    uint32_t simDepth;
+    uint64_t simStart;
+    uint64_t simHost; /* Host time spent in simulator code */
+    uint32_t storm;
+    uint32_t txSeq;
+    uint8_t nvicPrio[PRV_NVIC_LINES];
+    bool nvicEnabled[PRV_NVIC_LINES];
+    prv_irq_t irqs[PRV_IRQ_MAX];
+    uint32_t irqCount;
+    prv_can_t can[2];
+    prv_tim_t tim[4];
+} prv;
+
+static struct {
+    bool busy;
+    int source;
+    int mailbox;
+    co_sim_frame_t frame;
+    uint64_t sof;
+    uint64_t eof;
+    uint64_t idle;
+    co_sim_frame_t ext[PRV_EXT_QUEUE];
+    uint64_t extRelease[PRV_EXT_QUEUE];
+    uint32_t extHead;
+    uint32_t extCount;
+    co_sim_monitor_t monitor;
+    void* monitorObject;
+} prv_bus;
+
+static void prv_dispatch(void);
+#if CO_SIM_FDCAN
+static void prv_can_time(void);
+#endif
+
+/*******************************************************************************
+ * Host clock
+ ******************************************************************************/
+static uint64_t
+prv_clock_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* Time stamp counter is read in a few ns, against tens of ns of the system
+ * clock, calibrate it once against the system clock */
+static double prv_nsPerTick;
+
+uint64_t
+co_sim_host_ns(void) {
+    static uint64_t tick0;
+    double nsPerTick = prv_nsPerTick;
+
+    if (nsPerTick == 0.0) {
+        uint64_t ns0 = prv_clock_ns();
+        uint64_t ns;
+
+        tick0 = __builtin_ia32_rdtsc();
+        do {
+            ns = prv_clock_ns();
+        } while (ns - ns0 < 20000000U);
+        nsPerTick = (double)(ns - ns0) / (double)(__builtin_ia32_rdtsc() - tick0);
+        prv_nsPerTick = nsPerTick;
+    }
+    return (uint64_t)((double)(__builtin_ia32_rdtsc() - tick0) * nsPerTick);
+}
+
+double
+co_sim_host_ghz(void) {
+    (void)co_sim_host_ns();
+    return 1.0 / prv_nsPerTick;
+}
+#else
+uint64_t
+co_sim_host_ns(void) {
+    return prv_clock_ns();
+}
+
+double
+co_sim_host_ghz(void) {
+    return 0.0;
+}
+#endif
+
+uint64_t
+co_sim_overhead_ns(void) {
+    return prv.simHost;
+}
+
+/* Host time between outermost enter and leave is simulator overhead, except
+ * for interrupt handlers run from it */
+static void
+prv_sim_enter(void) {
+    if (prv.simDepth++ == 0U) {
+        prv.simStart = co_sim_host_ns();
+    }
+}
+
+static void
+prv_sim_leave(void) {
+    if (--prv.simDepth == 0U) {
+        prv.simHost += co_sim_host_ns() - prv.simStart;
+    }
+}
+
+uint32_t
+co_sim_host_cycles(void) {
+    return (uint32_t)(co_sim_host_ns() - prv.simHost);
+}
+
+/*******************************************************************************
+ * Timers
+ ******************************************************************************/
+static uint64_t
+prv_tim_period(const TIM_TypeDef* tim) {
+    return (uint64_t)tim->ARR + 1U;
+}
+
+/* Counter ticks from t0 to time */
+static uint64_t
+prv_tim_ticks(int i, uint64_t time) {
+    const TIM_TypeDef* tim = &co_sim_tim[i];
+
+    return (time - prv.tim[i].t0) * PRV_TIMCLK_MHZ / (1000U * ((uint64_t)tim->PSC + 1U));
+}
+
+/* Time of counter tick */
+static uint64_t
+prv_tim_time(int i, uint64_t tick) {
+    const TIM_TypeDef* tim = &co_sim_tim[i];
+    uint64_t ns = tick * 1000U * ((uint64_t)tim->PSC + 1U);
+
+    return prv.tim[i].t0 + (ns + PRV_TIMCLK_MHZ - 1U) / PRV_TIMCLK_MHZ;
+}
+
+/* First tick after lastTick with counter value */
+static uint64_t
+prv_tim_match(int i, uint32_t value) {
+    uint64_t period = prv_tim_period(&co_sim_tim[i]);
+    uint64_t next = prv.tim[i].lastTick + 1U;
+    uint64_t counter = ((uint64_t)prv.tim[i].cnt0 + next) % period;
+
+    if (value >= period) {
+        return CO_SIM_NEVER;
+    }
+    return next + (((uint64_t)value + period - counter) % period);
+}
+
+static uint32_t
+prv_tim_ccr(int i, int ch) {
+    return (&co_sim_tim[i].CCR1)[ch];
+}
+
+static void
+prv_tim_update(int i) {
+    TIM_TypeDef* tim = &co_sim_tim[i];
+    uint64_t ticks;
+
+    if (!prv.tim[i].running) {
+        return;
+    }
+    ticks = prv_tim_ticks(i, prv.now);
+    if (ticks == prv.tim[i].lastTick) {
+        return;
+    }
+    for (int ch = 0; ch < 4; ch++) {
+        if (prv_tim_match(i, prv_tim_ccr(i, ch)) <= ticks) {
+            tim->SR |= TIM_SR_CC1IF << ch;
+        }
+    }
+    if (prv_tim_match(i, 0U) <= ticks) {
+        tim->SR |= TIM_SR_UIF;
+    }
+    prv.tim[i].lastTick = ticks;
+    tim->CNT = (uint32_t)(((uint64_t)prv.tim[i].cnt0 + ticks) % prv_tim_period(tim));
+}
+
+static void
+prv_tim_rebase(int i) {
+    prv_tim_update(i);
+    prv.tim[i].t0 = prv.now;
+    prv.tim[i].cnt0 = co_sim_tim[i].CNT;
+    prv.tim[i].lastTick = 0U;
+    prv.tim[i].running = (co_sim_tim[i].CR1 & TIM_CR1_CEN) != 0U;
+}
+
+static uint64_t
+prv_tim_next(int i) {
+    const TIM_TypeDef* tim = &co_sim_tim[i];
+    uint64_t tick = CO_SIM_NEVER;
+
+    if (!prv.tim[i].running) {
+        return CO_SIM_NEVER;
+    }
+    for (int ch = 0; ch < 4; ch++) {
+        if ((tim->DIER & (TIM_DIER_CC1IE << ch)) != 0U) {
+            uint64_t match = prv_tim_match(i, prv_tim_ccr(i, ch));
+            tick = match < tick ? match : tick;
+        }
+    }
+    if ((tim->DIER & TIM_DIER_UIE) != 0U) {
+        uint64_t match = prv_tim_match(i, 0U);
+        tick = match < tick ? match : tick;
+    }
+    return tick == CO_SIM_NEVER ? CO_SIM_NEVER : prv_tim_time(i, tick);
+}
+
+/* Event generation register is written with plain stores, act on it lazily */
+static void
+prv_tim_egr(void) {
+    for (int i = 0; i < 4; i++) {
+        TIM_TypeDef* tim = &co_sim_tim[i];
+        uint32_t egr = tim->EGR;
+
+        if (egr == 0U) {
+            continue;
+        }
+        tim->EGR = 0U;
+        if ((egr & TIM_EGR_UG) != 0U) {
+            tim->CNT = 0U;
+            prv_tim_rebase(i);
+            tim->SR |= TIM_SR_UIF;
+        }
+        tim->SR |= egr & (TIM_EGR_CC1G | TIM_EGR_CC2G | TIM_EGR_CC3G | TIM_EGR_CC4G);
+    }
+}
+
+/*******************************************************************************
+ * Time
+ ******************************************************************************/
+static void
+prv_set_time(uint64_t time) {
+    uint64_t cycles;
+    uint32_t load;
+
+    if (time <= prv.now) {
+        return;
+    }
+    prv.now = time;
+    prv.storm = 0U;
+    cycles = (uint64_t)(((unsigned __int128)time * SystemCoreClock) / 1000000000U);
+    load = SystemCoreClock / 1000U;
+    co_sim_dwt.CYCCNT = (uint32_t)cycles;
+    co_sim_systick.LOAD = load - 1U;
+    co_sim_systick.VAL = load - 1U - (uint32_t)(cycles % load);
+    for (int i = 0; i < 4; i++) {
+        prv_tim_update(i);
+    }
+#if CO_SIM_FDCAN
+    prv_can_time();
+#endif
+}
+
+uint64_t
+co_sim_now_ns(void) {
+    return prv.now;
+}
+
+uint32_t
+HAL_GetTick(void) {
+    return (uint32_t)(prv.now / 1000000U);
+}
+
+uint32_t
+HAL_RCC_GetHCLKFreq(void) {
+    return SystemCoreClock;
+}
+
+uint32_t
+HAL_RCC_GetPCLK1Freq(void) {
+    return PRV_PCLK1_MHZ * 1000000U;
+}
+
+/*******************************************************************************
+ * CAN bus
+ ******************************************************************************/
+/* Data bytes of DLC code of CAN FD frame */
+static const uint8_t prv_dlc_bytes[16] = {0U, 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 12U, 16U, 20U, 24U, 32U, 48U, 64U};
+
+uint32_t
+co_sim_frame_bytes(const co_sim_frame_t* frame) {
+    uint32_t dlc = frame->dlc & 0xFU;
+
+    if ((frame->dlc & CO_SIM_FDF) != 0U) {
+        return prv_dlc_bytes[dlc];
+    }
+    return frame->rtr != 0U ? 0U : (dlc > 8U ? 8U : dlc);
+}
+
+/* Stuff bits after runs of five equal bits, those of the first split bits
+ * are counted in *before */
+static uint32_t
+prv_stuff_bits(const uint8_t* bits, uint32_t len, uint32_t split, uint32_t* before) {
+    uint32_t stuffed = 0U;
+    uint32_t run = 0U;
+    uint8_t last = 0U;
+
+    for (uint32_t i = 0U; i < len; i++) {
+        run = (i > 0U && bits[i] == last) ? run + 1U : 1U;
+        last = bits[i];
+        if (run == 5U) {
+            /* Stuff bit of opposite level starts a new run */
+            stuffed++;
+            last = (uint8_t)!last;
+            run = 1U;
+        }
+        if (i + 1U == split) {
+            *before = stuffed;
+        }
+    }
+    return stuffed;
+}
+
+/* Length of classic data frame with bit stuffing, from SOF to the end of EOF */
+static uint32_t
+prv_frame_bits_classic(const co_sim_frame_t* frame) {
+    uint8_t bits[128];
+    uint32_t len = 0U;
+    uint32_t dlc = frame->dlc & 0xFU;
+    uint32_t bytes = co_sim_frame_bytes(frame);
+    uint16_t crc = 0U;
+
+    bits[len++] = 0U;
+    for (int i = 10; i >= 0; i--) {
+        bits[len++] = (uint8_t)((frame->id >> i) & 1U);
+    }
+    bits[len++] = frame->rtr != 0U ? 1U : 0U;
+    bits[len++] = 0U; /* IDE */
+    bits[len++] = 0U; /* r0 */
+    for (int i = 3; i >= 0; i--) {
+        bits[len++] = (uint8_t)((dlc >> i) & 1U);
+    }
+    for (uint32_t b = 0U; b < bytes; b++) {
+        for (int i = 7; i >= 0; i--) {
+            bits[len++] = (uint8_t)((frame->data[b] >> i) & 1U);
+        }
+    }
+    for (uint32_t i = 0U; i < len; i++) {
+        uint16_t next = (uint16_t)(bits[i] ^ ((crc >> 14) & 1U));
+        crc = (uint16_t)((crc << 1) & 0x7FFFU);
+        if (next != 0U) {
+            crc ^= 0x4599U;
+        }
+    }
+    for (int i = 14; i >= 0; i--) {
+        bits[len++] = (uint8_t)((crc >> i) & 1U);
+    }
+    /* CRC delimiter, ACK slot and delimiter, EOF */
+    return len + prv_stuff_bits(bits, len, 0U, NULL) + 10U;
+}
+
+/* CAN FD frame: SOF to BRS and CRC delimiter to EOF are in nominal bit time,
+ * ESI to the end of CRC in the data phase. Stuff count and CRC have fixed
+ * stuff bits, before the first and after every four bits, their values do
+ * not change the length. */
+uint32_t
+co_sim_frame_bits_fd(const co_sim_frame_t* frame, uint32_t* dataBits) {
+    uint8_t bits[PRV_FD_ARBITRATION + 5U + 64U * 8U];
+    uint32_t len = 0U;
+    uint32_t dlc = frame->dlc & 0xFU;
+    uint32_t bytes = co_sim_frame_bytes(frame);
+    uint32_t crc = bytes <= 16U ? 17U : 21U;
+    uint32_t head = 0U;
+    uint32_t total;
+
+    if ((frame->dlc & CO_SIM_FDF) == 0U) {
+        if (dataBits != NULL) {
+            *dataBits = 0U;
+        }
+        return prv_frame_bits_classic(frame);
+    }
+    bits[len++] = 0U;
+    for (int i = 10; i >= 0; i--) {
+        bits[len++] = (uint8_t)((frame->id >> i) & 1U);
+    }
+    bits[len++] = 0U; /* RRS */
+    bits[len++] = 0U; /* IDE */
+    bits[len++] = 1U; /* FDF */
+    bits[len++] = 0U; /* res */
+    bits[len++] = (frame->dlc & CO_SIM_BRS) != 0U ? 1U : 0U;
+    bits[len++] = 0U; /* ESI, error active */
+    for (int i = 3; i >= 0; i--) {
+        bits[len++] = (uint8_t)((dlc >> i) & 1U);
+    }
+    for (uint32_t b = 0U; b < bytes; b++) {
+        for (int i = 7; i >= 0; i--) {
+            bits[len++] = (uint8_t)((frame->data[b] >> i) & 1U);
+        }
+    }
+    total = len + prv_stuff_bits(bits, len, PRV_FD_ARBITRATION, &head);
+    /* Stuff count, CRC, their fixed stuff bits, then as classic frame */
+    total += 4U + crc + 1U + (4U + crc) / 4U + 10U;
+    if (dataBits != NULL) {
+        *dataBits = total - (PRV_FD_ARBITRATION + head + 10U);
+    }
+    return total;
+}
+
+uint32_t
+co_sim_frame_bits(const co_sim_frame_t* frame) {
+    return co_sim_frame_bits_fd(frame, NULL);
+}
+
+#if CO_SIM_FDCAN
+/*******************************************************************************
+ * FDCAN controllers
+ ******************************************************************************/
+/* Interrupt line select group (ILS bit) of each interrupt flag */
+static const uint8_t prv_fdcan_group[24] = {0U, 0U, 0U, 1U, 1U, 1U, 2U, 2U, 2U, 3U, 3U, 3U,
+                                            3U, 4U, 4U, 4U, 5U, 5U, 6U, 6U, 6U, 6U, 6U, 6U};
+
+static int
+prv_can_index(const FDCAN_GlobalTypeDef* can) {
+    return can == FDCAN1 ? 0 : 1;
+}
+
+/* Element of message RAM of controller */
+static uint32_t*
+prv_element(int c, uint32_t offset, uint32_t size, uint32_t index) {
+    return &co_sim_sramcan[((uint32_t)c * SRAMCAN_SIZE + offset + index * size) / 4U];
+}
+
+static bool
+prv_can_offline(int c) {
+    return (co_sim_fdcan_ip[c].regs.CCCR & FDCAN_CCCR_INIT) != 0U;
+}
+
+static bool
+prv_can_started(int c) {
+    return !prv_can_offline(c) && prv.now >= prv.can[c].joinAt;
+}
+
+static uint64_t
+prv_fdcan_ns(uint32_t bits, uint32_t prescaler, uint32_t seg1, uint32_t seg2) {
+    return (uint64_t)bits * (prescaler + 1U) * (3U + seg1 + seg2) * 1000U / PRV_FDCAN_CLK_MHZ;
+}
+
+/* Bit timing of the bus, from the first controller which is configured */
+static uint64_t
+prv_bus_ns(uint32_t bits) {
+    uint32_t nbtp = 0U;
+
+    for (int c = 1; c >= 0; c--) {
+        if (co_sim_fdcan_ip[c].regs.NBTP != 0U) {
+            nbtp = co_sim_fdcan_ip[c].regs.NBTP;
+        }
+    }
+    if (nbtp == 0U) { /* 500 kbit/s */
+        nbtp = (9UL << FDCAN_NBTP_NBRP_Pos) | (12UL << FDCAN_NBTP_NTSEG1_Pos) | (1UL << FDCAN_NBTP_NTSEG2_Pos);
+    }
+    return prv_fdcan_ns(bits, (nbtp & FDCAN_NBTP_NBRP) >> FDCAN_NBTP_NBRP_Pos,
+                        (nbtp & FDCAN_NBTP_NTSEG1) >> FDCAN_NBTP_NTSEG1_Pos,
+                        (nbtp & FDCAN_NBTP_NTSEG2) >> FDCAN_NBTP_NTSEG2_Pos);
+}
+
+/* Data phase bit timing, from the first controller with bit rate switching */
+static uint64_t
+prv_data_ns(uint32_t bits) {
+    for (int c = 0; c < 2; c++) {
+        const FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+
+        if ((can->CCCR & FDCAN_CCCR_BRSE) != 0U && can->NBTP != 0U) {
+            return prv_fdcan_ns(bits, (can->DBTP & FDCAN_DBTP_DBRP) >> FDCAN_DBTP_DBRP_Pos,
+                                (can->DBTP & FDCAN_DBTP_DTSEG1) >> FDCAN_DBTP_DTSEG1_Pos,
+                                (can->DBTP & FDCAN_DBTP_DTSEG2) >> FDCAN_DBTP_DTSEG2_Pos);
+        }
+    }
+    return prv_bus_ns(bits);
+}
+
+/* Timestamp counter value at given time, counts nominal bits with TCP prescaler */
+static uint32_t
+prv_fdcan_stamp(int c, uint64_t time) {
+    const FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+    uint64_t tick = prv_bus_ns(1U) * (((can->TSCC & FDCAN_TSCC_TCP) >> FDCAN_TSCC_TCP_Pos) + 1U);
+
+    if ((can->TSCC & FDCAN_TSCC_TSS) != FDCAN_TIMESTAMP_INTERNAL) {
+        return 0U;
+    }
+    return (uint32_t)((time / tick) & FDCAN_TSCV_TSC);
+}
+
+static void
+prv_can_time(void) {
+    for (int c = 0; c < 2; c++) {
+        co_sim_fdcan_ip[c].regs.TSCV = prv_fdcan_stamp(c, prv.now);
+    }
+}
+
+/* TX FIFO/queue status from pending buffers. Queue puts into the first free
+ * buffer, its free level reads 0 */
+static void
+prv_fdcan_txfqs(int c) {
+    FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+    uint32_t pending = can->TXBRP & 0x7U;
+    uint32_t count = (uint32_t)__builtin_popcount(pending);
+    uint32_t txfqs;
+
+    if ((can->TXBC & FDCAN_TXBC_TFQM) != 0U) {
+        uint32_t put = 0U;
+        while (put < SRAMCAN_TFQ_NBR - 1U && (pending & (1UL << put)) != 0U) {
+            put++;
+        }
+        txfqs = put << FDCAN_TXFQS_TFQPI_Pos;
+    } else {
+        uint32_t put = prv.can[c].txPut;
+        txfqs = (SRAMCAN_TFQ_NBR - count) | (((put + SRAMCAN_TFQ_NBR - count) % SRAMCAN_TFQ_NBR) << FDCAN_TXFQS_TFGI_Pos)
+                | (put << FDCAN_TXFQS_TFQPI_Pos);
+    }
+    can->TXFQS = txfqs | (count == SRAMCAN_TFQ_NBR ? FDCAN_TXFQS_TFQF : 0U);
+}
+
+/* Fill level, get and put index of a FIFO status register, all FIFOs have 3
+ * elements. Acknowledged index releases it and all older elements. */
+static void
+prv_fdcan_ack(volatile uint32_t* status, uint32_t index) {
+    uint32_t s = *status;
+    uint32_t fill = s & FDCAN_RXF0S_F0FL;
+    uint32_t get = (s & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+    uint32_t n = (index + 3U - get) % 3U + 1U;
+
+    if (index >= 3U || fill == 0U || n > fill) {
+        return;
+    }
+    fill -= n;
+    get = (index + 1U) % 3U;
+    *status = (s & ~(FDCAN_RXF0S_F0FL | FDCAN_RXF0S_F0GI | FDCAN_RXF0S_F0F)) | fill | (get << FDCAN_RXF0S_F0GI_Pos);
+}
+
+/* Put index of a FIFO with free element, or -1 if full */
+static int
+prv_fdcan_put(volatile uint32_t* status) {
+    uint32_t s = *status;
+
+    return (s & FDCAN_RXF0S_F0FL) >= 3U ? -1 : (int)((s & FDCAN_RXF0S_F0PI) >> FDCAN_RXF0S_F0PI_Pos);
+}
+
+static void
+prv_fdcan_push(volatile uint32_t* status) {
+    uint32_t s = *status;
+    uint32_t fill = (s & FDCAN_RXF0S_F0FL) + 1U;
+    uint32_t put = (((s & FDCAN_RXF0S_F0PI) >> FDCAN_RXF0S_F0PI_Pos) + 1U) % 3U;
+
+    *status = (s & ~(FDCAN_RXF0S_F0FL | FDCAN_RXF0S_F0PI)) | fill | (put << FDCAN_RXF0S_F0PI_Pos)
+              | (fill == 3U ? FDCAN_RXF0S_F0F : 0U);
+}
+
+/* Transmit buffers take the place of bxCAN mailboxes in the bus engine */
+static void
+prv_mailbox_frame(int c, int k, co_sim_frame_t* frame) {
+    const FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+    const uint32_t* t = prv_element(c, SRAMCAN_TFQSA, SRAMCAN_TFQ_SIZE, (uint32_t)k);
+
+    memset(frame, 0, sizeof(*frame));
+    frame->id = (uint16_t)((t[0] >> 18) & 0x7FFU);
+    frame->rtr = (t[0] & FDCAN_REMOTE_FRAME) != 0U ? 1U : 0U;
+    frame->dlc = (uint8_t)((t[1] >> 16) & 0xFU);
+    /* FDF and BRS are ignored unless enabled in CCCR, CAN FD has no remote frames */
+    if ((t[1] & FDCAN_FD_CAN) != 0U && (can->CCCR & FDCAN_CCCR_FDOE) != 0U) {
+        frame->dlc |= CO_SIM_FDF;
+        frame->rtr = 0U;
+        if ((t[1] & FDCAN_BRS_ON) != 0U && (can->CCCR & FDCAN_CCCR_BRSE) != 0U) {
+            frame->dlc |= CO_SIM_BRS;
+        }
+    }
+    memcpy(frame->data, &t[2], co_sim_frame_bytes(frame));
+}
+
+static bool
+prv_mailbox_pending(int c, int k) {
+    return (co_sim_fdcan_ip[c].regs.TXBRP & (1UL << k)) != 0U && prv.can[c].txInFlight != k;
+}
+
+/* Buffer which the controller offers for arbitration, or -1: lowest
+ * identifier in queue mode, oldest request in FIFO mode */
+static int
+prv_mailbox_next(int c, uint64_t time) {
+    bool queue = (co_sim_fdcan_ip[c].regs.TXBC & FDCAN_TXBC_TFQM) != 0U;
+    int best = -1;
+    uint32_t bestKey = 0U;
+
+    for (int k = 0; k < (int)SRAMCAN_TFQ_NBR; k++) {
+        co_sim_frame_t frame;
+        uint32_t key;
+
+        if (!prv_mailbox_pending(c, k) || prv.can[c].txReady[k] > time) {
+            continue;
+        }
+        prv_mailbox_frame(c, k, &frame);
+        key = queue ? ((uint32_t)frame.id << 1) | frame.rtr : prv.can[c].txSeq[k];
+        if (best < 0 || key < bestKey) {
+            best = k;
+            bestKey = key;
+        }
+    }
+    return best;
+}
+
+/* Element of TX event FIFO for transmitted buffer with EFC set */
+static void
+prv_fdcan_event(int c, const uint32_t* t, uint64_t sof) {
+    FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+    int put = prv_fdcan_put(&can->TXEFS);
+    uint32_t* e;
+
+    if (put < 0) {
+        can->TXEFS |= FDCAN_TXEFS_TEFL;
+        can->IR |= FDCAN_IR_TEFL;
+        return;
+    }
+    e = prv_element(c, SRAMCAN_TEFSA, SRAMCAN_TEF_SIZE, (uint32_t)put);
+    e[0] = t[0];
+    e[1] = prv_fdcan_stamp(c, sof) | (t[1] & (0xF0000U | FDCAN_BRS_ON | FDCAN_FD_CAN)) | (1UL << 22) /* TX event */
+           | (t[1] & 0xFF000000U);
+    prv_fdcan_push(&can->TXEFS);
+    can->IR |= FDCAN_IR_TEFN | ((can->TXEFS & FDCAN_TXEFS_EFF) != 0U ? FDCAN_IR_TEFF : 0U);
+}
+
+static void
+prv_mailbox_done(int c, int k, bool ok) {
+    FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+    const uint32_t* t = prv_element(c, SRAMCAN_TFQSA, SRAMCAN_TFQ_SIZE, (uint32_t)k);
+    uint32_t bit = 1UL << k;
+    uint64_t sof = prv.can[c].txInFlight == k ? prv_bus.sof : prv.now;
+
+    can->TXBRP &= ~bit;
+    if (prv.can[c].txInFlight == k) {
+        prv.can[c].txInFlight = -1;
+    }
+    if (ok) {
+        can->TXBTO |= bit;
+        can->IR |= (can->TXBTIE & bit) != 0U ? FDCAN_IR_TC : 0U;
+        if ((t[1] & FDCAN_STORE_TX_EVENTS) != 0U) {
+            prv_fdcan_event(c, t, sof);
+        }
+        prv.can[c].stats.tx++;
+    } else {
+        can->TXBCF |= bit;
+        can->IR |= (can->TXBCIE & bit) != 0U ? FDCAN_IR_TCF : 0U;
+    }
+    if ((can->TXBRP & 0x7U) == 0U) {
+        can->IR |= FDCAN_IR_TFE;
+    }
+    prv_fdcan_txfqs(c);
+}
+
+/* Store received frame in FIFO after acceptance filtering: standard filter
+ * elements in order, the first match decides, non-matching frames go by
+ * RXGFC. FIFOs are in blocking mode. */
+static bool
+prv_can_rx(int c, const co_sim_frame_t* frame, uint64_t sof) {
+    FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+    uint32_t count = (can->RXGFC & FDCAN_RXGFC_LSS) >> FDCAN_RXGFC_LSS_Pos;
+    uint32_t id = frame->id;
+    uint32_t action = (can->RXGFC & FDCAN_RXGFC_ANFS) >> FDCAN_RXGFC_ANFS_Pos; /* 0 FIFO0, 1 FIFO1, else reject */
+    uint32_t r1 = PRV_FDCAN_ANMF;
+    volatile uint32_t* status;
+    uint32_t* e;
+    int put;
+
+    if (!prv_can_started(c)) {
+        return false;
+    }
+    if ((frame->dlc & CO_SIM_FDF) != 0U && (can->CCCR & FDCAN_CCCR_FDOE) == 0U) {
+        return false; /* Protocol error, CAN FD frames are not enabled */
+    }
+    if (frame->rtr != 0U && (can->RXGFC & FDCAN_RXGFC_RRFS) != 0U) {
+        prv.can[c].stats.filtered++;
+        return false;
+    }
+    for (uint32_t i = 0U; i < count && i < SRAMCAN_FLS_NBR; i++) {
+        uint32_t element = *prv_element(c, SRAMCAN_FLSSA, SRAMCAN_FLS_SIZE, i);
+        uint32_t sfec = (element >> 27) & 0x7U;
+        uint32_t id1 = (element >> 16) & 0x7FFU;
+        uint32_t id2 = element & 0x7FFU;
+        bool hit;
+
+        switch (element >> 30) {
+            case FDCAN_FILTER_RANGE: hit = id >= id1 && id <= id2; break;
+            case FDCAN_FILTER_DUAL: hit = id == id1 || id == id2; break;
+            case FDCAN_FILTER_MASK: hit = ((id ^ id1) & id2) == 0U; break;
+            default: hit = false; break;
+        }
+        if (sfec == FDCAN_FILTER_DISABLE || !hit) {
+            continue;
+        }
+        /* Store in FIFO0 or FIFO1, with or without priority, anything else rejects */
+        action = (sfec == 1U || sfec == 5U) ? 0U : ((sfec == 2U || sfec == 6U) ? 1U : 2U);
+        r1 = i << PRV_FDCAN_FIDX_POS;
+        break;
+    }
+    if (action > 1U) {
+        prv.can[c].stats.filtered++;
+        return false;
+    }
+    status = action == 0U ? &can->RXF0S : &can->RXF1S;
+    put = prv_fdcan_put(status);
+    if (put < 0) {
+        *status |= FDCAN_RXF0S_RF0L;
+        can->IR |= action == 0U ? FDCAN_IR_RF0L : FDCAN_IR_RF1L;
+        prv.can[c].stats.overrun++;
+        return false;
+    }
+    e = prv_element(c, action == 0U ? SRAMCAN_RF0SA : SRAMCAN_RF1SA, SRAMCAN_RF0_SIZE, (uint32_t)put);
+    e[0] = (id << 18) | (frame->rtr != 0U ? FDCAN_REMOTE_FRAME : 0U);
+    e[1] = r1 | prv_fdcan_stamp(c, sof) | ((uint32_t)(frame->dlc & 0xFU) << 16)
+           | ((frame->dlc & CO_SIM_FDF) != 0U ? FDCAN_FD_CAN : 0U)
+           | ((frame->dlc & (CO_SIM_FDF | CO_SIM_BRS)) == (CO_SIM_FDF | CO_SIM_BRS) ? FDCAN_BRS_ON : 0U);
+    memcpy(&e[2], frame->data, co_sim_frame_bytes(frame));
+    prv_fdcan_push(status);
+    if (action == 0U) {
+        can->IR |= FDCAN_IR_RF0N | ((*status & FDCAN_RXF0S_F0F) != 0U ? FDCAN_IR_RF0F : 0U);
+    } else {
+        can->IR |= FDCAN_IR_RF1N | ((*status & FDCAN_RXF1S_F1F) != 0U ? FDCAN_IR_RF1F : 0U);
+    }
+    prv.can[c].stats.rx++;
+    if ((*status & FDCAN_RXF0S_F0FL) > prv.can[c].stats.fifoMax) {
+        prv.can[c].stats.fifoMax = *status & FDCAN_RXF0S_F0FL;
+    }
+    return true;
+}
+
+/* Setting CCE in initialization mode resets the FIFO and buffer state */
+static void
+prv_fdcan_flush(int c) {
+    FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+
+    can->RXF0S = 0U;
+    can->RXF1S = 0U;
+    can->TXBRP = 0U;
+    can->TXBTO = 0U;
+    can->TXBCF = 0U;
+    can->TXEFS = 0U;
+    prv.can[c].txPut = 0U;
+    prv_fdcan_txfqs(c);
+}
+
+/* Interrupt line 0 or 1 of controller */
+static bool
+prv_fdcan_line(int c, uint32_t line) {
+    const FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+    uint32_t active = can->IR & can->IE & 0xFFFFFFU;
+
+    if ((can->ILE & (1UL << line)) == 0U) {
+        return false;
+    }
+    for (; active != 0U; active &= active - 1U) {
+        if (((can->ILS >> prv_fdcan_group[__builtin_ctz(active)]) & 1U) == line) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Side effects of register writes of FDCAN */
+static bool
+prv_can_write(volatile uint32_t* reg, uint32_t value) {
+    for (int c = 0; c < 2; c++) {
+        FDCAN_GlobalTypeDef* can = &co_sim_fdcan_ip[c].regs;
+        uintptr_t offset = (uintptr_t)reg - (uintptr_t)co_sim_fdcan_ip[c].block;
+
+        if (offset >= sizeof(co_sim_fdcan_ip[c].block)) {
+            continue;
+        }
+        if (reg == &can->CCCR) {
+            bool leave = (can->CCCR & FDCAN_CCCR_INIT) != 0U && (value & FDCAN_CCCR_INIT) == 0U;
+            if ((value & FDCAN_CCCR_INIT) == 0U) {
+                value &= ~FDCAN_CCCR_CCE;
+            } else if ((value & FDCAN_CCCR_CCE) != 0U && (can->CCCR & FDCAN_CCCR_CCE) == 0U) {
+                prv_fdcan_flush(c);
+            }
+            can->CCCR = value;
+            if (leave) {
+                /* Synchronize on 11 recessive bits */
+                prv.can[c].joinAt = co_sim_bus_idle_ns() > prv.now ? co_sim_bus_idle_ns() : prv.now;
+                prv.can[c].joinAt += prv_bus_ns(PRV_JOIN_BITS);
+            }
+        } else if (reg == &can->TXBAR) {
+            for (uint32_t k = 0U; k < SRAMCAN_TFQ_NBR; k++) {
+                uint32_t bit = 1UL << k;
+                if ((value & bit) != 0U && (can->TXBRP & bit) == 0U) {
+                    can->TXBRP |= bit;
+                    can->TXBTO &= ~bit;
+                    can->TXBCF &= ~bit;
+                    prv.can[c].txReady[k] = prv.now;
+                    prv.can[c].txSeq[k] = prv.txSeq++;
+                    prv.can[c].txPut = (k + 1U) % SRAMCAN_TFQ_NBR;
+                }
+            }
+            prv_fdcan_txfqs(c);
+        } else if (reg == &can->TXBCR) {
+            for (int k = 0; k < (int)SRAMCAN_TFQ_NBR; k++) {
+                if ((value & (1UL << k)) != 0U && prv_mailbox_pending(c, k)) {
+                    prv_mailbox_done(c, k, false);
+                }
+            }
+        } else if (reg == &can->RXF0A || reg == &can->RXF1A) {
+            *reg = value;
+            prv_fdcan_ack(reg == &can->RXF0A ? &can->RXF0S : &can->RXF1S, value & 0x7U);
+        } else if (reg == &can->TXEFA) {
+            *reg = value;
+            prv_fdcan_ack(&can->TXEFS, value & 0x3U);
+        } else if (reg == &can->IR) {
+            /* Write 1 to clear, status copies of lost flags go with them */
+            can->IR &= ~value;
+            can->RXF0S &= (value & FDCAN_IR_RF0L) != 0U ? ~FDCAN_RXF0S_RF0L : ~0U;
+            can->RXF1S &= (value & FDCAN_IR_RF1L) != 0U ? ~FDCAN_RXF1S_RF1L : ~0U;
+            can->TXEFS &= (value & FDCAN_IR_TEFL) != 0U ? ~FDCAN_TXEFS_TEFL : ~0U;
+        } else if (reg == &can->TXBC) {
+            can->TXBC = value;
+            prv_fdcan_txfqs(c);
+        } else if (reg == &can->TSCC) {
+            can->TSCC = value;
+            can->TSCV = prv_fdcan_stamp(c, prv.now);
+        } else {
+            *reg = value;
+        }
+        return true;
+    }
+    return false;
+}
+
+static void
+prv_can_reset(void) {
+    memset(co_sim_fdcan_ip, 0, sizeof(co_sim_fdcan_ip));
+    memset(co_sim_sramcan, 0, sizeof(co_sim_sramcan));
+    for (int c = 0; c < 2; c++) {
+        co_sim_fdcan_ip[c].regs.CCCR = FDCAN_CCCR_INIT;
+        co_sim_fdcan_ip[c].regs.PSR = 0x707U;
+        prv.can[c].txInFlight = -1;
+        prv_fdcan_txfqs(c);
+    }
+}
+#else
+/*******************************************************************************
+ * bxCAN controllers
+ ******************************************************************************/
+static int
+prv_can_index(const CAN_TypeDef* can) {
+    return can == CAN1 ? 0 : 1;
+}
+
+static bool
+prv_can_offline(int c) {
+    return (co_sim_can_ip[c].regs.MCR & (CAN_MCR_INRQ | CAN_MCR_SLEEP)) != 0U;
+}
+
+static bool
+prv_can_started(int c) {
+    return !prv_can_offline(c) && prv.now >= prv.can[c].joinAt;
+}
+
+/* Bit timing of the bus, from the first controller which is configured */
+static uint64_t
+prv_bus_ns(uint32_t bits) {
+    uint32_t btr = 0U;
+
+    for (int c = 1; c >= 0; c--) {
+        if (co_sim_can_ip[c].regs.BTR != 0U) {
+            btr = co_sim_can_ip[c].regs.BTR;
+        }
+    }
+    if (btr == 0U) { /* 500 kbit/s */
+        btr = 5U | CAN_BS1_TQ(11U) | CAN_BS2_TQ(2U);
+    }
+    uint64_t tq = (uint64_t)(btr & CAN_BTR_BRP) + 1U;
+    uint64_t nbt = 3U + ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) + ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos);
+    return (uint64_t)bits * tq * nbt * 1000U / PRV_PCLK1_MHZ;
+}
+
+/* No data phase on bxCAN */
+static uint64_t
+prv_data_ns(uint32_t bits) {
+    return prv_bus_ns(bits);
+}
+
+static void
+prv_mailbox_frame(int c, int k, co_sim_frame_t* frame) {
+    const CAN_TxMailBox_TypeDef* mb = &co_sim_can_ip[c].regs.sTxMailBox[k];
+
+    frame->id = (uint16_t)((mb->TIR >> CAN_TI0R_STID_Pos) & 0x7FFU);
+    frame->rtr = (mb->TIR & CAN_TI0R_RTR) != 0U ? 1U : 0U;
+    frame->dlc = (uint8_t)(mb->TDTR & CAN_TDT0R_DLC);
+    for (int i = 0; i < 4; i++) {
+        frame->data[i] = (uint8_t)(mb->TDLR >> (8 * i));
+        frame->data[4 + i] = (uint8_t)(mb->TDHR >> (8 * i));
+    }
+}
+
+static bool
+prv_mailbox_pending(int c, int k) {
+    return (co_sim_can_ip[c].regs.TSR & (CAN_TSR_TME0 << k)) == 0U && prv.can[c].txInFlight != k;
+}
+
+static void
+prv_mailbox_code(int c) {
+    CAN_TypeDef* can = &co_sim_can_ip[c].regs;
+    uint32_t code = 0U;
+
+    for (uint32_t k = 0U; k < 3U; k++) {
+        if ((can->TSR & (CAN_TSR_TME0 << k)) != 0U) {
+            code = k;
+            break;
+        }
+    }
+    can->TSR = (can->TSR & ~CAN_TSR_CODE) | (code << CAN_TSR_CODE_Pos);
+}
+
+/* Mailbox which the controller offers for arbitration, or -1 */
+static int
+prv_mailbox_next(int c, uint64_t time) {
+    const CAN_TypeDef* can = &co_sim_can_ip[c].regs;
+    int best = -1;
+    uint32_t bestKey = 0U;
+
+    for (int k = 0; k < 3; k++) {
+        co_sim_frame_t frame;
+        uint32_t key;
+
+        if (!prv_mailbox_pending(c, k) || prv.can[c].txReady[k] > time) {
+            continue;
+        }
+        prv_mailbox_frame(c, k, &frame);
+        key = (can->MCR & CAN_MCR_TXFP) != 0U ? prv.can[c].txSeq[k] : ((uint32_t)frame.id << 1) | frame.rtr;
+        if (best < 0 || key < bestKey) {
+            best = k;
+            bestKey = key;
+        }
+    }
+    return best;
+}
+
+/* Store received frame in FIFO, on acceptance filter match */
+static bool
+prv_can_rx(int c, const co_sim_frame_t* frame, uint64_t sof) {
+    CAN_TypeDef* can = &co_sim_can_ip[c].regs;
+    CAN_TypeDef* master = CAN1;
+    uint32_t split = (master->FMR & CAN_FMR_CAN2SB) >> CAN_FMR_CAN2SB_Pos;
+    uint32_t first = c == 0 ? 0U : split;
+    uint32_t last = c == 0 ? split : 28U;
+    uint32_t w16 = ((uint32_t)frame->id << 5) | ((uint32_t)frame->rtr << 4);
+    uint32_t w32 = ((uint32_t)frame->id << 21) | ((uint32_t)frame->rtr << 1);
+    uint32_t fmiBase[2] = {0U, 0U};
+    int bestRank = -1;
+    uint32_t bestFmi = 0U;
+    uint32_t bestFifo = 0U;
+
+    if (!prv_can_started(c) || (master->FMR & CAN_FMR_FINIT) != 0U) {
+        return false;
+    }
+    if ((frame->dlc & CO_SIM_FDF) != 0U) {
+        return false; /* bxCAN does not tolerate CAN FD frames */
+    }
+    for (uint32_t b = 0U; b < 28U; b++) {
+        uint32_t bit = 1UL << b;
+        bool scale32 = (master->FS1R & bit) != 0U;
+        bool list = (master->FM1R & bit) != 0U;
+        uint32_t fifo = (master->FFA1R & bit) != 0U ? 1U : 0U;
+        uint32_t fr1 = master->sFilterRegister[b].FR1;
+        uint32_t fr2 = master->sFilterRegister[b].FR2;
+        uint32_t fmi = fmiBase[fifo];
+        int rank = (scale32 ? 2 : 0) + (list ? 1 : 0);
+        int hit = -1;
+
+        fmiBase[fifo] += scale32 ? (list ? 2U : 1U) : (list ? 4U : 2U);
+        if (b < first || b >= last || (master->FA1R & bit) == 0U) {
+            continue;
+        }
+        if (scale32 && list) {
+            hit = w32 == (fr1 & ~1U) ? 0 : (w32 == (fr2 & ~1U) ? 1 : -1);
+        } else if (scale32) {
+            hit = ((w32 ^ fr1) & fr2 & ~1U) == 0U ? 0 : -1;
+        } else if (list) {
+            uint32_t ids[4] = {fr1 & 0xFFFFU, fr1 >> 16, fr2 & 0xFFFFU, fr2 >> 16};
+            for (int i = 0; i < 4 && hit < 0; i++) {
+                hit = ids[i] == w16 ? i : -1;
+            }
+        } else if (((w16 ^ fr1) & (fr1 >> 16) & 0xFFFFU) == 0U) {
+            hit = 0;
+        } else if (((w16 ^ fr2) & (fr2 >> 16) & 0xFFFFU) == 0U) {
+            hit = 1;
+        }
+        if (hit >= 0 && (rank > bestRank || (rank == bestRank && fmi + (uint32_t)hit < bestFmi))) {
+            bestRank = rank;
+            bestFmi = fmi + (uint32_t)hit;
+            bestFifo = fifo;
+        }
+    }
+    if (bestRank < 0) {
+        prv.can[c].stats.filtered++;
+        return false;
+    }
+
+    volatile uint32_t* rfr = bestFifo == 0U ? &can->RF0R : &can->RF1R;
+    uint32_t level = *rfr & CAN_RF0R_FMP0;
+    prv_slot_t slot;
+    uint64_t bitNs = prv_bus_ns(1U);
+
+    slot.RIR = ((uint32_t)frame->id << CAN_RI0R_STID_Pos) | (frame->rtr != 0U ? CAN_RI0R_RTR : 0U);
+    slot.RDTR = (frame->dlc & CAN_RDT0R_DLC) | (bestFmi << CAN_RDT0R_FMI_Pos);
+    if ((can->MCR & CAN_MCR_TTCM) != 0U) {
+        slot.RDTR |= (uint32_t)((sof / bitNs) & 0xFFFFU) << CAN_RDT0R_TIME_Pos;
+    }
+    slot.RDLR = (uint32_t)frame->data[0] | ((uint32_t)frame->data[1] << 8) | ((uint32_t)frame->data[2] << 16)
+                | ((uint32_t)frame->data[3] << 24);
+    slot.RDHR = (uint32_t)frame->data[4] | ((uint32_t)frame->data[5] << 8) | ((uint32_t)frame->data[6] << 16)
+                | ((uint32_t)frame->data[7] << 24);
+    if (level == 3U) {
+        *rfr |= CAN_RF0R_FOVR0;
+        prv.can[c].stats.overrun++;
+        if ((can->MCR & CAN_MCR_RFLM) == 0U) {
+            prv.can[c].slot[bestFifo][2] = slot;
+        }
+        return false;
+    }
+    prv.can[c].slot[bestFifo][level] = slot;
+    if (level == 0U) {
+        CAN_FIFOMailBox_TypeDef* out = &can->sFIFOMailBox[bestFifo];
+        out->RIR = slot.RIR;
+        out->RDTR = slot.RDTR;
+        out->RDLR = slot.RDLR;
+        out->RDHR = slot.RDHR;
+    }
+    level++;
+    *rfr = (*rfr & ~CAN_RF0R_FMP0) | level | (level == 3U ? CAN_RF0R_FULL0 : 0U);
+    prv.can[c].stats.rx++;
+    if (level > prv.can[c].stats.fifoMax) {
+        prv.can[c].stats.fifoMax = level;
+    }
+    return true;
+}
+
+static void
+prv_can_release(int c, uint32_t fifo) {
+    CAN_TypeDef* can = &co_sim_can_ip[c].regs;
+    volatile uint32_t* rfr = fifo == 0U ? &can->RF0R : &can->RF1R;
+    uint32_t level = *rfr & CAN_RF0R_FMP0;
+    prv_slot_t* slot = prv.can[c].slot[fifo];
+
+    if (level == 0U) {
+        return;
+    }
+    slot[0] = slot[1];
+    slot[1] = slot[2];
+    level--;
+    *rfr = (*rfr & ~(CAN_RF0R_FMP0 | CAN_RF0R_FULL0)) | level;
+    if (level > 0U) {
+        CAN_FIFOMailBox_TypeDef* out = &can->sFIFOMailBox[fifo];
+        out->RIR = slot[0].RIR;
+        out->RDTR = slot[0].RDTR;
+        out->RDLR = slot[0].RDLR;
+        out->RDHR = slot[0].RDHR;
+    }
+}
+
+static void
+prv_mailbox_done(int c, int k, bool ok) {
+    CAN_TypeDef* can = &co_sim_can_ip[c].regs;
+
+    can->sTxMailBox[k].TIR &= ~CAN_TI0R_TXRQ;
+    can->TSR |= (CAN_TSR_RQCP0 | (ok ? CAN_TSR_TXOK0 : 0U)) << (8 * k);
+    can->TSR |= CAN_TSR_TME0 << k;
+    if (prv.can[c].txInFlight == k) {
+        prv.can[c].txInFlight = -1;
+    }
+    if (ok) {
+        prv.can[c].stats.tx++;
+    }
+    prv_mailbox_code(c);
+}
+
+/* Side effects of register writes of bxCAN */
+static bool
+prv_can_write(volatile uint32_t* reg, uint32_t value) {
+    for (int c = 0; c < 2; c++) {
+        CAN_TypeDef* can = &co_sim_can_ip[c].regs;
+        uintptr_t offset = (uintptr_t)reg - (uintptr_t)co_sim_can_ip[c].block;
+
+        if (offset >= sizeof(co_sim_can_ip[c].block)) {
+            continue;
+        }
+        if (reg == &can->MCR) {
+            bool leave = (can->MCR & CAN_MCR_INRQ) != 0U && (value & CAN_MCR_INRQ) == 0U;
+            can->MCR = value;
+            can->MSR = (can->MSR & ~(CAN_MSR_INAK | CAN_MSR_SLAK)) | ((value & CAN_MCR_INRQ) != 0U ? CAN_MSR_INAK : 0U)
+                       | ((value & CAN_MCR_SLEEP) != 0U ? CAN_MSR_SLAK : 0U);
+            if (leave) {
+                /* Synchronize on 11 recessive bits */
+                prv.can[c].joinAt = co_sim_bus_idle_ns() > prv.now ? co_sim_bus_idle_ns() : prv.now;
+                prv.can[c].joinAt += prv_bus_ns(PRV_JOIN_BITS);
+            }
+        } else if (reg == &can->TSR) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t shift = 8U * (uint32_t)k;
+                if ((value & (CAN_TSR_RQCP0 << shift)) != 0U) {
+                    can->TSR &= ~((CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 | CAN_TSR_TERR0) << shift);
+                }
+                if ((value & (CAN_TSR_ABRQ0 << shift)) != 0U && prv_mailbox_pending(c, k)) {
+                    prv_mailbox_done(c, k, false);
+                }
+            }
+        } else if (reg == &can->RF0R || reg == &can->RF1R) {
+            uint32_t fifo = reg == &can->RF0R ? 0U : 1U;
+            *reg &= ~(value & (CAN_RF0R_FULL0 | CAN_RF0R_FOVR0));
+            if ((value & CAN_RF0R_RFOM0) != 0U) {
+                prv_can_release(c, fifo);
+            }
+        } else if (offset >= offsetof(CAN_TypeDef, sTxMailBox) && offset < offsetof(CAN_TypeDef, sFIFOMailBox)
+                   && (offset % sizeof(CAN_TxMailBox_TypeDef)) == 0U) {
+            int k = (int)((offset - offsetof(CAN_TypeDef, sTxMailBox)) / sizeof(CAN_TxMailBox_TypeDef));
+            bool empty = (can->TSR & (CAN_TSR_TME0 << k)) != 0U;
+            if (empty || (value & CAN_TI0R_TXRQ) == 0U) {
+                *reg = value;
+            }
+            if (empty && (value & CAN_TI0R_TXRQ) != 0U) {
+                can->TSR &= ~(CAN_TSR_TME0 << k);
+                prv.can[c].txReady[k] = prv.now;
+                prv.can[c].txSeq[k] = prv.txSeq++;
+                prv_mailbox_code(c);
+            }
+        } else {
+            *reg = value;
+        }
+        return true;
+    }
+    return false;
+}
+
+static void
+prv_can_reset(void) {
+    memset(co_sim_can_ip, 0, sizeof(co_sim_can_ip));
+    for (int c = 0; c < 2; c++) {
+        CAN_TypeDef* can = &co_sim_can_ip[c].regs;
+        can->MCR = CAN_MCR_SLEEP;
+        can->MSR = CAN_MSR_SLAK;
+        can->TSR = CAN_TSR_TME;
+        prv.can[c].txInFlight = -1;
+    }
+    CAN1->FMR = CAN_FMR_FINIT | (14UL << CAN_FMR_CAN2SB_Pos);
+}
+#endif /* CO_SIM_FDCAN */
+
+/*******************************************************************************
+ * Bus arbitration and frame delivery
+ ******************************************************************************/
+uint32_t
+co_sim_bus_bit_ns(void) {
+    return (uint32_t)prv_bus_ns(1U);
+}
+
+/* Bus time of frame, with data phase at data bit rate on BRS */
+uint64_t
+co_sim_frame_ns(const co_sim_frame_t* frame) {
+    uint32_t data;
+    uint32_t bits = co_sim_frame_bits_fd(frame, &data);
+
+    if ((frame->dlc & (CO_SIM_FDF | CO_SIM_BRS)) == (CO_SIM_FDF | CO_SIM_BRS)) {
+        return prv_bus_ns(bits - data) + prv_data_ns(data);
+    }
+    return prv_bus_ns(bits);
+}
+
+static uint64_t
+prv_bus_next(void) {
+    uint64_t ready = CO_SIM_NEVER;
+
+    if (prv_bus.busy) {
+        return prv_bus.eof;
+    }
+    for (int c = 0; c < 2; c++) {
+        if (prv_can_offline(c)) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            if (prv_mailbox_pending(c, k)) {
+                uint64_t t = prv.can[c].txReady[k] > prv.can[c].joinAt ? prv.can[c].txReady[k] : prv.can[c].joinAt;
+                ready = t < ready ? t : ready;
+            }
+        }
+    }
+    if (prv_bus.extCount > 0U && prv_bus.extRelease[prv_bus.extHead] < ready) {
+        ready = prv_bus.extRelease[prv_bus.extHead];
+    }
+    if (ready == CO_SIM_NEVER) {
+        return CO_SIM_NEVER;
+    }
+    return ready > prv_bus.idle ? ready : prv_bus.idle;
+}
+
+static void
+prv_bus_start(uint64_t time) {
+    int source = CO_SIM_EXTERNAL;
+    int mailbox = -1;
+    uint32_t bestKey = UINT32_MAX;
+
+    if (prv_bus.extCount > 0U && prv_bus.extRelease[prv_bus.extHead] <= time) {
+        const co_sim_frame_t* frame = &prv_bus.ext[prv_bus.extHead];
+        bestKey = ((uint32_t)frame->id << 1) | frame->rtr;
+        prv_bus.frame = *frame;
+    }
+    for (int c = 0; c < 2; c++) {
+        co_sim_frame_t frame;
+        int k;
+
+        if (!prv_can_started(c) || (k = prv_mailbox_next(c, time)) < 0) {
+            continue;
+        }
+        prv_mailbox_frame(c, k, &frame);
+        if ((((uint32_t)frame.id << 1) | frame.rtr) < bestKey) {
+            bestKey = ((uint32_t)frame.id << 1) | frame.rtr;
+            source = c;
+            mailbox = k;
+            prv_bus.frame = frame;
+        }
+    }
+    if (bestKey == UINT32_MAX) {
+        /* Nothing ready yet, controller still joining the bus */
+        prv_bus.idle = time + 1U;
+        return;
+    }
+    prv_bus.busy = true;
+    prv_bus.source = source;
+    prv_bus.mailbox = mailbox;
+    prv_bus.sof = time;
+    prv_bus.eof = time + co_sim_frame_ns(&prv_bus.frame);
+    if (source != CO_SIM_EXTERNAL) {
+        prv.can[source].txInFlight = mailbox;
+    }
+}
+
+static void
+prv_bus_end(void) {
+    co_sim_frame_t frame = prv_bus.frame;
+
+    prv_bus.busy = false;
+    prv_bus.idle = prv_bus.eof + prv_bus_ns(PRV_INTERMISSION);
+    if (prv_bus.source == CO_SIM_EXTERNAL) {
+        prv_bus.extHead = (prv_bus.extHead + 1U) % PRV_EXT_QUEUE;
+        prv_bus.extCount--;
+    } else {
+        prv_mailbox_done(prv_bus.source, prv_bus.mailbox, true);
+    }
+    for (int c = 0; c < 2; c++) {
+        if (c != prv_bus.source) {
+            (void)prv_can_rx(c, &frame, prv_bus.sof);
+        }
+    }
+    if (prv_bus.monitor != NULL) {
+        prv_bus.monitor(prv_bus.monitorObject, &frame, prv_bus.sof, prv_bus.eof, prv_bus.source);
+    }
+}
+
+static void
+prv_bus_process(void) {
+    for (;;) {
+        if (prv_bus.busy) {
+            if (prv_bus.eof > prv.now) {
+                return;
+            }
+            prv_bus_end();
+        } else {
+            uint64_t t = prv_bus_next();
+            if (t > prv.now) {
+                return;
+            }
+            prv_bus_start(t);
+        }
+    }
+}
+
+bool
+co_sim_bus_inject(const co_sim_frame_t* frame, uint64_t release_ns) {
+    if (prv_bus.extCount >= PRV_EXT_QUEUE) {
+        return false;
+    }
+    uint32_t tail = (prv_bus.extHead + prv_bus.extCount) % PRV_EXT_QUEUE;
+    prv_bus.ext[tail] = *frame;
+    prv_bus.extRelease[tail] = release_ns;
+    prv_bus.extCount++;
+    return true;
+}
+
+uint32_t
+co_sim_bus_injected(void) {
+    return prv_bus.extCount;
+}
+
+uint64_t
+co_sim_bus_idle_ns(void) {
+    return prv_bus.busy ? prv_bus.eof + prv_bus_ns(PRV_INTERMISSION) : prv_bus.idle;
+}
+
+void
+co_sim_bus_monitor(co_sim_monitor_t monitor, void* object) {
+    prv_bus.monitor = monitor;
+    prv_bus.monitorObject = object;
+}
+
+bool
+co_sim_can_receive(int can, const co_sim_frame_t* frame) {
+    bool stored;
+
+    prv_sim_enter();
+    stored = prv_can_rx(can, frame, prv.now);
+    prv_dispatch();
+    prv_sim_leave();
+    return stored;
+}
+
+bool
+co_sim_can_tx_complete(int can, co_sim_frame_t* frame) {
+    int k = prv_mailbox_next(can, CO_SIM_NEVER - 1U);
+    co_sim_frame_t sent;
+
+    if (k < 0) {
+        return false;
+    }
+    prv_sim_enter();
+    prv_mailbox_frame(can, k, &sent);
+    prv_mailbox_done(can, k, true);
+    if (frame != NULL) {
+        *frame = sent;
+    }
+    if (prv_bus.monitor != NULL) {
+        prv_bus.monitor(prv_bus.monitorObject, &sent, prv.now, prv.now, can);
+    }
+    prv_dispatch();
+    prv_sim_leave();
+    return true;
+}
+
+uint32_t
+co_sim_can_tx_pending(int can) {
+    uint32_t count = 0U;
+
+    for (int k = 0; k < 3; k++) {
+        count += prv_mailbox_pending(can, k) ? 1U : 0U;
+    }
+    return count;
+}
+
+const co_sim_can_stats_t*
+co_sim_can_stats(int can) {
+    return &prv.can[can].stats;
+}
+
+void
+co_sim_write_reg(volatile uint32_t* reg, uint32_t value) {
+    prv_sim_enter();
+    if (!prv_can_write(reg, value)) {
+        *reg = value;
+    }
+    prv_dispatch();
+    prv_sim_leave();
+}
+
+/*******************************************************************************
+ * Interrupts
+ ******************************************************************************/
+/* Interrupt request line from the peripheral registers */
+static bool
+prv_irq_line(IRQn_Type irq) {
+#if CO_SIM_FDCAN
+    switch (irq) {
+        case FDCAN1_IT0_IRQn: return prv_fdcan_line(0, 0U);
+        case FDCAN1_IT1_IRQn: return prv_fdcan_line(0, 1U);
+        case FDCAN2_IT0_IRQn: return prv_fdcan_line(1, 0U);
+        case FDCAN2_IT1_IRQn: return prv_fdcan_line(1, 1U);
+#else
+    int c = irq >= CAN2_TX_IRQn ? 1 : 0;
+    const CAN_TypeDef* can = &co_sim_can_ip[c].regs;
+
+    switch (irq) {
+        case CAN1_TX_IRQn:
+        case CAN2_TX_IRQn:
+            return (can->IER & CAN_IER_TMEIE) != 0U
+                   && (can->TSR & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2)) != 0U;
+        case CAN1_RX0_IRQn:
+        case CAN2_RX0_IRQn:
+            return ((can->IER & CAN_IER_FMPIE0) != 0U && (can->RF0R & CAN_RF0R_FMP0) != 0U)
+                   || ((can->IER & CAN_IER_FFIE0) != 0U && (can->RF0R & CAN_RF0R_FULL0) != 0U)
+                   || ((can->IER & CAN_IER_FOVIE0) != 0U && (can->RF0R & CAN_RF0R_FOVR0) != 0U);
+        case CAN1_RX1_IRQn:
+        case CAN2_RX1_IRQn:
+            return ((can->IER & CAN_IER_FMPIE1) != 0U && (can->RF1R & CAN_RF1R_FMP1) != 0U)
+                   || ((can->IER & CAN_IER_FFIE1) != 0U && (can->RF1R & CAN_RF1R_FULL1) != 0U)
+                   || ((can->IER & CAN_IER_FOVIE1) != 0U && (can->RF1R & CAN_RF1R_FOVR1) != 0U);
+#endif
+        case TIM2_IRQn: return (co_sim_tim[0].SR & co_sim_tim[0].DIER & 0x1FU) != 0U;
+        case TIM3_IRQn: return (co_sim_tim[1].SR & co_sim_tim[1].DIER & 0x1FU) != 0U;
+        case TIM4_IRQn: return (co_sim_tim[2].SR & co_sim_tim[2].DIER & 0x1FU) != 0U;
+        case TIM5_IRQn: return (co_sim_tim[3].SR & co_sim_tim[3].DIER & 0x1FU) != 0U;
+        default: return false;
+    }
+}
+
+static uint32_t
+prv_irq_prio(IRQn_Type irq) {
+    return (uint32_t)prv.nvicPrio[irq] << (8U - __NVIC_PRIO_BITS);
+}
+
+/* Pending interrupt of highest priority which preempts, or -1 */
+static int
+prv_irq_pick(bool masked) {
+    int best = -1;
+
+    for (uint32_t i = 0U; i < prv.irqCount; i++) {
+        IRQn_Type irq = prv.irqs[i].irq;
+        uint32_t prio = prv_irq_prio(irq);
+
+        if (!prv.nvicEnabled[irq] || prio >= prv.active || (masked && prv.primask != 0U)
+            || (prv.basepri != 0U && prio >= prv.basepri) || !prv_irq_line(irq)) {
+            continue;
+        }
+        if (best < 0 || prio < prv_irq_prio(prv.irqs[best].irq)) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+/* Pending state for event on pending (SEVONPEND), disabled interrupts too */
+static void
+prv_irq_poll(void) {
+    uint32_t pend = 0U;
+
+    prv_tim_egr();
+    for (uint32_t i = 0U; i < prv.irqCount; i++) {
+        pend |= prv_irq_line(prv.irqs[i].irq) ? (1UL << i) : 0U;
+    }
+    if ((pend & ~prv.pendPrev) != 0U && (co_sim_scb.SCR & SCB_SCR_SEVONPEND_Msk) != 0U) {
+        prv.event = true;
+    }
+    prv.pendPrev = pend;
+}
+
+static void
+prv_irq_run(prv_irq_t* irq) {
+    uint32_t active = prv.active;
+    uint64_t nested = prv.nestedHost;
+    uint64_t nestedSim = prv.nestedSim;
+    uint32_t depth = prv.simDepth;
+    uint64_t sim;
+    uint64_t start;
+    uint64_t elapsed;
+    uint64_t self;
+
+    if (++prv.storm > PRV_STORM_LIMIT) {
+        fprintf(stderr, "co_sim: interrupt %d does not clear its request\n", (int)irq->irq);
+        abort();
+    }
+    prv.active = prv_irq_prio(irq->irq);
+    prv.event = true;
+    prv.nestedHost = 0U;
+    prv.nestedSim = 0U;
+    /* Handler is not simulator overhead, but simulated registers it writes are */
+    start = co_sim_host_ns();
+    if (depth != 0U) {
+        prv.simHost += start - prv.simStart;
+    }
+    prv.simDepth = 0U;
+    sim = prv.simHost;
+    irq->handler(irq->object);
+    sim = prv.simHost - sim;
+    elapsed = co_sim_host_ns() - start;
+    prv.simDepth = depth;
+    prv.simStart = co_sim_host_ns();
+    self = elapsed - prv.nestedHost - (sim - prv.nestedSim);
+    self = self > elapsed ? 0U : self;
+    prv.nestedHost = nested + elapsed;
+    prv.nestedSim = nestedSim + sim;
+    irq->stats.count++;
+    irq->stats.host_ns += self;
+    if (self > irq->stats.host_ns_max) {
+        irq->stats.host_ns_max = self;
+    }
+    irq->hist[self / PRV_HIST_NS < PRV_HIST_BINS ? self / PRV_HIST_NS : PRV_HIST_BINS - 1U]++;
+    if (co_sim_irq_cost_ns != 0U || co_sim_irq_cost_scale != 0U) {
+        co_sim_busy(co_sim_irq_cost_ns + self * co_sim_irq_cost_scale);
+    }
+    prv.active = active;
+    prv.event = true;
+}
+
+static void
+prv_dispatch(void) {
+    for (;;) {
+        int i;
+
+        prv_irq_poll();
+        i = prv_irq_pick(true);
+        if (i < 0) {
+            return;
+        }
+        prv_irq_run(&prv.irqs[i]);
+    }
+}
+
+void
+co_sim_irq_handler(IRQn_Type irq, void (*handler)(void* object), void* object) {
+    uint32_t i;
+
+    for (i = 0U; i < prv.irqCount && prv.irqs[i].irq != irq; i++) {}
+    if (i == prv.irqCount) {
+        if (prv.irqCount == PRV_IRQ_MAX) {
+            abort();
+        }
+        /* Keep sorted by number, lower number wins at equal priority */
+        while (i > 0U && prv.irqs[i - 1U].irq > irq) {
+            prv.irqs[i] = prv.irqs[i - 1U];
+            i--;
+        }
+        prv.irqCount++;
+        memset(&prv.irqs[i], 0, sizeof(prv.irqs[i]));
+    }
+    prv.irqs[i].irq = irq;
+    prv.irqs[i].handler = handler;
+    prv.irqs[i].object = object;
+}
+
+const co_sim_irq_stats_t*
+co_sim_irq_stats(IRQn_Type irq) {
+    static const co_sim_irq_stats_t none;
+
+    for (uint32_t i = 0U; i < prv.irqCount; i++) {
+        if (prv.irqs[i].irq == irq) {
+            return &prv.irqs[i].stats;
+        }
+    }
+    return &none;
+}
+
+void
+co_sim_irq_stats_clear(void) {
+    for (uint32_t i = 0U; i < prv.irqCount; i++) {
+        memset(&prv.irqs[i].stats, 0, sizeof(prv.irqs[i].stats));
+        memset(prv.irqs[i].hist, 0, sizeof(prv.irqs[i].hist));
+    }
+}
+
+uint64_t
+co_sim_irq_percentile_ns(IRQn_Type irq, double fraction) {
+    for (uint32_t i = 0U; i < prv.irqCount; i++) {
+        const prv_irq_t* p = &prv.irqs[i];
+        uint64_t limit = (uint64_t)((double)p->stats.count * fraction);
+        uint64_t sum = 0U;
+
+        if (p->irq != irq) {
+            continue;
+        }
+        for (uint32_t b = 0U; b < PRV_HIST_BINS - 1U; b++) {
+            sum += p->hist[b];
+            if (sum >= limit) {
+                return (uint64_t)(b + 1U) * PRV_HIST_NS;
+            }
+        }
+        return p->stats.host_ns_max;
+    }
+    return 0U;
+}
+
+#if CO_SIM_FDCAN
+static void
+prv_can_irq(void* object) {
+    HAL_FDCAN_IRQHandler((FDCAN_HandleTypeDef*)object);
+}
+#else
+static void
+prv_can_irq(void* object) {
+    HAL_CAN_IRQHandler((CAN_HandleTypeDef*)object);
+}
+#endif
+
+static void
+prv_tim_irq(void* object) {
+    HAL_TIM_IRQHandler((TIM_HandleTypeDef*)object);
+}
+
+#if CO_SIM_FDCAN
+/* Both interrupt lines call HAL_FDCAN_IRQHandler() */
+void
+co_sim_fdcan_bind(FDCAN_HandleTypeDef* hfdcan, uint32_t priority) {
+    IRQn_Type base = prv_can_index(hfdcan->Instance) == 0 ? FDCAN1_IT0_IRQn : FDCAN2_IT0_IRQn;
+
+    for (int i = 0; i < 2; i++) {
+        co_sim_irq_handler((IRQn_Type)(base + i), prv_can_irq, hfdcan);
+        HAL_NVIC_SetPriority((IRQn_Type)(base + i), priority, 0U);
+        HAL_NVIC_EnableIRQ((IRQn_Type)(base + i));
+    }
+}
+#else
+void
+co_sim_can_bind(CAN_HandleTypeDef* hcan, uint32_t priority) {
+    IRQn_Type base = prv_can_index(hcan->Instance) == 0 ? CAN1_TX_IRQn : CAN2_TX_IRQn;
+
+    for (int i = 0; i < 3; i++) {
+        co_sim_irq_handler((IRQn_Type)(base + i), prv_can_irq, hcan);
+        HAL_NVIC_SetPriority((IRQn_Type)(base + i), priority, 0U);
+        HAL_NVIC_EnableIRQ((IRQn_Type)(base + i));
+    }
+}
+#endif
+
+void
+co_sim_tim_bind(TIM_HandleTypeDef* htim, uint32_t priority) {
+    static const IRQn_Type irqs[4] = {TIM2_IRQn, TIM3_IRQn, TIM4_IRQn, TIM5_IRQn};
+    IRQn_Type irq = irqs[htim->Instance - co_sim_tim];
+
+    co_sim_irq_handler(irq, prv_tim_irq, htim);
+    HAL_NVIC_SetPriority(irq, priority, 0U);
+    HAL_NVIC_EnableIRQ(irq);
+}
+
+void
+HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+    (void)SubPriority;
+    if (IRQn >= 0) {
+        prv.nvicPrio[IRQn] = (uint8_t)(PreemptPriority & 0xFU);
+    }
+}
+
+uint32_t
+NVIC_GetPriority(IRQn_Type IRQn) {
+    return IRQn >= 0 ? prv.nvicPrio[IRQn] : 0U;
+}
+
+void
+HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+    if (IRQn >= 0) {
+        prv.nvicEnabled[IRQn] = true;
+        prv_dispatch();
+    }
+}
+
+void
+HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+    if (IRQn >= 0) {
+        prv.nvicEnabled[IRQn] = false;
+    }
+}
+
+void
+HAL_NVIC_SystemReset(void) {
+    if (co_sim_system_reset == NULL) {
+        fprintf(stderr, "co_sim: system reset\n");
+        abort();
+    }
+    co_sim_system_reset();
+}
+
+uint32_t
+co_sim_get_primask(void) {
+    return prv.primask;
+}
+
+void
+co_sim_set_primask(uint32_t primask) {
+    prv.primask = primask & 1U;
+    if (prv.primask == 0U) {
+        prv_sim_enter();
+        prv_dispatch();
+        prv_sim_leave();
+    }
+}
+
+uint32_t
+co_sim_get_basepri(void) {
+    return prv.basepri;
+}
+
+void
+co_sim_set_basepri(uint32_t basepri, int max) {
+    basepri &= 0xFFU << (8U - __NVIC_PRIO_BITS) & 0xFFU;
+    if (!max || (basepri != 0U && (prv.basepri == 0U || basepri < prv.basepri))) {
+        prv.basepri = basepri;
+    }
+    prv_sim_enter();
+    prv_dispatch();
+    prv_sim_leave();
+}
+
+/*******************************************************************************
+ * Running time
+ ******************************************************************************/
+static uint64_t
+prv_next_event(void) {
+    uint64_t next = prv_bus_next();
+
+    for (int i = 0; i < 4; i++) {
+        uint64_t t = prv_tim_next(i);
+        next = t < next ? t : next;
+    }
+    return next;
+}
+
+/* Advance to next event, but not beyond limit */
+static void
+prv_step(uint64_t limit) {
+    uint64_t next = prv_next_event();
+
+    prv_set_time(next < limit ? next : limit);
+    prv_bus_process();
+}
+
+void
+co_sim_run_until(uint64_t time_ns) {
+    prv_sim_enter();
+    prv_bus_process();
+    prv_dispatch();
+    while (prv.now < time_ns) {
+        prv_step(time_ns);
+        prv_dispatch();
+    }
+    prv_sim_leave();
+}
+
+void
+co_sim_busy(uint64_t duration_ns) {
+    prv_sim_enter();
+    prv_bus_process();
+    prv_dispatch();
+    while (duration_ns > 0U) {
+        uint64_t start = prv.now;
+        prv_step(prv.now + duration_ns);
+        duration_ns -= prv.now - start;
+        prv_dispatch();
+    }
+    prv_sim_leave();
+}
+
+/* Sleep until wake-up condition, time steps over bus and timer events */
+static void
+prv_sleep(bool (*wake)(void)) {
+    co_sim_sleep_timeout = false;
+    for (;;) {
+        prv_bus_process();
+        prv_irq_poll();
+        if (wake()) {
+            return;
+        }
+        if (prv.now >= co_sim_deadline_ns) {
+            co_sim_sleep_timeout = true;
+            return;
+        }
+        if (prv_next_event() == CO_SIM_NEVER && co_sim_deadline_ns == CO_SIM_NEVER) {
+            fprintf(stderr, "co_sim: sleep without wake-up source at %llu ns\n", (unsigned long long)prv.now);
+            abort();
+        }
+        prv_step(co_sim_deadline_ns);
+    }
+}
+
+/* Interrupt which would preempt if PRIMASK was clear */
+static bool
+prv_wake_wfi(void) {
+    if (prv_irq_pick(false) < 0) {
+        return false;
+    }
+    prv_dispatch();
+    return true;
+}
+
+static bool
+prv_wake_wfe(void) {
+    prv_dispatch();
+    if (!prv.event) {
+        return false;
+    }
+    prv.event = false;
+    return true;
+}
+
+void
+co_sim_wfi(void) {
+    prv_sim_enter();
+    prv_sleep(prv_wake_wfi);
+    prv_sim_leave();
+}
+
+void
+co_sim_wfe(void) {
+    prv_sim_enter();
+    prv_sleep(prv_wake_wfe);
+    prv_sim_leave();
+}
+
+void
+co_sim_sev(void) {
+    prv.event = true;
+}
+
+void
+HAL_Delay(uint32_t Delay) {
+    co_sim_busy((uint64_t)Delay * 1000000U);
+}
+
+/*******************************************************************************
+ * Reset
+ ******************************************************************************/
+void
+co_sim_reset(void) {
+    memset(&prv, 0, sizeof(prv));
+    memset(&prv_bus, 0, sizeof(prv_bus));
+    memset(co_sim_tim, 0, sizeof(co_sim_tim));
+    memset(&co_sim_systick, 0, sizeof(co_sim_systick));
+    memset(&co_sim_scb, 0, sizeof(co_sim_scb));
+    memset(&co_sim_dwt, 0, sizeof(co_sim_dwt));
+    memset(&co_sim_coredebug, 0, sizeof(co_sim_coredebug));
+    prv.active = PRV_THREAD;
+    prv_can_reset();
+    for (int i = 0; i < 4; i++) {
+        co_sim_tim[i].ARR = (i == 0 || i == 3) ? 0xFFFFFFFFU : 0xFFFFU;
+    }
+    co_sim_systick.LOAD = SystemCoreClock / 1000U - 1U;
+    co_sim_systick.VAL = co_sim_systick.LOAD;
+    co_sim_systick.CTRL = SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk;
+    co_sim_deadline_ns = CO_SIM_NEVER;
+    co_sim_sleep_timeout = false;
+    co_sim_irq_cost_ns = 0U;
+    co_sim_irq_cost_scale = 0U;
+    co_sim_system_reset = NULL;
+    co_sim_filter_configs = 0U;
+}
+
+#if CO_SIM_FDCAN
+/*******************************************************************************
+ * HAL FDCAN
+ ******************************************************************************/
+HAL_StatusTypeDef
+HAL_FDCAN_Init(FDCAN_HandleTypeDef* hfdcan) {
+    FDCAN_GlobalTypeDef* can;
+    uintptr_t ram;
+
+    if (hfdcan == NULL) {
+        return HAL_ERROR;
+    }
+    can = hfdcan->Instance;
+    CLEAR_BIT(can->CCCR, FDCAN_CCCR_CSR);
+    SET_BIT(can->CCCR, FDCAN_CCCR_INIT);
+    SET_BIT(can->CCCR, FDCAN_CCCR_CCE);
+    MODIFY_REG(can->CCCR, FDCAN_CCCR_DAR | FDCAN_CCCR_FDOE | FDCAN_CCCR_BRSE,
+               (hfdcan->Init.AutoRetransmission == ENABLE ? 0U : FDCAN_CCCR_DAR) | hfdcan->Init.FrameFormat);
+    WRITE_REG(can->NBTP, ((hfdcan->Init.NominalSyncJumpWidth - 1U) << FDCAN_NBTP_NSJW_Pos)
+                             | ((hfdcan->Init.NominalTimeSeg1 - 1U) << FDCAN_NBTP_NTSEG1_Pos)
+                             | ((hfdcan->Init.NominalTimeSeg2 - 1U) << FDCAN_NBTP_NTSEG2_Pos)
+                             | ((hfdcan->Init.NominalPrescaler - 1U) << FDCAN_NBTP_NBRP_Pos));
+    if (hfdcan->Init.FrameFormat == FDCAN_FRAME_FD_BRS) {
+        WRITE_REG(can->DBTP, ((hfdcan->Init.DataSyncJumpWidth - 1U) << FDCAN_DBTP_DSJW_Pos)
+                                 | ((hfdcan->Init.DataTimeSeg1 - 1U) << FDCAN_DBTP_DTSEG1_Pos)
+                                 | ((hfdcan->Init.DataTimeSeg2 - 1U) << FDCAN_DBTP_DTSEG2_Pos)
+                                 | ((hfdcan->Init.DataPrescaler - 1U) << FDCAN_DBTP_DBRP_Pos));
+    }
+    MODIFY_REG(can->TXBC, FDCAN_TXBC_TFQM, hfdcan->Init.TxFifoQueueMode);
+    MODIFY_REG(can->RXGFC, FDCAN_RXGFC_LSS | FDCAN_RXGFC_LSE,
+               (hfdcan->Init.StdFiltersNbr << FDCAN_RXGFC_LSS_Pos) | (hfdcan->Init.ExtFiltersNbr << FDCAN_RXGFC_LSE_Pos));
+    /* Fixed message RAM layout of the instance */
+    ram = SRAMCAN_BASE + (uintptr_t)prv_can_index(can) * SRAMCAN_SIZE;
+    hfdcan->msgRam.StandardFilterSA = ram + SRAMCAN_FLSSA;
+    hfdcan->msgRam.ExtendedFilterSA = ram + SRAMCAN_FLESA;
+    hfdcan->msgRam.RxFIFO0SA = ram + SRAMCAN_RF0SA;
+    hfdcan->msgRam.RxFIFO1SA = ram + SRAMCAN_RF1SA;
+    hfdcan->msgRam.TxEventFIFOSA = ram + SRAMCAN_TEFSA;
+    hfdcan->msgRam.TxFIFOQSA = ram + SRAMCAN_TFQSA;
+    memset((void*)ram, 0, SRAMCAN_SIZE);
+    hfdcan->LatestTxFifoQRequest = 0U;
+    hfdcan->ErrorCode = HAL_FDCAN_ERROR_NONE;
+    hfdcan->State = HAL_FDCAN_STATE_READY;
+    return HAL_OK;
+}
+
+void
+co_sim_fdcan_handle(FDCAN_HandleTypeDef* hfdcan, FDCAN_GlobalTypeDef* instance, uint32_t kbit, uint32_t dataKbit) {
+    memset(hfdcan, 0, sizeof(*hfdcan));
+    hfdcan->Instance = instance;
+    /* 80 MHz kernel clock, 16 time quanta per nominal bit, 10 per data bit */
+    hfdcan->Init.ClockDivider = FDCAN_CLOCK_DIV1;
+    hfdcan->Init.FrameFormat = dataKbit == 0U ? FDCAN_FRAME_CLASSIC
+                                              : (dataKbit == kbit ? FDCAN_FRAME_FD_NO_BRS : FDCAN_FRAME_FD_BRS);
+    hfdcan->Init.Mode = FDCAN_MODE_NORMAL;
+    hfdcan->Init.AutoRetransmission = ENABLE;
+    hfdcan->Init.NominalPrescaler = 5000U / kbit;
+    hfdcan->Init.NominalSyncJumpWidth = 1U;
+    hfdcan->Init.NominalTimeSeg1 = 13U;
+    hfdcan->Init.NominalTimeSeg2 = 2U;
+    hfdcan->Init.DataPrescaler = dataKbit != 0U ? 8000U / dataKbit : 1U;
+    hfdcan->Init.DataSyncJumpWidth = 1U;
+    hfdcan->Init.DataTimeSeg1 = 7U;
+    hfdcan->Init.DataTimeSeg2 = 2U;
+    hfdcan->Init.StdFiltersNbr = SRAMCAN_FLS_NBR;
+    hfdcan->Init.ExtFiltersNbr = 0U;
+    hfdcan->Init.TxFifoQueueMode = FDCAN_TX_FIFO_OPERATION;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef* hfdcan, FDCAN_FilterTypeDef* sFilterConfig) {
+    uint32_t* element;
+
+    if (hfdcan->State != HAL_FDCAN_STATE_READY && hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    co_sim_filter_configs++;
+    if (sFilterConfig->IdType == FDCAN_STANDARD_ID) {
+        element = (uint32_t*)(hfdcan->msgRam.StandardFilterSA + sFilterConfig->FilterIndex * SRAMCAN_FLS_SIZE);
+        *element = (sFilterConfig->FilterType << 30) | (sFilterConfig->FilterConfig << 27)
+                   | (sFilterConfig->FilterID1 << 16) | sFilterConfig->FilterID2;
+    } else {
+        element = (uint32_t*)(hfdcan->msgRam.ExtendedFilterSA + sFilterConfig->FilterIndex * SRAMCAN_FLE_SIZE);
+        element[0] = (sFilterConfig->FilterConfig << 29) | sFilterConfig->FilterID1;
+        element[1] = (sFilterConfig->FilterType << 30) | sFilterConfig->FilterID2;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef* hfdcan, uint32_t NonMatchingStd, uint32_t NonMatchingExt,
+                             uint32_t RejectRemoteStd, uint32_t RejectRemoteExt) {
+    if (hfdcan->State != HAL_FDCAN_STATE_READY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    MODIFY_REG(hfdcan->Instance->RXGFC, FDCAN_RXGFC_ANFS | FDCAN_RXGFC_ANFE | FDCAN_RXGFC_RRFS | FDCAN_RXGFC_RRFE,
+               (NonMatchingStd << FDCAN_RXGFC_ANFS_Pos) | (NonMatchingExt << FDCAN_RXGFC_ANFE_Pos)
+                   | (RejectRemoteStd << 1) | RejectRemoteExt);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_ConfigTimestampCounter(FDCAN_HandleTypeDef* hfdcan, uint32_t TimestampPrescaler) {
+    if (hfdcan->State != HAL_FDCAN_STATE_READY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    MODIFY_REG(hfdcan->Instance->TSCC, FDCAN_TSCC_TCP, TimestampPrescaler);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_EnableTimestampCounter(FDCAN_HandleTypeDef* hfdcan, uint32_t TimestampOperation) {
+    if (hfdcan->State != HAL_FDCAN_STATE_READY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    MODIFY_REG(hfdcan->Instance->TSCC, FDCAN_TSCC_TSS, TimestampOperation);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_ConfigInterruptLines(FDCAN_HandleTypeDef* hfdcan, uint32_t ITList, uint32_t InterruptLine) {
+    if (InterruptLine == FDCAN_INTERRUPT_LINE0) {
+        CLEAR_BIT(hfdcan->Instance->ILS, ITList);
+    } else {
+        SET_BIT(hfdcan->Instance->ILS, ITList);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_Start(FDCAN_HandleTypeDef* hfdcan) {
+    if (hfdcan->State != HAL_FDCAN_STATE_READY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    hfdcan->State = HAL_FDCAN_STATE_BUSY;
+    /* Unlike bxCAN, the HAL does not wait for bus synchronization */
+    CLEAR_BIT(hfdcan->Instance->CCCR, FDCAN_CCCR_INIT);
+    hfdcan->ErrorCode = HAL_FDCAN_ERROR_NONE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_Stop(FDCAN_HandleTypeDef* hfdcan) {
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    SET_BIT(hfdcan->Instance->CCCR, FDCAN_CCCR_INIT);
+    CLEAR_BIT(hfdcan->Instance->CCCR, FDCAN_CCCR_CSR);
+    SET_BIT(hfdcan->Instance->CCCR, FDCAN_CCCR_CCE);
+    hfdcan->LatestTxFifoQRequest = 0U;
+    hfdcan->State = HAL_FDCAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef* hfdcan, FDCAN_TxHeaderTypeDef* pTxHeader, uint8_t* pTxData) {
+    uint32_t txfqs;
+    uint32_t put;
+    uint32_t* element;
+
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    txfqs = READ_REG(hfdcan->Instance->TXFQS);
+    if ((txfqs & FDCAN_TXFQS_TFQF) != 0U) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_FULL;
+        return HAL_ERROR;
+    }
+    put = (txfqs & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+    element = (uint32_t*)(hfdcan->msgRam.TxFIFOQSA + put * SRAMCAN_TFQ_SIZE);
+    element[0] = pTxHeader->ErrorStateIndicator | pTxHeader->IdType | pTxHeader->TxFrameType
+                 | (pTxHeader->Identifier << 18);
+    element[1] = (pTxHeader->MessageMarker << 24) | pTxHeader->TxEventFifoControl | pTxHeader->FDFormat
+                 | pTxHeader->BitRateSwitch | ((pTxHeader->DataLength / FDCAN_DLC_BYTES_1) << 16);
+    memcpy(&element[2], pTxData, prv_dlc_bytes[(pTxHeader->DataLength / FDCAN_DLC_BYTES_1) & 0xFU]);
+    hfdcan->LatestTxFifoQRequest = 1UL << put;
+    WRITE_REG(hfdcan->Instance->TXBAR, 1UL << put);
+    return HAL_OK;
+}
+
+uint32_t
+HAL_FDCAN_GetTxFifoFreeLevel(FDCAN_HandleTypeDef* hfdcan) {
+    return hfdcan->Instance->TXFQS & FDCAN_TXFQS_TFFL;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef* hfdcan, uint32_t RxLocation, FDCAN_RxHeaderTypeDef* pRxHeader,
+                       uint8_t* pRxData) {
+    FDCAN_GlobalTypeDef* can = hfdcan->Instance;
+    uint32_t rxfs = RxLocation == FDCAN_RX_FIFO0 ? can->RXF0S : can->RXF1S;
+    uint32_t get = (rxfs & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+    const uint32_t* element;
+
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    if ((rxfs & FDCAN_RXF0S_F0FL) == 0U) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_EMPTY;
+        return HAL_ERROR;
+    }
+    element = (const uint32_t*)((RxLocation == FDCAN_RX_FIFO0 ? hfdcan->msgRam.RxFIFO0SA : hfdcan->msgRam.RxFIFO1SA)
+                                + get * SRAMCAN_RF0_SIZE);
+    pRxHeader->IdType = element[0] & FDCAN_EXTENDED_ID;
+    pRxHeader->Identifier = pRxHeader->IdType == FDCAN_STANDARD_ID ? (element[0] >> 18) & 0x7FFU
+                                                                   : element[0] & 0x1FFFFFFFU;
+    pRxHeader->RxFrameType = element[0] & FDCAN_REMOTE_FRAME;
+    pRxHeader->ErrorStateIndicator = element[0] & FDCAN_ESI_PASSIVE;
+    pRxHeader->RxTimestamp = element[1] & FDCAN_TSCV_TSC;
+    pRxHeader->DataLength = ((element[1] >> 16) & 0xFU) * FDCAN_DLC_BYTES_1;
+    pRxHeader->BitRateSwitch = element[1] & FDCAN_BRS_ON;
+    pRxHeader->FDFormat = element[1] & FDCAN_FD_CAN;
+    pRxHeader->FilterIndex = (element[1] >> PRV_FDCAN_FIDX_POS) & 0x7FU;
+    pRxHeader->IsFilterMatchingFrame = (element[1] & PRV_FDCAN_ANMF) != 0U ? 1U : 0U;
+    /* As the HAL, copies all bytes of the DLC code, also of classic frames */
+    memcpy(pRxData, &element[2], prv_dlc_bytes[(element[1] >> 16) & 0xFU]);
+    if (RxLocation == FDCAN_RX_FIFO0) {
+        WRITE_REG(can->RXF0A, get);
+    } else {
+        WRITE_REG(can->RXF1A, get);
+    }
+    return HAL_OK;
+}
+
+uint32_t
+HAL_FDCAN_GetRxFifoFillLevel(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo) {
+    return (RxFifo == FDCAN_RX_FIFO0 ? hfdcan->Instance->RXF0S : hfdcan->Instance->RXF1S) & FDCAN_RXF0S_F0FL;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef* hfdcan, FDCAN_TxEventFifoTypeDef* pTxEvent) {
+    FDCAN_GlobalTypeDef* can = hfdcan->Instance;
+    uint32_t get = (can->TXEFS & FDCAN_TXEFS_EFGI) >> FDCAN_TXEFS_EFGI_Pos;
+    const uint32_t* element;
+
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    if ((can->TXEFS & FDCAN_TXEFS_EFFL) == 0U) {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_EMPTY;
+        return HAL_ERROR;
+    }
+    element = (const uint32_t*)(hfdcan->msgRam.TxEventFIFOSA + get * SRAMCAN_TEF_SIZE);
+    pTxEvent->IdType = element[0] & FDCAN_EXTENDED_ID;
+    pTxEvent->Identifier = pTxEvent->IdType == FDCAN_STANDARD_ID ? (element[0] >> 18) & 0x7FFU
+                                                                 : element[0] & 0x1FFFFFFFU;
+    pTxEvent->TxFrameType = element[0] & FDCAN_REMOTE_FRAME;
+    pTxEvent->ErrorStateIndicator = element[0] & FDCAN_ESI_PASSIVE;
+    pTxEvent->TxTimestamp = element[1] & FDCAN_TSCV_TSC;
+    pTxEvent->DataLength = ((element[1] >> 16) & 0xFU) * FDCAN_DLC_BYTES_1;
+    pTxEvent->BitRateSwitch = element[1] & FDCAN_BRS_ON;
+    pTxEvent->FDFormat = element[1] & FDCAN_FD_CAN;
+    pTxEvent->EventType = element[1] & (3UL << 22);
+    pTxEvent->MessageMarker = element[1] >> 24;
+    WRITE_REG(can->TXEFA, get);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t ActiveITs, uint32_t BufferIndexes) {
+    FDCAN_GlobalTypeDef* can = hfdcan->Instance;
+
+    for (uint32_t bit = 0U; bit < 24U; bit++) {
+        if ((ActiveITs & (1UL << bit)) != 0U) {
+            SET_BIT(can->ILE, ((can->ILS >> prv_fdcan_group[bit]) & 1U) != 0U ? FDCAN_ILE_EINT1 : FDCAN_ILE_EINT0);
+        }
+    }
+    if ((ActiveITs & FDCAN_IT_TX_COMPLETE) != 0U) {
+        SET_BIT(can->TXBTIE, BufferIndexes);
+    }
+    if ((ActiveITs & FDCAN_IT_TX_ABORT_COMPLETE) != 0U) {
+        SET_BIT(can->TXBCIE, BufferIndexes);
+    }
+    SET_BIT(can->IE, ActiveITs);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t InactiveITs) {
+    FDCAN_GlobalTypeDef* can = hfdcan->Instance;
+    uint32_t lines = 0U;
+
+    CLEAR_BIT(can->IE, InactiveITs);
+    if ((InactiveITs & FDCAN_IT_TX_COMPLETE) != 0U) {
+        CLEAR_BIT(can->TXBTIE, 0x7U);
+    }
+    if ((InactiveITs & FDCAN_IT_TX_ABORT_COMPLETE) != 0U) {
+        CLEAR_BIT(can->TXBCIE, 0x7U);
+    }
+    /* Lines stay enabled while any of their interrupts is */
+    for (uint32_t bit = 0U; bit < 24U; bit++) {
+        if ((can->IE & (1UL << bit)) != 0U) {
+            lines |= ((can->ILS >> prv_fdcan_group[bit]) & 1U) != 0U ? FDCAN_ILE_EINT1 : FDCAN_ILE_EINT0;
+        }
+    }
+    CLEAR_BIT(can->ILE, ~lines & (FDCAN_ILE_EINT0 | FDCAN_ILE_EINT1));
+    return HAL_OK;
+}
+
+void
+HAL_FDCAN_IRQHandler(FDCAN_HandleTypeDef* hfdcan) {
+    FDCAN_GlobalTypeDef* can = hfdcan->Instance;
+    uint32_t active = READ_REG(can->IR) & READ_REG(can->IE);
+    uint32_t teITs = active & (FDCAN_IR_TEFN | FDCAN_IR_TEFF | FDCAN_IR_TEFL);
+    uint32_t rx0ITs = active & (FDCAN_IR_RF0N | FDCAN_IR_RF0F | FDCAN_IR_RF0L);
+    uint32_t rx1ITs = active & (FDCAN_IR_RF1N | FDCAN_IR_RF1F | FDCAN_IR_RF1L);
+    uint32_t esITs = active & (FDCAN_IR_EP | FDCAN_IR_EW | FDCAN_IR_BO);
+    uint32_t errITs = active & (FDCAN_IR_ELO | FDCAN_IR_WDI | FDCAN_IR_PEA | FDCAN_IR_PED | FDCAN_IR_ARA);
+
+    if (teITs != 0U) {
+        WRITE_REG(can->IR, teITs);
+        HAL_FDCAN_TxEventFifoCallback(hfdcan, teITs);
+    }
+    if (rx0ITs != 0U) {
+        WRITE_REG(can->IR, rx0ITs);
+        HAL_FDCAN_RxFifo0Callback(hfdcan, rx0ITs);
+    }
+    if (rx1ITs != 0U) {
+        WRITE_REG(can->IR, rx1ITs);
+        HAL_FDCAN_RxFifo1Callback(hfdcan, rx1ITs);
+    }
+    if ((active & FDCAN_IR_TFE) != 0U) {
+        WRITE_REG(can->IR, FDCAN_IR_TFE);
+        HAL_FDCAN_TxFifoEmptyCallback(hfdcan);
+    }
+    if ((active & FDCAN_IR_TC) != 0U) {
+        uint32_t buffers = READ_REG(can->TXBTO) & READ_REG(can->TXBTIE);
+        WRITE_REG(can->IR, FDCAN_IR_TC);
+        HAL_FDCAN_TxBufferCompleteCallback(hfdcan, buffers);
+    }
+    if ((active & FDCAN_IR_TCF) != 0U) {
+        WRITE_REG(can->IR, FDCAN_IR_TCF);
+    }
+    if (esITs != 0U) {
+        WRITE_REG(can->IR, esITs);
+        HAL_FDCAN_ErrorStatusCallback(hfdcan, esITs);
+    }
+    if (errITs != 0U) {
+        WRITE_REG(can->IR, errITs);
+        hfdcan->ErrorCode |= errITs;
+    }
+}
+
+__attribute__((weak)) void
+HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t TxEventFifoITs) {
+    (void)hfdcan;
+    (void)TxEventFifoITs;
+}
+
+__attribute__((weak)) void
+HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs) {
+    (void)hfdcan;
+    (void)RxFifo0ITs;
+}
+
+__attribute__((weak)) void
+HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo1ITs) {
+    (void)hfdcan;
+    (void)RxFifo1ITs;
+}
+
+__attribute__((weak)) void
+HAL_FDCAN_TxFifoEmptyCallback(FDCAN_HandleTypeDef* hfdcan) {
+    (void)hfdcan;
+}
+
+__attribute__((weak)) void
+HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t BufferIndexes) {
+    (void)hfdcan;
+    (void)BufferIndexes;
+}
+
+__attribute__((weak)) void
+HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs) {
+    (void)hfdcan;
+    (void)ErrorStatusITs;
+}
+
+uint32_t
+HAL_RCCEx_GetPeriphCLKFreq(uint32_t PeriphClk) {
+    return PeriphClk == RCC_PERIPHCLK_FDCAN ? PRV_FDCAN_CLK_MHZ * 1000000U : 0U;
+}
+#else
+/*******************************************************************************
+ * HAL CAN
+ ******************************************************************************/
+HAL_StatusTypeDef
+HAL_CAN_Init(CAN_HandleTypeDef* hcan) {
+    CAN_TypeDef* can;
+    uint32_t mcr;
+
+    if (hcan == NULL) {
+        return HAL_ERROR;
+    }
+    can = hcan->Instance;
+    mcr = (can->MCR & ~(CAN_MCR_SLEEP | CAN_MCR_TTCM | CAN_MCR_ABOM | CAN_MCR_AWUM | CAN_MCR_NART | CAN_MCR_RFLM
+                        | CAN_MCR_TXFP))
+          | CAN_MCR_INRQ;
+    mcr |= hcan->Init.TimeTriggeredMode == ENABLE ? CAN_MCR_TTCM : 0U;
+    mcr |= hcan->Init.AutoBusOff == ENABLE ? CAN_MCR_ABOM : 0U;
+    mcr |= hcan->Init.AutoWakeUp == ENABLE ? CAN_MCR_AWUM : 0U;
+    mcr |= hcan->Init.AutoRetransmission == ENABLE ? 0U : CAN_MCR_NART;
+    mcr |= hcan->Init.ReceiveFifoLocked == ENABLE ? CAN_MCR_RFLM : 0U;
+    mcr |= hcan->Init.TransmitFifoPriority == ENABLE ? CAN_MCR_TXFP : 0U;
+    WRITE_REG(can->MCR, mcr);
+    WRITE_REG(can->BTR, hcan->Init.Mode | hcan->Init.SyncJumpWidth | hcan->Init.TimeSeg1 | hcan->Init.TimeSeg2
+                            | (hcan->Init.Prescaler - 1U));
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    hcan->State = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+void
+co_sim_can_handle(CAN_HandleTypeDef* hcan, CAN_TypeDef* instance, uint32_t kbit) {
+    memset(hcan, 0, sizeof(*hcan));
+    hcan->Instance = instance;
+    /* 42 MHz clock, 14 time quanta per bit, sample point at 85.7 % */
+    hcan->Init.Prescaler = 3000U / kbit;
+    hcan->Init.Mode = CAN_MODE_NORMAL;
+    hcan->Init.SyncJumpWidth = CAN_SJW_1TQ;
+    hcan->Init.TimeSeg1 = CAN_BS1_TQ(11U);
+    hcan->Init.TimeSeg2 = CAN_BS2_TQ(2U);
+    hcan->Init.AutoBusOff = ENABLE;
+    hcan->Init.AutoRetransmission = ENABLE;
+}
+
+HAL_StatusTypeDef
+HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, CAN_FilterTypeDef* sFilterConfig) {
+    CAN_TypeDef* can = CAN1;
+    uint32_t bit = 1UL << (sFilterConfig->FilterBank & 0x1FU);
+
+    if (hcan->State != HAL_CAN_STATE_READY && hcan->State != HAL_CAN_STATE_LISTENING) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    co_sim_filter_configs++;
+    SET_BIT(can->FMR, CAN_FMR_FINIT);
+    CLEAR_BIT(can->FMR, CAN_FMR_CAN2SB);
+    SET_BIT(can->FMR, sFilterConfig->SlaveStartFilterBank << CAN_FMR_CAN2SB_Pos);
+    CLEAR_BIT(can->FA1R, bit);
+    if (sFilterConfig->FilterScale == CAN_FILTERSCALE_16BIT) {
+        CLEAR_BIT(can->FS1R, bit);
+        can->sFilterRegister[sFilterConfig->FilterBank].FR1 = ((0xFFFFU & sFilterConfig->FilterMaskIdLow) << 16U)
+                                                              | (0xFFFFU & sFilterConfig->FilterIdLow);
+        can->sFilterRegister[sFilterConfig->FilterBank].FR2 = ((0xFFFFU & sFilterConfig->FilterMaskIdHigh) << 16U)
+                                                              | (0xFFFFU & sFilterConfig->FilterIdHigh);
+    } else {
+        SET_BIT(can->FS1R, bit);
+        can->sFilterRegister[sFilterConfig->FilterBank].FR1 = ((0xFFFFU & sFilterConfig->FilterIdHigh) << 16U)
+                                                              | (0xFFFFU & sFilterConfig->FilterIdLow);
+        can->sFilterRegister[sFilterConfig->FilterBank].FR2 = ((0xFFFFU & sFilterConfig->FilterMaskIdHigh) << 16U)
+                                                              | (0xFFFFU & sFilterConfig->FilterMaskIdLow);
+    }
+    if (sFilterConfig->FilterMode == CAN_FILTERMODE_IDMASK) {
+        CLEAR_BIT(can->FM1R, bit);
+    } else {
+        SET_BIT(can->FM1R, bit);
+    }
+    if (sFilterConfig->FilterFIFOAssignment == CAN_FILTER_FIFO0) {
+        CLEAR_BIT(can->FFA1R, bit);
+    } else {
+        SET_BIT(can->FFA1R, bit);
+    }
+    if (sFilterConfig->FilterActivation == CAN_FILTER_ENABLE) {
+        SET_BIT(can->FA1R, bit);
+    }
+    CLEAR_BIT(can->FMR, CAN_FMR_FINIT);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_CAN_Start(CAN_HandleTypeDef* hcan) {
+    int c = prv_can_index(hcan->Instance);
+
+    if (hcan->State != HAL_CAN_STATE_READY) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    hcan->State = HAL_CAN_STATE_LISTENING;
+    CLEAR_BIT(hcan->Instance->MCR, CAN_MCR_INRQ);
+    /* Wait for INAK cleared, after synchronization on the bus */
+    if (prv.can[c].joinAt > prv.now) {
+        co_sim_busy(prv.can[c].joinAt - prv.now);
+    }
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_CAN_Stop(CAN_HandleTypeDef* hcan) {
+    if (hcan->State != HAL_CAN_STATE_LISTENING) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    SET_BIT(hcan->Instance->MCR, CAN_MCR_INRQ);
+    CLEAR_BIT(hcan->Instance->MCR, CAN_MCR_SLEEP);
+    hcan->State = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_CAN_AddTxMessage(CAN_HandleTypeDef* hcan, CAN_TxHeaderTypeDef* pHeader, uint8_t aData[], uint32_t* pTxMailbox) {
+    CAN_TypeDef* can = hcan->Instance;
+    uint32_t tsr = READ_REG(can->TSR);
+    uint32_t k;
+
+    if (hcan->State != HAL_CAN_STATE_READY && hcan->State != HAL_CAN_STATE_LISTENING) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    if ((tsr & CAN_TSR_TME) == 0U) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+    k = (tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    *pTxMailbox = 1UL << k;
+    can->sTxMailBox[k].TIR = (pHeader->StdId << CAN_TI0R_STID_Pos) | pHeader->RTR;
+    can->sTxMailBox[k].TDTR = pHeader->DLC;
+    WRITE_REG(can->sTxMailBox[k].TDHR, ((uint32_t)aData[7] << 24) | ((uint32_t)aData[6] << 16)
+                                           | ((uint32_t)aData[5] << 8) | (uint32_t)aData[4]);
+    WRITE_REG(can->sTxMailBox[k].TDLR, ((uint32_t)aData[3] << 24) | ((uint32_t)aData[2] << 16)
+                                           | ((uint32_t)aData[1] << 8) | (uint32_t)aData[0]);
+    SET_BIT(can->sTxMailBox[k].TIR, CAN_TI0R_TXRQ);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_CAN_AbortTxRequest(CAN_HandleTypeDef* hcan, uint32_t TxMailboxes) {
+    for (uint32_t k = 0U; k < 3U; k++) {
+        if ((TxMailboxes & (1UL << k)) != 0U) {
+            SET_BIT(hcan->Instance->TSR, CAN_TSR_ABRQ0 << (8U * k));
+        }
+    }
+    return HAL_OK;
+}
+
+uint32_t
+HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef* hcan) {
+    uint32_t tsr = hcan->Instance->TSR;
+
+    return ((tsr & CAN_TSR_TME0) != 0U ? 1U : 0U) + ((tsr & CAN_TSR_TME1) != 0U ? 1U : 0U)
+           + ((tsr & CAN_TSR_TME2) != 0U ? 1U : 0U);
+}
+
+HAL_StatusTypeDef
+HAL_CAN_GetRxMessage(CAN_HandleTypeDef* hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef* pHeader, uint8_t aData[]) {
+    CAN_TypeDef* can = hcan->Instance;
+    const CAN_FIFOMailBox_TypeDef* mb = &can->sFIFOMailBox[RxFifo];
+    uint32_t level = (RxFifo == CAN_RX_FIFO0 ? can->RF0R : can->RF1R) & CAN_RF0R_FMP0;
+
+    if (hcan->State != HAL_CAN_STATE_READY && hcan->State != HAL_CAN_STATE_LISTENING) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    if (level == 0U) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+    pHeader->IDE = mb->RIR & CAN_RI0R_IDE;
+    pHeader->StdId = (mb->RIR >> CAN_RI0R_STID_Pos) & 0x7FFU;
+    pHeader->ExtId = mb->RIR >> CAN_RI0R_EXID_Pos;
+    pHeader->RTR = mb->RIR & CAN_RI0R_RTR;
+    pHeader->DLC = mb->RDTR & CAN_RDT0R_DLC;
+    pHeader->FilterMatchIndex = (mb->RDTR & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos;
+    pHeader->Timestamp = (mb->RDTR & CAN_RDT0R_TIME) >> CAN_RDT0R_TIME_Pos;
+    for (int i = 0; i < 4; i++) {
+        aData[i] = (uint8_t)(mb->RDLR >> (8 * i));
+        aData[4 + i] = (uint8_t)(mb->RDHR >> (8 * i));
+    }
+    if (RxFifo == CAN_RX_FIFO0) {
+        SET_BIT(can->RF0R, CAN_RF0R_RFOM0);
+    } else {
+        SET_BIT(can->RF1R, CAN_RF1R_RFOM1);
+    }
+    return HAL_OK;
+}
+
+uint32_t
+HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef* hcan, uint32_t RxFifo) {
+    return (RxFifo == CAN_RX_FIFO0 ? hcan->Instance->RF0R : hcan->Instance->RF1R) & CAN_RF0R_FMP0;
+}
+
+HAL_StatusTypeDef
+HAL_CAN_ActivateNotification(CAN_HandleTypeDef* hcan, uint32_t ActiveITs) {
+    SET_BIT(hcan->Instance->IER, ActiveITs);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_CAN_DeactivateNotification(CAN_HandleTypeDef* hcan, uint32_t InactiveITs) {
+    CLEAR_BIT(hcan->Instance->IER, InactiveITs);
+    return HAL_OK;
+}
+
+void
+HAL_CAN_IRQHandler(CAN_HandleTypeDef* hcan) {
+    static void (*const txComplete[3])(CAN_HandleTypeDef*) = {
+        HAL_CAN_TxMailbox0CompleteCallback, HAL_CAN_TxMailbox1CompleteCallback, HAL_CAN_TxMailbox2CompleteCallback};
+    CAN_TypeDef* can = hcan->Instance;
+    uint32_t ier = READ_REG(can->IER);
+    uint32_t tsr = READ_REG(can->TSR);
+
+    if ((ier & CAN_IT_TX_MAILBOX_EMPTY) != 0U) {
+        for (uint32_t k = 0U; k < 3U; k++) {
+            uint32_t shift = 8U * k;
+            if ((tsr & (CAN_TSR_RQCP0 << shift)) != 0U) {
+                WRITE_REG(can->TSR, CAN_TSR_RQCP0 << shift);
+                if ((tsr & (CAN_TSR_TXOK0 << shift)) != 0U) {
+                    txComplete[k](hcan);
+                }
+            }
+        }
+    }
+    for (uint32_t fifo = 0U; fifo < 2U; fifo++) {
+        volatile uint32_t* rfr = fifo == 0U ? &can->RF0R : &can->RF1R;
+        uint32_t shift = 3U * fifo;
+        if ((ier & (CAN_IER_FOVIE0 << shift)) != 0U && (*rfr & CAN_RF0R_FOVR0) != 0U) {
+            WRITE_REG(*rfr, CAN_RF0R_FOVR0);
+        }
+        if ((ier & (CAN_IER_FFIE0 << shift)) != 0U && (*rfr & CAN_RF0R_FULL0) != 0U) {
+            WRITE_REG(*rfr, CAN_RF0R_FULL0);
+        }
+        if ((ier & (CAN_IER_FMPIE0 << shift)) != 0U && (*rfr & CAN_RF0R_FMP0) != 0U) {
+            if (fifo == 0U) {
+                HAL_CAN_RxFifo0MsgPendingCallback(hcan);
+            } else {
+                HAL_CAN_RxFifo1MsgPendingCallback(hcan);
+            }
+        }
+    }
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) {
+    (void)hcan;
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) {
+    (void)hcan;
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) {
+    (void)hcan;
+}
+
+__attribute__((weak)) void
+HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    (void)hcan;
+}
+
+__attribute__((weak)) void
+HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    (void)hcan;
+}
+
+#endif /* CO_SIM_FDCAN */
+
+/*******************************************************************************
+ * HAL TIM
+ ******************************************************************************/
+static int
+prv_tim_index(const TIM_HandleTypeDef* htim) {
+    return (int)(htim->Instance - co_sim_tim);
+}
+
+HAL_StatusTypeDef
+HAL_TIM_Base_Init(TIM_HandleTypeDef* htim) {
+    int i = prv_tim_index(htim);
+
+    prv_tim_update(i);
+    htim->Instance->PSC = htim->Init.Prescaler;
+    htim->Instance->ARR = htim->Init.Period;
+    htim->Instance->CNT = 0U;
+    prv_tim_rebase(i);
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef
+prv_tim_start(TIM_HandleTypeDef* htim, uint32_t dier, uint32_t ccer) {
+    int i = prv_tim_index(htim);
+
+    prv_tim_update(i);
+    htim->Instance->DIER |= dier;
+    htim->Instance->CCER |= ccer;
+    if ((htim->Instance->CR1 & TIM_CR1_CEN) == 0U) {
+        htim->Instance->CR1 |= TIM_CR1_CEN;
+        prv_tim_rebase(i);
+    }
+    prv_dispatch();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_TIM_Base_Start(TIM_HandleTypeDef* htim) {
+    return prv_tim_start(htim, 0U, 0U);
+}
+
+HAL_StatusTypeDef
+HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim) {
+    return prv_tim_start(htim, TIM_DIER_UIE, 0U);
+}
+
+HAL_StatusTypeDef
+HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim) {
+    int i = prv_tim_index(htim);
+
+    prv_tim_update(i);
+    htim->Instance->DIER &= ~TIM_DIER_UIE;
+    htim->Instance->CR1 &= ~TIM_CR1_CEN;
+    prv.tim[i].running = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef
+HAL_TIM_OC_Start_IT(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    return prv_tim_start(htim, TIM_DIER_CC1IE << (Channel / 4U), 1UL << Channel);
+}
+
+HAL_StatusTypeDef
+HAL_TIM_OC_Stop_IT(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    htim->Instance->DIER &= ~(TIM_DIER_CC1IE << (Channel / 4U));
+    htim->Instance->CCER &= ~(1UL << Channel);
+    return HAL_OK;
+}
+
+void
+HAL_TIM_IRQHandler(TIM_HandleTypeDef* htim) {
+    TIM_TypeDef* tim = htim->Instance;
+
+    for (uint32_t ch = 0U; ch < 4U; ch++) {
+        uint32_t flag = TIM_SR_CC1IF << ch;
+        if ((tim->SR & flag) != 0U && (tim->DIER & flag) != 0U) {
+            tim->SR &= ~flag;
+            htim->Channel = (HAL_TIM_ActiveChannel)(1U << ch);
+            HAL_TIM_OC_DelayElapsedCallback(htim);
+            htim->Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+        }
+    }
+    if ((tim->SR & TIM_SR_UIF) != 0U && (tim->DIER & TIM_DIER_UIE) != 0U) {
+        tim->SR &= ~TIM_SR_UIF;
+        HAL_TIM_PeriodElapsedCallback(htim);
+    }
+}
+
+__attribute__((weak)) void
+HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    (void)htim;
+}
+
+__attribute__((weak)) void
+HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim) {
+    (void)htim;
+}
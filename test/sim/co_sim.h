@@ -0,0 +1,168 @@
+/*
+ * Host simulator of the STM32 peripherals used by CANopenSTM32: Cortex-M
+ * interrupt masking and NVIC, bxCAN controllers with filters and receive
+ * FIFOs on a loopback CAN bus, and general purpose timers. With CO_SIM_FDCAN
+ * the controllers are FDCAN (STM32G4), with CAN FD frames on the bus.
+ *
+ * Time is virtual, in nanoseconds. It advances only in co_sim_run_until(),
+ * co_sim_busy(), __WFI() and __WFE(), code between them takes no time. All
+ * bus and timer events are processed in order of their virtual time and
+ * interrupts are dispatched at their priority as soon as they become
+ * pending and unmasked.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CO_SIM_H
+#define CO_SIM_H
+
+#include <stdbool.h>
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CO_SIM_NEVER UINT64_MAX
+
+/* CAN frame on the simulated bus, standard identifiers only. dlc is the DLC
+ * code, classic frames with code 9 to 15 carry 8 bytes. CAN FD frames have
+ * CO_SIM_FDF and optionally CO_SIM_BRS set in dlc above the code and carry up
+ * to 64 bytes. */
+typedef struct {
+    uint16_t id;
+    uint8_t rtr;
+    uint8_t dlc;
+    uint8_t data[64];
+} co_sim_frame_t;
+
+#define CO_SIM_FDF 0x10U /* CAN FD frame */
+#define CO_SIM_BRS 0x20U /* Data phase with data bit rate */
+
+/* Number of data bytes of a frame */
+uint32_t co_sim_frame_bytes(const co_sim_frame_t* frame);
+
+/* Per interrupt statistics, host time excludes nested interrupts and the
+ * simulator */
+typedef struct {
+    uint32_t count;
+    uint64_t host_ns;
+    uint64_t host_ns_max;
+} co_sim_irq_stats_t;
+
+/* Per controller statistics */
+typedef struct {
+    uint32_t tx;       /* Frames transmitted */
+    uint32_t rx;       /* Frames stored in a receive FIFO */
+    uint32_t filtered; /* Frames rejected by acceptance filters */
+    uint32_t overrun;  /* Frames lost on full receive FIFO */
+    uint32_t fifoMax;  /* Highest receive FIFO fill level seen */
+} co_sim_can_stats_t;
+
+/* Source of a frame in bus monitor, controller index or external node */
+#define CO_SIM_EXTERNAL (-1)
+
+typedef void (*co_sim_monitor_t)(void* object, const co_sim_frame_t* frame, uint64_t sof_ns, uint64_t eof_ns,
+                                 int source);
+
+/* Reset all peripherals, interrupt handlers, the bus and time to 0 */
+void co_sim_reset(void);
+
+/* Virtual time */
+uint64_t co_sim_now_ns(void);
+void co_sim_run_until(uint64_t time_ns);
+void co_sim_busy(uint64_t duration_ns);
+
+/* Sleep in __WFI() or __WFE() returns at this time even without an interrupt
+ * and sets co_sim_sleep_timeout, default CO_SIM_NEVER aborts a sleep with no
+ * event in sight */
+extern uint64_t co_sim_deadline_ns;
+extern bool co_sim_sleep_timeout;
+
+/* Virtual CPU time charged for each interrupt: fixed cost plus host time of
+ * the handler multiplied by scale */
+extern uint64_t co_sim_irq_cost_ns;
+extern uint32_t co_sim_irq_cost_scale;
+
+/* Host monotonic clock, for CPU cost measurement. Host time spent in the
+ * simulator itself, in register writes, interrupt dispatch and running time,
+ * adds up in co_sim_overhead_ns() and is not in interrupt statistics */
+uint64_t co_sim_host_ns(void);
+uint32_t co_sim_host_cycles(void);
+uint64_t co_sim_overhead_ns(void);
+
+/* Nominal clock of host CPU in cycles per ns, time stamp counter rate, or 0
+ * if not known */
+double co_sim_host_ghz(void);
+
+/* Interrupts, priority 0 (highest) to 15 */
+void co_sim_irq_handler(IRQn_Type irq, void (*handler)(void* object), void* object);
+#if CO_SIM_FDCAN
+void co_sim_fdcan_bind(FDCAN_HandleTypeDef* hfdcan, uint32_t priority);
+#else
+void co_sim_can_bind(CAN_HandleTypeDef* hcan, uint32_t priority);
+#endif
+void co_sim_tim_bind(TIM_HandleTypeDef* htim, uint32_t priority);
+const co_sim_irq_stats_t* co_sim_irq_stats(IRQn_Type irq);
+/* Host time, which given fraction of interrupts did not exceed, in 8 ns
+ * steps. Maximum includes preemption of the host process, a high percentile
+ * is the repeatable worst case. */
+uint64_t co_sim_irq_percentile_ns(IRQn_Type irq, double fraction);
+void co_sim_irq_stats_clear(void);
+
+/* HAL_NVIC_SystemReset() calls this, abort() if NULL */
+extern void (*co_sim_system_reset)(void);
+
+#if CO_SIM_FDCAN
+/* CubeMX style configuration of FDCAN handle, nominal bit rate in kbit/s
+ * from 125, 250, 500 or 1000, data bit rate from 1000, 2000, 4000 or 8000.
+ * dataKbit 0 selects classic CAN frames, equal to kbit CAN FD without BRS. */
+void co_sim_fdcan_handle(FDCAN_HandleTypeDef* hfdcan, FDCAN_GlobalTypeDef* instance, uint32_t kbit,
+                         uint32_t dataKbit);
+#else
+/* CubeMX style configuration of CAN handle, bit rate in kbit/s from
+ * 125, 250, 500 or 1000 */
+void co_sim_can_handle(CAN_HandleTypeDef* hcan, CAN_TypeDef* instance, uint32_t kbit);
+#endif
+
+/* CAN bus. Bits of a frame include bit stuffing, the CAN FD data phase is
+ * counted in *dataBits (may be NULL), which are not in nominal bit time with
+ * BRS. */
+uint32_t co_sim_bus_bit_ns(void);
+uint32_t co_sim_frame_bits(const co_sim_frame_t* frame);
+uint32_t co_sim_frame_bits_fd(const co_sim_frame_t* frame, uint32_t* dataBits);
+uint64_t co_sim_frame_ns(const co_sim_frame_t* frame);
+bool co_sim_bus_inject(const co_sim_frame_t* frame, uint64_t release_ns);
+uint32_t co_sim_bus_injected(void);
+uint64_t co_sim_bus_idle_ns(void);
+void co_sim_bus_monitor(co_sim_monitor_t monitor, void* object);
+
+/* Shortcuts without bus timing: receive a frame through filters of a
+ * controller, or complete the pending transmit mailbox of highest priority */
+bool co_sim_can_receive(int can, const co_sim_frame_t* frame);
+bool co_sim_can_tx_complete(int can, co_sim_frame_t* frame);
+uint32_t co_sim_can_tx_pending(int can);
+const co_sim_can_stats_t* co_sim_can_stats(int can);
+
+/* Number of HAL_CAN_ConfigFilter() or HAL_FDCAN_ConfigFilter() calls */
+extern uint32_t co_sim_filter_configs;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CO_SIM_H */
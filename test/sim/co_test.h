@@ -0,0 +1,73 @@
+/*
+ * Common part of host tests: failure counting checks, the CAN handle of the
+ * tested node with its CANInitFunction and the result of the test. Each test
+ * is one executable, so the objects are static in this header.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CO_TEST_H
+#define CO_TEST_H
+
+#include <stdio.h>
+#include "co_sim.h"
+
+/* Number of failed TEST_CHECK()s */
+static uint32_t co_test_failures;
+
+/* Print the failed condition with a message in printf() format and count it,
+ * the test goes on */
+#define TEST_CHECK(cond, ...)                                                                                          \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                \
+            printf(__VA_ARGS__);                                                                                       \
+            printf("\n");                                                                                              \
+            co_test_failures++;                                                                                        \
+        }                                                                                                              \
+    } while (0)
+
+/* CAN handle of the tested node, configured by co_sim_can_handle() or
+ * co_sim_fdcan_handle() */
+#if CO_SIM_FDCAN
+static FDCAN_HandleTypeDef co_test_hcan;
+#else
+static CAN_HandleTypeDef co_test_hcan;
+#endif
+
+/* CANInitFunction of the tested node, like MX_CANx_Init() of CubeMX */
+static inline void
+co_test_can_init(void) {
+#if CO_SIM_FDCAN
+    HAL_FDCAN_Init(&co_test_hcan);
+#else
+    HAL_CAN_Init(&co_test_hcan);
+#endif
+}
+
+/* Exit code of main(), prints number of failures or that the test passed */
+static inline int
+co_test_result(const char* name) {
+    if (co_test_failures != 0U) {
+        printf("%u failures\n", (unsigned)co_test_failures);
+        return 1;
+    }
+    printf("%s: OK\n", name);
+    return 0;
+}
+
+#endif /* CO_TEST_H */
@@ -0,0 +1,928 @@
+/*
+ * Stand-in for CubeMX main.h on the host: the subset of CMSIS and STM32 HAL
+ * definitions used by CANopenSTM32, for a bxCAN device (STM32F4 layout) or,
+ * with CO_SIM_FDCAN set to 1, for an FDCAN device (STM32G4 layout).
+ *
+ * Peripheral registers live in RAM and are updated by the simulator in
+ * co_sim.c. Registers with side effects on write (TXRQ, RFOMx, TXBAR, RXFxA,
+ * write 1 to clear flags) must be written with WRITE_REG(), SET_BIT() or
+ * CLEAR_BIT(), as HAL does, the simulator acts on them immediately. FDCAN
+ * message RAM is plain memory.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CO_SIM_MAIN_H
+#define CO_SIM_MAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CO_SIM_FDCAN
+#define CO_SIM_FDCAN 0
+#endif
+
+#define __IO     volatile
+#define __I      volatile const
+#define __STATIC_INLINE static inline
+#define UNUSED(X) (void)(X)
+
+typedef enum { RESET = 0U, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0U, ENABLE = !DISABLE } FunctionalState;
+typedef enum { HAL_OK = 0x00U, HAL_ERROR = 0x01U, HAL_BUSY = 0x02U, HAL_TIMEOUT = 0x03U } HAL_StatusTypeDef;
+
+/* Register access, writes go through the simulator */
+void co_sim_write_reg(volatile uint32_t* reg, uint32_t value);
+#define WRITE_REG(REG, VAL)    co_sim_write_reg(&(REG), (uint32_t)(VAL))
+#define READ_REG(REG)          ((REG))
+#define SET_BIT(REG, BIT)      co_sim_write_reg(&(REG), (REG) | (uint32_t)(BIT))
+#define CLEAR_BIT(REG, BIT)    co_sim_write_reg(&(REG), (REG) & ~(uint32_t)(BIT))
+#define READ_BIT(REG, BIT)     ((REG) & (BIT))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK) WRITE_REG((REG), (((REG) & (~(CLEARMASK))) | (SETMASK)))
+
+/*******************************************************************************
+ * Cortex-M4 core
+ ******************************************************************************/
+#define __CORTEX_M       4U
+#define __NVIC_PRIO_BITS 4U
+
+typedef enum {
+    SysTick_IRQn = -1,
+#if CO_SIM_FDCAN
+    FDCAN1_IT0_IRQn = 21,
+    FDCAN1_IT1_IRQn = 22,
+#else
+    CAN1_TX_IRQn = 19,
+    CAN1_RX0_IRQn = 20,
+    CAN1_RX1_IRQn = 21,
+    CAN1_SCE_IRQn = 22,
+#endif
+    TIM2_IRQn = 28,
+    TIM3_IRQn = 29,
+    TIM4_IRQn = 30,
+    TIM5_IRQn = 50,
+#if CO_SIM_FDCAN
+    FDCAN2_IT0_IRQn = 86,
+    FDCAN2_IT1_IRQn = 87,
+#else
+    CAN2_TX_IRQn = 63,
+    CAN2_RX0_IRQn = 64,
+    CAN2_RX1_IRQn = 65,
+    CAN2_SCE_IRQn = 66,
+#endif
+} IRQn_Type;
+
+/* Interrupt masking and sleep, see co_sim.c */
+uint32_t co_sim_get_primask(void);
+void co_sim_set_primask(uint32_t primask);
+uint32_t co_sim_get_basepri(void);
+void co_sim_set_basepri(uint32_t basepri, int max);
+void co_sim_wfi(void);
+void co_sim_wfe(void);
+void co_sim_sev(void);
+
+static inline uint32_t __get_PRIMASK(void) { return co_sim_get_primask(); }
+static inline void __set_PRIMASK(uint32_t priMask) { co_sim_set_primask(priMask); }
+static inline void __disable_irq(void) { co_sim_set_primask(1U); }
+static inline void __enable_irq(void) { co_sim_set_primask(0U); }
+static inline uint32_t __get_BASEPRI(void) { return co_sim_get_basepri(); }
+static inline void __set_BASEPRI(uint32_t basePri) { co_sim_set_basepri(basePri, 0); }
+static inline void __set_BASEPRI_MAX(uint32_t basePri) { co_sim_set_basepri(basePri, 1); }
+#define __WFI() co_sim_wfi()
+#define __WFE() co_sim_wfe()
+#define __SEV() co_sim_sev()
+#define __DMB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __DSB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __ISB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __NOP() ((void)0)
+#define __BKPT(value) ((void)(value))
+static inline uint32_t __CLZ(uint32_t value) { return value == 0U ? 32U : (uint32_t)__builtin_clz(value); }
+static inline uint32_t __RBIT(uint32_t value) {
+    uint32_t result = 0U;
+    for (int i = 0; i < 32; i++, value >>= 1) {
+        result = (result << 1) | (value & 1U);
+    }
+    return result;
+}
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t LOAD;
+    __IO uint32_t VAL;
+    __I uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+    __I uint32_t CPUID;
+    __IO uint32_t ICSR;
+    __IO uint32_t VTOR;
+    __IO uint32_t AIRCR;
+    __IO uint32_t SCR;
+    __IO uint32_t CCR;
+} SCB_Type;
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DHCSR;
+    __IO uint32_t DCRSR;
+    __IO uint32_t DCRDR;
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern SysTick_Type co_sim_systick;
+extern SCB_Type co_sim_scb;
+extern DWT_Type co_sim_dwt;
+extern CoreDebug_Type co_sim_coredebug;
+#define SysTick   (&co_sim_systick)
+#define SCB       (&co_sim_scb)
+#define DWT       (&co_sim_dwt)
+#define CoreDebug (&co_sim_coredebug)
+
+#define SCB_ICSR_PENDSTSET_Msk      (1UL << 26)
+#define SCB_SCR_SLEEPONEXIT_Msk     (1UL << 1)
+#define SCB_SCR_SLEEPDEEP_Msk       (1UL << 2)
+#define SCB_SCR_SEVONPEND_Msk       (1UL << 4)
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+#define SysTick_CTRL_ENABLE_Msk     (1UL << 0)
+#define SysTick_CTRL_TICKINT_Msk    (1UL << 1)
+
+extern uint32_t SystemCoreClock;
+
+/* Benchmarks of CPU cost count host nanoseconds as CPU cycles, default is the
+ * virtual DWT cycle counter */
+#ifdef CO_SIM_HOST_CLOCK
+uint32_t co_sim_host_cycles(void);
+#define CO_CAN_CLOCK() co_sim_host_cycles()
+#endif
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_SystemReset(void);
+/* CMSIS, preemption priority with all priority bits for preemption */
+uint32_t NVIC_GetPriority(IRQn_Type IRQn);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+
+#if !CO_SIM_FDCAN
+/*******************************************************************************
+ * bxCAN
+ ******************************************************************************/
+typedef struct {
+    __IO uint32_t TIR;
+    __IO uint32_t TDTR;
+    __IO uint32_t TDLR;
+    __IO uint32_t TDHR;
+} CAN_TxMailBox_TypeDef;
+
+typedef struct {
+    __IO uint32_t RIR;
+    __IO uint32_t RDTR;
+    __IO uint32_t RDLR;
+    __IO uint32_t RDHR;
+} CAN_FIFOMailBox_TypeDef;
+
+typedef struct {
+    __IO uint32_t FR1;
+    __IO uint32_t FR2;
+} CAN_FilterRegister_TypeDef;
+
+typedef struct {
+    __IO uint32_t MCR;
+    __IO uint32_t MSR;
+    __IO uint32_t TSR;
+    __IO uint32_t RF0R;
+    __IO uint32_t RF1R;
+    __IO uint32_t IER;
+    __IO uint32_t ESR;
+    __IO uint32_t BTR;
+    uint32_t RESERVED0[88];
+    CAN_TxMailBox_TypeDef sTxMailBox[3];
+    CAN_FIFOMailBox_TypeDef sFIFOMailBox[2];
+    uint32_t RESERVED1[12];
+    __IO uint32_t FMR;
+    __IO uint32_t FM1R;
+    uint32_t RESERVED2;
+    __IO uint32_t FS1R;
+    uint32_t RESERVED3;
+    __IO uint32_t FFA1R;
+    uint32_t RESERVED4;
+    __IO uint32_t FA1R;
+    uint32_t RESERVED5[8];
+    CAN_FilterRegister_TypeDef sFilterRegister[28];
+} CAN_TypeDef;
+
+/* Register blocks of simulated peripherals, 1 kB apart as on the device */
+typedef union {
+    CAN_TypeDef regs;
+    uint8_t block[0x400];
+} co_sim_can_block_t;
+extern co_sim_can_block_t co_sim_can_ip[2];
+#define CAN1 (&co_sim_can_ip[0].regs)
+#define CAN2 (&co_sim_can_ip[1].regs)
+
+#define CAN_MCR_INRQ          (1UL << 0)
+#define CAN_MCR_SLEEP         (1UL << 1)
+#define CAN_MCR_TXFP          (1UL << 2)
+#define CAN_MCR_RFLM          (1UL << 3)
+#define CAN_MCR_NART          (1UL << 4)
+#define CAN_MCR_AWUM          (1UL << 5)
+#define CAN_MCR_ABOM          (1UL << 6)
+#define CAN_MCR_TTCM          (1UL << 7)
+#define CAN_MCR_RESET         (1UL << 15)
+#define CAN_MSR_INAK          (1UL << 0)
+#define CAN_MSR_SLAK          (1UL << 1)
+#define CAN_TSR_RQCP0         (1UL << 0)
+#define CAN_TSR_TXOK0         (1UL << 1)
+#define CAN_TSR_ALST0         (1UL << 2)
+#define CAN_TSR_TERR0         (1UL << 3)
+#define CAN_TSR_ABRQ0         (1UL << 7)
+#define CAN_TSR_RQCP1         (1UL << 8)
+#define CAN_TSR_TXOK1         (1UL << 9)
+#define CAN_TSR_ALST1         (1UL << 10)
+#define CAN_TSR_TERR1         (1UL << 11)
+#define CAN_TSR_ABRQ1         (1UL << 15)
+#define CAN_TSR_RQCP2         (1UL << 16)
+#define CAN_TSR_TXOK2         (1UL << 17)
+#define CAN_TSR_ALST2         (1UL << 18)
+#define CAN_TSR_TERR2         (1UL << 19)
+#define CAN_TSR_ABRQ2         (1UL << 23)
+#define CAN_TSR_CODE_Pos      24U
+#define CAN_TSR_CODE          (0x3UL << CAN_TSR_CODE_Pos)
+#define CAN_TSR_TME_Pos       26U
+#define CAN_TSR_TME           (0x7UL << CAN_TSR_TME_Pos)
+#define CAN_TSR_TME0          (1UL << 26)
+#define CAN_TSR_TME1          (1UL << 27)
+#define CAN_TSR_TME2          (1UL << 28)
+#define CAN_RF0R_FMP0         (0x3UL << 0)
+#define CAN_RF0R_FULL0        (1UL << 3)
+#define CAN_RF0R_FOVR0        (1UL << 4)
+#define CAN_RF0R_RFOM0        (1UL << 5)
+#define CAN_RF1R_FMP1         (0x3UL << 0)
+#define CAN_RF1R_FULL1        (1UL << 3)
+#define CAN_RF1R_FOVR1        (1UL << 4)
+#define CAN_RF1R_RFOM1        (1UL << 5)
+#define CAN_IER_TMEIE         (1UL << 0)
+#define CAN_IER_FMPIE0        (1UL << 1)
+#define CAN_IER_FFIE0         (1UL << 2)
+#define CAN_IER_FOVIE0        (1UL << 3)
+#define CAN_IER_FMPIE1        (1UL << 4)
+#define CAN_IER_FFIE1         (1UL << 5)
+#define CAN_IER_FOVIE1        (1UL << 6)
+#define CAN_IER_ERRIE         (1UL << 15)
+#define CAN_ESR_EWGF          (1UL << 0)
+#define CAN_ESR_EPVF          (1UL << 1)
+#define CAN_ESR_BOFF          (1UL << 2)
+#define CAN_ESR_TEC_Pos       16U
+#define CAN_ESR_REC_Pos       24U
+#define CAN_BTR_BRP           (0x3FFUL << 0)
+#define CAN_BTR_TS1_Pos       16U
+#define CAN_BTR_TS1           (0xFUL << CAN_BTR_TS1_Pos)
+#define CAN_BTR_TS2_Pos       20U
+#define CAN_BTR_TS2           (0x7UL << CAN_BTR_TS2_Pos)
+#define CAN_BTR_SJW_Pos       24U
+#define CAN_BTR_SJW           (0x3UL << CAN_BTR_SJW_Pos)
+#define CAN_BTR_LBKM          (1UL << 30)
+#define CAN_BTR_SILM          (1UL << 31)
+#define CAN_TI0R_TXRQ         (1UL << 0)
+#define CAN_TI0R_RTR          (1UL << 1)
+#define CAN_TI0R_IDE          (1UL << 2)
+#define CAN_TI0R_EXID_Pos     3U
+#define CAN_TI0R_STID_Pos     21U
+#define CAN_TDT0R_DLC         (0xFUL << 0)
+#define CAN_TDT0R_TGT         (1UL << 8)
+#define CAN_RI0R_RTR          (1UL << 1)
+#define CAN_RI0R_IDE          (1UL << 2)
+#define CAN_RI0R_EXID_Pos     3U
+#define CAN_RI0R_STID_Pos     21U
+#define CAN_RDT0R_DLC         (0xFUL << 0)
+#define CAN_RDT0R_FMI_Pos     8U
+#define CAN_RDT0R_FMI         (0xFFUL << CAN_RDT0R_FMI_Pos)
+#define CAN_RDT0R_TIME_Pos    16U
+#define CAN_RDT0R_TIME        (0xFFFFUL << CAN_RDT0R_TIME_Pos)
+#define CAN_FMR_FINIT         (1UL << 0)
+#define CAN_FMR_CAN2SB_Pos    8U
+#define CAN_FMR_CAN2SB        (0x3FUL << CAN_FMR_CAN2SB_Pos)
+
+typedef enum {
+    HAL_CAN_STATE_RESET = 0x00U,
+    HAL_CAN_STATE_READY = 0x01U,
+    HAL_CAN_STATE_LISTENING = 0x02U,
+    HAL_CAN_STATE_SLEEP_PENDING = 0x03U,
+    HAL_CAN_STATE_SLEEP_ACTIVE = 0x04U,
+    HAL_CAN_STATE_ERROR = 0x05U
+} HAL_CAN_StateTypeDef;
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t Mode;
+    uint32_t SyncJumpWidth;
+    uint32_t TimeSeg1;
+    uint32_t TimeSeg2;
+    FunctionalState TimeTriggeredMode;
+    FunctionalState AutoBusOff;
+    FunctionalState AutoWakeUp;
+    FunctionalState AutoRetransmission;
+    FunctionalState ReceiveFifoLocked;
+    FunctionalState TransmitFifoPriority;
+} CAN_InitTypeDef;
+
+typedef struct {
+    CAN_TypeDef* Instance;
+    CAN_InitTypeDef Init;
+    __IO HAL_CAN_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} CAN_HandleTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    FunctionalState TransmitGlobalTime;
+} CAN_TxHeaderTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t Timestamp;
+    uint32_t FilterMatchIndex;
+} CAN_RxHeaderTypeDef;
+
+typedef struct {
+    uint32_t FilterIdHigh;
+    uint32_t FilterIdLow;
+    uint32_t FilterMaskIdHigh;
+    uint32_t FilterMaskIdLow;
+    uint32_t FilterFIFOAssignment;
+    uint32_t FilterBank;
+    uint32_t FilterMode;
+    uint32_t FilterScale;
+    uint32_t FilterActivation;
+    uint32_t SlaveStartFilterBank;
+} CAN_FilterTypeDef;
+
+#define CAN_MODE_NORMAL            0x00000000U
+#define CAN_MODE_LOOPBACK          CAN_BTR_LBKM
+#define CAN_MODE_SILENT            CAN_BTR_SILM
+#define CAN_SJW_1TQ                0x00000000U
+#define CAN_BS1_TQ(n)              ((uint32_t)((n) - 1U) << CAN_BTR_TS1_Pos)
+#define CAN_BS2_TQ(n)              ((uint32_t)((n) - 1U) << CAN_BTR_TS2_Pos)
+#define CAN_ID_STD                 0x00000000U
+#define CAN_ID_EXT                 0x00000004U
+#define CAN_RTR_DATA               0x00000000U
+#define CAN_RTR_REMOTE             0x00000002U
+#define CAN_RX_FIFO0               0x00000000U
+#define CAN_RX_FIFO1               0x00000001U
+#define CAN_TX_MAILBOX0            0x00000001U
+#define CAN_TX_MAILBOX1            0x00000002U
+#define CAN_TX_MAILBOX2            0x00000004U
+#define CAN_FILTERMODE_IDMASK      0x00000000U
+#define CAN_FILTERMODE_IDLIST      0x00000001U
+#define CAN_FILTERSCALE_16BIT      0x00000000U
+#define CAN_FILTERSCALE_32BIT      0x00000001U
+#define CAN_FILTER_DISABLE         0x00000000U
+#define CAN_FILTER_ENABLE          0x00000001U
+#define CAN_FILTER_FIFO0           0x00000000U
+#define CAN_FILTER_FIFO1           0x00000001U
+#define CAN_IT_TX_MAILBOX_EMPTY    CAN_IER_TMEIE
+#define CAN_IT_RX_FIFO0_MSG_PENDING CAN_IER_FMPIE0
+#define CAN_IT_RX_FIFO0_FULL       CAN_IER_FFIE0
+#define CAN_IT_RX_FIFO0_OVERRUN    CAN_IER_FOVIE0
+#define CAN_IT_RX_FIFO1_MSG_PENDING CAN_IER_FMPIE1
+#define CAN_IT_RX_FIFO1_FULL       CAN_IER_FFIE1
+#define CAN_IT_RX_FIFO1_OVERRUN    CAN_IER_FOVIE1
+#define HAL_CAN_ERROR_NONE         0x00000000U
+#define HAL_CAN_ERROR_NOT_READY    0x00040000U
+#define HAL_CAN_ERROR_NOT_STARTED  0x00080000U
+#define HAL_CAN_ERROR_NOT_INITIALIZED 0x00100000U
+#define HAL_CAN_ERROR_PARAM        0x00200000U
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, CAN_FilterTypeDef* sFilterConfig);
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef* hcan, CAN_TxHeaderTypeDef* pHeader, uint8_t aData[],
+                                       uint32_t* pTxMailbox);
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef* hcan, uint32_t TxMailboxes);
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef* hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef* pHeader,
+                                       uint8_t aData[]);
+uint32_t HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef* hcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef* hcan, uint32_t ActiveITs);
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef* hcan, uint32_t InactiveITs);
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef* hcan);
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan);
+#else /* !CO_SIM_FDCAN */
+/*******************************************************************************
+ * FDCAN
+ ******************************************************************************/
+typedef struct {
+    __IO uint32_t CREL;
+    __IO uint32_t ENDN;
+    uint32_t RESERVED1;
+    __IO uint32_t DBTP;
+    __IO uint32_t TEST;
+    __IO uint32_t RWD;
+    __IO uint32_t CCCR;
+    __IO uint32_t NBTP;
+    __IO uint32_t TSCC;
+    __IO uint32_t TSCV;
+    __IO uint32_t TOCC;
+    __IO uint32_t TOCV;
+    uint32_t RESERVED2[4];
+    __IO uint32_t ECR;
+    __IO uint32_t PSR;
+    __IO uint32_t TDCR;
+    uint32_t RESERVED3;
+    __IO uint32_t IR;
+    __IO uint32_t IE;
+    __IO uint32_t ILS;
+    __IO uint32_t ILE;
+    uint32_t RESERVED4[8];
+    __IO uint32_t RXGFC;
+    __IO uint32_t XIDAM;
+    __IO uint32_t HPMS;
+    uint32_t RESERVED5;
+    __IO uint32_t RXF0S;
+    __IO uint32_t RXF0A;
+    __IO uint32_t RXF1S;
+    __IO uint32_t RXF1A;
+    uint32_t RESERVED6[8];
+    __IO uint32_t TXBC;
+    __IO uint32_t TXFQS;
+    __IO uint32_t TXBRP;
+    __IO uint32_t TXBAR;
+    __IO uint32_t TXBCR;
+    __IO uint32_t TXBTO;
+    __IO uint32_t TXBCF;
+    __IO uint32_t TXBTIE;
+    __IO uint32_t TXBCIE;
+    __IO uint32_t TXEFS;
+    __IO uint32_t TXEFA;
+} FDCAN_GlobalTypeDef;
+
+/* Register blocks of simulated peripherals, 1 kB apart as on the device */
+typedef union {
+    FDCAN_GlobalTypeDef regs;
+    uint8_t block[0x400];
+} co_sim_fdcan_block_t;
+extern co_sim_fdcan_block_t co_sim_fdcan_ip[2];
+#define FDCAN1 (&co_sim_fdcan_ip[0].regs)
+#define FDCAN2 (&co_sim_fdcan_ip[1].regs)
+
+/* Message RAM with fixed layout, SRAMCAN_SIZE bytes per instance */
+#define SRAMCAN_SIZE  0x350U
+#define SRAMCAN_FLSSA 0x000U /* 28 standard filter elements */
+#define SRAMCAN_FLESA 0x070U /* 8 extended filter elements */
+#define SRAMCAN_RF0SA 0x0B0U /* 3 RX FIFO 0 elements */
+#define SRAMCAN_RF1SA 0x188U /* 3 RX FIFO 1 elements */
+#define SRAMCAN_TEFSA 0x260U /* 3 TX event FIFO elements */
+#define SRAMCAN_TFQSA 0x278U /* 3 TX buffers */
+#define SRAMCAN_FLS_NBR 28U
+#define SRAMCAN_FLE_NBR 8U
+#define SRAMCAN_RF0_NBR 3U
+#define SRAMCAN_RF1_NBR 3U
+#define SRAMCAN_TEF_NBR 3U
+#define SRAMCAN_TFQ_NBR 3U
+#define SRAMCAN_FLS_SIZE (1U * 4U)
+#define SRAMCAN_FLE_SIZE (2U * 4U)
+#define SRAMCAN_RF0_SIZE (18U * 4U)
+#define SRAMCAN_RF1_SIZE (18U * 4U)
+#define SRAMCAN_TEF_SIZE (2U * 4U)
+#define SRAMCAN_TFQ_SIZE (18U * 4U)
+extern uint32_t co_sim_sramcan[2 * SRAMCAN_SIZE / 4U];
+#define SRAMCAN_BASE ((uintptr_t)co_sim_sramcan)
+
+#define FDCAN_CCCR_INIT       (1UL << 0)
+#define FDCAN_CCCR_CCE        (1UL << 1)
+#define FDCAN_CCCR_ASM        (1UL << 2)
+#define FDCAN_CCCR_CSA        (1UL << 3)
+#define FDCAN_CCCR_CSR        (1UL << 4)
+#define FDCAN_CCCR_MON        (1UL << 5)
+#define FDCAN_CCCR_DAR        (1UL << 6)
+#define FDCAN_CCCR_TEST       (1UL << 7)
+#define FDCAN_CCCR_FDOE       (1UL << 8)
+#define FDCAN_CCCR_BRSE       (1UL << 9)
+#define FDCAN_NBTP_NTSEG2_Pos 0U
+#define FDCAN_NBTP_NTSEG2     (0x7FUL << FDCAN_NBTP_NTSEG2_Pos)
+#define FDCAN_NBTP_NTSEG1_Pos 8U
+#define FDCAN_NBTP_NTSEG1     (0xFFUL << FDCAN_NBTP_NTSEG1_Pos)
+#define FDCAN_NBTP_NBRP_Pos   16U
+#define FDCAN_NBTP_NBRP       (0x1FFUL << FDCAN_NBTP_NBRP_Pos)
+#define FDCAN_NBTP_NSJW_Pos   25U
+#define FDCAN_NBTP_NSJW       (0x7FUL << FDCAN_NBTP_NSJW_Pos)
+#define FDCAN_DBTP_DSJW_Pos   0U
+#define FDCAN_DBTP_DSJW       (0xFUL << FDCAN_DBTP_DSJW_Pos)
+#define FDCAN_DBTP_DTSEG2_Pos 4U
+#define FDCAN_DBTP_DTSEG2     (0xFUL << FDCAN_DBTP_DTSEG2_Pos)
+#define FDCAN_DBTP_DTSEG1_Pos 8U
+#define FDCAN_DBTP_DTSEG1     (0x1FUL << FDCAN_DBTP_DTSEG1_Pos)
+#define FDCAN_DBTP_DBRP_Pos   16U
+#define FDCAN_DBTP_DBRP       (0x1FUL << FDCAN_DBTP_DBRP_Pos)
+#define FDCAN_TSCC_TSS        (0x3UL << 0)
+#define FDCAN_TSCC_TCP_Pos    16U
+#define FDCAN_TSCC_TCP        (0xFUL << FDCAN_TSCC_TCP_Pos)
+#define FDCAN_TSCV_TSC        (0xFFFFUL << 0)
+#define FDCAN_PSR_EP          (1UL << 5)
+#define FDCAN_PSR_EW          (1UL << 6)
+#define FDCAN_PSR_BO          (1UL << 7)
+#define FDCAN_IR_RF0N         (1UL << 0)
+#define FDCAN_IR_RF0F         (1UL << 1)
+#define FDCAN_IR_RF0L         (1UL << 2)
+#define FDCAN_IR_RF1N         (1UL << 3)
+#define FDCAN_IR_RF1F         (1UL << 4)
+#define FDCAN_IR_RF1L         (1UL << 5)
+#define FDCAN_IR_HPM          (1UL << 6)
+#define FDCAN_IR_TC           (1UL << 7)
+#define FDCAN_IR_TCF          (1UL << 8)
+#define FDCAN_IR_TFE          (1UL << 9)
+#define FDCAN_IR_TEFN         (1UL << 10)
+#define FDCAN_IR_TEFF         (1UL << 11)
+#define FDCAN_IR_TEFL         (1UL << 12)
+#define FDCAN_IR_TSW          (1UL << 13)
+#define FDCAN_IR_MRAF         (1UL << 14)
+#define FDCAN_IR_TOO          (1UL << 15)
+#define FDCAN_IR_ELO          (1UL << 16)
+#define FDCAN_IR_EP           (1UL << 17)
+#define FDCAN_IR_EW           (1UL << 18)
+#define FDCAN_IR_BO           (1UL << 19)
+#define FDCAN_IR_WDI          (1UL << 20)
+#define FDCAN_IR_PEA          (1UL << 21)
+#define FDCAN_IR_PED          (1UL << 22)
+#define FDCAN_IR_ARA          (1UL << 23)
+#define FDCAN_ILS_RXFIFO0     (1UL << 0)
+#define FDCAN_ILS_RXFIFO1     (1UL << 1)
+#define FDCAN_ILS_SMSG        (1UL << 2)
+#define FDCAN_ILS_TFERR       (1UL << 3)
+#define FDCAN_ILS_MISC        (1UL << 4)
+#define FDCAN_ILS_BERR        (1UL << 5)
+#define FDCAN_ILS_PERR        (1UL << 6)
+#define FDCAN_ILE_EINT0       (1UL << 0)
+#define FDCAN_ILE_EINT1       (1UL << 1)
+#define FDCAN_RXGFC_RRFE      (1UL << 0)
+#define FDCAN_RXGFC_RRFS      (1UL << 1)
+#define FDCAN_RXGFC_ANFE_Pos  2U
+#define FDCAN_RXGFC_ANFE      (0x3UL << FDCAN_RXGFC_ANFE_Pos)
+#define FDCAN_RXGFC_ANFS_Pos  4U
+#define FDCAN_RXGFC_ANFS      (0x3UL << FDCAN_RXGFC_ANFS_Pos)
+#define FDCAN_RXGFC_LSS_Pos   16U
+#define FDCAN_RXGFC_LSS       (0x1FUL << FDCAN_RXGFC_LSS_Pos)
+#define FDCAN_RXGFC_LSE_Pos   24U
+#define FDCAN_RXGFC_LSE       (0xFUL << FDCAN_RXGFC_LSE_Pos)
+#define FDCAN_RXF0S_F0FL      (0xFUL << 0)
+#define FDCAN_RXF0S_F0GI_Pos  8U
+#define FDCAN_RXF0S_F0GI      (0x3UL << FDCAN_RXF0S_F0GI_Pos)
+#define FDCAN_RXF0S_F0PI_Pos  16U
+#define FDCAN_RXF0S_F0PI      (0x3UL << FDCAN_RXF0S_F0PI_Pos)
+#define FDCAN_RXF0S_F0F       (1UL << 24)
+#define FDCAN_RXF0S_RF0L      (1UL << 25)
+#define FDCAN_RXF1S_F1FL      (0xFUL << 0)
+#define FDCAN_RXF1S_F1GI_Pos  8U
+#define FDCAN_RXF1S_F1GI      (0x3UL << FDCAN_RXF1S_F1GI_Pos)
+#define FDCAN_RXF1S_F1PI_Pos  16U
+#define FDCAN_RXF1S_F1PI      (0x3UL << FDCAN_RXF1S_F1PI_Pos)
+#define FDCAN_RXF1S_F1F       (1UL << 24)
+#define FDCAN_RXF1S_RF1L      (1UL << 25)
+#define FDCAN_TXBC_TFQM       (1UL << 24)
+#define FDCAN_TXFQS_TFFL      (0x7UL << 0)
+#define FDCAN_TXFQS_TFGI_Pos  8U
+#define FDCAN_TXFQS_TFGI      (0x3UL << FDCAN_TXFQS_TFGI_Pos)
+#define FDCAN_TXFQS_TFQPI_Pos 16U
+#define FDCAN_TXFQS_TFQPI     (0x3UL << FDCAN_TXFQS_TFQPI_Pos)
+#define FDCAN_TXFQS_TFQF      (1UL << 21)
+#define FDCAN_TXEFS_EFFL      (0x7UL << 0)
+#define FDCAN_TXEFS_EFGI_Pos  8U
+#define FDCAN_TXEFS_EFGI      (0x3UL << FDCAN_TXEFS_EFGI_Pos)
+#define FDCAN_TXEFS_EFPI_Pos  16U
+#define FDCAN_TXEFS_EFPI      (0x3UL << FDCAN_TXEFS_EFPI_Pos)
+#define FDCAN_TXEFS_EFF       (1UL << 24)
+#define FDCAN_TXEFS_TEFL      (1UL << 25)
+
+typedef enum {
+    HAL_FDCAN_STATE_RESET = 0x00U,
+    HAL_FDCAN_STATE_READY = 0x01U,
+    HAL_FDCAN_STATE_BUSY = 0x02U,
+    HAL_FDCAN_STATE_ERROR = 0x03U
+} HAL_FDCAN_StateTypeDef;
+
+typedef struct {
+    uint32_t ClockDivider;
+    uint32_t FrameFormat;
+    uint32_t Mode;
+    FunctionalState AutoRetransmission;
+    FunctionalState TransmitPause;
+    FunctionalState ProtocolException;
+    uint32_t NominalPrescaler;
+    uint32_t NominalSyncJumpWidth;
+    uint32_t NominalTimeSeg1;
+    uint32_t NominalTimeSeg2;
+    uint32_t DataPrescaler;
+    uint32_t DataSyncJumpWidth;
+    uint32_t DataTimeSeg1;
+    uint32_t DataTimeSeg2;
+    uint32_t StdFiltersNbr;
+    uint32_t ExtFiltersNbr;
+    uint32_t TxFifoQueueMode;
+} FDCAN_InitTypeDef;
+
+/* Start addresses of message RAM sections, uintptr_t on the host */
+typedef struct {
+    uintptr_t StandardFilterSA;
+    uintptr_t ExtendedFilterSA;
+    uintptr_t RxFIFO0SA;
+    uintptr_t RxFIFO1SA;
+    uintptr_t TxEventFIFOSA;
+    uintptr_t TxFIFOQSA;
+} FDCAN_MsgRamAddressTypeDef;
+
+typedef struct {
+    FDCAN_GlobalTypeDef* Instance;
+    FDCAN_InitTypeDef Init;
+    FDCAN_MsgRamAddressTypeDef msgRam;
+    uint32_t LatestTxFifoQRequest;
+    __IO HAL_FDCAN_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} FDCAN_HandleTypeDef;
+
+typedef struct {
+    uint32_t Identifier;
+    uint32_t IdType;
+    uint32_t TxFrameType;
+    uint32_t DataLength;
+    uint32_t ErrorStateIndicator;
+    uint32_t BitRateSwitch;
+    uint32_t FDFormat;
+    uint32_t TxEventFifoControl;
+    uint32_t MessageMarker;
+} FDCAN_TxHeaderTypeDef;
+
+typedef struct {
+    uint32_t Identifier;
+    uint32_t IdType;
+    uint32_t RxFrameType;
+    uint32_t DataLength;
+    uint32_t ErrorStateIndicator;
+    uint32_t BitRateSwitch;
+    uint32_t FDFormat;
+    uint32_t RxTimestamp;
+    uint32_t FilterIndex;
+    uint32_t IsFilterMatchingFrame;
+} FDCAN_RxHeaderTypeDef;
+
+typedef struct {
+    uint32_t Identifier;
+    uint32_t IdType;
+    uint32_t TxFrameType;
+    uint32_t DataLength;
+    uint32_t ErrorStateIndicator;
+    uint32_t BitRateSwitch;
+    uint32_t FDFormat;
+    uint32_t TxTimestamp;
+    uint32_t MessageMarker;
+    uint32_t EventType;
+} FDCAN_TxEventFifoTypeDef;
+
+typedef struct {
+    uint32_t IdType;
+    uint32_t FilterIndex;
+    uint32_t FilterType;
+    uint32_t FilterConfig;
+    uint32_t FilterID1;
+    uint32_t FilterID2;
+} FDCAN_FilterTypeDef;
+
+#define FDCAN_CLOCK_DIV1             0x00000000U
+#define FDCAN_FRAME_CLASSIC          0x00000000U
+#define FDCAN_FRAME_FD_NO_BRS        FDCAN_CCCR_FDOE
+#define FDCAN_FRAME_FD_BRS           (FDCAN_CCCR_FDOE | FDCAN_CCCR_BRSE)
+#define FDCAN_MODE_NORMAL            0x00000000U
+#define FDCAN_TX_FIFO_OPERATION      0x00000000U
+#define FDCAN_TX_QUEUE_OPERATION     FDCAN_TXBC_TFQM
+#define FDCAN_STANDARD_ID            0x00000000U
+#define FDCAN_EXTENDED_ID            0x40000000U
+#define FDCAN_DATA_FRAME             0x00000000U
+#define FDCAN_REMOTE_FRAME           0x20000000U
+#define FDCAN_ESI_ACTIVE             0x00000000U
+#define FDCAN_ESI_PASSIVE            0x80000000U
+#define FDCAN_BRS_OFF                0x00000000U
+#define FDCAN_BRS_ON                 0x00100000U
+#define FDCAN_CLASSIC_CAN            0x00000000U
+#define FDCAN_FD_CAN                 0x00200000U
+#define FDCAN_NO_TX_EVENTS           0x00000000U
+#define FDCAN_STORE_TX_EVENTS        0x00800000U
+#define FDCAN_DLC_BYTES_1            0x00000001U /* DLC code is not shifted, as in newer HAL */
+#define FDCAN_RX_FIFO0               0x00000040U
+#define FDCAN_RX_FIFO1               0x00000041U
+#define FDCAN_FILTER_RANGE           0x00000000U
+#define FDCAN_FILTER_DUAL            0x00000001U
+#define FDCAN_FILTER_MASK            0x00000002U
+#define FDCAN_FILTER_DISABLE         0x00000000U
+#define FDCAN_FILTER_TO_RXFIFO0      0x00000001U
+#define FDCAN_FILTER_TO_RXFIFO1      0x00000002U
+#define FDCAN_FILTER_REJECT          0x00000003U
+#define FDCAN_ACCEPT_IN_RX_FIFO0     0x00000000U
+#define FDCAN_ACCEPT_IN_RX_FIFO1     0x00000001U
+#define FDCAN_REJECT                 0x00000002U
+#define FDCAN_FILTER_REMOTE          0x00000000U
+#define FDCAN_REJECT_REMOTE          0x00000001U
+#define FDCAN_TIMESTAMP_PRESC_1      0x00000000U
+#define FDCAN_TIMESTAMP_INTERNAL     0x00000001U
+#define FDCAN_INTERRUPT_LINE0        FDCAN_ILE_EINT0
+#define FDCAN_INTERRUPT_LINE1        FDCAN_ILE_EINT1
+#define FDCAN_IT_GROUP_RX_FIFO0      FDCAN_ILS_RXFIFO0
+#define FDCAN_IT_GROUP_RX_FIFO1      FDCAN_ILS_RXFIFO1
+#define FDCAN_IT_GROUP_SMSG          FDCAN_ILS_SMSG
+#define FDCAN_IT_GROUP_TX_FIFO_ERROR FDCAN_ILS_TFERR
+#define FDCAN_IT_GROUP_MISC          FDCAN_ILS_MISC
+#define FDCAN_IT_GROUP_BIT_LINE_ERROR FDCAN_ILS_BERR
+#define FDCAN_IT_GROUP_PROTOCOL_ERROR FDCAN_ILS_PERR
+#define FDCAN_IT_RX_FIFO0_NEW_MESSAGE FDCAN_IR_RF0N
+#define FDCAN_IT_RX_FIFO0_FULL       FDCAN_IR_RF0F
+#define FDCAN_IT_RX_FIFO0_MESSAGE_LOST FDCAN_IR_RF0L
+#define FDCAN_IT_RX_FIFO1_NEW_MESSAGE FDCAN_IR_RF1N
+#define FDCAN_IT_RX_FIFO1_FULL       FDCAN_IR_RF1F
+#define FDCAN_IT_RX_FIFO1_MESSAGE_LOST FDCAN_IR_RF1L
+#define FDCAN_IT_TX_COMPLETE         FDCAN_IR_TC
+#define FDCAN_IT_TX_ABORT_COMPLETE   FDCAN_IR_TCF
+#define FDCAN_IT_TX_FIFO_EMPTY       FDCAN_IR_TFE
+#define FDCAN_IT_TX_EVT_FIFO_NEW_DATA FDCAN_IR_TEFN
+#define FDCAN_IT_TX_EVT_FIFO_FULL    FDCAN_IR_TEFF
+#define FDCAN_IT_TX_EVT_FIFO_ELT_LOST FDCAN_IR_TEFL
+#define FDCAN_IT_ERROR_LOGGING_OVERFLOW FDCAN_IR_ELO
+#define FDCAN_IT_ERROR_PASSIVE       FDCAN_IR_EP
+#define FDCAN_IT_ERROR_WARNING       FDCAN_IR_EW
+#define FDCAN_IT_BUS_OFF             FDCAN_IR_BO
+#define FDCAN_IT_ARB_PROTOCOL_ERROR  FDCAN_IR_PEA
+#define FDCAN_IT_DATA_PROTOCOL_ERROR FDCAN_IR_PED
+#define HAL_FDCAN_ERROR_NONE         0x00000000U
+#define HAL_FDCAN_ERROR_NOT_INITIALIZED 0x00000080U
+#define HAL_FDCAN_ERROR_NOT_READY    0x00000100U
+#define HAL_FDCAN_ERROR_NOT_STARTED  0x00000200U
+#define HAL_FDCAN_ERROR_FIFO_EMPTY   0x00000020U
+#define HAL_FDCAN_ERROR_FIFO_FULL    0x00000040U
+
+/* FDCAN kernel clock */
+#define RCC_PERIPHCLK_FDCAN 0x00001000U
+uint32_t HAL_RCCEx_GetPeriphCLKFreq(uint32_t PeriphClk);
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef* hfdcan, FDCAN_FilterTypeDef* sFilterConfig);
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef* hfdcan, uint32_t NonMatchingStd,
+                                               uint32_t NonMatchingExt, uint32_t RejectRemoteStd,
+                                               uint32_t RejectRemoteExt);
+HAL_StatusTypeDef HAL_FDCAN_ConfigTimestampCounter(FDCAN_HandleTypeDef* hfdcan, uint32_t TimestampPrescaler);
+HAL_StatusTypeDef HAL_FDCAN_EnableTimestampCounter(FDCAN_HandleTypeDef* hfdcan, uint32_t TimestampOperation);
+HAL_StatusTypeDef HAL_FDCAN_ConfigInterruptLines(FDCAN_HandleTypeDef* hfdcan, uint32_t ITList,
+                                                 uint32_t InterruptLine);
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef* hfdcan, FDCAN_TxHeaderTypeDef* pTxHeader,
+                                                uint8_t* pTxData);
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef* hfdcan, uint32_t RxLocation,
+                                         FDCAN_RxHeaderTypeDef* pRxHeader, uint8_t* pRxData);
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_FDCAN_GetTxEvent(FDCAN_HandleTypeDef* hfdcan, FDCAN_TxEventFifoTypeDef* pTxEvent);
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t ActiveITs,
+                                                 uint32_t BufferIndexes);
+HAL_StatusTypeDef HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t InactiveITs);
+void HAL_FDCAN_IRQHandler(FDCAN_HandleTypeDef* hfdcan);
+void HAL_FDCAN_TxEventFifoCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t TxEventFifoITs);
+void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs);
+void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo1ITs);
+void HAL_FDCAN_TxFifoEmptyCallback(FDCAN_HandleTypeDef* hfdcan);
+void HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t BufferIndexes);
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs);
+#endif /* !CO_SIM_FDCAN */
+
+/*******************************************************************************
+ * General purpose timers
+ ******************************************************************************/
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CCMR1;
+    __IO uint32_t CCMR2;
+    __IO uint32_t CCER;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+    __IO uint32_t RCR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+    __IO uint32_t BDTR;
+    __IO uint32_t DCR;
+    __IO uint32_t DMAR;
+    __IO uint32_t OR;
+} TIM_TypeDef;
+
+extern TIM_TypeDef co_sim_tim[4];
+#define TIM2 (&co_sim_tim[0])
+#define TIM3 (&co_sim_tim[1])
+#define TIM4 (&co_sim_tim[2])
+#define TIM5 (&co_sim_tim[3])
+
+#define TIM_CR1_CEN   (1UL << 0)
+#define TIM_DIER_UIE  (1UL << 0)
+#define TIM_DIER_CC1IE (1UL << 1)
+#define TIM_SR_UIF    (1UL << 0)
+#define TIM_SR_CC1IF  (1UL << 1)
+#define TIM_EGR_UG    (1UL << 0)
+#define TIM_EGR_CC1G  (1UL << 1)
+#define TIM_EGR_CC2G  (1UL << 2)
+#define TIM_EGR_CC3G  (1UL << 3)
+#define TIM_EGR_CC4G  (1UL << 4)
+#define TIM_CHANNEL_1 0x00000000U
+#define TIM_CHANNEL_2 0x00000004U
+#define TIM_CHANNEL_3 0x00000008U
+#define TIM_CHANNEL_4 0x0000000CU
+#define TIM_COUNTERMODE_UP 0x00000000U
+#define TIM_CLOCKDIVISION_DIV1 0x00000000U
+#define TIM_AUTORELOAD_PRELOAD_DISABLE 0x00000000U
+
+typedef enum {
+    HAL_TIM_ACTIVE_CHANNEL_1 = 0x01U,
+    HAL_TIM_ACTIVE_CHANNEL_2 = 0x02U,
+    HAL_TIM_ACTIVE_CHANNEL_3 = 0x04U,
+    HAL_TIM_ACTIVE_CHANNEL_4 = 0x08U,
+    HAL_TIM_ACTIVE_CHANNEL_CLEARED = 0x00U
+} HAL_TIM_ActiveChannel;
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t CounterMode;
+    uint32_t Period;
+    uint32_t ClockDivision;
+    uint32_t RepetitionCounter;
+    uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+    TIM_TypeDef* Instance;
+    TIM_Base_InitTypeDef Init;
+    HAL_TIM_ActiveChannel Channel;
+} TIM_HandleTypeDef;
+
+#define __HAL_TIM_GET_COUNTER(__HANDLE__)    ((__HANDLE__)->Instance->CNT)
+#define __HAL_TIM_GET_AUTORELOAD(__HANDLE__) ((__HANDLE__)->Instance->ARR)
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__)                                                    \
+    (*(__IO uint32_t*)(&((__HANDLE__)->Instance->CCR1) + ((__CHANNEL__) >> 2U)) = (__COMPARE__))
+#define __HAL_TIM_GET_COMPARE(__HANDLE__, __CHANNEL__)                                                                 \
+    (*(__IO uint32_t*)(&((__HANDLE__)->Instance->CCR1) + ((__CHANNEL__) >> 2U)))
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_OC_Start_IT(TIM_HandleTypeDef* htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_OC_Stop_IT(TIM_HandleTypeDef* htim, uint32_t Channel);
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef* htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim);
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CO_SIM_MAIN_H */
@@ -0,0 +1,72 @@
+/*
+ * Host build stand-in for CANopenNode 301/CO_Emergency.h. Errors are kept
+ * as a bit field and counted, emergency messages are not sent.
+ */
+
+#ifndef CO_EMERGENCY_H
+#define CO_EMERGENCY_H
+
+#include "301/CO_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CO_EM_CAN_BUS_WARNING      0x01U
+#define CO_EM_RXMSG_WRONG_LENGTH   0x02U
+#define CO_EM_RXMSG_OVERFLOW       0x03U
+#define CO_EM_RPDO_WRONG_LENGTH    0x04U
+#define CO_EM_RPDO_OVERFLOW        0x05U
+#define CO_EM_CAN_RX_BUS_PASSIVE   0x06U
+#define CO_EM_CAN_TX_BUS_PASSIVE   0x07U
+#define CO_EM_NMT_WRONG_COMMAND    0x08U
+#define CO_EM_TIME_TIMEOUT         0x09U
+#define CO_EM_CAN_TX_BUS_OFF       0x12U
+#define CO_EM_CAN_RXB_OVERFLOW     0x13U
+#define CO_EM_CAN_TX_OVERFLOW      0x14U
+#define CO_EM_TPDO_OUTSIDE_WINDOW  0x15U
+#define CO_EM_SYNC_TIME_OUT        0x18U
+#define CO_EM_SYNC_LENGTH          0x19U
+#define CO_EM_PDO_WRONG_MAPPING    0x1AU
+#define CO_EM_HEARTBEAT_CONSUMER   0x1BU
+#define CO_EM_HB_CONSUMER_REMOTE_RESET 0x1CU
+#define CO_EM_NON_VOLATILE_MEMORY  0x2FU
+#define CO_EM_MANUFACTURER_START   0x30U
+#define CO_EM_MANUFACTURER_END     0x3FU
+
+#define CO_EMC_NO_ERROR            0x0000U
+#define CO_EMC_HARDWARE            0x5000U
+#define CO_EMC_COMMUNICATION       0x8100U
+#define CO_EMC_CAN_OVERRUN         0x8110U
+#define CO_EMC_HEARTBEAT           0x8130U
+#define CO_EMC_SYNC_DATA_LENGTH    0x8240U
+#define CO_EMC_RPDO_TIMEOUT        0x8250U
+
+/* Entry of emergency FIFO, CO_new() allocates one more than 0x1003 */
+typedef struct {
+    uint32_t msg;
+    uint32_t info;
+} CO_EM_fifo_t;
+
+typedef struct {
+    uint8_t errorStatusBits[8]; /* Bit per errorBit 0..63 */
+    uint32_t reports;           /* Number of reported errors, which were not set */
+    uint32_t lastInfo;          /* infoCode of the last reported error */
+    CO_CANmodule_t* CANdevTx;
+    CO_CANtx_t* CANtxBuff;
+} CO_EM_t;
+
+void CO_error(CO_EM_t* em, bool_t setError, const uint8_t errorBit, uint16_t errorCode, uint32_t infoCode);
+
+#define CO_errorReport(em, errorBit, errorCode, infoCode) CO_error(em, true, errorBit, errorCode, infoCode)
+#define CO_errorReset(em, errorBit, infoCode)             CO_error(em, false, errorBit, CO_EMC_NO_ERROR, infoCode)
+
+static inline bool_t CO_isError(CO_EM_t* em, const uint8_t errorBit) {
+    return em != NULL && (em->errorStatusBits[errorBit >> 3] & (1U << (errorBit & 7U))) != 0U;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CO_EMERGENCY_H */
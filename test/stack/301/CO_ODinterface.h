@@ -0,0 +1,108 @@
+/*
+ * Host build stand-in for CANopenNode 301/CO_ODinterface.h: Object
+ * Dictionary entries are a flat table of variables, enough for OD_find(),
+ * OD extensions and OD_get_xx().
+ */
+
+#ifndef CO_OD_INTERFACE_H
+#define CO_OD_INTERFACE_H
+
+#include "301/CO_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t OD_size_t;
+typedef uint8_t OD_attr_t;
+
+typedef enum {
+    ODR_PARTIAL = -1,
+    ODR_OK = 0,
+    ODR_OUT_OF_MEM = 1,
+    ODR_UNSUPP_ACCESS = 2,
+    ODR_WRITEONLY = 3,
+    ODR_READONLY = 4,
+    ODR_IDX_NOT_EXIST = 5,
+    ODR_NO_MAP = 6,
+    ODR_MAP_LEN = 7,
+    ODR_PAR_INCOMPAT = 8,
+    ODR_DEV_INCOMPAT = 9,
+    ODR_HW = 10,
+    ODR_TYPE_MISMATCH = 11,
+    ODR_DATA_LONG = 12,
+    ODR_DATA_SHORT = 13,
+    ODR_SUB_NOT_EXIST = 14,
+    ODR_INVALID_VALUE = 15,
+    ODR_VALUE_HIGH = 16,
+    ODR_VALUE_LOW = 17,
+    ODR_MAX_LESS_MIN = 18,
+    ODR_NO_RESOURCE = 19,
+    ODR_GENERAL = 20,
+    ODR_DATA_TRANSF = 21,
+    ODR_DATA_LOC_CTRL = 22,
+    ODR_DATA_DEV_STATE = 23,
+    ODR_OD_MISSING = 24,
+    ODR_NO_DATA = 25,
+    ODR_COUNT = 26
+} ODR_t;
+
+typedef struct {
+    void* dataOrig;
+    void* object;
+    OD_size_t dataLength;
+    OD_size_t dataOffset;
+    OD_attr_t attribute;
+    uint8_t subIndex;
+} OD_stream_t;
+
+typedef struct {
+    void* object;
+    ODR_t (*read)(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead);
+    ODR_t (*write)(OD_stream_t* stream, const void* buf, OD_size_t count, OD_size_t* countWritten);
+} OD_extension_t;
+
+/* Entry with sub-indexes 0..subCount-1, each sub-index is a variable */
+typedef struct OD_entry_t {
+    uint16_t index;
+    uint8_t subCount;
+    void* const* data;           /* Variable of each sub-index */
+    const OD_size_t* length;     /* Length of each sub-index */
+    OD_extension_t* extension;
+} OD_entry_t;
+
+typedef struct OD_t {
+    uint16_t size;
+    OD_entry_t* list;
+    void* persistComm; /* OD_PERSIST_COMM_t of OD.h, read by the stack */
+    void* ram;         /* OD_RAM_t of OD.h */
+} OD_t;
+
+OD_entry_t* OD_find(OD_t* od, uint16_t index);
+ODR_t OD_extension_init(OD_entry_t* entry, OD_extension_t* extension);
+ODR_t OD_readOriginal(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead);
+ODR_t OD_writeOriginal(OD_stream_t* stream, const void* buf, OD_size_t count, OD_size_t* countWritten);
+ODR_t OD_get_value(const OD_entry_t* entry, uint8_t subIndex, void* val, OD_size_t len, bool_t odOrig);
+ODR_t OD_set_value(const OD_entry_t* entry, uint8_t subIndex, const void* val, OD_size_t len, bool_t odOrig);
+
+static inline ODR_t OD_get_u8(const OD_entry_t* entry, uint8_t subIndex, uint8_t* val, bool_t odOrig) {
+    return OD_get_value(entry, subIndex, val, sizeof(*val), odOrig);
+}
+static inline ODR_t OD_get_u16(const OD_entry_t* entry, uint8_t subIndex, uint16_t* val, bool_t odOrig) {
+    return OD_get_value(entry, subIndex, val, sizeof(*val), odOrig);
+}
+static inline ODR_t OD_get_u32(const OD_entry_t* entry, uint8_t subIndex, uint32_t* val, bool_t odOrig) {
+    return OD_get_value(entry, subIndex, val, sizeof(*val), odOrig);
+}
+static inline ODR_t OD_set_u8(const OD_entry_t* entry, uint8_t subIndex, uint8_t val, bool_t odOrig) {
+    return OD_set_value(entry, subIndex, &val, sizeof(val), odOrig);
+}
+static inline ODR_t OD_set_u32(const OD_entry_t* entry, uint8_t subIndex, uint32_t val, bool_t odOrig) {
+    return OD_set_value(entry, subIndex, &val, sizeof(val), odOrig);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CO_OD_INTERFACE_H */
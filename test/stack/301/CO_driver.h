@@ -0,0 +1,125 @@
+/*
+ * Host build stand-in for CANopenNode 301/CO_driver.h: the driver interface
+ * of CANopenNode v4, as used by CANopenSTM32. See test/ReadMe.md.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CO_DRIVER_H
+#define CO_DRIVER_H
+
+#include <string.h>
+
+#include "CO_driver_target.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stack configuration, same flags as CANopenNode CO_config.h */
+#define CO_CONFIG_FLAG_CALLBACK_PRE      0x1000
+#define CO_CONFIG_FLAG_TIMERNEXT         0x2000
+#define CO_CONFIG_GLOBAL_FLAG_TIMERNEXT  CO_CONFIG_FLAG_TIMERNEXT
+#define CO_CONFIG_SYNC_ENABLE            0x01
+#define CO_CONFIG_SYNC_PRODUCER          0x02
+#define CO_CONFIG_RPDO_ENABLE            0x01
+#define CO_CONFIG_TPDO_ENABLE            0x02
+#define CO_CONFIG_HB_CONS_ENABLE         0x01
+#define CO_CONFIG_EM_PRODUCER            0x01
+#define CO_CONFIG_EM_HISTORY             0x04
+#define CO_CONFIG_EM_CONSUMER            0x08
+#define CO_CONFIG_STORAGE_ENABLE         0x01
+#define CO_CONFIG_CRC16_ENABLE           0x01
+#ifndef CO_CONFIG_SYNC
+#define CO_CONFIG_SYNC (CO_CONFIG_SYNC_ENABLE | CO_CONFIG_FLAG_TIMERNEXT)
+#endif
+#ifndef CO_CONFIG_PDO
+#define CO_CONFIG_PDO (CO_CONFIG_RPDO_ENABLE | CO_CONFIG_TPDO_ENABLE | CO_CONFIG_FLAG_TIMERNEXT)
+#endif
+#ifndef CO_CONFIG_EM
+#define CO_CONFIG_EM (CO_CONFIG_EM_PRODUCER | CO_CONFIG_EM_HISTORY)
+#endif
+#ifndef CO_CONFIG_HB_CONS
+#define CO_CONFIG_HB_CONS (CO_CONFIG_HB_CONS_ENABLE | CO_CONFIG_FLAG_TIMERNEXT)
+#endif
+#ifndef CO_CONFIG_STORAGE
+#define CO_CONFIG_STORAGE CO_CONFIG_STORAGE_ENABLE
+#endif
+#ifndef CO_CONFIG_CRC16
+#define CO_CONFIG_CRC16 CO_CONFIG_CRC16_ENABLE
+#endif
+
+/* Memory for CO_new(), calloc() unless the target redefines it */
+#ifndef CO_alloc
+#include <stdlib.h>
+#define CO_alloc(num, size) calloc((num), (size))
+#define CO_free(ptr)        free((ptr))
+#endif
+
+typedef enum {
+    CO_ERROR_NO = 0,
+    CO_ERROR_ILLEGAL_ARGUMENT = -1,
+    CO_ERROR_OUT_OF_MEMORY = -2,
+    CO_ERROR_TIMEOUT = -3,
+    CO_ERROR_ILLEGAL_BAUDRATE = -4,
+    CO_ERROR_RX_OVERFLOW = -5,
+    CO_ERROR_RX_PDO_OVERFLOW = -6,
+    CO_ERROR_RX_MSG_LENGTH = -7,
+    CO_ERROR_RX_PDO_LENGTH = -8,
+    CO_ERROR_TX_OVERFLOW = -9,
+    CO_ERROR_TX_PDO_WINDOW = -10,
+    CO_ERROR_TX_UNCONFIGURED = -11,
+    CO_ERROR_OD_PARAMETERS = -12,
+    CO_ERROR_DATA_CORRUPT = -13,
+    CO_ERROR_CRC = -14,
+    CO_ERROR_TX_BUSY = -15,
+    CO_ERROR_WRONG_NMT_STATE = -16,
+    CO_ERROR_SYSCALL = -17,
+    CO_ERROR_INVALID_STATE = -18,
+    CO_ERROR_NODE_ID_UNCONFIGURED_LSS = -19
+} CO_ReturnError_t;
+
+typedef enum {
+    CO_CAN_ERRTX_WARNING = 0x0001,
+    CO_CAN_ERRTX_PASSIVE = 0x0002,
+    CO_CAN_ERRTX_BUS_OFF = 0x0004,
+    CO_CAN_ERRTX_OVERFLOW = 0x0008,
+    CO_CAN_ERRTX_PDO_LATE = 0x0080,
+    CO_CAN_ERRRX_WARNING = 0x0100,
+    CO_CAN_ERRRX_PASSIVE = 0x0200,
+    CO_CAN_ERRRX_OVERFLOW = 0x0800,
+    CO_CAN_ERR_WARN_PASSIVE = 0x0303
+} CO_CAN_ERR_status_t;
+
+void CO_CANsetConfigurationMode(void* CANptr);
+void CO_CANsetNormalMode(CO_CANmodule_t* CANmodule);
+CO_ReturnError_t CO_CANmodule_init(CO_CANmodule_t* CANmodule, void* CANptr, CO_CANrx_t rxArray[], uint16_t rxSize,
+                                   CO_CANtx_t txArray[], uint16_t txSize, uint16_t CANbitRate);
+void CO_CANmodule_disable(CO_CANmodule_t* CANmodule);
+CO_ReturnError_t CO_CANrxBufferInit(CO_CANmodule_t* CANmodule, uint16_t index, uint16_t ident, uint16_t mask,
+                                    bool_t rtr, void* object, void (*CANrx_callback)(void* object, void* message));
+CO_CANtx_t* CO_CANtxBufferInit(CO_CANmodule_t* CANmodule, uint16_t index, uint16_t ident, bool_t rtr,
+                               uint8_t noOfBytes, bool_t syncFlag);
+CO_ReturnError_t CO_CANsend(CO_CANmodule_t* CANmodule, CO_CANtx_t* buffer);
+void CO_CANclearPendingSyncPDOs(CO_CANmodule_t* CANmodule);
+void CO_CANmodule_process(CO_CANmodule_t* CANmodule);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CO_DRIVER_H */
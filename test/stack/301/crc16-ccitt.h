@@ -0,0 +1,13 @@
+/*
+ * Host build stand-in for CANopenNode 301/crc16-ccitt.h.
+ */
+
+#ifndef CRC16_CCITT_H
+#define CRC16_CCITT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint16_t crc16_ccitt(const uint8_t block[], size_t blockLength, uint16_t crc);
+
+#endif /* CRC16_CCITT_H */
@@ -0,0 +1,756 @@
+/*
+ * Host build stand-in for CANopenNode, see CANopen.h.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "CANopen.h"
+#include "OD.h"
+#include "301/crc16-ccitt.h"
+#include "storage/CO_storage.h"
+
+#define CO_SDO_ABORT_NOT_EXIST 0x06020000UL
+#define CO_SDO_ABORT_SUB       0x06090011UL
+#define CO_SDO_ABORT_CMD       0x05040001UL
+#define CO_SDO_ABORT_HW        0x06060000UL
+#define CO_SDO_ABORT_GENERAL   0x08000000UL
+#define CO_SDO_ABORT_STORE     0x08000020UL
+
+static void*
+prv_alloc(size_t num, size_t size, uint32_t* used) {
+    void* ptr = CO_alloc(num, size);
+
+    if (ptr != NULL) {
+        *used += (uint32_t)(num * size);
+    }
+    return ptr;
+}
+
+CO_t*
+CO_new(CO_config_t* config, uint32_t* heapMemoryUsed) {
+    uint32_t used = 0;
+    CO_t* co;
+
+    (void)config;
+    co = prv_alloc(1, sizeof(CO_t), &used);
+    if (co == NULL) {
+        return NULL;
+    }
+    co->CANmodule = prv_alloc(1, sizeof(CO_CANmodule_t), &used);
+    co->CANrx = prv_alloc(CO_RX_CNT_ALL, sizeof(CO_CANrx_t), &used);
+    co->CANtx = prv_alloc(CO_TX_CNT_ALL, sizeof(CO_CANtx_t), &used);
+    co->NMT = prv_alloc(1, sizeof(CO_NMT_t), &used);
+    co->em = prv_alloc(1, sizeof(CO_EM_t), &used);
+    co->em_fifo = prv_alloc(OD_CNT_ARR_1003 + 1, sizeof(CO_EM_fifo_t), &used);
+    co->SDOserver = prv_alloc(1, sizeof(CO_SDOserver_t), &used);
+    co->SYNC = prv_alloc(1, sizeof(CO_SYNC_t), &used);
+    co->HBcons = prv_alloc(1, sizeof(CO_HBconsumer_t), &used);
+    co->RPDO = prv_alloc(CO_RPDO_COUNT, sizeof(CO_RPDO_t), &used);
+    co->TPDO = prv_alloc(CO_TPDO_COUNT, sizeof(CO_TPDO_t), &used);
+    if (co->HBcons != NULL) {
+        co->HBcons->monitoredNodes = prv_alloc(CO_HB_CONS_MAX, sizeof(CO_HBconsNode_t), &used);
+    }
+    if (co->CANmodule == NULL || co->CANrx == NULL || co->CANtx == NULL || co->NMT == NULL || co->em == NULL
+        || co->em_fifo == NULL || co->SDOserver == NULL || co->SYNC == NULL || co->HBcons == NULL
+        || co->HBcons->monitoredNodes == NULL || co->RPDO == NULL || co->TPDO == NULL) {
+        CO_delete(co);
+        return NULL;
+    }
+    if (heapMemoryUsed != NULL) {
+        *heapMemoryUsed = used;
+    }
+    return co;
+}
+
+void
+CO_delete(CO_t* co) {
+    if (co == NULL) {
+        return;
+    }
+    if (co->HBcons != NULL) {
+        CO_free(co->HBcons->monitoredNodes);
+    }
+    CO_free(co->TPDO);
+    CO_free(co->RPDO);
+    CO_free(co->HBcons);
+    CO_free(co->SYNC);
+    CO_free(co->SDOserver);
+    CO_free(co->em_fifo);
+    CO_free(co->em);
+    CO_free(co->NMT);
+    CO_free(co->CANtx);
+    CO_free(co->CANrx);
+    CO_free(co->CANmodule);
+    CO_free(co);
+}
+
+CO_ReturnError_t
+CO_CANinit(CO_t* co, void* CANptr, uint16_t bitRate) {
+    co->CANmodule->CANnormal = false;
+    CO_CANsetConfigurationMode(CANptr);
+    return CO_CANmodule_init(co->CANmodule, CANptr, co->CANrx, CO_RX_CNT_ALL, co->CANtx, CO_TX_CNT_ALL, bitRate);
+}
+
+CO_ReturnError_t
+CO_LSSinit(CO_t* co, CO_LSS_address_t* lssAddress, uint8_t* pendingNodeID, uint16_t* pendingBitRate) {
+    (void)co;
+    (void)lssAddress;
+    (void)pendingNodeID;
+    (void)pendingBitRate;
+    return CO_ERROR_NO;
+}
+
+/******************************************************************************/
+/* Emergency */
+void
+CO_error(CO_EM_t* em, bool_t setError, const uint8_t errorBit, uint16_t errorCode, uint32_t infoCode) {
+    uint8_t mask = (uint8_t)(1U << (errorBit & 7U));
+    uint8_t* bits;
+
+    if (em == NULL || errorBit >= 64U) {
+        return;
+    }
+    bits = &em->errorStatusBits[errorBit >> 3];
+    if (setError == ((*bits & mask) != 0U)) {
+        return;
+    }
+    if (setError) {
+        *bits |= mask;
+        em->reports++;
+        em->lastInfo = infoCode;
+    } else {
+        *bits &= (uint8_t)~mask;
+    }
+    /* Emergency message, CANopenNode sends it from CO_EM_process() */
+    if (em->CANtxBuff != NULL && em->CANdevTx != NULL && em->CANdevTx->CANnormal) {
+        uint16_t code = setError ? errorCode : CO_EMC_NO_ERROR;
+
+        em->CANtxBuff->data[0] = (uint8_t)code;
+        em->CANtxBuff->data[1] = (uint8_t)(code >> 8);
+        em->CANtxBuff->data[2] = 0;
+        em->CANtxBuff->data[3] = errorBit;
+        memcpy(&em->CANtxBuff->data[4], &infoCode, 4);
+        (void)CO_CANsend(em->CANdevTx, em->CANtxBuff);
+    }
+}
+
+/******************************************************************************/
+/* Receive callbacks, called from CAN receive interrupt or CO_CANrxProcess() */
+static void
+prv_nmt_receive(void* object, void* msg) {
+    CO_NMT_t* NMT = object;
+    const uint8_t* data = CO_CANrxMsg_readData(msg);
+
+    if (CO_CANrxMsg_readDLC(msg) == 2U && (data[1] == 0U || data[1] == NMT->nodeId)) {
+        NMT->internalCommand = data[0];
+    }
+}
+
+static void
+prv_sdo_receive(void* object, void* msg) {
+    CO_SDOserver_t* SDO = object;
+
+    /* New request while previous is processed is ignored */
+    if (CO_CANrxMsg_readDLC(msg) == 8U && !CO_FLAG_READ(SDO->CANrxNew)) {
+        memcpy(SDO->CANrxData, CO_CANrxMsg_readData(msg), 8);
+        CO_FLAG_SET(SDO->CANrxNew);
+    }
+}
+
+static void
+prv_sync_receive(void* object, void* msg) {
+    CO_SYNC_t* SYNC = object;
+
+    if (CO_CANrxMsg_readDLC(msg) == 0U) {
+        SYNC->received++;
+        CO_FLAG_SET(SYNC->CANrxNew);
+    } else {
+        SYNC->receiveError = true;
+    }
+}
+
+static void
+prv_hb_receive(void* object, void* msg) {
+    CO_HBconsNode_t* node = object;
+
+    if (CO_CANrxMsg_readDLC(msg) == 1U) {
+        node->NMTstate = (int8_t)CO_CANrxMsg_readData(msg)[0];
+        CO_FLAG_SET(node->CANrxNew);
+    }
+}
+
+static void
+prv_rpdo_receive(void* object, void* msg) {
+    CO_RPDO_t* RPDO = object;
+    uint8_t dlc = CO_CANrxMsg_readDLC(msg);
+
+    RPDO->dataLength = dlc < 8U ? dlc : 8U;
+    memcpy(RPDO->CANrxData, CO_CANrxMsg_readData(msg), RPDO->dataLength);
+    RPDO->received++;
+    CO_FLAG_SET(RPDO->CANrxNew);
+}
+
+/******************************************************************************/
+CO_ReturnError_t
+CO_CANopenInit(CO_t* co, CO_NMT_t* NMT, CO_EM_t* em, OD_t* od, OD_entry_t* OD_statusBits, uint16_t NMTcontrol,
+               uint16_t firstHBTime_ms, uint16_t SDOserverTimeoutTime_ms, uint16_t SDOclientTimeoutTime_ms,
+               bool_t SDOclientBlockTransfer, uint8_t nodeId, uint32_t* errInfo) {
+    const OD_PERSIST_COMM_t* comm = od->persistComm;
+    CO_CANmodule_t* CANmodule = co->CANmodule;
+
+    (void)NMT;
+    (void)em;
+    (void)OD_statusBits;
+    (void)SDOserverTimeoutTime_ms;
+    (void)SDOclientTimeoutTime_ms;
+    (void)SDOclientBlockTransfer;
+    (void)errInfo;
+
+    co->nodeIdUnconfigured = false;
+    if (nodeId == 0xFFU) {
+        co->nodeIdUnconfigured = true;
+        return CO_ERROR_NODE_ID_UNCONFIGURED_LSS;
+    }
+    if (nodeId < 1U || nodeId > 127U) {
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+
+    /* Emergency */
+    memset(co->em, 0, sizeof(*co->em));
+    co->em->CANdevTx = CANmodule;
+    co->em->CANtxBuff = CO_CANtxBufferInit(CANmodule, CO_TX_IDX_EM_PROD, 0x080U + nodeId, false, 8, false);
+
+    /* NMT and heartbeat producer, first heartbeat after firstHBTime_ms */
+    memset(co->NMT, 0, sizeof(*co->NMT));
+    co->NMT->operatingState = CO_NMT_INITIALIZING;
+    co->NMT->operatingStatePrev = CO_NMT_INITIALIZING;
+    co->NMT->nodeId = nodeId;
+    co->NMT->NMTcontrol = NMTcontrol;
+    co->NMT->HBproducerTime_us = (uint32_t)comm->x1017_producerHeartbeatTime * 1000U;
+    co->NMT->HBproducerTimer = (uint32_t)firstHBTime_ms * 1000U;
+    CO_CANrxBufferInit(CANmodule, CO_RX_IDX_NMT_SLV, 0x000U, 0x7FFU, false, co->NMT, prv_nmt_receive);
+    co->NMT->HB_TXbuff = CO_CANtxBufferInit(CANmodule, CO_TX_IDX_HB_PROD, 0x700U + nodeId, false, 1, false);
+
+    /* SDO server */
+    memset(co->SDOserver, 0, sizeof(*co->SDOserver));
+    co->SDOserver->OD = od;
+    co->SDOserver->nodeId = nodeId;
+    CO_CANrxBufferInit(CANmodule, CO_RX_IDX_SDO_SRV, 0x600U + nodeId, 0x7FFU, false, co->SDOserver, prv_sdo_receive);
+    co->SDOserver->CANtxBuff = CO_CANtxBufferInit(CANmodule, CO_TX_IDX_SDO_SRV, 0x580U + nodeId, false, 8, false);
+
+    /* SYNC consumer */
+    memset(co->SYNC, 0, sizeof(*co->SYNC));
+    co->SYNC->em = co->em;
+    co->SYNC->communicationCyclePeriod = comm->x1006_communicationCyclePeriod;
+    co->SYNC->synchronousWindowLength = comm->x1007_synchronousWindowLength;
+    CO_CANrxBufferInit(CANmodule, CO_RX_IDX_SYNC, 0x080U, 0x7FFU, false, co->SYNC, prv_sync_receive);
+
+    /* Heartbeat consumer, nodes with configured time get consecutive buffers */
+    CO_HBconsNode_t* nodes = co->HBcons->monitoredNodes;
+    memset(nodes, 0, CO_HB_CONS_MAX * sizeof(*nodes));
+    co->HBcons->em = co->em;
+    co->HBcons->numberOfMonitoredNodes = 0;
+    co->HBcons->timeouts = 0;
+    for (uint8_t i = 0; i < OD_CNT_ARR_1016 && i < CO_HB_CONS_MAX; i++) {
+        uint32_t value = comm->x1016_consumerHeartbeatTime[i];
+        uint8_t node = (uint8_t)(value >> 16);
+        uint16_t time_ms = (uint16_t)value;
+
+        if (node == 0U || node > 127U || time_ms == 0U) {
+            continue;
+        }
+        CO_HBconsNode_t* monitored = &nodes[co->HBcons->numberOfMonitoredNodes];
+        monitored->nodeId = node;
+        monitored->NMTstate = CO_NMT_UNKNOWN;
+        monitored->HBstate = CO_HBconsumer_UNKNOWN;
+        monitored->time_us = (uint32_t)time_ms * 1000U;
+        CO_CANrxBufferInit(CANmodule, CO_RX_IDX_HB_CONS + co->HBcons->numberOfMonitoredNodes, 0x700U + node, 0x7FFU,
+                           false, monitored, prv_hb_receive);
+        co->HBcons->numberOfMonitoredNodes++;
+    }
+    return CO_ERROR_NO;
+}
+
+/* COB-ID of PDO, default one includes node-ID */
+static bool_t
+prv_pdo_cob(const OD_PDOcommunicationParameter_t* param, uint16_t base, uint8_t nodeId, uint16_t* cob) {
+    if ((param->COB_ID & 0x80000000UL) != 0U) {
+        return false;
+    }
+    *cob = (param->COB_ID & 0x7FFU) != 0U ? (uint16_t)(param->COB_ID & 0x7FFU) : (uint16_t)(base + nodeId);
+    return true;
+}
+
+CO_ReturnError_t
+CO_CANopenInitPDO(CO_t* co, CO_EM_t* em, OD_t* od, uint8_t nodeId, uint32_t* errInfo) {
+    const OD_PERSIST_COMM_t* comm = od->persistComm;
+    OD_RAM_t* ram = od->ram;
+
+    (void)em;
+    (void)errInfo;
+    if (co->nodeIdUnconfigured) {
+        return CO_ERROR_NODE_ID_UNCONFIGURED_LSS;
+    }
+    for (uint8_t i = 0; i < CO_RPDO_COUNT; i++) {
+        const OD_PDOcommunicationParameter_t* param = &comm->x1400_RPDOCommunicationParameter[i];
+        CO_RPDO_t* RPDO = &co->RPDO[i];
+        uint16_t cob;
+
+        memset(RPDO, 0, sizeof(*RPDO));
+        RPDO->mapped = &ram->x6200_writeOutput8Bit[i * 8U];
+        RPDO->synchronous = param->transmissionType <= 240U;
+        RPDO->valid = prv_pdo_cob(param, 0x200U + 0x100U * i, nodeId, &cob);
+        if (RPDO->valid) {
+            CO_CANrxBufferInit(co->CANmodule, CO_RX_IDX_RPDO + i, cob, 0x7FFU, false, RPDO, prv_rpdo_receive);
+        }
+    }
+    for (uint8_t i = 0; i < CO_TPDO_COUNT; i++) {
+        const OD_PDOcommunicationParameter_t* param = &comm->x1800_TPDOCommunicationParameter[i];
+        CO_TPDO_t* TPDO = &co->TPDO[i];
+        uint16_t cob;
+
+        memset(TPDO, 0, sizeof(*TPDO));
+        TPDO->mapped = &ram->x6000_readInput8Bit[i * 8U];
+        TPDO->transmissionType = param->transmissionType;
+        TPDO->eventTime_us = (uint32_t)param->eventTimer * 1000U;
+        TPDO->eventTimer = TPDO->eventTime_us;
+        TPDO->valid = prv_pdo_cob(param, 0x180U + 0x100U * i, nodeId, &cob);
+        if (TPDO->valid) {
+            TPDO->CANtxBuff = CO_CANtxBufferInit(co->CANmodule, CO_TX_IDX_TPDO + i, cob, false, 8,
+                                                 TPDO->transmissionType <= 240U);
+        }
+    }
+    return CO_ERROR_NO;
+}
+
+/******************************************************************************/
+static inline void
+prv_timer_next(uint32_t* timerNext_us, uint32_t time_us) {
+    if (timerNext_us != NULL && *timerNext_us > time_us) {
+        *timerNext_us = time_us;
+    }
+}
+
+static uint32_t
+prv_sdo_abort_code(ODR_t odr) {
+    switch (odr) {
+        case ODR_IDX_NOT_EXIST: return CO_SDO_ABORT_NOT_EXIST;
+        case ODR_SUB_NOT_EXIST: return CO_SDO_ABORT_SUB;
+        case ODR_HW: return CO_SDO_ABORT_HW;
+        case ODR_DATA_TRANSF: return CO_SDO_ABORT_STORE;
+        default: return CO_SDO_ABORT_GENERAL;
+    }
+}
+
+/* Expedited transfers only, response is sent before the function returns */
+static void
+prv_sdo_process(CO_CANmodule_t* CANmodule, CO_SDOserver_t* SDO) {
+    const uint8_t* req = SDO->CANrxData;
+    uint8_t* resp = SDO->CANtxBuff->data;
+    uint16_t index = (uint16_t)(req[1] | (req[2] << 8));
+    uint8_t subIndex = req[3];
+    OD_entry_t* entry = OD_find(SDO->OD, index);
+    uint32_t abortCode = 0;
+
+    SDO->requests++;
+    memset(resp, 0, 8);
+    resp[1] = req[1];
+    resp[2] = req[2];
+    resp[3] = subIndex;
+    if (entry == NULL) {
+        abortCode = CO_SDO_ABORT_NOT_EXIST;
+    } else if (subIndex >= entry->subCount) {
+        abortCode = CO_SDO_ABORT_SUB;
+    } else {
+        OD_stream_t stream = {entry->data[subIndex], NULL, entry->length[subIndex], 0, 0, subIndex};
+        OD_extension_t* ext = entry->extension;
+        OD_size_t n = 0;
+        ODR_t odr;
+
+        if (ext != NULL) {
+            stream.object = ext->object;
+        }
+        if ((req[0] & 0xE3U) == 0x23U) {
+            /* Expedited download with size */
+            OD_size_t size = 4U - ((req[0] >> 2) & 3U);
+
+            odr = (ext != NULL && ext->write != NULL) ? ext->write(&stream, &req[4], size, &n)
+                                                      : OD_writeOriginal(&stream, &req[4], size, &n);
+            if (odr == ODR_OK) {
+                resp[0] = 0x60;
+            } else {
+                abortCode = prv_sdo_abort_code(odr);
+            }
+        } else if ((req[0] & 0xE0U) == 0x40U && stream.dataLength <= 4U) {
+            /* Upload, expedited response */
+            odr = (ext != NULL && ext->read != NULL) ? ext->read(&stream, &resp[4], 4, &n)
+                                                     : OD_readOriginal(&stream, &resp[4], 4, &n);
+            if (odr == ODR_OK) {
+                resp[0] = (uint8_t)(0x43U | ((4U - n) << 2));
+            } else {
+                abortCode = prv_sdo_abort_code(odr);
+            }
+        } else {
+            abortCode = CO_SDO_ABORT_CMD;
+        }
+    }
+    if (abortCode != 0U) {
+        resp[0] = 0x80;
+        memcpy(&resp[4], &abortCode, 4);
+    }
+    (void)CO_CANsend(CANmodule, SDO->CANtxBuff);
+}
+
+CO_NMT_reset_cmd_t
+CO_process(CO_t* co, bool_t enableGateway, uint32_t timeDifference_us, uint32_t* timerNext_us) {
+    CO_NMT_t* NMT = co->NMT;
+    CO_NMT_reset_cmd_t reset = CO_RESET_NOT;
+
+    (void)enableGateway;
+    CO_CANmodule_process(co->CANmodule);
+    if (co->nodeIdUnconfigured) {
+        return CO_RESET_NOT;
+    }
+
+    /* NMT slave */
+    switch (NMT->internalCommand) {
+        case CO_NMT_ENTER_OPERATIONAL: NMT->operatingState = CO_NMT_OPERATIONAL; break;
+        case CO_NMT_ENTER_STOPPED: NMT->operatingState = CO_NMT_STOPPED; break;
+        case CO_NMT_ENTER_PRE_OPERATIONAL: NMT->operatingState = CO_NMT_PRE_OPERATIONAL; break;
+        case CO_NMT_RESET_NODE: reset = CO_RESET_APP; break;
+        case CO_NMT_RESET_COMMUNICATION: reset = CO_RESET_COMM; break;
+        default: break;
+    }
+    NMT->internalCommand = CO_NMT_NO_COMMAND;
+    if (reset != CO_RESET_NOT) {
+        return reset;
+    }
+
+    /* Boot-up message, then heartbeat producer */
+    if (NMT->operatingState == CO_NMT_INITIALIZING) {
+        NMT->HB_TXbuff->data[0] = 0;
+        (void)CO_CANsend(co->CANmodule, NMT->HB_TXbuff);
+        NMT->operatingState = (NMT->NMTcontrol & CO_NMT_STARTUP_TO_OPERATIONAL) != 0U ? CO_NMT_OPERATIONAL
+                                                                                       : CO_NMT_PRE_OPERATIONAL;
+        NMT->operatingStatePrev = NMT->operatingState;
+        if (NMT->HBproducerTime_us > 0U) {
+            NMT->HBproducerTimer = NMT->HBproducerTime_us;
+        }
+    } else {
+        NMT->HBproducerTimer = NMT->HBproducerTimer > timeDifference_us ? NMT->HBproducerTimer - timeDifference_us
+                                                                        : 0U;
+        if (NMT->HBproducerTime_us > 0U
+            && (NMT->HBproducerTimer == 0U || NMT->operatingState != NMT->operatingStatePrev)) {
+            NMT->HB_TXbuff->data[0] = (uint8_t)NMT->operatingState;
+            (void)CO_CANsend(co->CANmodule, NMT->HB_TXbuff);
+            NMT->HBproducerTimer = NMT->HBproducerTime_us;
+        }
+        NMT->operatingStatePrev = NMT->operatingState;
+    }
+    if (NMT->HBproducerTime_us > 0U) {
+        prv_timer_next(timerNext_us, NMT->HBproducerTimer);
+    }
+
+    /* SDO server */
+    if (CO_FLAG_READ(co->SDOserver->CANrxNew)) {
+        prv_sdo_process(co->CANmodule, co->SDOserver);
+        CO_FLAG_CLEAR(co->SDOserver->CANrxNew);
+    }
+
+    /* Heartbeat consumer, timeout counts from processing of the heartbeat */
+    for (uint8_t i = 0; i < co->HBcons->numberOfMonitoredNodes; i++) {
+        CO_HBconsNode_t* node = &co->HBcons->monitoredNodes[i];
+
+        if (CO_FLAG_READ(node->CANrxNew)) {
+            node->HBstate = CO_HBconsumer_ACTIVE;
+            node->timeoutTimer = 0;
+            CO_FLAG_CLEAR(node->CANrxNew);
+        } else if (node->HBstate == CO_HBconsumer_ACTIVE) {
+            node->timeoutTimer += timeDifference_us;
+            if (node->timeoutTimer >= node->time_us) {
+                node->HBstate = CO_HBconsumer_TIMEOUT;
+                co->HBcons->timeouts++;
+                CO_errorReport(co->em, CO_EM_HEARTBEAT_CONSUMER, CO_EMC_HEARTBEAT, i);
+            }
+        }
+        if (node->HBstate == CO_HBconsumer_ACTIVE) {
+            prv_timer_next(timerNext_us, node->time_us - node->timeoutTimer);
+        }
+    }
+    return CO_RESET_NOT;
+}
+
+bool_t
+CO_process_SYNC(CO_t* co, uint32_t timeDifference_us, uint32_t* timerNext_us) {
+    CO_SYNC_t* SYNC = co->SYNC;
+    bool_t syncWas = false;
+
+    if (co->NMT->operatingState != CO_NMT_OPERATIONAL && co->NMT->operatingState != CO_NMT_PRE_OPERATIONAL) {
+        CO_FLAG_CLEAR(SYNC->CANrxNew);
+        SYNC->timer = 0;
+        return false;
+    }
+    if (SYNC->timer < UINT32_MAX - timeDifference_us) {
+        SYNC->timer += timeDifference_us;
+    }
+    if (CO_FLAG_READ(SYNC->CANrxNew)) {
+        SYNC->timer = 0;
+        SYNC->syncIsOutsideWindow = false;
+        syncWas = true;
+        CO_FLAG_CLEAR(SYNC->CANrxNew);
+    }
+
+    /* Synchronous PDOs are not sent outside the window */
+    if (SYNC->synchronousWindowLength > 0U && !SYNC->syncIsOutsideWindow) {
+        if (SYNC->timer > SYNC->synchronousWindowLength) {
+            SYNC->syncIsOutsideWindow = true;
+            CO_CANclearPendingSyncPDOs(co->CANmodule);
+        } else {
+            prv_timer_next(timerNext_us, SYNC->synchronousWindowLength - SYNC->timer + 1U);
+        }
+    }
+    if (SYNC->communicationCyclePeriod > 0U) {
+        uint32_t timeout = SYNC->communicationCyclePeriod + SYNC->communicationCyclePeriod / 2U;
+
+        if (SYNC->timer > timeout) {
+            if (!SYNC->timeoutError) {
+                SYNC->timeoutError = true;
+                CO_errorReport(SYNC->em, CO_EM_SYNC_TIME_OUT, CO_EMC_COMMUNICATION, SYNC->timer);
+            }
+        } else {
+            if (SYNC->timeoutError && syncWas) {
+                SYNC->timeoutError = false;
+                CO_errorReset(SYNC->em, CO_EM_SYNC_TIME_OUT, 0);
+            }
+            prv_timer_next(timerNext_us, timeout - SYNC->timer + 1U);
+        }
+    }
+    return syncWas;
+}
+
+void
+CO_process_RPDO(CO_t* co, bool_t syncWas, uint32_t timeDifference_us, uint32_t* timerNext_us) {
+    (void)timeDifference_us;
+    (void)timerNext_us;
+    if (co->NMT->operatingState != CO_NMT_OPERATIONAL) {
+        return;
+    }
+    for (uint8_t i = 0; i < CO_RPDO_COUNT; i++) {
+        CO_RPDO_t* RPDO = &co->RPDO[i];
+
+        /* Synchronous RPDO takes effect with the next SYNC */
+        if (RPDO->valid && CO_FLAG_READ(RPDO->CANrxNew) && (!RPDO->synchronous || syncWas)) {
+            memcpy(RPDO->mapped, RPDO->CANrxData, RPDO->dataLength);
+            CO_FLAG_CLEAR(RPDO->CANrxNew);
+        }
+    }
+}
+
+static void
+prv_tpdo_send(CO_CANmodule_t* CANmodule, CO_TPDO_t* TPDO) {
+    memcpy(TPDO->CANtxBuff->data, TPDO->mapped, 8);
+    TPDO->sent++;
+    (void)CO_CANsend(CANmodule, TPDO->CANtxBuff);
+}
+
+void
+CO_process_TPDO(CO_t* co, bool_t syncWas, uint32_t timeDifference_us, uint32_t* timerNext_us) {
+    if (co->NMT->operatingState != CO_NMT_OPERATIONAL) {
+        return;
+    }
+    for (uint8_t i = 0; i < CO_TPDO_COUNT; i++) {
+        CO_TPDO_t* TPDO = &co->TPDO[i];
+
+        if (!TPDO->valid) {
+            continue;
+        }
+        if (TPDO->transmissionType <= 240U) {
+            /* Every transmissionType-th SYNC, 0 is acyclic: every SYNC here */
+            if (syncWas && ++TPDO->syncCounter >= (TPDO->transmissionType > 0U ? TPDO->transmissionType : 1U)) {
+                TPDO->syncCounter = 0;
+                prv_tpdo_send(co->CANmodule, TPDO);
+            }
+        } else if (TPDO->eventTime_us > 0U) {
+            TPDO->eventTimer = TPDO->eventTimer > timeDifference_us ? TPDO->eventTimer - timeDifference_us : 0U;
+            if (TPDO->eventTimer == 0U) {
+                prv_tpdo_send(co->CANmodule, TPDO);
+                TPDO->eventTimer = TPDO->eventTime_us;
+            }
+            prv_timer_next(timerNext_us, TPDO->eventTimer);
+        }
+    }
+}
+
+/******************************************************************************/
+/* Object Dictionary interface */
+OD_entry_t*
+OD_find(OD_t* od, uint16_t index) {
+    for (uint16_t i = 0; od != NULL && i < od->size; i++) {
+        if (od->list[i].index == index) {
+            return &od->list[i];
+        }
+    }
+    return NULL;
+}
+
+ODR_t
+OD_extension_init(OD_entry_t* entry, OD_extension_t* extension) {
+    if (entry == NULL) {
+        return ODR_IDX_NOT_EXIST;
+    }
+    entry->extension = extension;
+    return ODR_OK;
+}
+
+ODR_t
+OD_readOriginal(OD_stream_t* stream, void* buf, OD_size_t count, OD_size_t* countRead) {
+    OD_size_t n = stream->dataLength - stream->dataOffset;
+
+    if (n > count) {
+        n = count;
+    }
+    memcpy(buf, (const uint8_t*)stream->dataOrig + stream->dataOffset, n);
+    stream->dataOffset += n;
+    *countRead = n;
+    return ODR_OK;
+}
+
+ODR_t
+OD_writeOriginal(OD_stream_t* stream, const void* buf, OD_size_t count, OD_size_t* countWritten) {
+    if (count > stream->dataLength - stream->dataOffset) {
+        return ODR_DATA_LONG;
+    }
+    memcpy((uint8_t*)stream->dataOrig + stream->dataOffset, buf, count);
+    stream->dataOffset += count;
+    *countWritten = count;
+    return ODR_OK;
+}
+
+ODR_t
+OD_get_value(const OD_entry_t* entry, uint8_t subIndex, void* val, OD_size_t len, bool_t odOrig) {
+    (void)odOrig;
+    if (entry == NULL) {
+        return ODR_IDX_NOT_EXIST;
+    }
+    if (subIndex >= entry->subCount) {
+        return ODR_SUB_NOT_EXIST;
+    }
+    if (entry->length[subIndex] != len) {
+        return ODR_TYPE_MISMATCH;
+    }
+    memcpy(val, entry->data[subIndex], len);
+    return ODR_OK;
+}
+
+ODR_t
+OD_set_value(const OD_entry_t* entry, uint8_t subIndex, const void* val, OD_size_t len, bool_t odOrig) {
+    (void)odOrig;
+    if (entry == NULL) {
+        return ODR_IDX_NOT_EXIST;
+    }
+    if (subIndex >= entry->subCount) {
+        return ODR_SUB_NOT_EXIST;
+    }
+    if (entry->length[subIndex] != len) {
+        return ODR_TYPE_MISMATCH;
+    }
+    memcpy(entry->data[subIndex], val, len);
+    return ODR_OK;
+}
+
+/******************************************************************************/
+/* Storage, 0x1010 "save" and 0x1011 "load" call functions of the target */
+#define CO_STORAGE_SAVE 0x65766173UL
+#define CO_STORAGE_LOAD 0x64616F6CUL
+
+static ODR_t
+prv_storage_command(CO_storage_t* storage, uint8_t subIndex, bool_t store) {
+    ODR_t ret = ODR_OK;
+
+    for (uint8_t i = 0; i < storage->entriesCount; i++) {
+        CO_storage_entry_t* entry = &storage->entries[i];
+        bool_t match = subIndex == 1U ? (entry->attr & CO_storage_cmd) != 0U : entry->subIndexOD == subIndex;
+
+        if (match) {
+            ODR_t odr = store ? storage->store(entry, storage->CANmodule) : storage->restore(entry, storage->CANmodule);
+            if (odr != ODR_OK) {
+                ret = odr;
+            }
+        }
+    }
+    return ret;
+}
+
+static ODR_t
+prv_storage_write(OD_stream_t* stream, const void* buf, OD_size_t count, OD_size_t* countWritten, bool_t store) {
+    uint32_t value;
+
+    if (stream->subIndex == 0U || count != 4U) {
+        return ODR_READONLY;
+    }
+    memcpy(&value, buf, 4);
+    if (value != (store ? CO_STORAGE_SAVE : CO_STORAGE_LOAD)) {
+        return ODR_DATA_TRANSF;
+    }
+    *countWritten = 4;
+    return prv_storage_command(stream->object, stream->subIndex, store);
+}
+
+static ODR_t
+prv_storage_write_1010(OD_stream_t* stream, const void* buf, OD_size_t count, OD_size_t* countWritten) {
+    return prv_storage_write(stream, buf, count, countWritten, true);
+}
+
+static ODR_t
+prv_storage_write_1011(OD_stream_t* stream, const void* buf, OD_size_t count, OD_size_t* countWritten) {
+    return prv_storage_write(stream, buf, count, countWritten, false);
+}
+
+CO_ReturnError_t
+CO_storage_init(CO_storage_t* storage, CO_CANmodule_t* CANmodule, OD_entry_t* OD_1010_StoreParameters,
+                OD_entry_t* OD_1011_RestoreDefaultParameters,
+                ODR_t (*store)(CO_storage_entry_t* entry, CO_CANmodule_t* CANmodule),
+                ODR_t (*restore)(CO_storage_entry_t* entry, CO_CANmodule_t* CANmodule), CO_storage_entry_t* entries,
+                uint8_t entriesCount) {
+    if (storage == NULL || store == NULL || restore == NULL || entries == NULL) {
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+    storage->CANmodule = CANmodule;
+    storage->store = store;
+    storage->restore = restore;
+    storage->entries = entries;
+    storage->entriesCount = entriesCount;
+    storage->OD_1010_extension.object = storage;
+    storage->OD_1010_extension.read = OD_readOriginal;
+    storage->OD_1010_extension.write = prv_storage_write_1010;
+    storage->OD_1011_extension.object = storage;
+    storage->OD_1011_extension.read = OD_readOriginal;
+    storage->OD_1011_extension.write = prv_storage_write_1011;
+    (void)OD_extension_init(OD_1010_StoreParameters, &storage->OD_1010_extension);
+    (void)OD_extension_init(OD_1011_RestoreDefaultParameters, &storage->OD_1011_extension);
+    return CO_ERROR_NO;
+}
+
+/******************************************************************************/
+uint16_t
+crc16_ccitt(const uint8_t block[], size_t blockLength, uint16_t crc) {
+    for (size_t i = 0; i < blockLength; i++) {
+        crc ^= (uint16_t)block[i] << 8;
+        for (uint8_t bit = 0; bit < 8U; bit++) {
+            crc = (crc & 0x8000U) != 0U ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,217 @@
+/*
+ * Host build stand-in for CANopenNode CANopen.h.
+ *
+ * A small CANopen stack with the object names and calls of CANopenNode v4,
+ * which CANopenSTM32 uses: NMT with boot-up and heartbeat producer,
+ * emergency, expedited SDO server, SYNC consumer, heartbeat consumer and
+ * four RPDOs and TPDOs with fixed 8-byte mapping. Communication parameters
+ * are read from OD_PERSIST_COMM of the Object Dictionary (OD.h). It lets
+ * the driver and CO_app_STM32.c run on the host against the simulated
+ * peripherals (test/sim), timing and call pattern follow CANopenNode.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CANopen_H
+#define CANopen_H
+
+#include "301/CO_driver.h"
+#include "301/CO_ODinterface.h"
+#include "301/CO_Emergency.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CO_RPDO_COUNT 4U
+#define CO_TPDO_COUNT 4U
+#define CO_HB_CONS_MAX 8U
+
+/* Receive and transmit buffers of CO_t */
+#define CO_RX_IDX_NMT_SLV 0U
+#define CO_RX_IDX_SYNC    1U
+#define CO_RX_IDX_RPDO    2U
+#define CO_RX_IDX_SDO_SRV (CO_RX_IDX_RPDO + CO_RPDO_COUNT)
+#define CO_RX_IDX_HB_CONS (CO_RX_IDX_SDO_SRV + 1U)
+#define CO_RX_CNT_ALL     (CO_RX_IDX_HB_CONS + CO_HB_CONS_MAX)
+#define CO_TX_IDX_HB_PROD 0U
+#define CO_TX_IDX_SDO_SRV 1U
+#define CO_TX_IDX_TPDO    2U
+#define CO_TX_IDX_EM_PROD (CO_TX_IDX_TPDO + CO_TPDO_COUNT)
+#define CO_TX_CNT_ALL     (CO_TX_IDX_EM_PROD + 1U)
+
+typedef enum {
+    CO_NMT_UNKNOWN = -1,
+    CO_NMT_INITIALIZING = 0,
+    CO_NMT_PRE_OPERATIONAL = 127,
+    CO_NMT_OPERATIONAL = 5,
+    CO_NMT_STOPPED = 4
+} CO_NMT_internalState_t;
+
+typedef enum {
+    CO_NMT_NO_COMMAND = 0,
+    CO_NMT_ENTER_OPERATIONAL = 1,
+    CO_NMT_ENTER_STOPPED = 2,
+    CO_NMT_ENTER_PRE_OPERATIONAL = 128,
+    CO_NMT_RESET_NODE = 129,
+    CO_NMT_RESET_COMMUNICATION = 130
+} CO_NMT_command_t;
+
+typedef enum {
+    CO_RESET_NOT = 0,
+    CO_RESET_COMM = 1,
+    CO_RESET_APP = 2,
+    CO_RESET_QUIT = 3
+} CO_NMT_reset_cmd_t;
+
+typedef enum {
+    CO_NMT_ERR_REG_MASK = 0x00FFU,
+    CO_NMT_STARTUP_TO_OPERATIONAL = 0x0100U,
+    CO_NMT_ERR_ON_BUSOFF_HB = 0x1000U,
+    CO_NMT_ERR_ON_ERR_REG = 0x2000U,
+    CO_NMT_ERR_TO_STOPPED = 0x4000U,
+    CO_NMT_ERR_FREE_TO_OPERATIONAL = 0x8000U
+} CO_NMT_control_t;
+
+typedef struct {
+    int8_t operatingState;
+    int8_t operatingStatePrev;
+    uint8_t nodeId;
+    volatile uint8_t internalCommand; /* CO_NMT_command_t from NMT master */
+    uint16_t NMTcontrol;
+    uint32_t HBproducerTime_us;
+    uint32_t HBproducerTimer;
+    CO_CANtx_t* HB_TXbuff;
+} CO_NMT_t;
+
+typedef struct {
+    OD_t* OD;
+    uint8_t nodeId;
+    volatile void* CANrxNew;
+    uint8_t CANrxData[8];
+    CO_CANtx_t* CANtxBuff;
+    uint32_t requests; /* Number of processed requests */
+} CO_SDOserver_t;
+
+typedef struct {
+    CO_EM_t* em;
+    volatile void* CANrxNew;
+    bool_t receiveError;
+    bool_t timeoutError;
+    bool_t syncIsOutsideWindow;
+    uint32_t timer;
+    uint32_t communicationCyclePeriod; /* 0x1006, microseconds */
+    uint32_t synchronousWindowLength;  /* 0x1007, microseconds */
+    uint32_t received;                 /* Number of received SYNC messages */
+} CO_SYNC_t;
+
+typedef enum {
+    CO_HBconsumer_UNCONFIGURED = 0x00,
+    CO_HBconsumer_UNKNOWN = 0x01,
+    CO_HBconsumer_ACTIVE = 0x02,
+    CO_HBconsumer_TIMEOUT = 0x03
+} CO_HBconsumer_state_t;
+
+typedef struct {
+    uint8_t nodeId;
+    int8_t NMTstate;
+    CO_HBconsumer_state_t HBstate;
+    uint32_t timeoutTimer;
+    uint32_t time_us;
+    volatile void* CANrxNew;
+} CO_HBconsNode_t;
+
+typedef struct {
+    CO_EM_t* em;
+    CO_HBconsNode_t* monitoredNodes;
+    uint8_t numberOfMonitoredNodes;
+    uint32_t timeouts; /* Number of detected timeouts */
+} CO_HBconsumer_t;
+
+typedef struct {
+    bool_t valid;
+    bool_t synchronous;        /* Transmission type 0..240 */
+    volatile void* CANrxNew;
+    uint8_t CANrxData[8];
+    uint8_t dataLength;
+    uint8_t* mapped;           /* OD variable of the 8 mapped bytes */
+    uint32_t received;         /* Number of received frames */
+} CO_RPDO_t;
+
+typedef struct {
+    bool_t valid;
+    uint8_t transmissionType;
+    uint8_t syncCounter;
+    uint32_t eventTime_us;
+    uint32_t eventTimer;
+    const uint8_t* mapped;
+    CO_CANtx_t* CANtxBuff;
+    uint32_t sent; /* Number of frames given to CO_CANsend() */
+} CO_TPDO_t;
+
+typedef struct {
+    struct {
+        uint32_t vendorID;
+        uint32_t productCode;
+        uint32_t revisionNumber;
+        uint32_t serialNumber;
+    } identity;
+} CO_LSS_address_t;
+
+/* Number of objects, CO_new() takes them from CO_HB_CONS_MAX and OD */
+typedef struct {
+    uint8_t CNT_NMT;
+    uint8_t CNT_EM;
+    uint8_t CNT_SDO_SRV;
+    uint8_t CNT_SYNC;
+    uint8_t CNT_RPDO;
+    uint8_t CNT_TPDO;
+    uint8_t CNT_HB_CONS;
+    uint8_t CNT_LEDS;
+    uint8_t CNT_LSS_SLV;
+} CO_config_t;
+
+typedef struct {
+    CO_CANmodule_t* CANmodule;
+    CO_CANrx_t* CANrx;
+    CO_CANtx_t* CANtx;
+    CO_NMT_t* NMT;
+    CO_EM_t* em;
+    CO_EM_fifo_t* em_fifo;
+    CO_SDOserver_t* SDOserver;
+    CO_SYNC_t* SYNC;
+    CO_HBconsumer_t* HBcons;
+    CO_RPDO_t* RPDO;
+    CO_TPDO_t* TPDO;
+    bool_t nodeIdUnconfigured;
+} CO_t;
+
+CO_t* CO_new(CO_config_t* config, uint32_t* heapMemoryUsed);
+void CO_delete(CO_t* co);
+CO_ReturnError_t CO_CANinit(CO_t* co, void* CANptr, uint16_t bitRate);
+CO_ReturnError_t CO_LSSinit(CO_t* co, CO_LSS_address_t* lssAddress, uint8_t* pendingNodeID, uint16_t* pendingBitRate);
+CO_ReturnError_t CO_CANopenInit(CO_t* co, CO_NMT_t* NMT, CO_EM_t* em, OD_t* od, OD_entry_t* OD_statusBits,
+                                uint16_t NMTcontrol, uint16_t firstHBTime_ms, uint16_t SDOserverTimeoutTime_ms,
+                                uint16_t SDOclientTimeoutTime_ms, bool_t SDOclientBlockTransfer, uint8_t nodeId,
+                                uint32_t* errInfo);
+CO_ReturnError_t CO_CANopenInitPDO(CO_t* co, CO_EM_t* em, OD_t* od, uint8_t nodeId, uint32_t* errInfo);
+CO_NMT_reset_cmd_t CO_process(CO_t* co, bool_t enableGateway, uint32_t timeDifference_us, uint32_t* timerNext_us);
+bool_t CO_process_SYNC(CO_t* co, uint32_t timeDifference_us, uint32_t* timerNext_us);
+void CO_process_RPDO(CO_t* co, bool_t syncWas, uint32_t timeDifference_us, uint32_t* timerNext_us);
+void CO_process_TPDO(CO_t* co, bool_t syncWas, uint32_t timeDifference_us, uint32_t* timerNext_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CANopen_H */
@@ -0,0 +1,70 @@
+/*
+ * Host build stand-in for the Object Dictionary, see OD.h.
+ */
+
+#include <string.h>
+
+#include "OD.h"
+
+static const OD_size_t prv_len_store[1 + OD_CNT_ARR_1010] = {1, 4, 4, 4, 4};
+static const OD_size_t prv_len_restore[1 + OD_CNT_ARR_1011] = {1, 4, 4, 4, 4};
+
+#define CO_SIM_OD_DEFINE(name)                                                                                         \
+    OD_PERSIST_COMM_t name##_PERSIST_COMM;                                                                             \
+    OD_RAM_t name##_RAM;                                                                                               \
+    static void* const name##_1010[] = {&name##_RAM.x1010_storeParameters_sub0,                                       \
+                                        &name##_RAM.x1010_storeParameters[0], &name##_RAM.x1010_storeParameters[1],    \
+                                        &name##_RAM.x1010_storeParameters[2], &name##_RAM.x1010_storeParameters[3]};   \
+    static void* const name##_1011[] = {                                                                               \
+        &name##_RAM.x1011_restoreDefaultParameters_sub0, &name##_RAM.x1011_restoreDefaultParameters[0],                \
+        &name##_RAM.x1011_restoreDefaultParameters[1], &name##_RAM.x1011_restoreDefaultParameters[2],                  \
+        &name##_RAM.x1011_restoreDefaultParameters[3]};                                                                \
+    static OD_entry_t name##_list[] = {                                                                                \
+        {0x1010, 1 + OD_CNT_ARR_1010, name##_1010, prv_len_store, NULL},                                               \
+        {0x1011, 1 + OD_CNT_ARR_1011, name##_1011, prv_len_restore, NULL},                                             \
+    };                                                                                                                 \
+    static OD_t name##_obj = {sizeof(name##_list) / sizeof(name##_list[0]), name##_list, &name##_PERSIST_COMM,         \
+                              &name##_RAM};                                                                            \
+    OD_t* name = &name##_obj;
+
+CO_SIM_OD_DEFINE(OD)
+CO_SIM_OD_DEFINE(OD1)
+CO_SIM_OD_DEFINE(OD2)
+
+static void
+prv_defaults(OD_t* od) {
+    OD_PERSIST_COMM_t* comm = od->persistComm;
+    OD_RAM_t* ram = od->ram;
+
+    memset(comm, 0, sizeof(*comm));
+    memset(ram, 0, sizeof(*ram));
+    for (uint8_t i = 0; i < od->size; i++) {
+        od->list[i].extension = NULL;
+    }
+    comm->x1000_deviceType = 0x00000191UL;
+    comm->x1016_consumerHeartbeatTime_sub0 = OD_CNT_ARR_1016;
+    comm->x1017_producerHeartbeatTime = 1000;
+    comm->x1018_identity.highestSub_indexSupported = 4;
+    comm->x1018_identity.vendor_ID = 0x00000123UL;
+    for (uint8_t i = 0; i < OD_CNT_RPDO; i++) {
+        comm->x1400_RPDOCommunicationParameter[i].highestSub_indexSupported = 5;
+        comm->x1400_RPDOCommunicationParameter[i].transmissionType = 254;
+    }
+    for (uint8_t i = 0; i < OD_CNT_TPDO; i++) {
+        comm->x1800_TPDOCommunicationParameter[i].highestSub_indexSupported = 6;
+        comm->x1800_TPDOCommunicationParameter[i].transmissionType = 254;
+    }
+    ram->x1010_storeParameters_sub0 = OD_CNT_ARR_1010;
+    ram->x1011_restoreDefaultParameters_sub0 = OD_CNT_ARR_1011;
+    for (uint8_t i = 0; i < OD_CNT_ARR_1010; i++) {
+        ram->x1010_storeParameters[i] = 0x00000001UL;
+        ram->x1011_restoreDefaultParameters[i] = 0x00000001UL;
+    }
+}
+
+void
+OD_sim_defaults(void) {
+    prv_defaults(OD);
+    prv_defaults(OD1);
+    prv_defaults(OD2);
+}
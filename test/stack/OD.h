@@ -0,0 +1,111 @@
+/*
+ * Host build stand-in for the Object Dictionary generated by CANopenEditor.
+ *
+ * Three Object Dictionaries of the same layout: OD for single-OD builds,
+ * OD1 and OD2 for CO_MULTIPLE_OD builds. Only communication parameters,
+ * which the stack stand-in (CANopen.h) reads, 0x1010/0x1011 and the mapped
+ * process data are present.
+ */
+
+#ifndef OD_H
+#define OD_H
+
+#include "301/CO_ODinterface.h"
+
+#define OD_CNT_NMT      1
+#define OD_CNT_EM       1
+#define OD_CNT_SYNC     1
+#define OD_CNT_HB_CONS  1
+#define OD_CNT_HB_PROD  1
+#define OD_CNT_SDO_SRV  1
+#define OD_CNT_RPDO     4
+#define OD_CNT_TPDO     4
+#define OD_CNT_ARR_1003 8
+#define OD_CNT_ARR_1010 4
+#define OD_CNT_ARR_1011 4
+#define OD_CNT_ARR_1016 8
+
+typedef struct {
+    uint8_t highestSub_indexSupported;
+    uint32_t COB_ID;           /* Bit 31 disables PDO, 0 is default COB-ID with node-ID */
+    uint8_t transmissionType;  /* 0..240 synchronous, 254 and 255 event driven */
+    uint16_t eventTimer;       /* TPDO only, milliseconds */
+} OD_PDOcommunicationParameter_t;
+
+typedef struct {
+    uint32_t x1000_deviceType;
+    uint32_t x1006_communicationCyclePeriod; /* microseconds */
+    uint32_t x1007_synchronousWindowLength;  /* microseconds */
+    uint8_t x1016_consumerHeartbeatTime_sub0;
+    uint32_t x1016_consumerHeartbeatTime[OD_CNT_ARR_1016]; /* node-ID << 16 | milliseconds */
+    uint16_t x1017_producerHeartbeatTime;                  /* milliseconds */
+    struct {
+        uint8_t highestSub_indexSupported;
+        uint32_t vendor_ID;
+        uint32_t productCode;
+        uint32_t revisionNumber;
+        uint32_t serialNumber;
+    } x1018_identity;
+    OD_PDOcommunicationParameter_t x1400_RPDOCommunicationParameter[OD_CNT_RPDO];
+    OD_PDOcommunicationParameter_t x1800_TPDOCommunicationParameter[OD_CNT_TPDO];
+} OD_PERSIST_COMM_t;
+
+typedef struct {
+    uint8_t x1010_storeParameters_sub0;
+    uint32_t x1010_storeParameters[OD_CNT_ARR_1010];
+    uint8_t x1011_restoreDefaultParameters_sub0;
+    uint32_t x1011_restoreDefaultParameters[OD_CNT_ARR_1011];
+    uint8_t x6000_readInput8Bit[8 * OD_CNT_TPDO];   /* Mapped to TPDOs, 8 bytes each */
+    uint8_t x6200_writeOutput8Bit[8 * OD_CNT_RPDO]; /* Mapped from RPDOs, 8 bytes each */
+} OD_RAM_t;
+
+/* Object Dictionary with its variables, see CO_ODinterface.h */
+#define CO_SIM_OD_DECLARE(name)                                                                                        \
+    extern OD_PERSIST_COMM_t name##_PERSIST_COMM;                                                                      \
+    extern OD_RAM_t name##_RAM;                                                                                        \
+    extern OD_t* name;
+
+CO_SIM_OD_DECLARE(OD)
+CO_SIM_OD_DECLARE(OD1)
+CO_SIM_OD_DECLARE(OD2)
+
+/* Default values of OD_PERSIST_COMM and OD_RAM of all Object Dictionaries */
+void OD_sim_defaults(void);
+
+#define OD_INIT_CONFIG(config)                                                                                         \
+    do {                                                                                                               \
+        (config).CNT_NMT = OD_CNT_NMT;                                                                                 \
+        (config).CNT_EM = OD_CNT_EM;                                                                                   \
+        (config).CNT_SDO_SRV = OD_CNT_SDO_SRV;                                                                         \
+        (config).CNT_SYNC = OD_CNT_SYNC;                                                                               \
+        (config).CNT_RPDO = OD_CNT_RPDO;                                                                               \
+        (config).CNT_TPDO = OD_CNT_TPDO;                                                                               \
+        (config).CNT_HB_CONS = OD_CNT_HB_CONS;                                                                         \
+    } while (0)
+#define OD1_INIT_CONFIG(config) OD_INIT_CONFIG(config)
+#define OD2_INIT_CONFIG(config) OD_INIT_CONFIG(config)
+
+/* Counts of OD1 and OD2, same as OD, optional objects are absent in all.
+ * CO_app_STM32.h sizes memory arena of each port from them. */
+#define OD1_CNT_NMT      OD_CNT_NMT
+#define OD1_CNT_EM       OD_CNT_EM
+#define OD1_CNT_SYNC     OD_CNT_SYNC
+#define OD1_CNT_HB_CONS  OD_CNT_HB_CONS
+#define OD1_CNT_HB_PROD  OD_CNT_HB_PROD
+#define OD1_CNT_SDO_SRV  OD_CNT_SDO_SRV
+#define OD1_CNT_RPDO     OD_CNT_RPDO
+#define OD1_CNT_TPDO     OD_CNT_TPDO
+#define OD1_CNT_ARR_1003 OD_CNT_ARR_1003
+#define OD1_CNT_ARR_1016 OD_CNT_ARR_1016
+#define OD2_CNT_NMT      OD_CNT_NMT
+#define OD2_CNT_EM       OD_CNT_EM
+#define OD2_CNT_SYNC     OD_CNT_SYNC
+#define OD2_CNT_HB_CONS  OD_CNT_HB_CONS
+#define OD2_CNT_HB_PROD  OD_CNT_HB_PROD
+#define OD2_CNT_SDO_SRV  OD_CNT_SDO_SRV
+#define OD2_CNT_RPDO     OD_CNT_RPDO
+#define OD2_CNT_TPDO     OD_CNT_TPDO
+#define OD2_CNT_ARR_1003 OD_CNT_ARR_1003
+#define OD2_CNT_ARR_1016 OD_CNT_ARR_1016
+
+#endif /* OD_H */
@@ -0,0 +1,2 @@
+/* Host build stand-in, see OD.h */
+#include "OD.h"
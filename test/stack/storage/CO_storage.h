@@ -0,0 +1,44 @@
+/*
+ * Host build stand-in for CANopenNode storage/CO_storage.h.
+ */
+
+#ifndef CO_STORAGE_H
+#define CO_STORAGE_H
+
+#include "301/CO_driver.h"
+#include "301/CO_ODinterface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CO_storage_cmd = 0x01,
+    CO_storage_auto = 0x02,
+    CO_storage_restore = 0x04
+} CO_storage_attributes_t;
+
+typedef struct {
+    OD_extension_t OD_1010_extension;
+    OD_extension_t OD_1011_extension;
+    CO_CANmodule_t* CANmodule;
+    ODR_t (*store)(CO_storage_entry_t* entry, CO_CANmodule_t* CANmodule);
+    ODR_t (*restore)(CO_storage_entry_t* entry, CO_CANmodule_t* CANmodule);
+    CO_storage_entry_t* entries;
+    uint8_t entriesCount;
+} CO_storage_t;
+
+/* Initializes OD extensions of 0x1010 and 0x1011. Writing "save" (0x65766173)
+ * to 0x1010 sub-index N calls store of entries with subIndexOD N (1: all
+ * entries with CO_storage_cmd), "load" (0x64616F6C) to 0x1011 restore. */
+CO_ReturnError_t CO_storage_init(CO_storage_t* storage, CO_CANmodule_t* CANmodule,
+                                 OD_entry_t* OD_1010_StoreParameters, OD_entry_t* OD_1011_RestoreDefaultParameters,
+                                 ODR_t (*store)(CO_storage_entry_t* entry, CO_CANmodule_t* CANmodule),
+                                 ODR_t (*restore)(CO_storage_entry_t* entry, CO_CANmodule_t* CANmodule),
+                                 CO_storage_entry_t* entries, uint8_t entriesCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CO_STORAGE_H */
@@ -0,0 +1,275 @@
+/*
+ * Test of log structured flash storage on simulated flash.
+ *
+ * Power loss: a sequence of store commands, auto stores, restores and
+ * compactions is cut at its Nth flash operation, for every N. The torn unit
+ * reads with ECC error. After re-initialization every entry must hold the
+ * data of its last completed store or of the one, which was cut, and
+ * storage must keep working.
+ *
+ * Wear: many stores on a small region, erase counts of pages must stay
+ * within one of each other. Reports erase counts, bytes programmed and
+ * store latency in flash operations, with STM32G4 program and erase times.
+ * CO_storageFlash_process() with no time budget must do one step per
+ * call, also when it compacts.
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "co_test.h"
+#include "CO_storageFlash.h"
+
+#define TEST_BASE       0x08070000UL
+#define TEST_PAGE_SIZE  256U
+#define TEST_PAGES      4U
+#define TEST_STEPS      64U   /* Steps of power loss sequence */
+#define TEST_WEAR_STEPS 20000U
+#define TEST_PROGRAM_US 82U    /* STM32G4 double word program time */
+#define TEST_ERASE_US   22000U /* STM32G4 page erase time */
+
+#define TEST_A       0U /* Entry stored by command and restored */
+#define TEST_B       1U /* Entry stored automatically */
+#define TEST_C       2U /* Entry stored rarely, compaction copies its record */
+#define TEST_ENTRIES 3U
+
+static uint8_t prv_memory[TEST_PAGES * TEST_PAGE_SIZE];
+static uint8_t prv_torn[TEST_PAGES * TEST_PAGE_SIZE / CO_STORAGE_FLASH_ALIGN];
+static CO_storageFlash_sim_t prv_sim = {
+    .memory = prv_memory, .torn = prv_torn, .base = TEST_BASE, .size = sizeof(prv_memory), .pageSize = TEST_PAGE_SIZE};
+static const CO_storageFlash_region_t prv_region = {TEST_BASE,
+                                                    TEST_PAGE_SIZE,
+                                                    TEST_PAGES,
+                                                    &prv_sim,
+                                                    CO_storageFlash_simRead,
+                                                    CO_storageFlash_simProgram,
+                                                    CO_storageFlash_simErase};
+
+static CO_CANmodule_t prv_module;
+static CO_storage_t prv_storage;
+static CO_storageFlash_t prv_flash;
+static uint8_t prv_a[24];
+static uint8_t prv_b[8];
+static uint8_t prv_c[16];
+static uint8_t* const prv_data[TEST_ENTRIES] = {prv_a, prv_b, prv_c};
+static const size_t prv_len[TEST_ENTRIES] = {sizeof(prv_a), sizeof(prv_b), sizeof(prv_c)};
+static CO_storage_entry_t prv_entries[TEST_ENTRIES];
+static uint32_t prv_stepOpsMax; /* Flash operations of one CO_storageFlash_process() call */
+
+/* Version of entry data, 0 is default, -1 none */
+static int32_t prv_committed[TEST_ENTRIES];
+static int32_t prv_pending[TEST_ENTRIES];
+
+static uint8_t
+prv_pattern(uint8_t entry, int32_t version, size_t i) {
+    return (uint8_t)(version == 0 ? 0xA5 ^ (int32_t)i : version * 7 + (int32_t)i + entry * 64);
+}
+
+static void
+prv_fill(uint8_t entry, int32_t version) {
+    for (size_t i = 0U; i < prv_len[entry]; i++) {
+        prv_data[entry][i] = prv_pattern(entry, version, i);
+    }
+}
+
+static bool
+prv_holds(uint8_t entry, int32_t version) {
+    for (size_t i = 0U; i < prv_len[entry]; i++) {
+        if (version < 0 || prv_data[entry][i] != prv_pattern(entry, version, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Power on with default values, power is lost again at powerFail flash
+ * operation, if not 0. Return result of init. */
+static CO_ReturnError_t
+prv_power_on(uint32_t powerFail) {
+    uint32_t initError;
+
+    prv_sim.powerLost = false;
+    prv_sim.powerFail = powerFail;
+    for (uint8_t entry = 0U; entry < TEST_ENTRIES; entry++) {
+        prv_fill(entry, 0);
+        prv_entries[entry] = (CO_storage_entry_t){.addr = prv_data[entry],
+                                                  .len = prv_len[entry],
+                                                  .subIndexOD = (uint8_t)(2U + entry),
+                                                  .attr = entry == TEST_B ? CO_storage_auto : CO_storage_cmd};
+    }
+    prv_entries[TEST_A].attr |= CO_storage_restore;
+    return CO_storageFlash_init(&prv_flash, &prv_storage, &prv_module, NULL, NULL, &prv_region, prv_entries,
+                                TEST_ENTRIES, &initError);
+}
+
+static void
+prv_blank(void) {
+    memset(prv_memory, 0xFF, sizeof(prv_memory));
+    memset(prv_torn, 0, sizeof(prv_torn));
+    memset(prv_sim.erases, 0, sizeof(prv_sim.erases));
+    prv_sim.operations = 0U;
+    prv_sim.eccErrors = 0U;
+}
+
+/* Auto store of changed entry B, false on flash error */
+static bool
+prv_auto_store(void) {
+    uint32_t stores = prv_flash.stats.stores;
+
+    for (uint32_t i = 0U; i < 1000U && prv_flash.stats.stores == stores; i++) {
+        uint32_t operations = prv_sim.operations;
+
+        if (!CO_storageFlash_process(&prv_flash, 0U)) {
+            return false;
+        }
+        if (prv_sim.operations - operations > prv_stepOpsMax) {
+            prv_stepOpsMax = prv_sim.operations - operations;
+        }
+    }
+    return prv_flash.stats.stores != stores;
+}
+
+/* Store, auto store and restore until a flash operation fails, return
+ * false then. Flash operations of the longest step are counted in maxOps. */
+static bool
+prv_sequence(uint32_t steps, uint32_t* maxOps) {
+    for (uint32_t s = 1U; s <= steps; s++) {
+        uint8_t entry = s % 4U == 2U ? TEST_B : s % 32U == 1U ? TEST_C : TEST_A;
+        int32_t version = s % 12U == 3U ? 0 : (int32_t)s;
+        uint32_t operations = prv_sim.operations;
+        bool ok;
+
+        prv_pending[entry] = version;
+        if (entry == TEST_B) {
+            prv_fill(TEST_B, version);
+            ok = prv_auto_store();
+        } else if (version == 0) {
+            ok = prv_storage.restore(&prv_entries[TEST_A], NULL) == ODR_OK;
+        } else {
+            prv_fill(entry, version);
+            ok = prv_storage.store(&prv_entries[entry], NULL) == ODR_OK;
+        }
+        if (!ok) {
+            return false;
+        }
+        prv_committed[entry] = version;
+        prv_pending[entry] = -1;
+        if (maxOps != NULL && prv_sim.operations - operations > *maxOps) {
+            *maxOps = prv_sim.operations - operations;
+        }
+    }
+    return true;
+}
+
+/* Entry holds data of its last store or of the interrupted one */
+static void
+prv_check_entry(uint8_t entry, uint32_t cut) {
+    TEST_CHECK(prv_holds(entry, prv_committed[entry]) || prv_holds(entry, prv_pending[entry]),
+               "cut at %u: entry %u is neither version %d nor %d", (unsigned)cut, (unsigned)entry,
+               (int)prv_committed[entry], (int)prv_pending[entry]);
+}
+
+static void
+prv_test_power_loss(void) {
+    uint32_t total;
+    uint32_t eccErrors = 0U;
+
+    /* Operations of the whole sequence, from blank flash */
+    prv_blank();
+    if (prv_power_on(0U) != CO_ERROR_NO || !prv_sequence(TEST_STEPS, NULL)) {
+        printf("FAIL: sequence without power loss\n");
+        exit(1);
+    }
+    total = prv_sim.operations;
+
+    for (uint32_t cut = 1U; cut <= total; cut++) {
+        CO_ReturnError_t err;
+
+        prv_blank();
+        memset(prv_committed, 0, sizeof(prv_committed));
+        memset(prv_pending, 0xFF, sizeof(prv_pending));
+        if (prv_power_on(cut) == CO_ERROR_NO) {
+            (void)prv_sequence(TEST_STEPS, NULL);
+        }
+        TEST_CHECK(prv_sim.powerLost, "cut at %u: power was not lost", (unsigned)cut);
+
+        err = prv_power_on(0U);
+        eccErrors += prv_sim.eccErrors;
+        TEST_CHECK(err == CO_ERROR_NO, "cut at %u: init %d", (unsigned)cut, err);
+        for (uint8_t entry = 0U; entry < TEST_ENTRIES; entry++) {
+            prv_check_entry(entry, cut);
+        }
+
+        /* Storage keeps working */
+        prv_committed[TEST_A] = 1000;
+        prv_committed[TEST_B] = 1001;
+        prv_fill(TEST_A, 1000);
+        prv_fill(TEST_B, 1001);
+        TEST_CHECK(prv_storage.store(&prv_entries[TEST_A], NULL) == ODR_OK && prv_auto_store(),
+                   "cut at %u: store after power loss", (unsigned)cut);
+        TEST_CHECK(prv_power_on(0U) == CO_ERROR_NO, "cut at %u: init after store", (unsigned)cut);
+        TEST_CHECK(prv_holds(TEST_A, 1000) && prv_holds(TEST_B, 1001), "cut at %u: store after power loss lost",
+                   (unsigned)cut);
+    }
+    printf("power loss: cut at each of %u flash operations, %u torn unit reads\n", (unsigned)total,
+           (unsigned)eccErrors);
+}
+
+static void
+prv_test_wear(void) {
+    uint32_t maxOps = 0U;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0U;
+
+    prv_blank();
+    if (prv_power_on(0U) != CO_ERROR_NO || !prv_sequence(TEST_WEAR_STEPS, &maxOps)) {
+        printf("FAIL: wear sequence\n");
+        exit(1);
+    }
+    printf("wear: %u steps, %u records, %u unchanged, %u bytes programmed, %u compactions\n",
+           (unsigned)TEST_WEAR_STEPS, (unsigned)prv_flash.stats.stores, (unsigned)prv_flash.stats.unchanged,
+           (unsigned)prv_flash.stats.bytes, (unsigned)prv_flash.stats.compactions);
+    printf("erases per page:");
+    for (uint8_t page = 0U; page < TEST_PAGES; page++) {
+        printf(" %u", (unsigned)prv_sim.erases[page]);
+        TEST_CHECK(prv_flash.eraseCount[page] == prv_sim.erases[page], "page %u erase count %u, erased %u times",
+                   (unsigned)page, (unsigned)prv_flash.eraseCount[page], (unsigned)prv_sim.erases[page]);
+        min = prv_sim.erases[page] < min ? prv_sim.erases[page] : min;
+        max = prv_sim.erases[page] > max ? prv_sim.erases[page] : max;
+    }
+    printf(", %.1f records per erase\n", (double)prv_flash.stats.stores / (max > 0U ? max * TEST_PAGES : 1U));
+    TEST_CHECK(max - min <= 1U, "erase counts %u .. %u", (unsigned)min, (unsigned)max);
+
+    /* Longest step is a record with compaction: copies and one erase */
+    printf("store latency: max %u flash operations, about %.1f ms on STM32G4\n", (unsigned)maxOps,
+           ((maxOps - 1U) * TEST_PROGRAM_US + TEST_ERASE_US) / 1000.0);
+    /* Auto store and compaction do one step with no time budget left: a
+     * programming unit, or page erase with erase count of the page */
+    printf("auto store: max %u flash operations per CO_storageFlash_process() call\n", (unsigned)prv_stepOpsMax);
+    TEST_CHECK(prv_stepOpsMax <= 2U, "%u flash operations in one call with budget 0", (unsigned)prv_stepOpsMax);
+}
+
+int
+main(void) {
+    co_sim_reset();
+    prv_test_power_loss();
+    prv_test_wear();
+
+    return co_test_result("storage flash");
+}